@@ -0,0 +1,346 @@
+// arp.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "arp.h"
+#include "ethernet.h"
+#include "timers.h"
+#include "uart0.h"
+
+arpEntry arpCache[ARP_CACHE_SIZE];
+arpPending arpQueue[ARP_PENDING_SLOTS];
+timerHandle arpTimer = TIMER_INVALID; // Wakes the main loop when an entry is due
+
+// Empty cache and queue, called at boot and again by dhcp and the shell when the local address changes
+void initArp(void)
+{
+    memset(arpCache, 0, sizeof(arpCache));
+    memset(arpQueue, 0, sizeof(arpQueue));
+}
+
+// Hosts on a LAN mostly differ in the last octets
+uint8_t arpHash(uint8_t ip[])
+{
+    return (ip[3] ^ ip[2]) & (ARP_CACHE_SIZE - 1);
+}
+
+// Address frames for ip are sent to, the gateway when ip is outside the subnet
+void arpNextHop(uint8_t ip[], uint8_t hop[])
+{
+    uint8_t i;
+
+    for(i = 0; i < IP_ADD_LENGTH; i++)
+    {
+        if((ip[i] & ipSubnetMask[i]) != (ipAddress[i] & ipSubnetMask[i]))
+        {
+            setAddressInfo(hop, ipGwAddress, IP_ADD_LENGTH);
+            return;
+        }
+    }
+
+    setAddressInfo(hop, ip, IP_ADD_LENGTH);
+}
+
+// Limited or subnet-directed broadcast, sent to the broadcast MAC
+bool arpIsBroadcast(uint8_t ip[])
+{
+    uint8_t i;
+    bool limited = true, directed = true;
+
+    for(i = 0; i < IP_ADD_LENGTH; i++)
+    {
+        limited  &= (ip[i] == 0xFF);
+        directed &= ((ip[i] | ipSubnetMask[i]) == 0xFF) && ((ip[i] & ipSubnetMask[i]) == (ipAddress[i] & ipSubnetMask[i]));
+    }
+
+    return limited || (directed && ipSubnetMask[IP_ADD_LENGTH - 1] != 0xFF);
+}
+
+// Returns entry for ip or NULL
+arpEntry* arpFind(uint8_t ip[])
+{
+    uint8_t i, slot = arpHash(ip);
+
+    for(i = 0; i < ARP_PROBE_SLOTS; i++)
+    {
+        arpEntry* entry = &arpCache[(slot + i) & (ARP_CACHE_SIZE - 1)];
+
+        if(entry->state != ARP_FREE && memcmp(entry->ip, ip, IP_ADD_LENGTH) == 0)
+            return entry;
+    }
+
+    return NULL;
+}
+
+// Entry for ip in its probe window, a free one or else the oldest is reused.
+// Frames still waiting on a reused entry are dropped with it.
+arpEntry* arpInsert(uint8_t ip[])
+{
+    uint8_t i, slot = arpHash(ip);
+    arpEntry* oldest = NULL;
+
+    for(i = 0; i < ARP_PROBE_SLOTS; i++)
+    {
+        arpEntry* entry = &arpCache[(slot + i) & (ARP_CACHE_SIZE - 1)];
+
+        if(entry->state == ARP_FREE)
+        {
+            oldest = entry;
+            break;
+        }
+        if(oldest == NULL || (int32_t)(entry->time - oldest->time) < 0)
+            oldest = entry;
+    }
+
+    if(oldest->state != ARP_FREE)
+        arpFlush(oldest->ip, NULL);
+
+    memset(oldest, 0, sizeof(arpEntry));
+    setAddressInfo(oldest->ip, ip, IP_ADD_LENGTH);
+
+    return oldest;
+}
+
+// Broadcast a request for ip, or unicast it to mac when refreshing an entry
+void arpSendRequest(uint8_t ip[], uint8_t mac[])
+{
+    uint8_t frame[42];
+    uint8_t i;
+
+    etherFrame* ether = (etherFrame*)frame;
+    arpFrame* arp = (arpFrame*)&ether->data;
+
+    for(i = 0; i < HW_ADD_LENGTH; i++)
+    {
+        ether->destAddress[i] = (mac != NULL) ? mac[i] : 0xFF;
+        ether->sourceAddress[i] = macAddress[i];
+        arp->sourceAddress[i] = macAddress[i];
+        arp->destAddress[i] = 0;
+    }
+
+    ether->frameType = htons(0x0806);
+
+    arp->hardwareType = htons(1);
+    arp->protocolType = htons(0x0800);
+    arp->hardwareSize = 6;
+    arp->protocolSize = 4;
+    arp->op = htons(1);
+
+    setAddressInfo(arp->sourceIp, ipAddress, IP_ADD_LENGTH);
+    setAddressInfo(arp->destIp, ip, IP_ADD_LENGTH);
+
+    etherPutPacket(frame, 42);
+}
+
+// Copies MAC for ip into mac and returns true when known. Otherwise a request
+// is sent, unless one already is outstanding, and false is returned.
+bool arpLookup(uint8_t ip[], uint8_t mac[])
+{
+    arpEntry* entry;
+    uint8_t hop[IP_ADD_LENGTH];
+
+    if(arpIsBroadcast(ip))
+    {
+        memset(mac, 0xFF, HW_ADD_LENGTH);
+        return true;
+    }
+
+    arpNextHop(ip, hop);
+
+    entry = arpFind(hop);
+
+    if(entry == NULL)
+    {
+        entry = arpInsert(hop);
+        entry->state = ARP_PENDING;
+        entry->time = timerGetTicks();
+        arpSendRequest(hop, NULL);
+        return false;
+    }
+
+    if(entry->state == ARP_PENDING)
+        return false;
+
+    setAddressInfo(mac, entry->mac, HW_ADD_LENGTH);
+    return true;
+}
+
+// Fills destination MAC of an IP frame, false if it is not known yet
+bool arpResolve(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+
+    return arpLookup(ip->destIp, ether->destAddress);
+}
+
+// Sends an IP frame, holding it until the next hop is resolved
+void arpSendPacket(uint8_t packet[], uint16_t size)
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    uint8_t i;
+
+    if(arpResolve(packet))
+    {
+        etherPutPacket(packet, size);
+        return;
+    }
+
+    if(size > ARP_PENDING_SIZE)
+        return;
+
+    for(i = 0; i < ARP_PENDING_SLOTS; i++)
+    {
+        if(arpQueue[i].size == 0)
+        {
+            arpNextHop(ip->destIp, arpQueue[i].ip);
+            memcpy(arpQueue[i].frame, packet, size);
+            arpQueue[i].size = size;
+            return;
+        }
+    }
+}
+
+// Send or drop frames waiting on ip
+void arpFlush(uint8_t ip[], uint8_t mac[])
+{
+    uint8_t i;
+
+    for(i = 0; i < ARP_PENDING_SLOTS; i++)
+    {
+        if(arpQueue[i].size != 0 && memcmp(arpQueue[i].ip, ip, IP_ADD_LENGTH) == 0)
+        {
+            if(mac != NULL)
+            {
+                setAddressInfo(arpQueue[i].frame, mac, HW_ADD_LENGTH);
+                etherPutPacket(arpQueue[i].frame, arpQueue[i].size);
+            }
+            arpQueue[i].size = 0;
+        }
+    }
+}
+
+// Learn sender of an ARP request or reply (RFC826). A sender already cached
+// is updated, a new one is added only when the packet is for this device.
+void arpReceived(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+    arpFrame* arp = (arpFrame*)&ether->data;
+    arpEntry* entry;
+    uint8_t i;
+    bool zero = true;
+
+    for(i = 0; i < IP_ADD_LENGTH; i++)
+        zero &= (arp->sourceIp[i] == 0);
+
+    // Probes have no sender address to learn
+    if(zero)
+        return;
+
+    entry = arpFind(arp->sourceIp);
+
+    if(entry == NULL)
+    {
+        if(memcmp(arp->destIp, ipAddress, IP_ADD_LENGTH) != 0)
+            return;
+        entry = arpInsert(arp->sourceIp);
+    }
+
+    setAddressInfo(entry->mac, arp->sourceAddress, HW_ADD_LENGTH);
+    entry->state = ARP_RESOLVED;
+    entry->retries = 0;
+    entry->time = timerGetTicks();
+
+    arpFlush(entry->ip, entry->mac);
+}
+
+// Nothing to do here, expiring wakes the main loop which calls arpPoll
+void arpTimerExpired(void)
+{
+}
+
+// Refresh aged entries, repeat unanswered requests and give up on dead hosts
+void arpPoll(void)
+{
+    uint8_t i;
+    arpEntry* entry;
+    uint32_t now = timerGetTicks();
+    uint32_t wait = 0, left;
+
+    for(i = 0; i < ARP_CACHE_SIZE; i++)
+    {
+        entry = &arpCache[i];
+
+        if(entry->state == ARP_RESOLVED)
+        {
+            if((now - entry->time) >= ARP_ENTRY_TIME)
+            {
+                entry->state = ARP_REFRESH;
+                entry->retries = 0;
+                entry->time = now;
+                arpSendRequest(entry->ip, entry->mac);
+            }
+        }
+        else if(entry->state != ARP_FREE && (now - entry->time) >= ARP_RETRY_TIME)
+        {
+            if(entry->retries >= ARP_MAX_RETRIES)
+            {
+                arpFlush(entry->ip, NULL);
+                entry->state = ARP_FREE;
+                continue;
+            }
+
+            entry->retries++;
+            entry->time = now;
+            arpSendRequest(entry->ip, (entry->state == ARP_REFRESH) ? entry->mac : NULL);
+        }
+    }
+
+    // The main loop sleeps between interrupts, have one when the next entry is due
+    for(i = 0; i < ARP_CACHE_SIZE; i++)
+    {
+        entry = &arpCache[i];
+        if(entry->state == ARP_FREE)
+            continue;
+
+        left = ((entry->state == ARP_RESOLVED) ? ARP_ENTRY_TIME : ARP_RETRY_TIME) - (now - entry->time);
+        if(wait == 0 || left < wait)
+            wait = left;
+    }
+
+    timerStop(arpTimer);
+    arpTimer = (wait != 0) ? timerStart(arpTimerExpired, wait, false) : TIMER_INVALID;
+}
+
+// Print cache entries to terminal
+void arpPrint(void)
+{
+    const char* const states[] = {"free", "pending", "resolved", "refresh"};
+    uint8_t i;
+    arpEntry* entry;
+
+    for(i = 0; i < ARP_CACHE_SIZE; i++)
+    {
+        entry = &arpCache[i];
+
+        if(entry->state == ARP_FREE)
+            continue;
+
+        printfUart0(UART0_BLOCK, "  %u.%u.%u.%u  %02X:%02X:%02X:%02X:%02X:%02X  %s\r\n",
+                    entry->ip[0], entry->ip[1], entry->ip[2], entry->ip[3],
+                    entry->mac[0], entry->mac[1], entry->mac[2],
+                    entry->mac[3], entry->mac[4], entry->mac[5], states[entry->state]);
+    }
+}
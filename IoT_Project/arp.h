@@ -0,0 +1,75 @@
+// arp.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef ARP_H_
+#define ARP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ARP cache
+// Entries are hashed on the IP address and probed over a short window, so a
+// lookup touches at most ARP_PROBE_SLOTS entries. IP frames sent while a
+// request is outstanding wait in a small queue and go out when the reply
+// arrives. Destinations outside the subnet resolve to the gateway.
+
+#define ARP_CACHE_SIZE    16      // Must be a power of 2
+#define ARP_PROBE_SLOTS   4       // Entries searched from the hashed one
+#define ARP_ENTRY_TIME    300000  // Refresh an entry after ms
+#define ARP_RETRY_TIME    1000    // Repeat an unanswered request after ms
+#define ARP_MAX_RETRIES   3       // Requests before entry and its frames are dropped
+#define ARP_PENDING_SLOTS 2       // Frames waiting on a reply
+#define ARP_PENDING_SIZE  256     // Larger frames are dropped, TCP resends them
+
+typedef enum
+{
+    ARP_FREE,
+    ARP_PENDING,  // Request sent, no MAC yet
+    ARP_RESOLVED,
+    ARP_REFRESH   // Entry aged, MAC still used while a new request is sent
+} arpState;
+
+typedef struct _arpEntry
+{
+    uint8_t  ip[4];
+    uint8_t  mac[6];
+    uint8_t  state;
+    uint8_t  retries;
+    uint32_t time;    // timerGetTicks() when resolved or last request sent
+} arpEntry;
+
+typedef struct _arpPending
+{
+    uint8_t  ip[4];   // Next hop the frame is waiting on
+    uint16_t size;    // 0 when slot is free
+    uint8_t  frame[ARP_PENDING_SIZE];
+} arpPending;
+
+extern arpEntry arpCache[ARP_CACHE_SIZE];
+
+void initArp(void);
+uint8_t arpHash(uint8_t ip[]);
+void arpNextHop(uint8_t ip[], uint8_t hop[]);
+bool arpIsBroadcast(uint8_t ip[]);
+arpEntry* arpFind(uint8_t ip[]);
+arpEntry* arpInsert(uint8_t ip[]);
+bool arpLookup(uint8_t ip[], uint8_t mac[]);
+bool arpResolve(uint8_t packet[]);
+void arpSendPacket(uint8_t packet[], uint16_t size);
+void arpFlush(uint8_t ip[], uint8_t mac[]);
+void arpReceived(uint8_t packet[]);
+void arpSendRequest(uint8_t ip[], uint8_t mac[]);
+void arpTimerExpired(void);
+void arpPoll(void);
+void arpPrint(void);
+
+#endif
@@ -0,0 +1,130 @@
+// checksum.c
+// agent
+// Created on: October 17, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#include "checksum.h"
+
+// Folds a 64-bit accumulator down to 16 bits with end-around carry
+static uint16_t checksumFold64(uint64_t acc)
+{
+    while ((acc >> 16) > 0)
+        acc = (acc & 0xFFFF) + (acc >> 16);
+    return (uint16_t)acc;
+}
+
+// Adds data to a partial sum, 32 bits at a time with carries deferred to the end
+// The first byte of data is always treated as the low byte of a 16-bit word (same as etherSumWords)
+uint32_t checksumAdd(uint32_t sum, const void* data, uint16_t sizeInBytes)
+{
+    const uint8_t* pData = (const uint8_t*)data;
+    uint64_t acc = 0;
+    uint16_t folded;
+    bool swapped = false;
+
+    if (sizeInBytes == 0)
+        return sum;
+
+    // On an odd address take the first byte on its own, the rest of the data
+    // is then summed one byte out of phase and swapped back at the end (RFC1071 2.B)
+    if (((uintptr_t)pData & 1) != 0)
+    {
+        sum += *pData++;
+        sizeInBytes--;
+        swapped = true;
+    }
+
+    // Get to a word boundary
+    if (((uintptr_t)pData & 2) != 0 && sizeInBytes >= 2)
+    {
+        acc += *(const uint16_t*)pData;
+        pData += 2;
+        sizeInBytes -= 2;
+    }
+
+    // Main loop, four words per pass
+    while (sizeInBytes >= 16)
+    {
+        acc += ((const uint32_t*)pData)[0];
+        acc += ((const uint32_t*)pData)[1];
+        acc += ((const uint32_t*)pData)[2];
+        acc += ((const uint32_t*)pData)[3];
+        pData += 16;
+        sizeInBytes -= 16;
+    }
+
+    while (sizeInBytes >= 4)
+    {
+        acc += *(const uint32_t*)pData;
+        pData += 4;
+        sizeInBytes -= 4;
+    }
+
+    if (sizeInBytes >= 2)
+    {
+        acc += *(const uint16_t*)pData;
+        pData += 2;
+        sizeInBytes -= 2;
+    }
+
+    // Trailing byte is the low byte of a word padded with zero
+    if (sizeInBytes > 0)
+        acc += *pData;
+
+    folded = checksumFold64(acc);
+    if (swapped)
+        folded = (folded >> 8) | (folded << 8);
+
+    return sum + folded;
+}
+
+// Adds data that sits at offset bytes into the summed region but is not
+// contiguous with it (e.g. a payload streamed from another buffer).
+// Data at an odd offset lands in the high byte of each word, so its sum is swapped.
+uint32_t checksumAddAt(uint32_t sum, const void* data, uint16_t sizeInBytes, uint16_t offset)
+{
+    uint16_t folded;
+
+    if ((offset & 1) == 0)
+        return checksumAdd(sum, data, sizeInBytes);
+
+    folded = checksumFold64(checksumAdd(0, data, sizeInBytes));
+
+    return sum + (uint16_t)((folded >> 8) | (folded << 8));
+}
+
+// Completes 1's compliment addition by folding carries back into field
+uint16_t checksumFold(uint32_t sum)
+{
+    return ~checksumFold64(sum);
+}
+
+// Incrementally updates a checksum when one 16-bit field changes
+// HC' = ~(~HC + ~m + m') (RFC1624 eqn. 3)
+uint16_t checksumUpdate16(uint16_t check, uint16_t oldValue, uint16_t newValue)
+{
+    uint32_t tmp32;
+    tmp32 = (uint16_t)~check;
+    tmp32 += (uint16_t)~oldValue;
+    tmp32 += newValue;
+    return checksumFold(tmp32);
+}
+
+// Incrementally updates a checksum when one 32-bit field changes (e.g. seq or ack number)
+uint16_t checksumUpdate32(uint16_t check, uint32_t oldValue, uint32_t newValue)
+{
+    uint32_t tmp32;
+    tmp32 = (uint16_t)~check;
+    tmp32 += (uint16_t)~oldValue;
+    tmp32 += (uint16_t)~(oldValue >> 16);
+    tmp32 += newValue & 0xFFFF;
+    tmp32 += newValue >> 16;
+    return checksumFold(tmp32);
+}
@@ -0,0 +1,30 @@
+// checksum.h
+// agent
+// Created on: October 17, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef CHECKSUM_H_
+#define CHECKSUM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Internet checksum (RFC1071) helpers
+// Sums are kept in the byte order the data has in memory, so a folded result
+// can be stored straight into a header field without htons.
+// All functions are reentrant, partial sums are passed in and returned.
+
+uint32_t checksumAdd(uint32_t sum, const void* data, uint16_t sizeInBytes);
+uint32_t checksumAddAt(uint32_t sum, const void* data, uint16_t sizeInBytes, uint16_t offset);
+uint16_t checksumFold(uint32_t sum);
+uint16_t checksumUpdate16(uint16_t check, uint16_t oldValue, uint16_t newValue);
+uint16_t checksumUpdate32(uint16_t check, uint32_t oldValue, uint32_t newValue);
+
+#endif /* CHECKSUM_H_ */
@@ -0,0 +1,155 @@
+// console.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// UART0 transmit ring and formatted output, declared in uart0.h
+// Messages are queued here and sent by uart0TxStart in uart0.c.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdarg.h>
+#include "uart0.h"
+#include "ethernet.h"
+#include "format.h"
+
+UART0_BUFFER uart0Info = {0};
+uint32_t uart0DroppedBytes = 0;
+uint32_t uart0DroppedMessages = 0;
+
+// Add characters to UART0 TX ring, waits for room
+void sendUart0String(char str[])
+{
+    uart0Write(str, strlen(str), UART0_BLOCK);
+}
+
+// Add characters to UART0 TX ring, waits for room
+void sendUart0StringLiteral(const char str[])
+{
+    uart0Write(str, strlen(str), UART0_BLOCK);
+}
+
+// Returns free bytes in the TX ring
+uint16_t uart0TxSpace(void)
+{
+    return QUEUE_BUFFER_LENGTH - (uint16_t)(uart0Info.writeIndex - uart0Info.readIndex);
+}
+
+// Copy size bytes into the TX ring and start sending them. With UART0_DROP
+// nothing is copied unless all of it fits, the loss is counted instead.
+// Returns false if the message was dropped.
+bool uart0Write(const char str[], uint16_t size, uint8_t policy)
+{
+    uint16_t i, room, start;
+
+    if(policy == UART0_DROP && uart0TxSpace() < size)
+    {
+        uart0DroppedBytes += size;
+        uart0DroppedMessages++;
+        return false;
+    }
+
+    while(size != 0)
+    {
+        // Only uart0Isr makes room, by finishing a transfer
+        while((room = uart0TxSpace()) == 0);
+        if(room > size)
+            room = size;
+
+        for(i = 0; i < room; i++)
+        {
+            start = (uart0Info.writeIndex + i) & (QUEUE_BUFFER_LENGTH - 1);
+            uart0Info.uart0String[start] = str[i];
+        }
+        uart0Info.writeIndex += room;
+        str += room;
+        size -= room;
+
+        uart0Lock();
+        uart0TxStart();
+        uart0Unlock();
+    }
+
+    return true;
+}
+
+// Format a message with formatString and send it
+void printfUart0(uint8_t policy, const char fmt[], ...)
+{
+    char str[UART0_FORMAT_SIZE];
+    uint16_t size;
+    va_list args;
+
+    va_start(args, fmt);
+    size = formatVString(str, sizeof(str), fmt, args);
+    va_end(args);
+
+    uart0Write(str, size, policy);
+}
+
+// Print dropped output since last call, then clear the counters
+void printUart0Stats(void)
+{
+    uint32_t bytes = uart0DroppedBytes, messages = uart0DroppedMessages;
+
+    uart0DroppedBytes = 0;
+    uart0DroppedMessages = 0;
+    printfUart0(UART0_BLOCK, "  Dropped: %lu bytes in %lu messages\r\n", (unsigned long)bytes, (unsigned long)messages);
+}
+
+// Function to Print Main Menu
+void printMainMenu(void)
+{
+    // Output to terminal configuration info
+    displayConnectionInfo();
+
+    sendUart0String("\r\nCommands:\r\n");
+    sendUart0String("  dhcp ON|OFF|REFRESH|RELEASE\r\n");
+    sendUart0String("  set IP|GW|DNS|SN|MQTT w.x.y.z\r\n");
+    sendUart0String("  set QOS|WINDOW n\r\n");
+    sendUart0String("  ifconfig\r\n");
+    sendUart0String("  spi\r\n");
+    sendUart0String("  arp\r\n");
+    sendUart0String("  idle\r\n");
+    sendUart0String("  sched\r\n");
+    sendUart0String("  uart\r\n");
+    sendUart0String("  publish TOPIC DATA\r\n");
+    sendUart0String("  subscribe TOPIC\r\n");
+    sendUart0String("  unsubscribe TOPIC\r\n");
+    sendUart0String("  rule ADD|DEL|LIST|CLEAR\r\n");
+    sendUart0String("  connect\r\n");
+    sendUart0String("  disconnect\r\n");
+    sendUart0String("  help Inputs\r\n");
+    sendUart0String("  help Outputs\r\n");
+    sendUart0String("  help Subs\r\n");
+    sendUart0String("  reboot\r\n\r\n");
+}
+
+// Function to Print Help Inputs
+void printHelpInputs(void)
+{
+    sendUart0String("\r\n  Local Input Topics to MQTT Client:\r\n");
+    sendUart0String("    env/pb\r\n");
+    sendUart0String("    env/temp\r\n");
+    sendUart0String("    env/led/green on|off\r\n");
+    sendUart0String("    env/led/red   on|off\r\n");
+    sendUart0String("    env/led/blue  on|off\r\n");
+}
+
+// Function to Print Help Outputs
+void printHelpOututs(void)
+{
+    sendUart0String("\r\n  Local Output Topics to MQTT Client:\r\n");
+    sendUart0String("    env/uart\r\n");
+    sendUart0String("    env/led/green STATUS\r\n");
+    sendUart0String("    env/led/red   STATUS\r\n");
+    sendUart0String("    env/led/blue  STATUS\r\n");
+}
@@ -15,16 +15,17 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include "tm4c123gh6pm.h"
 #include "dhcp.h"
 #include "eeprom.h"
 #include "uart0.h"
 #include "timers.h"
 #include "ethernet.h"
 #include "mqtt.h"
+#include "arp.h"
 
 uint32_t transactionId = 0;
 bool dhcpIpLeased = false;
+bool dhcpArpProbing = false; // Leased address is being checked for conflicts
 
 dhcpSysState nextDhcpState = INIT;
 
@@ -50,13 +51,17 @@ dhcpStateMachine stateTransitions [] =
     {REBINDING,   DHCPNACK_EVENT,      (_dhcpCallback)dhcpNackHandler}          //
 };
 
+const uint8_t stateTransitionCount = sizeof(stateTransitions)/sizeof(stateTransitions[0]);
+
+// stateTransitions expanded by dhcpInitStateTable so lookup is a single index
+_dhcpCallback dhcpStateTable[DHCP_NUM_STATES][DHCP_NUM_EVENTS];
+
 // Function to determine if DHCP mode ENABLED or DISABLED
 bool readDeviceConfig(void)
 {
     if(readEeprom(0x0010) == 0xFFFFFFFF) // If statement evaluates to TRUE if NOT in DHCP Mode
     {
         getAddressInfo(mqttIpAddress, 0x0001, 4);    // Get MQTT Broker IP address
-        getAddressInfo(mqttMacAddress, 0x0002, 6);   // Get MQTT Broker MAC Address
 
         // Initialize ENCJ2860 module
         initEthernetInterface(false);
@@ -75,7 +80,6 @@ bool readDeviceConfig(void)
         getAddressInfo(ipSubnetMask, 0x0014, 4);     // Get SN mask
         getAddressInfo(serverMacAddress, 0x0015, 6); // Get Server MAC Address
         getAddressInfo(mqttIpAddress, 0x0001, 4);    // Get MQTT Broker IP address
-        getAddressInfo(mqttMacAddress, 0x0002, 6);   // Get MQTT Broker MAC Address
 
         // Initialize ENCJ2860 module
         initEthernetInterface(true);
@@ -87,6 +91,9 @@ bool readDeviceConfig(void)
 // Handles exiting dhcp mode
 void exitDhcpMode(void){nextDhcpState = INIT;}
 
+// Default for events a state does not handle, message is dropped and state kept
+void dhcpIgnoreEvent(uint8_t packet[]){return;}
+
 // Transmit DHCPDISCOVER message
 void sendDhcpDiscoverMessage(uint8_t packet[])
 {
@@ -753,20 +760,6 @@ void sendDhcpDeclineMessage(uint8_t packet[])
     nextDhcpState = INIT;
 }
 
-// Function to check if received packet is DHCP Message
-bool etherIsDhcp(uint8_t packet[])
-{
-    // IP header Encapsulation
-    etherFrame *ether = (etherFrame*)packet;
-    ipFrame *ip       = (ipFrame*)&ether->data;
-    udpFrame *udp     = (udpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-
-    if(htons(udp->destPort) == 68 && htons(udp->sourcePort) == 67)
-        return true;
-
-    return false;
-}
-
 // Extract DHCP Option info from incoming packets
 uint8_t dhcpOfferType(uint8_t packet[])
 {
@@ -815,7 +808,10 @@ uint8_t dhcpOfferType(uint8_t packet[])
 
             // Set IP provided by server if message type = DHCPOFFER
             if(type == DHCPOFFER_EVENT)
+            {
                 etherSetIpAddress(dhcp->yiaddr[0], dhcp->yiaddr[1], dhcp->yiaddr[2], dhcp->yiaddr[3]);
+                initArp();
+            }
             break;
         case 54: // DHCP Server Identifier
             i += 2;
@@ -843,6 +839,10 @@ void dhcpNackHandler(uint8_t packet[])
     stopTimer(renewalTimer);
     stopTimer(rebindTimer);
     stopTimer(arpResponseTimer);
+    dhcpArpProbing = false;
+
+    // Entries learned under the old address are no longer valid
+    initArp();
 
     // Send another DHCPDISCOVER message
     (*dhcpLookup(INIT, DHCPDISCOVERY_EVENT))(packet);
@@ -853,6 +853,8 @@ void dhcpNackHandler(uint8_t packet[])
 // DHCP "WAIT" TIMER, sends DHCPDISOVER message after 10 seconds has elapsed
 void waitTimer(void)
 {
+    stopTimer(waitTimer);
+
     //uint8_t data[MAX_PACKET_SIZE] = {0};
 
     // Send another DHCPDISCOVER message
@@ -871,8 +873,9 @@ void LeaseAddressHandler(uint8_t packet[])
     // Start Rebind Timer
     startOneShotTimer(rebindTimer, ((leaseTime * MULT_FACTOR * 7) / (8 * LEASE_TIME_DIVISOR)));
 
-    // Send ARP probe
+    // Send ARP probe, a reply from the address means it is in use
     sendArpProbe(packet);
+    dhcpArpProbing = true;
 
     // Start ARP Response timer
     startOneShotTimer(arpResponseTimer, 2 * MULT_FACTOR);
@@ -925,6 +928,10 @@ void leaseExpHandler(void)
     stopTimer(renewalTimer);
     stopTimer(rebindTimer);
     stopTimer(arpResponseTimer);
+    dhcpArpProbing = false;
+
+    // Entries learned under the old address are no longer valid
+    initArp();
 
     // Send another DHCPDISCOVER message
     (*dhcpLookup(INIT, DHCPDISCOVERY_EVENT))(data);
@@ -936,6 +943,7 @@ void leaseExpHandler(void)
 void arpResponseTimer(void)
 {
     stopTimer(arpResponseTimer);
+    dhcpArpProbing = false;
 
     // Store device configuration information
     storeAddressEeprom(ipAddress, 0x0011, 4);        // Store device IP address
@@ -949,6 +957,8 @@ void arpResponseTimer(void)
     // Transition to next state
     nextDhcpState = BOUND;
 
+    // Only one announcement timer, a new lease would add another
+    stopTimer(periodicallyAnnounceAddress);
     startPeriodicTimer(periodicallyAnnounceAddress, 120 * MULT_FACTOR);
 }
 
@@ -957,21 +967,27 @@ void periodicallyAnnounceAddress(void)
     sendArpAnnouncement(data);
 }
 
-// Lookup requested callback function
-_dhcpCallback dhcpLookup(dhcpSysState state, dhcpSysEvent event)
+// Build dense [state][event] table from stateTransitions, must run before dhcpLookup
+void dhcpInitStateTable(void)
 {
-    uint8_t i, size;
+    uint8_t i, j;
 
-    size = sizeof(stateTransitions)/sizeof(stateTransitions[0]);
-
-    for(i = 0; i < size; i++)
+    for(i = 0; i < DHCP_NUM_STATES; i++)
     {
-        if(state == stateTransitions[i].state && event == stateTransitions[i].event)
-        {
-            return stateTransitions[i].eventHandler;
-        }
+        for(j = 0; j < DHCP_NUM_EVENTS; j++)
+            dhcpStateTable[i][j] = (_dhcpCallback)dhcpIgnoreEvent;
     }
 
-    // Modify this return later to return NACK_HANDLER function
-    return NULL;
+    for(i = 0; i < stateTransitionCount; i++)
+        dhcpStateTable[stateTransitions[i].state][stateTransitions[i].event] = stateTransitions[i].eventHandler;
+}
+
+// Lookup requested callback function
+_dhcpCallback dhcpLookup(dhcpSysState state, dhcpSysEvent event)
+{
+    // Message types outside of the table (options 1-8) are ignored
+    if(event >= DHCP_NUM_EVENTS)
+        return (_dhcpCallback)dhcpIgnoreEvent;
+
+    return dhcpStateTable[state][event];
 }
@@ -19,6 +19,7 @@
 
 extern uint32_t transactionId;
 extern bool dhcpIpLeased;
+extern bool dhcpArpProbing;
 
 //
 // Enumerations of States
@@ -54,6 +55,9 @@ typedef enum
     DHCPINFORM_EVENT
 } dhcpSysEvent;
 
+#define DHCP_NUM_STATES (REBINDING + 1)
+#define DHCP_NUM_EVENTS (DHCPINFORM_EVENT + 1)
+
 typedef dhcpSysState(*_dhcpCallback)(uint8_t packet[]);
 
 //
@@ -66,6 +70,9 @@ typedef struct
     _dhcpCallback eventHandler;
 } dhcpStateMachine;
 
+extern dhcpStateMachine stateTransitions[];
+extern const uint8_t stateTransitionCount;
+
 typedef struct _dhcpFrame
 {
   uint8_t   op;
@@ -90,7 +97,6 @@ void sendDhcpDeclineMessage(uint8_t packet[]);
 void sendDhcpReleaseMessage(uint8_t packet[]);
 void sendDhcpRequestMessage(uint8_t packet[]);
 bool readDeviceConfig(void);
-bool etherIsDhcp(uint8_t packet[]);
 uint8_t dhcpOfferType(uint8_t packet[]);
 void sendDhcpInformMessage(uint8_t packet[]);
 void sendDhcpDiscoverMessage(uint8_t packet[]);
@@ -103,7 +109,9 @@ void leaseExpHandler(void);
 void waitTimer(void);
 void resetTimers(void);
 void periodicallyAnnounceAddress(void);
+void dhcpIgnoreEvent(uint8_t packet[]);
 
+void dhcpInitStateTable(void);
 _dhcpCallback dhcpLookup(dhcpSysState state, dhcpSysEvent event);
 
 #endif /* DHCP_H_ */
@@ -14,11 +14,11 @@
 #define EEPROM_H_
 
 #include <stdint.h>
-#include "tm4c123gh6pm.h"
 
 void initEeprom(void);
 void writeEeprom(uint16_t add, uint32_t data);
 uint32_t readEeprom(uint16_t add);
+void waitEeprom(void);
 void getAddressInfo(uint8_t add[], uint8_t mem, uint8_t SIZE);
 void storeAddressEeprom(uint8_t add[], uint16_t block, uint8_t SIZE);
 void eraseAddressEeprom(void);
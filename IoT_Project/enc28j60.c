@@ -0,0 +1,610 @@
+// enc28j60.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// ENC28J60 Ethernet controller on SPI0
+//   ~CS on PA3
+//   ~INT on PC6
+
+#include "ethernet.h"
+#include "enc28j60.h"
+#include "events.h"
+
+// Buffer is configured as follows
+// Receive fifo from 0x0000 to 0x13FF (bottom 5K of 8K space)
+// Two 0x600 byte transmit slots from 0x1400 (see ETHER_TX_START)
+uint8_t nextPacketLsb = 0x00;
+uint8_t nextPacketMsb = 0x00;
+
+etherRxRing rxRing = {0};
+etherTxRing txRing = {0};
+uint8_t etherLockCount = 0;
+uint16_t etherTxSize = 0;
+
+// Driver cost counters, shown and cleared by etherPrintSpiStats
+uint32_t etherCsToggles = 0;
+uint32_t etherBankSwitches = 0;
+
+volatile uint8_t etherBank = ETHER_BANK_UNKNOWN; // Bank selected in ECON1 BSEL bits
+
+// Masks the INT pin interrupt so etherIsr cannot interleave spi transactions
+// (or change the register bank) while the main loop is using the chip
+void etherLock(void)
+{
+    disablePinInterrupt(INT);
+    etherLockCount++;
+}
+
+void etherUnlock(void)
+{
+    if (--etherLockCount == 0)
+        enablePinInterrupt(INT);
+}
+
+void etherCsOn(void)
+{
+    setPinValue(CS, 0);
+    etherCsToggles++;
+    _delay_cycles(4);
+}
+
+void etherCsOff(void)
+{
+    setPinValue(CS, 1);
+}
+
+void etherWriteReg(uint8_t reg, uint8_t data)
+{
+    etherCsOn();
+    writeSpi0Data(0x40 | (reg & 0x1F));
+    readSpi0Data();
+    writeSpi0Data(data);
+    readSpi0Data();
+    etherCsOff();
+}
+
+uint8_t etherReadReg(uint8_t reg)
+{
+    uint8_t data;
+    etherCsOn();
+    writeSpi0Data(0x00 | (reg & 0x1F));
+    readSpi0Data();
+    writeSpi0Data(0);
+    data = readSpi0Data();
+    etherCsOff();
+    return data;
+}
+
+void etherSetReg(uint8_t reg, uint8_t mask)
+{
+    etherCsOn();
+    writeSpi0Data(0x80 | (reg & 0x1F));
+    readSpi0Data();
+    writeSpi0Data(mask);
+    readSpi0Data();
+    etherCsOff();
+}
+
+void etherClearReg(uint8_t reg, uint8_t mask)
+{
+    etherCsOn();
+    writeSpi0Data(0xA0 | (reg & 0x1F));
+    readSpi0Data();
+    writeSpi0Data(mask);
+    readSpi0Data();
+    etherCsOff();
+}
+
+// Selects the bank of reg. The selected bank is remembered so nothing is sent
+// if it is already selected, and common registers (EIE to ECON1, 0x1B-0x1F)
+// are in every bank. Otherwise only the BSEL bits that change are cleared/set.
+void etherSetBank(uint8_t reg)
+{
+    uint8_t bank = (reg >> 5) & 0x03;
+
+    if ((reg & 0x1F) >= EIE || bank == etherBank)
+        return;
+
+    etherBankSwitches++;
+
+    if (etherBank == ETHER_BANK_UNKNOWN)
+    {
+        etherClearReg(ECON1, 0x03);
+        if (bank != 0)
+            etherSetReg(ECON1, bank);
+    }
+    else
+    {
+        if ((etherBank & ~bank) != 0)
+            etherClearReg(ECON1, etherBank & ~bank);
+        if ((bank & ~etherBank) != 0)
+            etherSetReg(ECON1, bank & ~etherBank);
+    }
+
+    etherBank = bank;
+}
+
+void etherWritePhy(uint8_t reg, uint16_t data)
+{
+    etherSetBank(MIREGADR);
+    etherWriteReg(MIREGADR, reg);
+    etherWriteReg(MIWRL, data & 0xFF);
+    etherWriteReg(MIWRH, (data >> 8) & 0xFF);
+}
+
+uint16_t etherReadPhy(uint8_t reg)
+{
+    uint16_t data, dataH;
+    etherSetBank(MIREGADR);
+    etherWriteReg(MIREGADR, reg);
+    etherWriteReg(MICMD, MIIRD);
+    waitMicrosecond(11);
+    etherSetBank(MISTAT);
+    while ((etherReadReg(MISTAT) & MIBUSY) != 0);
+    etherSetBank(MICMD);
+    etherWriteReg(MICMD, 0);
+    data = etherReadReg(MIRDL);
+    dataH = etherReadReg(MIRDH);
+    data |= (dataH << 8);
+    return data;
+}
+
+void etherWriteMemStart(void)
+{
+    etherCsOn();
+    writeSpi0Data(0x7A);
+    readSpi0Data();
+}
+
+void etherWriteMem(uint8_t data)
+{
+    writeSpi0Data(data);
+    readSpi0Data();
+}
+
+// Writes a block to buffer memory using a burst spi transfer
+void etherWriteMemBlock(const uint8_t data[], uint16_t size)
+{
+    writeSpi0Block(data, size);
+}
+
+void etherWriteMemStop(void)
+{
+    etherCsOff();
+}
+
+void etherReadMemStart(void)
+{
+    etherCsOn();
+    writeSpi0Data(0x3A);
+    readSpi0Data();
+}
+
+uint8_t etherReadMem(void)
+{
+    writeSpi0Data(0);
+    return readSpi0Data();
+}
+
+// Reads a block from buffer memory using a burst spi transfer
+void etherReadMemBlock(uint8_t data[], uint16_t size)
+{
+    readSpi0Block(data, size);
+}
+
+void etherReadMemStop(void)
+{
+    etherCsOff();
+}
+
+// Initializes ethernet device
+// Uses order suggested in Chapter 6 of datasheet except 6.4 OST which is first here
+void etherInit(uint16_t mode)
+{
+    // Configure pins for ethernet module
+    selectPinPushPullOutput(CS);
+    selectPinDigitalInput(WOL);
+    selectPinDigitalInput(INT);
+
+    // Bank left selected by anything that ran before is not known
+    etherBank = ETHER_BANK_UNKNOWN;
+
+    // make sure that oscillator start-up timer has expired
+    while ((etherReadReg(ESTAT) & CLKRDY) == 0) {}
+
+    // disable transmission and reception of packets
+    etherClearReg(ECON1, RXEN);
+    etherClearReg(ECON1, TXRTS);
+
+    // initialize receive buffer space
+    etherSetBank(ERXSTL);
+    etherWriteReg(ERXSTL, LOBYTE(ETHER_RX_START));
+    etherWriteReg(ERXSTH, HIBYTE(ETHER_RX_START));
+    etherWriteReg(ERXNDL, LOBYTE(ETHER_RX_END));
+    etherWriteReg(ERXNDH, HIBYTE(ETHER_RX_END));
+
+    // initialize receiver write and read ptrs
+    // at startup, will write from 0 to 13FE only and will not overwrite rd ptr
+    etherWriteReg(ERXWRPTL, LOBYTE(ETHER_RX_START));
+    etherWriteReg(ERXWRPTH, HIBYTE(ETHER_RX_START));
+    etherWriteReg(ERXRDPTL, LOBYTE(ETHER_RX_END));
+    etherWriteReg(ERXRDPTH, HIBYTE(ETHER_RX_END));
+    etherWriteReg(ERDPTL, LOBYTE(ETHER_RX_START));
+    etherWriteReg(ERDPTH, HIBYTE(ETHER_RX_START));
+
+    // setup receive filter
+    // always check CRC, use OR mode
+    etherSetBank(ERXFCON);
+    etherWriteReg(ERXFCON, (mode | ETHER_CHECKCRC) & 0xFF);
+
+    // bring mac out of reset
+    etherSetBank(MACON2);
+    etherWriteReg(MACON2, 0);
+
+    // enable mac rx, enable pause control for full duplex
+    etherWriteReg(MACON1, TXPAUS | RXPAUS | MARXEN);
+
+    // enable padding to 60 bytes (no runt packets)
+    // add crc to tx packets, set full or half duplex
+    if ((mode & ETHER_FULLDUPLEX) != 0)
+        etherWriteReg(MACON3, FULDPX | FRMLNEN | TXCRCEN | PAD60);
+    else
+        etherWriteReg(MACON3, FRMLNEN | TXCRCEN | PAD60);
+
+    // leave MACON4 as reset
+
+    // set maximum rx packet size
+    etherWriteReg(MAMXFLL, LOBYTE(1518));
+    etherWriteReg(MAMXFLH, HIBYTE(1518));
+
+    // set back-to-back inter-packet gap to 9.6us
+    if ((mode & ETHER_FULLDUPLEX) != 0)
+        etherWriteReg(MABBIPG, 0x15);
+    else
+        etherWriteReg(MABBIPG, 0x12);
+
+    // set non-back-to-back inter-packet gap registers
+    etherWriteReg(MAIPGL, 0x12);
+    etherWriteReg(MAIPGH, 0x0C);
+
+    // leave collision window MACLCON2 as reset
+
+    // setup mac address
+    etherSetBank(MAADR0);
+    etherWriteReg(MAADR5, macAddress[0]);
+    etherWriteReg(MAADR4, macAddress[1]);
+    etherWriteReg(MAADR3, macAddress[2]);
+    etherWriteReg(MAADR2, macAddress[3]);
+    etherWriteReg(MAADR1, macAddress[4]);
+    etherWriteReg(MAADR0, macAddress[5]);
+
+    // initialize phy duplex
+    if ((mode & ETHER_FULLDUPLEX) != 0)
+        etherWritePhy(PHCON1, PDPXMD);
+    else
+        etherWritePhy(PHCON1, 0);
+
+    // disable phy loopback if in half-duplex mode
+    etherWritePhy(PHCON2, HDLDIS);
+
+    // Flash LEDA and LEDB
+    etherWritePhy(PHLCON, 0x0880);
+    waitMicrosecond(100000);
+
+    // set LEDA (link status) and LEDB (tx/rx activity)
+    // stretch LED on to 40ms (default)
+    etherWritePhy(PHLCON, 0x0472);
+
+    // INT pin is active low, let etherIsr drain frames as they arrive
+    // and retire transmitted frames
+    rxRing.writeIndex = rxRing.readIndex = 0;
+    rxRing.stalled = rxRing.overflow = false;
+    txRing.writeIndex = txRing.sendIndex = 0;
+    txRing.busy = false;
+    selectPinInterruptFallingEdge(INT);
+    clearPinInterrupt(INT);
+    enablePinInterrupt(INT);
+    enablePortInterrupt(PORTC);              // turn-on interrupt 18 (GPIOC)
+    etherWriteReg(EIE, INTIE | PKTIE | RXERIE | TXIE | TXERIE);
+
+    // enable reception
+    etherSetReg(ECON1, RXEN);
+}
+
+// Returns true if link is up
+bool etherIsLinkUp(void)
+{
+    bool up;
+    etherLock();
+    up = (etherReadPhy(PHSTAT1) & LSTAT) != 0;
+    etherUnlock();
+    return up;
+}
+
+// Returns TRUE if packet received
+bool etherIsDataAvailable(void)
+{
+    bool ok;
+    etherLock();
+    ok = ((etherReadReg(EIR) & PKTIF) != 0);
+    etherUnlock();
+    return ok;
+}
+
+// Returns true if rx buffer overflowed after correcting the problem
+// The overflow is detected and cleared by etherIsr
+bool etherIsOverflow(void)
+{
+    bool err;
+    etherLock();
+    err = rxRing.overflow;
+    rxRing.overflow = false;
+    etherUnlock();
+    return err;
+}
+
+// Handles the INT pin falling edge by moving every frame counted in EPKTCNT into the rx ring
+// INTIE is cleared while draining so INT is released and re-asserted on any work left over
+void etherIsr(void)
+{
+    uint8_t slot;
+
+    clearPinInterrupt(INT);
+    etherClearReg(EIE, INTIE);
+
+    if ((etherReadReg(EIR) & RXERIF) != 0)
+    {
+        etherClearReg(EIR, RXERIF);
+        rxRing.overflow = true;
+    }
+
+    // Free the slot on the wire and start the next one
+    if ((etherReadReg(EIR) & (TXIF | TXERIF)) != 0)
+        etherTxPoll();
+
+    while ((uint8_t)(rxRing.writeIndex - rxRing.readIndex) < ETHER_RX_RING_SIZE)
+    {
+        etherSetBank(EPKTCNT);
+        if (etherReadReg(EPKTCNT) == 0)
+            break;
+
+        slot = rxRing.writeIndex & (ETHER_RX_RING_SIZE - 1);
+        rxRing.size[slot] = etherGetPacket(rxRing.packet[slot], MAX_PACKET_SIZE);
+        if (rxRing.size[slot] > 0)
+            rxRing.writeIndex++;
+        else
+            rxRing.rejected++;
+    }
+
+    // Leave chip interrupt off if ring is full, etherFreeRxBuffer turns it back on
+    if ((uint8_t)(rxRing.writeIndex - rxRing.readIndex) == ETHER_RX_RING_SIZE)
+        rxRing.stalled = true;
+    else
+        etherSetReg(EIE, INTIE);
+
+    eventSet(EVENT_ETHER);
+}
+
+// Returns oldest frame in rx ring or NULL if empty
+// Frame stays valid (and may be modified in place) until etherFreeRxBuffer is called
+uint8_t* etherGetRxBuffer(void)
+{
+    if (rxRing.writeIndex == rxRing.readIndex)
+        return NULL;
+
+    return rxRing.packet[rxRing.readIndex & (ETHER_RX_RING_SIZE - 1)];
+}
+
+// Returns size of oldest frame in rx ring, valid while etherGetRxBuffer is not NULL
+uint16_t etherGetRxSize(void)
+{
+    return rxRing.size[rxRing.readIndex & (ETHER_RX_RING_SIZE - 1)];
+}
+
+// Returns number of frames waiting in rx ring
+uint8_t etherGetRxCount(void)
+{
+    return rxRing.writeIndex - rxRing.readIndex;
+}
+
+// Returns oldest frame to the rx ring
+void etherFreeRxBuffer(void)
+{
+    etherLock();
+    rxRing.readIndex++;
+    if (rxRing.stalled)
+    {
+        rxRing.stalled = false;
+        etherSetReg(EIE, INTIE); // re-asserts INT if frames are still waiting in the chip
+    }
+    etherUnlock();
+}
+
+// Returns up to max_size characters in data buffer
+// Returns number of bytes copied to buffer, or 0 if the frame was received with errors
+// Contents written are 16-bit size, 16-bit status, payload excl crc
+uint16_t etherGetPacket(uint8_t packet[], uint16_t maxSize)
+{
+    uint8_t header[6];
+    uint16_t size;
+
+    // enable read from FIFO buffers
+    etherReadMemStart();
+
+    // get next packet pointer, size and status in one burst
+    etherReadMemBlock(header, 6);
+    nextPacketLsb = header[0];
+    nextPacketMsb = header[1];
+
+    // calc size
+    // don't return crc, instead return size + status, so size is correct
+    size = header[2] | (header[3] << 8);
+
+    // frames failing crc or length checks are skipped without copying
+    if ((header[4] & RSV_RX_OK) == 0)
+        size = 0;
+
+    // copy data
+    if (size > maxSize)
+        size = maxSize;
+    if (size > 0)
+        etherReadMemBlock(packet, size);
+
+    // end read from FIFO buffers
+    etherReadMemStop();
+
+    // advance read pointer
+    etherSetBank(ERXRDPTL);
+    etherWriteReg(ERXRDPTL, nextPacketLsb); // hw ptr
+    etherWriteReg(ERXRDPTH, nextPacketMsb);
+    etherWriteReg(ERDPTL, nextPacketLsb);   // dma rd ptr
+    etherWriteReg(ERDPTH, nextPacketMsb);
+
+    // decrement packet counter so that PKTIF is maintained correctly
+    etherSetReg(ECON2, PKTDEC);
+
+    return size;
+}
+
+// Starts transmission of the oldest queued slot if the transmitter is idle
+void etherTxKick(void)
+{
+    uint8_t slot;
+    uint16_t start;
+
+    if (txRing.busy || txRing.sendIndex == txRing.writeIndex)
+        return;
+
+    slot = txRing.sendIndex & (ETHER_TX_SLOTS - 1);
+    start = ETHER_TX_START + (slot * ETHER_TX_SLOT_SIZE);
+
+    // request transmit
+    etherSetBank(ETXSTL);
+    etherWriteReg(ETXSTL, LOBYTE(start));
+    etherWriteReg(ETXSTH, HIBYTE(start));
+    etherWriteReg(ETXNDL, LOBYTE(start + txRing.size[slot]));
+    etherWriteReg(ETXNDH, HIBYTE(start + txRing.size[slot]));
+    etherClearReg(EIR, TXIF);
+    etherSetReg(ECON1, TXRTS);
+
+    txRing.busy = true;
+}
+
+// Retires the frame on the wire once the chip is done with it and starts the next
+// Called from etherIsr on TXIF/TXERIF, or with the chip locked when waiting for a slot
+void etherTxPoll(void)
+{
+    // nothing on the wire, drop stale flags so INT is not held asserted
+    if (!txRing.busy)
+    {
+        etherClearReg(EIR, TXIF | TXERIF);
+        return;
+    }
+
+    // tx logic must be reset after an error, TXRTS may be left set (errata)
+    if ((etherReadReg(EIR) & TXERIF) != 0)
+    {
+        etherClearReg(ECON1, TXRTS);
+        etherSetReg(ECON1, TXRST);
+        etherClearReg(ECON1, TXRST);
+        etherClearReg(EIR, TXERIF);
+        txRing.errors++;
+    }
+    else if ((etherReadReg(ECON1) & TXRTS) != 0)
+        return;
+    else if ((etherReadReg(ESTAT) & TXABORT) != 0)
+        txRing.errors++;
+
+    etherClearReg(EIR, TXIF);
+    txRing.busy = false;
+    txRing.sendIndex++;
+
+    etherTxKick();
+}
+
+// Starts a frame in the next free tx slot. The frame is then streamed in one or more
+// segments with etherTxWrite and queued with etherTxSend, so headers and payload
+// can come from separate buffers without being staged in one packet first.
+// Only waits when every slot is queued or on the wire.
+void etherTxStart(void)
+{
+    uint16_t start;
+
+    etherLock();
+
+    while ((uint8_t)(txRing.writeIndex - txRing.sendIndex) == ETHER_TX_SLOTS)
+        etherTxPoll();
+
+    start = ETHER_TX_START + ((txRing.writeIndex & (ETHER_TX_SLOTS - 1)) * ETHER_TX_SLOT_SIZE);
+
+    // set DMA start address
+    etherSetBank(EWRPTL);
+    etherWriteReg(EWRPTL, LOBYTE(start));
+    etherWriteReg(EWRPTH, HIBYTE(start));
+
+    // start FIFO buffer write
+    etherWriteMemStart();
+
+    // write control byte
+    etherWriteMem(0);
+
+    etherTxSize = 0;
+}
+
+// Appends a segment to the frame being written
+void etherTxWrite(const void* data, uint16_t size)
+{
+    etherWriteMemBlock(data, size);
+    etherTxSize += size;
+}
+
+// Finishes the frame being written and queues it, completion is reported by TXIF
+void etherTxSend(void)
+{
+    // stop write
+    etherWriteMemStop();
+
+    txRing.size[txRing.writeIndex & (ETHER_TX_SLOTS - 1)] = etherTxSize;
+    txRing.writeIndex++;
+
+    etherTxKick();
+
+    etherUnlock();
+}
+
+// Writes a packet
+void etherPutPacket(uint8_t packet[], uint16_t size)
+{
+    etherTxStart();
+    etherTxWrite(packet, size);
+    etherTxSend();
+}
+
+// Print spi traffic to the ethernet controller since last call and the
+// time it takes on the wire, then clear the counters. Run before and after
+// an operation to see what it costs.
+void etherPrintSpiStats(void)
+{
+    uint32_t wireTime = 0;
+
+    if(spi0BitRate != 0)
+        wireTime = ((uint64_t)spi0Bytes * 8 * 1000000) / spi0BitRate;
+
+    printfUart0(UART0_BLOCK, "  SPI bytes:     %lu\r\n", (unsigned long)spi0Bytes);
+    printfUart0(UART0_BLOCK, "  Transactions:  %lu\r\n", (unsigned long)etherCsToggles);
+    printfUart0(UART0_BLOCK, "  Bank switches: %lu\r\n", (unsigned long)etherBankSwitches);
+    printfUart0(UART0_BLOCK, "  Wire time:     %lu us at %lu Hz\r\n", (unsigned long)wireTime, (unsigned long)spi0BitRate);
+
+    spi0Bytes = 0;
+    etherCsToggles = 0;
+    etherBankSwitches = 0;
+}
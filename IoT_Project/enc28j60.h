@@ -0,0 +1,180 @@
+// enc28j60.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef ENC28J60_H_
+#define ENC28J60_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ethernet.h"
+
+// ENC28J60 8K buffer memory map
+// Rx fifo takes the bottom, followed by tx slots of one max size frame each
+// (control byte + 1518 + 7 byte status vector) so one frame can be written
+// while another is on the wire
+#define ETHER_RX_START     0x0000
+#define ETHER_RX_END       0x13FF
+#define ETHER_TX_START     0x1400
+#define ETHER_TX_SLOT_SIZE 0x0600
+#define ETHER_TX_SLOTS     2      // must be a power of 2
+
+// etherBank before the first bank is selected
+#define ETHER_BANK_UNKNOWN 0xFF
+
+// Pins
+#define CS  PORTA,3
+#define WOL PORTB,3
+#define INT PORTC,6
+
+// Ether registers
+#define ERDPTL      0x00
+#define ERDPTH      0x01
+#define EWRPTL      0x02
+#define EWRPTH      0x03
+#define ETXSTL      0x04
+#define ETXSTH      0x05
+#define ETXNDL      0x06
+#define ETXNDH      0x07
+#define ERXSTL      0x08
+#define ERXSTH      0x09
+#define ERXNDL      0x0A
+#define ERXNDH      0x0B
+#define ERXRDPTL    0x0C
+#define ERXRDPTH    0x0D
+#define ERXWRPTL    0x0E
+#define ERXWRPTH    0x0F
+#define EIE         0x1B
+#define RXERIE      0x01
+#define TXERIE      0x02
+#define TXIE        0x08
+#define PKTIE       0x40
+#define INTIE       0x80
+#define EIR         0x1C
+#define RXERIF      0x01
+#define TXERIF      0x02
+#define TXIF        0x08
+#define PKTIF       0x40
+#define ESTAT       0x1D
+#define CLKRDY      0x01
+#define TXABORT     0x02
+#define ECON2       0x1E
+#define PKTDEC      0x40
+#define ECON1       0x1F
+#define RXEN        0x04
+#define TXRTS       0x08
+#define TXRST       0x80
+#define ERXFCON     0x38
+#define EPKTCNT     0x39
+#define MACON1      0x40
+#define MARXEN      0x01
+#define RXPAUS      0x04
+#define TXPAUS      0x08
+#define MACON2      0x41
+#define MARST       0x80
+#define MACON3      0x42
+#define FULDPX      0x01
+#define FRMLNEN     0x02
+#define TXCRCEN     0x10
+#define PAD60       0x20
+#define MACON4      0x43
+#define MABBIPG     0x44
+#define MAIPGL      0x46
+#define MAIPGH      0x47
+#define MACLCON1    0x48
+#define MACLCON2    0x49
+#define MAMXFLL     0x4A
+#define MAMXFLH     0x4B
+#define MICMD       0x52
+#define MIIRD       0x01
+#define MIREGADR    0x54
+#define MIWRL       0x56
+#define MIWRH       0x57
+#define MIRDL       0x58
+#define MIRDH       0x59
+#define MAADR1      0x60
+#define MAADR0      0x61
+#define MAADR3      0x62
+#define MAADR2      0x63
+#define MAADR5      0x64
+#define MAADR4      0x65
+#define MISTAT      0x6A
+#define MIBUSY      0x01
+#define ECOCON      0x75
+
+// Ether phy registers
+#define PHCON1      0x00
+#define PDPXMD      0x0100
+#define PHSTAT1     0x01
+#define LSTAT       0x0400
+#define PHCON2      0x10
+#define HDLDIS      0x0100
+#define PHLCON      0x14
+
+// Receive status vector (third byte, bit 23 of the vector)
+#define RSV_RX_OK   0x80
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+extern uint8_t  nextPacketLsb;
+extern uint8_t  nextPacketMsb;
+
+// ------------------------------------------------------------------------------
+//  Structures
+// ------------------------------------------------------------------------------
+
+typedef struct _enc28j60Frame // 4-bytes
+{
+  uint16_t size;
+  uint16_t status;
+  uint8_t  data;
+} enc28j60Frame;
+
+// Ring of received frames filled by etherIsr and consumed by the main loop
+typedef struct _etherRxRing
+{
+    uint8_t  packet[ETHER_RX_RING_SIZE][MAX_PACKET_SIZE];
+    uint16_t size[ETHER_RX_RING_SIZE];
+    volatile uint8_t writeIndex;
+    volatile uint8_t readIndex;
+    volatile bool    stalled;  // ring filled up and chip interrupt left disabled
+    volatile bool    overflow; // chip rx buffer overflowed since last check
+    uint16_t rejected;         // frames skipped without the received ok bit
+} etherRxRing;
+
+// Tx slots in chip buffer memory, queued in order and sent one at a time
+typedef struct _etherTxRing
+{
+    uint16_t size[ETHER_TX_SLOTS];
+    uint8_t  writeIndex;         // next slot to fill
+    uint8_t  sendIndex;          // oldest slot queued or on the wire
+    bool     busy;               // sendIndex slot is on the wire
+    uint16_t errors;             // frames aborted or reset after TXERIF
+} etherTxRing;
+
+extern etherTxRing txRing;
+
+// ------------------------------------------------------------------------------
+//  Register access, for the driver and tools that measure it
+// ------------------------------------------------------------------------------
+
+void etherLock(void);
+void etherUnlock(void);
+void etherWriteReg(uint8_t reg, uint8_t data);
+uint8_t etherReadReg(uint8_t reg);
+void etherSetReg(uint8_t reg, uint8_t mask);
+void etherClearReg(uint8_t reg, uint8_t mask);
+void etherSetBank(uint8_t reg);
+void etherWritePhy(uint8_t reg, uint16_t data);
+uint16_t etherReadPhy(uint8_t reg);
+
+#endif /* ENC28J60_H_ */
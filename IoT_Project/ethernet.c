@@ -10,18 +10,17 @@
 // Target uC:       TM4C123GH6PM
 // System Clock:    40 MHz
 
+#include <string.h>
 #include "ethernet.h"
+#include "timers.h"
 
 #define GREEN_LED PORTF, 3
 #define BLUE_LED  PORTF, 2
 
-// Buffer is configured as follows
-// Receive buffer starts at 0x0000 (bottom 6666 bytes of 8K space)
-// Transmit buffer at 01A0A (top 1526 bytes of 8K space)
-uint8_t nextPacketLsb = 0x00;
-uint8_t nextPacketMsb = 0x00;
 uint8_t sequenceId    = 1;
 uint32_t sum = 0;
+uint8_t pingTokens = ETHER_PING_BURST;
+uint32_t pingTime = 0;  // timerGetTicks() up to which tokens have been added
 uint8_t macAddress[HW_ADD_LENGTH]       = {2,3,4,5,6,UNIQUE_ID};
 uint8_t serverMacAddress[HW_ADD_LENGTH] = {0,0,0,0,0,0};
 uint8_t broadcastAddress[HW_ADD_LENGTH] = {255,255,255,255,255,255};
@@ -35,381 +34,29 @@ uint8_t data[MAX_PACKET_SIZE] = {0};
 
 bool dhcpEnabled = true;
 
-void etherCsOn(void)
-{
-    setPinValue(CS, 0);
-    _delay_cycles(4);
-}
-
-void etherCsOff(void)
-{
-    setPinValue(CS, 1);
-}
-
-void etherWriteReg(uint8_t reg, uint8_t data)
-{
-    etherCsOn();
-    writeSpi0Data(0x40 | (reg & 0x1F));
-    readSpi0Data();
-    writeSpi0Data(data);
-    readSpi0Data();
-    etherCsOff();
-}
-
-uint8_t etherReadReg(uint8_t reg)
-{
-    uint8_t data;
-    etherCsOn();
-    writeSpi0Data(0x00 | (reg & 0x1F));
-    readSpi0Data();
-    writeSpi0Data(0);
-    data = readSpi0Data();
-    etherCsOff();
-    return data;
-}
-
-void etherSetReg(uint8_t reg, uint8_t mask)
-{
-    etherCsOn();
-    writeSpi0Data(0x80 | (reg & 0x1F));
-    readSpi0Data();
-    writeSpi0Data(mask);
-    readSpi0Data();
-    etherCsOff();
-}
-
-void etherClearReg(uint8_t reg, uint8_t mask)
-{
-    etherCsOn();
-    writeSpi0Data(0xA0 | (reg & 0x1F));
-    readSpi0Data();
-    writeSpi0Data(mask);
-    readSpi0Data();
-    etherCsOff();
-}
-
-void etherSetBank(uint8_t reg)
-{
-    etherClearReg(ECON1, 0x03);
-    etherSetReg(ECON1, reg >> 5);
-}
-
-void etherWritePhy(uint8_t reg, uint16_t data)
-{
-    etherSetBank(MIREGADR);
-    etherWriteReg(MIREGADR, reg);
-    etherWriteReg(MIWRL, data & 0xFF);
-    etherWriteReg(MIWRH, (data >> 8) & 0xFF);
-}
-
-uint16_t etherReadPhy(uint8_t reg)
-{
-    uint16_t data, dataH;
-    etherSetBank(MIREGADR);
-    etherWriteReg(MIREGADR, reg);
-    etherWriteReg(MICMD, MIIRD);
-    waitMicrosecond(11);
-    etherSetBank(MISTAT);
-    while ((etherReadReg(MISTAT) & MIBUSY) != 0);
-    etherSetBank(MICMD);
-    etherWriteReg(MICMD, 0);
-    data = etherReadReg(MIRDL);
-    dataH = etherReadReg(MIRDH);
-    data |= (dataH << 8);
-    return data;
-}
-
-void etherWriteMemStart(void)
-{
-    etherCsOn();
-    writeSpi0Data(0x7A);
-    readSpi0Data();
-}
-
-void etherWriteMem(uint8_t data)
-{
-    writeSpi0Data(data);
-    readSpi0Data();
-}
-
-void etherWriteMemStop(void)
-{
-    etherCsOff();
-}
-
-void etherReadMemStart(void)
-{
-    etherCsOn();
-    writeSpi0Data(0x3A);
-    readSpi0Data();
-}
-
-uint8_t etherReadMem(void)
-{
-    writeSpi0Data(0);
-    return readSpi0Data();
-}
-
-void etherReadMemStop(void)
-{
-    etherCsOff();
-}
-
-// Initializes ethernet device
-// Uses order suggested in Chapter 6 of datasheet except 6.4 OST which is first here
-void etherInit(uint16_t mode)
-{
-    // Configure pins for ethernet module
-    selectPinPushPullOutput(CS);
-    selectPinDigitalInput(WOL);
-    selectPinDigitalInput(INT);
-
-    // make sure that oscillator start-up timer has expired
-    while ((etherReadReg(ESTAT) & CLKRDY) == 0) {}
-
-    // disable transmission and reception of packets
-    etherClearReg(ECON1, RXEN);
-    etherClearReg(ECON1, TXRTS);
-
-    // initialize receive buffer space
-    etherSetBank(ERXSTL);
-    etherWriteReg(ERXSTL, LOBYTE(0x0000));
-    etherWriteReg(ERXSTH, HIBYTE(0x0000));
-    etherWriteReg(ERXNDL, LOBYTE(0x1A09));
-    etherWriteReg(ERXNDH, HIBYTE(0x1A09));
-
-    // initialize receiver write and read ptrs
-    // at startup, will write from 0 to 1A08 only and will not overwrite rd ptr
-    etherWriteReg(ERXWRPTL, LOBYTE(0x0000));
-    etherWriteReg(ERXWRPTH, HIBYTE(0x0000));
-    etherWriteReg(ERXRDPTL, LOBYTE(0x1A09));
-    etherWriteReg(ERXRDPTH, HIBYTE(0x1A09));
-    etherWriteReg(ERDPTL, LOBYTE(0x0000));
-    etherWriteReg(ERDPTH, HIBYTE(0x0000));
-
-    // setup receive filter
-    // always check CRC, use OR mode
-    etherSetBank(ERXFCON);
-    etherWriteReg(ERXFCON, (mode | ETHER_CHECKCRC) & 0xFF);
-
-    // bring mac out of reset
-    etherSetBank(MACON2);
-    etherWriteReg(MACON2, 0);
-
-    // enable mac rx, enable pause control for full duplex
-    etherWriteReg(MACON1, TXPAUS | RXPAUS | MARXEN);
-
-    // enable padding to 60 bytes (no runt packets)
-    // add crc to tx packets, set full or half duplex
-    if ((mode & ETHER_FULLDUPLEX) != 0)
-        etherWriteReg(MACON3, FULDPX | FRMLNEN | TXCRCEN | PAD60);
-    else
-        etherWriteReg(MACON3, FRMLNEN | TXCRCEN | PAD60);
-
-    // leave MACON4 as reset
-
-    // set maximum rx packet size
-    etherWriteReg(MAMXFLL, LOBYTE(1518));
-    etherWriteReg(MAMXFLH, HIBYTE(1518));
-
-    // set back-to-back inter-packet gap to 9.6us
-    if ((mode & ETHER_FULLDUPLEX) != 0)
-        etherWriteReg(MABBIPG, 0x15);
-    else
-        etherWriteReg(MABBIPG, 0x12);
-
-    // set non-back-to-back inter-packet gap registers
-    etherWriteReg(MAIPGL, 0x12);
-    etherWriteReg(MAIPGH, 0x0C);
-
-    // leave collision window MACLCON2 as reset
-
-    // setup mac address
-    etherSetBank(MAADR0);
-    etherWriteReg(MAADR5, macAddress[0]);
-    etherWriteReg(MAADR4, macAddress[1]);
-    etherWriteReg(MAADR3, macAddress[2]);
-    etherWriteReg(MAADR2, macAddress[3]);
-    etherWriteReg(MAADR1, macAddress[4]);
-    etherWriteReg(MAADR0, macAddress[5]);
-
-    // initialize phy duplex
-    if ((mode & ETHER_FULLDUPLEX) != 0)
-        etherWritePhy(PHCON1, PDPXMD);
-    else
-        etherWritePhy(PHCON1, 0);
-
-    // disable phy loopback if in half-duplex mode
-    etherWritePhy(PHCON2, HDLDIS);
-
-    // Flash LEDA and LEDB
-    etherWritePhy(PHLCON, 0x0880);
-    waitMicrosecond(100000);
-
-    // set LEDA (link status) and LEDB (tx/rx activity)
-    // stretch LED on to 40ms (default)
-    etherWritePhy(PHLCON, 0x0472);
-    // enable reception
-    etherSetReg(ECON1, RXEN);
-}
-
-// Returns true if link is up
-bool etherIsLinkUp(void)
-{
-    return (etherReadPhy(PHSTAT1) & LSTAT) != 0;
-}
-
-// Returns TRUE if packet received
-bool etherIsDataAvailable(void)
-{
-    return ((etherReadReg(EIR) & PKTIF) != 0);
-}
-
-// Returns true if rx buffer overflowed after correcting the problem
-bool etherIsOverflow(void)
-{
-    bool err;
-    err = (etherReadReg(EIR) & RXERIF) != 0;
-    if (err)
-        etherClearReg(EIR, RXERIF);
-    return err;
-}
-
-// Returns up to max_size characters in data buffer
-// Returns number of bytes copied to buffer
-// Contents written are 16-bit size, 16-bit status, payload excl crc
-uint16_t etherGetPacket(uint8_t packet[], uint16_t maxSize)
-{
-    uint16_t i = 0, size, tmp16, status;
-
-    // enable read from FIFO buffers
-    etherReadMemStart();
-
-    // get next packet information
-    nextPacketLsb = etherReadMem();
-    nextPacketMsb = etherReadMem();
-
-    // calc size
-    // don't return crc, instead return size + status, so size is correct
-    size = etherReadMem();
-    tmp16 = etherReadMem();
-    size |= (tmp16 << 8);
-
-    // get status (currently unused)
-    status = etherReadMem();
-    tmp16 = etherReadMem();
-    status |= (tmp16 << 8);
-
-    // copy data
-    if (size > maxSize)
-        size = maxSize;
-    while (i < size)
-        packet[i++] = etherReadMem();
-
-    // end read from FIFO buffers
-    etherReadMemStop();
-
-    // advance read pointer
-    etherSetBank(ERXRDPTL);
-    etherWriteReg(ERXRDPTL, nextPacketLsb); // hw ptr
-    etherWriteReg(ERXRDPTH, nextPacketMsb);
-    etherWriteReg(ERDPTL, nextPacketLsb);   // dma rd ptr
-    etherWriteReg(ERDPTH, nextPacketMsb);
-
-    // decrement packet counter so that PKTIF is maintained correctly
-    etherSetReg(ECON2, PKTDEC);
-
-    return size;
-}
-
-// Writes a packet
-bool etherPutPacket(uint8_t packet[], uint16_t size)
-{
-    uint16_t i;
-
-    // clear out any tx errors
-    if ((etherReadReg(EIR) & TXERIF) != 0)
-    {
-        etherClearReg(EIR, TXERIF);
-        etherSetReg(ECON1, TXRTS);
-        etherClearReg(ECON1, TXRTS);
-    }
-
-    // set DMA start address
-    etherSetBank(EWRPTL);
-    etherWriteReg(EWRPTL, LOBYTE(0x1A0A));
-    etherWriteReg(EWRPTH, HIBYTE(0x1A0A));
-
-    // start FIFO buffer write
-    etherWriteMemStart();
-
-    // write control byte
-    etherWriteMem(0);
-
-    // write data
-    for (i = 0; i < size; i++)
-    {
-        etherWriteMem(packet[i]);
-    }
-
-    // stop write
-    etherWriteMemStop();
-
-    // request transmit
-    etherWriteReg(ETXSTL, LOBYTE(0x1A0A));
-    etherWriteReg(ETXSTH, HIBYTE(0x1A0A));
-    etherWriteReg(ETXNDL, LOBYTE(0x1A0A+size));
-    etherWriteReg(ETXNDH, HIBYTE(0x1A0A+size));
-    etherClearReg(EIR, TXIF);
-    etherSetReg(ECON1, TXRTS);
-
-    // wait for completion
-    while ((etherReadReg(ECON1) & TXRTS) != 0);
-
-    // determine success
-    return ((etherReadReg(ESTAT) & TXABORT) == 0);
-}
 
 // Calculate sum of words
 // Must use getEtherChecksum to complete 1's compliment addition
 void etherSumWords(void* data, uint16_t sizeInBytes)
 {
-    uint8_t* pData = (uint8_t*)data;
-    uint16_t i;
-    uint8_t phase = 0;
-    uint16_t data_temp;
-    for (i = 0; i < sizeInBytes; i++)
-    {
-        if (phase)
-        {
-            data_temp = *pData;
-            sum += data_temp << 8;
-        }
-        else
-          sum += *pData;
-        phase = 1 - phase;
-        pData++;
-    }
+    sum = checksumAdd(sum, data, sizeInBytes);
 }
 
 // Completes 1's compliment addition by folding carries back into field
 uint16_t getEtherChecksum(void)
 {
-    uint16_t result;
     // this is based on rfc1071
-    while ((sum >> 16) > 0)
-      sum = (sum & 0xFFFF) + (sum >> 16);
-    result = sum & 0xFFFF;
-    return ~result;
+    return checksumFold(sum);
 }
 
 void etherCalcIpChecksum(ipFrame* ip)
 {
+    uint32_t ipSum;
+
     // 32-bit sum over ip header
-    sum = 0;
-    etherSumWords(&ip->revSize, 10);
-    etherSumWords(ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
-    ip->headerChecksum = getEtherChecksum();
+    ipSum = checksumAdd(0, &ip->revSize, 10);
+    ipSum = checksumAdd(ipSum, ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
+    ip->headerChecksum = checksumFold(ipSum);
 }
 
 // Converts from host to network order and vice versa
@@ -425,21 +72,6 @@ uint32_t htons32(uint32_t value)
     return (((value & 0xFF000000) >> 24) + ((value & 0x00FF0000) >> 8) + ((value & 0x0000FF00) << 8) + ((value & 0x000000FF) << 24));
 }
 
-// Determines whether packet is IP datagram
-bool etherIsIp(uint8_t packet[])
-{
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-
-    if(ether->frameType != htons(0x0800))
-        return false;
-
-    sum = 0;
-    etherSumWords(&ip->revSize, (ip->revSize & 0xF) * 4);
-
-    return (getEtherChecksum() == 0);
-}
-
 // Determines whether packet is unicast to this ip
 // Must be an IP packet
 bool etherIsIpUnicast(uint8_t packet[])
@@ -459,24 +91,51 @@ bool etherIsIpUnicast(uint8_t packet[])
     return true;
 }
 
-// Determines whether packet is ping request
+// Determines whether packet is ping request sent to this ip
+// Broadcast requests are not answered (RFC1122 3.2.2.6)
 // Must be an IP packet
 bool etherIsPingRequest(uint8_t packet[])
 {
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip = (ipFrame*)&ether->data;
     icmpFrame* icmp = (icmpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-    return (ip->protocol == 0x01 & icmp->type == 8);
+    return (ip->protocol == 0x01 && icmp->type == 8 && icmp->code == 0 && etherIsIpUnicast(packet));
 }
 
-// Sends a ping response given the request data
+// Takes a token for a ping reply, false if the bucket is empty
+// Tokens are added at ETHER_PING_RATE per second up to ETHER_PING_BURST
+bool etherPingAllowed(void)
+{
+    uint32_t added = (timerGetTicks() - pingTime) / (1000 / ETHER_PING_RATE);
+
+    if(added >= (uint32_t)(ETHER_PING_BURST - pingTokens))
+    {
+        pingTokens = ETHER_PING_BURST;
+        pingTime = timerGetTicks();
+    }
+    else
+    {
+        pingTokens += added;
+        pingTime += added * (1000 / ETHER_PING_RATE);
+    }
+
+    if(pingTokens == 0)
+        return false;
+
+    pingTokens--;
+    return true;
+}
+
+// Turns a ping request into its response in place and sends it
+// Swapping addresses leaves the IP checksum as it is and only the ICMP type
+// changes, so the ICMP checksum is patched instead of summed over the data
 void etherSendPingResponse(uint8_t packet[])
 {
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip = (ipFrame*)&ether->data;
     icmpFrame* icmp = (icmpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
     uint8_t i, tmp;
-    uint16_t icmp_size;
+    uint16_t oldTypeCode, newTypeCode;
     // swap source and destination fields
     for (i = 0; i < HW_ADD_LENGTH; i++)
     {
@@ -490,15 +149,11 @@ void etherSendPingResponse(uint8_t packet[])
         ip->destIp[i] = ip ->sourceIp[i];
         ip->sourceIp[i] = tmp;
     }
-    // this is a response
+    // this is a response, type and code share one checksum word
+    memcpy(&oldTypeCode, &icmp->type, 2);
     icmp->type = 0;
-    // calc icmp checksum
-    sum = 0;
-    etherSumWords(&icmp->type, 2);
-    icmp_size = ntohs(ip->length);
-    icmp_size -= 24; // sub ip header and icmp code, type, and check
-    etherSumWords(&icmp->id, icmp_size);
-    icmp->check = getEtherChecksum();
+    memcpy(&newTypeCode, &icmp->type, 2);
+    icmp->check = checksumUpdate16(icmp->check, oldTypeCode, newTypeCode);
     // send packet
     etherPutPacket((uint8_t *)ether, 14 + ntohs(ip->length));
 }
@@ -974,33 +629,20 @@ void getDnsAddress(uint8_t dns[4])
 // Function to Ethernet Connection Information
 void displayConnectionInfo(void)
 {
-    char str[10];
-    uint8_t i, mac[6], ip[4];
+    uint8_t mac[6], ip[4];
 
     sendUart0String("\r\nStarting eth0\r\n");
 
     // Retrieve Mac Address
     etherGetMacAddress(mac);
     sendUart0String("  HW:  ");
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        sprintf(str, "%02u", mac[i]);
-        sendUart0String(str);
-        if (i < (HW_ADD_LENGTH - 1))
-            sendUart0String(":");
-    }
+    printfUart0(UART0_BLOCK, "%02u:%02u:%02u:%02u:%02u:%02u", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
     sendUart0String("\r\n");
 
     // Retrieve IP Address
     etherGetIpAddress(ip);
     sendUart0String("  IP:  ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        sendUart0String(str);
-        if (i < 4-1)
-            sendUart0String(".");
-    }
+    printfUart0(UART0_BLOCK, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
 
     // Check if DHCP Mode is Enabled
     if (etherIsDhcpEnabled())
@@ -1012,37 +654,19 @@ void displayConnectionInfo(void)
     // Retrieve IP Subnet Mask
     etherGetIpSubnetMask(ip);
     sendUart0String("  SN:  ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        sendUart0String(str);
-        if (i < 4-1)
-            sendUart0String(".");
-    }
+    printfUart0(UART0_BLOCK, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
     sendUart0String("\r\n");
 
     // Retrieve IP Gateway Address
     etherGetIpGatewayAddress(ip);
     sendUart0String("  GW:  ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        sendUart0String(str);
-        if (i < 4-1)
-            sendUart0String(".");
-    }
+    printfUart0(UART0_BLOCK, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
     sendUart0String("\r\n");
 
     // Retrieve IP Gateway Address
     getMqttAddress(ip);
     sendUart0String("  MQTT: ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        sendUart0String(str);
-        if (i < 4-1)
-            sendUart0String(".");
-    }
+    printfUart0(UART0_BLOCK, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
     sendUart0String("\r\n");
 
     // Check if Ethernet Link is UP|DOWN
@@ -1053,36 +677,22 @@ void displayConnectionInfo(void)
 }
 
 
-// Function to Ethernet Connection Information
+
 void displayIfconfigInfo(void)
 {
-    char str[10];
-    uint8_t i;
     uint8_t mac[6];
     uint8_t ip[4];
 
     // Retrieve Mac Address
     etherGetMacAddress(mac);
     sendUart0String("  MAC:  ");
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        sprintf(str, "%02u", mac[i]);
-        sendUart0String(str);
-        if (i < (HW_ADD_LENGTH - 1))
-            sendUart0String(":");
-    }
+    printfUart0(UART0_BLOCK, "%02u:%02u:%02u:%02u:%02u:%02u", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
     sendUart0String("\r\n");
 
     // Retrieve IP Address
     etherGetIpAddress(ip);
     sendUart0String("  IP:   ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        sendUart0String(str);
-        if (i < 4-1)
-            sendUart0String(".");
-    }
+    printfUart0(UART0_BLOCK, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
 
     // Check if DHCP Mode is Enabled
     if (etherIsDhcpEnabled())
@@ -1094,49 +704,25 @@ void displayIfconfigInfo(void)
     // Retrieve IP Subnet Mask
     etherGetIpSubnetMask(ip);
     sendUart0String("  SN:   ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        sendUart0String(str);
-        if (i < 4-1)
-            sendUart0String(".");
-    }
+    printfUart0(UART0_BLOCK, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
     sendUart0String("\r\n");
 
     // Retrieve IP Gateway Address
     etherGetIpGatewayAddress(ip);
     sendUart0String("  GW:   ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        sendUart0String(str);
-        if (i < 4-1)
-            sendUart0String(".");
-    }
+    printfUart0(UART0_BLOCK, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
     sendUart0String("\r\n");
 
     // Retrieve IP Gateway Address
     getDnsAddress(ip);
     sendUart0String("  DNS:  ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        sendUart0String(str);
-        if (i < 4-1)
-            sendUart0String(".");
-    }
+    printfUart0(UART0_BLOCK, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
     sendUart0String("\r\n");
 
     // Retrieve IP Gateway Address
     getMqttAddress(ip);
     sendUart0String("  MQTT: ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        sendUart0String(str);
-        if (i < 4-1)
-            sendUart0String(".");
-    }
+    printfUart0(UART0_BLOCK, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
     sendUart0String("\r\n");
 
     // Check if Ethernet Link is UP|DOWN
@@ -20,103 +20,27 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include "tm4c123gh6pm.h"
 #include "wait.h"
 #include "gpio.h"
 #include "uart0.h"
 #include "spi.h"
+#include "checksum.h"
 #include "mqtt.h"
 
 // Max packet is calculated as:
 // Ether frame header (18) + Max MTU (1500) + CRC (4)
 #define MAX_PACKET_SIZE 1522
 
+// Number of received frames buffered by etherIsr (must be a power of 2)
+#define ETHER_RX_RING_SIZE 4
+
+// Ping replies are limited by a token bucket so a flood cannot take the link
+#define ETHER_PING_RATE    10     // Replies per second
+#define ETHER_PING_BURST   4      // Replies that can be sent back to back
+
 // User IP and MAC Unique ID for Static Mode
 #define UNIQUE_ID 106
 
-// Pins
-#define CS  PORTA,3
-#define WOL PORTB,3
-#define INT PORTC,6
-
-// Ether registers
-#define ERDPTL      0x00
-#define ERDPTH      0x01
-#define EWRPTL      0x02
-#define EWRPTH      0x03
-#define ETXSTL      0x04
-#define ETXSTH      0x05
-#define ETXNDL      0x06
-#define ETXNDH      0x07
-#define ERXSTL      0x08
-#define ERXSTH      0x09
-#define ERXNDL      0x0A
-#define ERXNDH      0x0B
-#define ERXRDPTL    0x0C
-#define ERXRDPTH    0x0D
-#define ERXWRPTL    0x0E
-#define ERXWRPTH    0x0F
-#define EIE         0x1B
-#define EIR         0x1C
-#define RXERIF      0x01
-#define TXERIF      0x02
-#define TXIF        0x08
-#define PKTIF       0x40
-#define ESTAT       0x1D
-#define CLKRDY      0x01
-#define TXABORT     0x02
-#define ECON2       0x1E
-#define PKTDEC      0x40
-#define ECON1       0x1F
-#define RXEN        0x04
-#define TXRTS       0x08
-#define ERXFCON     0x38
-#define EPKTCNT     0x39
-#define MACON1      0x40
-#define MARXEN      0x01
-#define RXPAUS      0x04
-#define TXPAUS      0x08
-#define MACON2      0x41
-#define MARST       0x80
-#define MACON3      0x42
-#define FULDPX      0x01
-#define FRMLNEN     0x02
-#define TXCRCEN     0x10
-#define PAD60       0x20
-#define MACON4      0x43
-#define MABBIPG     0x44
-#define MAIPGL      0x46
-#define MAIPGH      0x47
-#define MACLCON1    0x48
-#define MACLCON2    0x49
-#define MAMXFLL     0x4A
-#define MAMXFLH     0x4B
-#define MICMD       0x52
-#define MIIRD       0x01
-#define MIREGADR    0x54
-#define MIWRL       0x56
-#define MIWRH       0x57
-#define MIRDL       0x58
-#define MIRDH       0x59
-#define MAADR1      0x60
-#define MAADR0      0x61
-#define MAADR3      0x62
-#define MAADR2      0x63
-#define MAADR5      0x64
-#define MAADR4      0x65
-#define MISTAT      0x6A
-#define MIBUSY      0x01
-#define ECOCON      0x75
-
-// Ether phy registers
-#define PHCON1      0x00
-#define PDPXMD      0x0100
-#define PHSTAT1     0x01
-#define LSTAT       0x0400
-#define PHCON2      0x10
-#define HDLDIS      0x0100
-#define PHLCON      0x14
-
 // Packets
 #define IP_ADD_LENGTH 4
 #define HW_ADD_LENGTH 6
@@ -138,8 +62,6 @@
 // ------------------------------------------------------------------------------
 //  Globals
 // ------------------------------------------------------------------------------
-extern uint8_t  nextPacketLsb;
-extern uint8_t  nextPacketMsb;
 extern uint8_t  sequenceId;
 extern uint32_t sum;
 extern uint8_t  macAddress[HW_ADD_LENGTH];
@@ -162,13 +84,6 @@ extern bool     dhcpEnabled;
 // Network byte order is big endian
 // Must interpret uint16_t in reverse order
 
-typedef struct _enc28j60Frame // 4-bytes
-{
-  uint16_t size;
-  uint16_t status;
-  uint8_t  data;
-} enc28j60Frame;
-
 typedef struct _etherFrame // 14-bytes
 {
   uint8_t  destAddress[6];
@@ -229,18 +144,30 @@ typedef struct _udpFrame // 8 bytes
 // Subroutines
 //-----------------------------------------------------------------------------
 
+// Driver, the ENC28J60 in enc28j60.c on the target
 void etherInit(uint16_t mode);
 bool etherIsLinkUp(void);
 
 bool etherIsDataAvailable(void);
 bool etherIsOverflow(void);
 uint16_t etherGetPacket(uint8_t packet[], uint16_t maxSize);
-bool etherPutPacket(uint8_t packet[], uint16_t size);
+void etherPutPacket(uint8_t packet[], uint16_t size);
+void etherTxStart(void);
+void etherTxWrite(const void* data, uint16_t size);
+void etherTxSend(void);
+void etherTxKick(void);
+void etherTxPoll(void);
+uint8_t* etherGetRxBuffer(void);
+uint16_t etherGetRxSize(void);
+uint8_t etherGetRxCount(void);
+void etherFreeRxBuffer(void);
+void etherIsr(void);
+void etherPrintSpiStats(void);
 
-bool etherIsIp(uint8_t packet[]);
 bool etherIsIpUnicast(uint8_t packet[]);
 
 bool etherIsPingRequest(uint8_t packet[]);
+bool etherPingAllowed(void);
 void etherSendPingResponse(uint8_t packet[]);
 
 bool etherIsArpRequest(uint8_t packet[]);
@@ -0,0 +1,89 @@
+// events.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "events.h"
+#include "timers.h"
+#include "uart0.h"
+
+volatile uint8_t eventFlags = 0;
+
+// Idle counters, shown and cleared by eventPrintStats
+uint64_t eventSleepCycles = 0;
+uint64_t eventStatsStart = 0;
+uint32_t eventWakeups = 0;
+
+// Called from interrupts, the main loop only clears flags with them masked
+void eventSet(uint8_t events)
+{
+    eventFlags |= events;
+}
+
+// Return the events since the last call without sleeping
+uint8_t eventTake(void)
+{
+    uint8_t events;
+
+    __asm("    CPSID I");
+    events = eventFlags;
+    eventFlags = 0;
+    __asm("    CPSIE I");
+
+    return events;
+}
+
+// Sleep until an interrupt sets an event, unless one already has, and
+// return the events since the last call.
+// Interrupts are masked from the check to WFI so one arriving in between
+// is not missed, WFI still wakes on it and it runs once they are unmasked.
+uint8_t eventWait(void)
+{
+    uint8_t events;
+    uint64_t start;
+
+    __asm("    CPSID I");
+    if (eventFlags == 0)
+    {
+        start = timerGetCycles();
+        __asm("    WFI");
+        eventSleepCycles += timerGetCycles() - start;
+        eventWakeups++;
+
+        // Let the interrupt that woke the core run
+        __asm("    CPSIE I");
+        __asm("    CPSID I");
+    }
+    events = eventFlags;
+    eventFlags = 0;
+    __asm("    CPSIE I");
+
+    return events;
+}
+
+void eventPrintStats(void)
+{
+    uint64_t now = timerGetCycles();
+    uint64_t total = now - eventStatsStart;
+    uint32_t percent = 0;
+
+    if (total != 0)
+        percent = (eventSleepCycles * 100) / total;
+
+    printfUart0(UART0_BLOCK, "  Asleep:  %lu ms (%lu%%)\r\n", (unsigned long)(eventSleepCycles / TIMER_CYCLES_PER_MS), (unsigned long)percent);
+    printfUart0(UART0_BLOCK, "  Busy:    %lu ms\r\n", (unsigned long)((total - eventSleepCycles) / TIMER_CYCLES_PER_MS));
+    printfUart0(UART0_BLOCK, "  Wakeups: %lu\r\n", (unsigned long)eventWakeups);
+
+    eventSleepCycles = 0;
+    eventWakeups = 0;
+    eventStatsStart = now;
+}
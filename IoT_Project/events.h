@@ -0,0 +1,39 @@
+// events.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Idle
+// Interrupts that leave work for the main loop set an event flag. When the
+// loop has nothing left to do it calls eventWait, which sleeps the core with
+// WFI until one of them does. Time asleep is counted against time since the
+// counters were last cleared so the busy share can be shown.
+
+#define EVENT_ETHER 0x01    // etherIsr queued frames or saw an overflow
+#define EVENT_UART  0x02    // Character waiting in UART0 rx fifo
+#define EVENT_TIMER 0x04    // Expired timer waiting for timerPoll
+
+extern volatile uint8_t eventFlags;
+extern uint64_t eventSleepCycles;
+extern uint64_t eventStatsStart;
+extern uint32_t eventWakeups;
+
+void eventSet(uint8_t events);
+uint8_t eventTake(void);
+uint8_t eventWait(void);
+void eventPrintStats(void);
+
+#endif
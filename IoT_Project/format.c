@@ -0,0 +1,152 @@
+// format.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include "format.h"
+
+// Append c if there is room, one byte is kept for the terminator
+void formatPut(formatBuffer* out, char c)
+{
+    if (out->length + 1 < out->size)
+        out->buf[out->length++] = c;
+}
+
+// Add text padded to width, a sign stays in front of zero padding
+void formatField(formatBuffer* out, const char text[], uint16_t length, uint8_t width, bool left, char pad)
+{
+    uint16_t i;
+
+    if (pad == '0' && length != 0 && text[0] == '-')
+    {
+        formatPut(out, '-');
+        text++;
+        length--;
+        if (width != 0)
+            width--;
+    }
+
+    for (i = length; !left && i < width; i++)
+        formatPut(out, pad);
+    for (i = 0; i < length; i++)
+        formatPut(out, text[i]);
+    for (i = length; left && i < width; i++)
+        formatPut(out, ' ');
+}
+
+// Format into buf, returns length without the terminator
+uint16_t formatVString(char buf[], uint16_t size, const char fmt[], va_list args)
+{
+    formatBuffer out = {buf, size, 0};
+    char digits[12], *p;
+    const char* s;
+    uint32_t value;
+    uint8_t width, base;
+    bool left, isLong, negative;
+    char pad, c;
+
+    while ((c = *fmt++) != '\0')
+    {
+        if (c != '%')
+        {
+            formatPut(&out, c);
+            continue;
+        }
+
+        left = false;
+        pad = ' ';
+        width = 0;
+        isLong = false;
+
+        for (; *fmt == '-' || *fmt == '0'; fmt++)
+        {
+            if (*fmt == '-')
+                left = true;
+            else
+                pad = '0';
+        }
+        for (; *fmt >= '0' && *fmt <= '9'; fmt++)
+            width = width * 10 + (*fmt - '0');
+        for (; *fmt == 'l'; fmt++)
+            isLong = true;
+
+        switch (c = *fmt++)
+        {
+        case 'c':
+            digits[0] = (char)va_arg(args, int);
+            formatField(&out, digits, 1, width, left, ' ');
+            break;
+        case 's':
+            s = va_arg(args, const char*);
+            formatField(&out, s, strlen(s), width, left, ' ');
+            break;
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+            if (c == 'd' || c == 'i')
+            {
+                int32_t number = isLong ? (int32_t)va_arg(args, long) : (int32_t)va_arg(args, int);
+                negative = number < 0;
+                value = negative ? -(uint32_t)number : (uint32_t)number;
+            }
+            else
+            {
+                negative = false;
+                value = isLong ? (uint32_t)va_arg(args, unsigned long) : (uint32_t)va_arg(args, unsigned int);
+            }
+            base = (c == 'x' || c == 'X') ? 16 : 10;
+
+            // Digits are built from the end of the buffer
+            p = &digits[sizeof(digits)];
+            do
+            {
+                *--p = "0123456789abcdef"[value % base];
+                if (c == 'X' && *p >= 'a')
+                    *p -= 'a' - 'A';
+                value /= base;
+            }
+            while (value != 0);
+            if (negative)
+                *--p = '-';
+
+            formatField(&out, p, &digits[sizeof(digits)] - p, width, left, left ? ' ' : pad);
+            break;
+        case '\0':
+            fmt--;
+            break;
+        default:    // %% and anything not supported are copied
+            formatPut(&out, c);
+            break;
+        }
+    }
+
+    if (size != 0)
+        buf[out.length] = '\0';
+
+    return out.length;
+}
+
+uint16_t formatString(char buf[], uint16_t size, const char fmt[], ...)
+{
+    va_list args;
+    uint16_t length;
+
+    va_start(args, fmt);
+    length = formatVString(buf, size, fmt, args);
+    va_end(args);
+
+    return length;
+}
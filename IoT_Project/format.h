@@ -0,0 +1,38 @@
+// format.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+// Small printf-style formatter, used instead of sprintf to keep the C
+// library's formatter out of the image.
+// Supports %c %s %d %i %u %x %X and %%, the - and 0 flags, a field width
+// and the l length modifier. Output is cut to fit the buffer and is always
+// terminated.
+
+typedef struct _formatBuffer
+{
+    char*    buf;
+    uint16_t size;
+    uint16_t length;
+} formatBuffer;
+
+void formatPut(formatBuffer* out, char c);
+void formatField(formatBuffer* out, const char text[], uint16_t length, uint8_t width, bool left, char pad);
+uint16_t formatVString(char buf[], uint16_t size, const char fmt[], va_list args);
+uint16_t formatString(char buf[], uint16_t size, const char fmt[], ...);
+
+#endif /* FORMAT_H_ */
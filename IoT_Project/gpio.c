@@ -26,6 +26,7 @@
 #define OFS_DATA_TO_IBE    3*4*8
 #define OFS_DATA_TO_IEV    4*4*8
 #define OFS_DATA_TO_IM     5*4*8
+#define OFS_DATA_TO_ICR    8*4*8
 #define OFS_DATA_TO_AFSEL  9*4*8
 #define OFS_DATA_TO_ODR   68*4*8
 #define OFS_DATA_TO_PUR   69*4*8
@@ -73,6 +74,31 @@ void enablePort(PORT port)
     _delay_cycles(3);
 }
 
+// Enable interrupt of port in the NVIC, pin interrupts are selected with the functions below
+void enablePortInterrupt(PORT port)
+{
+    switch(port)
+    {
+        case PORTA:
+            NVIC_EN0_R |= 1 << (INT_GPIOA-16);
+            break;
+        case PORTB:
+            NVIC_EN0_R |= 1 << (INT_GPIOB-16);
+            break;
+        case PORTC:
+            NVIC_EN0_R |= 1 << (INT_GPIOC-16);
+            break;
+        case PORTD:
+            NVIC_EN0_R |= 1 << (INT_GPIOD-16);
+            break;
+        case PORTE:
+            NVIC_EN0_R |= 1 << (INT_GPIOE-16);
+            break;
+        case PORTF:
+            NVIC_EN1_R |= 1 << (INT_GPIOF-48);
+    }
+}
+
 void disablePort(PORT port)
 {
     switch(port)
@@ -300,6 +326,13 @@ void setPinValue(PORT port, uint8_t pin, bool value)
     *p = value;
 }
 
+void clearPinInterrupt(PORT port, uint8_t pin)
+{
+    uint32_t* p;
+    p = (uint32_t*)port + pin + OFS_DATA_TO_ICR;
+    *p = 1;
+}
+
 bool getPinValue(PORT port, uint8_t pin)
 {
     uint32_t* p;
@@ -47,6 +47,7 @@ typedef enum _PORT
 
 void enablePort(PORT port);
 void disablePort(PORT port);
+void enablePortInterrupt(PORT port);
 
 void selectPinPushPullOutput(PORT port, uint8_t pin);
 void selectPinOpenDrainOutput(PORT port, uint8_t pin);
@@ -68,6 +69,7 @@ void selectPinInterruptHighLevel(PORT port, uint8_t pin);
 void selectPinInterruptLowLevel(PORT port, uint8_t pin);
 void enablePinInterrupt(PORT port, uint8_t pin);
 void disablePinInterrupt(PORT port, uint8_t pin);
+void clearPinInterrupt(PORT port, uint8_t pin);
 
 void setPinValue(PORT port, uint8_t pin, bool value);
 bool getPinValue(PORT port, uint8_t pin);
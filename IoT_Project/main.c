@@ -27,6 +27,12 @@
 #include "reboot.h"
 #include "wait.h"
 #include "mqtt.h"
+#include "topic.h"
+#include "rules.h"
+#include "arp.h"
+#include "events.h"
+#include "sched.h"
+#include "packet.h"
 #include "rtc.h"
 #include "adc.h"
 #include "pwm0.h"
@@ -53,16 +59,180 @@ void initHw(void)
     selectPinDigitalInput(PUSH_BUTTON);
 }
 
+// Handles ARP messages
+void arpHandler(packetInfo* info)
+{
+    // Learn sender, sends frames that were waiting on it
+    arpReceived(info->packet);
+
+    if(etherIsArpRequest(info->packet)) // Handle ARP request
+    {
+        etherSendArpResponse(info->packet);
+    }
+    else if(dhcpArpProbing && etherIsGratuitousResponse(info->packet)) // Leased address answered probe
+    {
+        // If ARP Response received before 2 second timer elapses
+        // then send decline message, invalidate IP and use static IP,
+        // wait at least 10 seconds and send another DHCPDISCOVER message.
+        stopTimer(arpResponseTimer);
+        dhcpArpProbing = false;
+        sendDhcpDeclineMessage(info->packet);
+        setStaticNetworkAddresses();
+        startOneShotTimer(waitTimer, 10 * MULT_FACTOR);
+    }
+}
+
+// Handles ICMP messages, pings beyond the rate limit are dropped
+void icmpHandler(packetInfo* info)
+{
+    if(etherIsPingRequest(info->packet) && etherPingAllowed())
+        etherSendPingResponse(info->packet);
+}
+
+// Handles DHCP messages
+void dhcpHandler(packetInfo* info)
+{
+    // Get next DHCP state event
+    dhcpSysEvent nextDhcpEvent = (dhcpSysEvent)dhcpOfferType(info->packet);
+
+    // If DHCP msg rx'd then transition to next state
+    (*dhcpLookup(nextDhcpState, nextDhcpEvent))(info->packet);
+}
+
+// Handles TCP packets
+void tcpHandler(packetInfo* info)
+{
+    transCtrlBlock* connection;
+    uint16_t nextTcpEvent = info->tcpFlags & 0x001F; // Control bits are the TCP state event
+
+    // Everything runs on the connection the segment belongs to
+    if((connection = tcpFindTcb(info->packet)) == NULL)
+        return;
+
+    tcb = connection;
+
+    // Only the broker connection carries MQTT. It is matched on remote
+    // address and both ports, so another host sending from port 1883
+    // can not deliver publishes or acknowledge ours.
+    if(connection == mqttTcb)
+    {
+        // Find the first MQTT packet boundary before anything reads the data
+        mqttStreamSegment(info->packet);
+
+        // Acknowledgements for QoS 1/2 publishes
+        mqttProcessAck(info->packet);
+
+        // Every publish that is whole in the segment
+        do
+        {
+            if(isMqttMessage(info->packet))
+            {
+                processMqttMessage(&mqttInfo, info->packet);
+
+                ifttRulesTable(&mqttInfo, info->packet);
+            }
+        }
+        while(mqttNextPacket(info->packet));
+    }
+
+    // Release segments the broker has acknowledged
+    tcpRtxAck(info->packet);
+
+    // If TCP msg rx'd then transition to next state
+    (*tcpLookup(tcb->state, (tcpSysEvent)nextTcpEvent))(info->packet, nextTcpEvent);
+}
+
+// Network level, handles one received frame
+bool netTask(void)
+{
+    uint8_t* packet;
+
+    if(etherIsOverflow())
+    {
+        // Set on-board Red LED to alert of Ethernet device overflow
+        setPinValue(RED_LED, 1);
+
+        // Start timer to clear Red LED after time has elapsed
+        startOneShotTimer(clearRedLed, 3 * MULT_FACTOR);
+    }
+
+    // Frames are queued by etherIsr
+    if((packet = etherGetRxBuffer()) == NULL)
+        return false;
+
+    // Headers are parsed once, then the frame goes to its handler
+    packetDispatch(packet, etherGetRxSize());
+
+    // Return frame to rx ring
+    etherFreeRxBuffer();
+
+    // Handler may have sent something that needs ARP or a retry
+    schedPost(SCHED_TIMER);
+
+    return etherGetRxBuffer() != NULL;
+}
+
+// Timer level, runs callbacks of expired timers and the protocol retries
+// that depend on them
+bool timerTask(void)
+{
+    // Run callbacks of expired timers
+    timerPoll();
+
+    // Resend unacknowledged TCP data if retransmission timer expired
+    tcpRtxPoll();
+
+    // Send MQTT acknowledgements and resend unacknowledged publishes
+    mqttInflightPoll(data);
+
+    // Repeat unanswered ARP requests and refresh aged entries, last as
+    // everything above can send a request
+    arpPoll();
+
+    return false;
+}
+
+// Rules level, runs one received publish through the rules
+bool rulesTask(void)
+{
+    bool more = ruleQueueRun();
+
+    // Rule may have published
+    schedPost(SCHED_TIMER);
+
+    return more;
+}
+
+USER_DATA userInput = {.delimeter = true,
+                       .endOfString = false,
+                       .fieldCount = 0,
+                       .startCount = 0,
+                       .characterCount = 0,
+};
+
+// Console level, takes one typed character
+bool consoleTask(void)
+{
+    if(!kbhitUart0())
+        return false;
+
+    if(getsUart0(&userInput)) // Get User Input
+    {
+        shellCommands(&userInput, data);
+
+        // Command may have sent something
+        schedPost(SCHED_TIMER);
+    }
+    else
+        parseFields(&userInput); // Tokenize User Input
+
+    return kbhitUart0();
+}
+
 int main(void)
 {
     // Declare Variables
     bool ok;
-    USER_DATA userInput = {.delimeter = true,
-                           .endOfString = false,
-                           .fieldCount = 0,
-                           .startCount = 0,
-                           .characterCount = 0,
-    };
 
     // Initialize Hardware
     initHw();
@@ -74,6 +244,31 @@ int main(void)
     //initRtc();
     //initWatchdog();
 
+    // Expand state machine transition arrays into lookup tables
+    tcpInitStateTable();
+    dhcpInitStateTable();
+
+    // Received frames go to the handler for their type, the rest are dropped
+    initPackets();
+    packetRegister(PACKET_ARP, arpHandler);
+    packetRegister(PACKET_ICMP, icmpHandler);
+    packetRegister(PACKET_DHCP, dhcpHandler);
+    packetRegister(PACKET_TCP, tcpHandler);
+
+    // Nothing resolved yet, MACs are learned as they are needed
+    initArp();
+
+    // Work is run by priority, the interrupts wake the levels they feed
+    initSched();
+    schedRegister(SCHED_NET, "net", netTask, etherGetRxCount, SCHED_NET_BUDGET, EVENT_ETHER);
+    schedRegister(SCHED_TIMER, "timer", timerTask, NULL, SCHED_TIMER_BUDGET, EVENT_TIMER);
+    schedRegister(SCHED_RULES, "rules", rulesTask, ruleQueueCount, SCHED_RULES_BUDGET, 0);
+    schedRegister(SCHED_CONSOLE, "console", consoleTask, NULL, SCHED_CONSOLE_BUDGET, EVENT_UART);
+
+    // Empty topic trie, then hook rules stored in EEPROM on it
+    initTopics();
+    initRules();
+
     // Display current ifconfig values and send DHCPREQUEST if Rebooting device
     ok = readDeviceConfig();
 
@@ -97,73 +292,9 @@ int main(void)
         startPeriodicTimer(periodicallyAnnounceAddress, 120 * MULT_FACTOR);
     }
 
-    while(true)
-    {
-        // Packet processing if available
-        if(etherIsDataAvailable())
-        {
-            if(etherIsOverflow())
-            {
-                // Set on-board Red LED to alert of Ethernet device overflow
-                setPinValue(RED_LED, 1);
+    // Boot messages above may be waiting on ARP
+    schedPost(SCHED_TIMER);
 
-                // Start timer to clear Red LED after time has elapsed
-                startOneShotTimer(clearRedLed, 3 * MULT_FACTOR);
-            }
-
-            // Get packet
-            etherGetPacket(data, MAX_PACKET_SIZE);
-
-            // Handles IP messages
-            if(etherIsIp(data))
-            {
-                if(etherIsTcp(data)) // Handles TCP packets
-                {
-                    if(isMqttMessage(data))
-                    {
-                        processMqttMessage(&mqttInfo, data);
-
-                        ifttRulesTable(&mqttInfo, data);
-                    }
-
-                    // Get next TCP state event
-                    uint16_t nextTcpEvent = etherIsTcpMsgType(data);
-
-                    // If DHCP msg rx'd then transition to next state
-                    (*tcpLookup(nextTcpState, (tcpSysEvent)nextTcpEvent))(data, nextTcpEvent);
-                }
-                else if(etherIsDhcp(data)) // Handles DHCP messages
-                {
-                    // Get next DHCP state event
-                    dhcpSysEvent nextDhcpEvent = (dhcpSysEvent)dhcpOfferType(data);
-
-                    // If DHCP msg rx'd then transition to next state
-                    (*dhcpLookup(nextDhcpState, nextDhcpEvent))(data);
-                }
-                else if(etherIsArpRequest(data)) // Handle ARP request
-                {
-                    etherSendArpResponse(data);
-                }
-                else if(etherIsArpResponse(data)) // Handle ARP response
-                {
-                    // If ARP Response received before 2 second timer elapses
-                    // then send decline message, invalidate IP and use static IP,
-                    // wait at least 10 seconds and send another DHCPDISCOVER message.
-                    stopTimer(arpResponseTimer);
-                    sendDhcpDeclineMessage(data);
-                    setStaticNetworkAddresses();
-                    startOneShotTimer(waitTimer, 10 * MULT_FACTOR);
-                }
-            }
-        }
-
-        // If User Input detected, then process input
-        if(kbhitUart0())
-        {
-            if(getsUart0(&userInput)) // Get User Input
-                shellCommands(&userInput, data);
-            else
-                parseFields(&userInput); // Tokenize User Input
-        }
-    }
+    while(true)
+        schedRun();
 }
@@ -15,20 +15,30 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include "tm4c123gh6pm.h"
 #include "mqtt.h"
 #include "ethernet.h"
 #include "shell.h"
 #include "tcp.h"
 #include "uart0.h"
 #include "timers.h"
+#include "arp.h"
+#include "packet.h"
 
-mqttTopics topics[MQTT_MAX_TABLE_SIZE] = {0};
 uint8_t mqttIpAddress[MQTT_ADD_LENGTH] = {0};
-uint8_t mqttMacAddress[MQTT_HW_ADD_LENGTH] = {0};
 uint8_t mqttMsgType = 0;
 uint16_t mqttSrcPort = 54000;
 uint16_t mqttPacketId = 0;
+uint8_t mqttPublishQos = 0;
+uint8_t mqttWindowSize = MQTT_MAX_INFLIGHT;
+
+mqttInflight inflight[MQTT_MAX_INFLIGHT] = {0};
+uint16_t rxQos2Ids[MQTT_MAX_INFLIGHT] = {0}; // QoS 2 publishes received and waiting for PUBREL, 0 = empty
+mqttAck ackQueue[MQTT_ACK_QUEUE_SIZE];
+uint8_t ackHead = 0;
+uint8_t ackTail = 0;
+timerHandle mqttRetryTimer = TIMER_INVALID; // Wakes the main loop when a resend is due
+mqttStream stream = {0};
+uint16_t streamOffset = 0; // First whole packet in the segment being processed
 
 // Set MQTT Address
 void setMqttAddress(uint8_t mqtt0, uint8_t mqtt1, uint8_t mqtt2, uint8_t mqtt3)
@@ -47,70 +57,77 @@ void getMqttAddress(uint8_t mqtt[])
         mqtt[i] = mqttIpAddress[i];
 }
 
-// Function finds 1st slot with validBit field set to false and returns the index value to it.
-uint8_t findEmptySlot(void)
+// Returns the MQTT data of a segment from the broker from its first whole
+// packet on and its size, or NULL if segment carries no packet start. packet
+// must be the frame described by rxInfo, already matched to mqttTcb, after
+// mqttStreamSegment has been called for it.
+mqttFrame* getMqttFrame(uint8_t packet[], uint16_t* size)
 {
-    uint8_t i;
-
-    i = 0;
-    while(i < MQTT_MAX_TABLE_SIZE)
-    {
-        if(!(topics[i].validBit))
-            return i;
-        i++;
-    }
-    return 0;
-}
+    *size = rxInfo.dataSize - streamOffset;
 
-// Function to Create Empty Slot in Subscriptions Table for re-use
-void createEmptySlot(char info[])
-{
-    uint8_t i = 0;
+    if(rxInfo.type != PACKET_TCP || rxInfo.sourcePort != MQTT_BROKER_PORT || *size == 0)
+        return NULL;
 
-    while(i < MQTT_MAX_TABLE_SIZE)
-    {
-        if(strcmp(topics[i].subs, info) == 0)
-        {
-            topics[i].validBit = false;
-            return;
-        }
-        i++;
-    }
+    return (mqttFrame*)&packet[rxInfo.dataOffset + streamOffset];
 }
 
 // Determines whether packet is MQTT
 bool isMqttMessage(uint8_t packet[])
 {
-    uint16_t index;
-
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
-
-    // Find where data begins for TCP Header and then point the mqttFrame to that index
-    index = (((htons(tcp->dataCtrlFields) & 0xF000) >> 12) - 5) * 4;
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data[index];
+    uint16_t size;
+    mqttFrame *mqtt = getMqttFrame(packet, &size);
 
     // If Source Port = 1883 it is a MQTT packet.
     // Further filter for only MQTT Publish packets received from broker
-    if(htons(tcp->sourcePort) == 1883 && (mqtt->control & 0xF0) == 48)
+    if(mqtt != NULL && (mqtt->control & 0xF0) == 48)
         return true;
 
     return false;
 }
 
+// Copy topic and payload of a received PUBLISH into strings, cut short to
+// fit topicSize and payloadSize. Returns false if packet is malformed.
+bool getMqttPublish(uint8_t packet[], char topic[], uint16_t topicSize, char payload[], uint16_t payloadSize)
+{
+    uint8_t* body;
+    uint16_t size, topicLength, length;
+    uint32_t remainingLength, payloadStart;
+    mqttFrame *mqtt = getMqttFrame(packet, &size);
+
+    if(mqtt == NULL || (body = getMqttVariableHeader(mqtt, size, &remainingLength)) == NULL)
+        return false;
+
+    if(remainingLength < 2)
+        return false;
+
+    // Packet Identifier sits between topic and payload if QoS Level Set
+    topicLength  = (body[0] << 8) | body[1];
+    payloadStart = 2 + (uint32_t)topicLength + (((mqtt->control & 0x06) != 0) ? 2 : 0);
+
+    if(payloadStart > remainingLength)
+        return false;
+
+    length = (topicLength < topicSize) ? topicLength : (topicSize - 1);
+    memcpy(topic, &body[2], length);
+    topic[length] = '\0';
+
+    length = remainingLength - payloadStart;
+    if(length >= payloadSize)
+        length = payloadSize - 1;
+    memcpy(payload, &body[payloadStart], length);
+    payload[length] = '\0';
+
+    return true;
+}
+
 // Returns MQTT packet type
 uint8_t getMqttMsgType(uint8_t packet[])
 {
-    uint16_t index;
-
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+    uint16_t size;
+    mqttFrame *mqtt = getMqttFrame(packet, &size);
 
-    // Find where data begins for TCP Header and then point the mqttFrame to that index
-    index = (((htons(tcp->dataCtrlFields) & 0xF000) >> 12) - 5) * 4;
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data[index];
+    if(mqtt == NULL)
+        return RESERVED;
 
     return (mqtt->control & 0xF0);
 }
@@ -119,6 +136,9 @@ void mqttMessageEstablished(void)
 {
     //uint8_t packet[MAX_PACKET_SIZE];
 
+    // Clean Session is set so nothing outstanding carries over
+    mqttInflightReset();
+
     sendMqttConnectMessage(data, 0x5018); // Flag = PSH + ACK
 
     startPeriodicTimer(mqttPingTimerExpired, (MQTT_KEEP_ALIVE_TIME * MULT_FACTOR));
@@ -132,82 +152,215 @@ void mqttPingTimerExpired(void)
 
     sendMqttPingRequest(data, 0x5018);
 }
-/*
 // Algorithm for encoding a non-negative integer into the variable length encoding scheme
-uint32_t encodeRemainingLength(uint8_t packet[], uint32_t )
+// (MQTT 3.1.1 Section 2.2.3). Returns number of bytes written to encoded (1-4).
+uint8_t encodeRemainingLength(uint8_t encoded[], uint32_t value)
 {
-    uint8_t encodedByte;
-    uint32_t value;
+    uint8_t encodedByte, i = 0;
 
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
-
-    while(value > 0)
+    do
     {
+        encodedByte = value % 128;
+        value = value / 128;
+
+        // if there are more data to encode, set the top bit of this byte
+        if(value > 0)
+            encodedByte = encodedByte | 128;
 
+        encoded[i++] = encodedByte;
     }
+    while(value > 0 && i < MQTT_MAX_LENGTH_BYTES);
+
+    return i;
 }
 
-// Algorithm for decoding the Remaining Length field
-uint32_t decodeRemainingLength(uint8_t packet[])
+// Start decoding a new Remaining Length field
+void resetRemainingLength(mqttLengthDecoder* decoder)
 {
-    uint8_t encodedByte;
-    uint32_t multiplier = 1, value = 0;
+    decoder->value      = 0;
+    decoder->multiplier = 1;
+    decoder->count      = 0;
+}
 
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
+// Algorithm for decoding the Remaining Length field, one byte at a time so
+// a field split across TCP segments picks up where it left off
+mqttLengthStatus decodeRemainingLength(mqttLengthDecoder* decoder, uint8_t encodedByte)
+{
+    if(decoder->count >= MQTT_MAX_LENGTH_BYTES)
+        return LENGTH_MALFORMED;
+
+    decoder->value += (encodedByte & 127) * decoder->multiplier;
+    decoder->multiplier *= 128;
+    decoder->count++;
 
+    if((encodedByte & 128) != 0)
+        return (decoder->count < MQTT_MAX_LENGTH_BYTES) ? LENGTH_INCOMPLETE : LENGTH_MALFORMED;
 
+    return LENGTH_COMPLETE;
 }
-*/
 
-// Connect Variable Header Contains: Protocol Name, Protocol Level, Connect Flags, Keep Alive, and Properties
-void sendMqttConnectMessage(uint8_t packet[], uint16_t flags)
+// Returns start of variable header of a received MQTT packet and its Remaining Length,
+// or NULL if the Remaining Length field is malformed or the packet does not fit in
+// the size bytes from mqtt on
+uint8_t* getMqttVariableHeader(mqttFrame* mqtt, uint16_t size, uint32_t* remainingLength)
 {
-    uint8_t i = 0;
-    uint16_t tcpSize = 0, tmp16 = 0;
+    uint8_t* encoded = &mqtt->packetLength;
+    mqttLengthDecoder decoder;
+    mqttLengthStatus status;
 
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
+    resetRemainingLength(&decoder);
 
-    // Fill etherFrame
-    for (i = 0; i < HW_ADD_LENGTH; i++)
+    do
     {
-        ether->destAddress[i]   = mqttMacAddress[i];
-        ether->sourceAddress[i] = macAddress[i];
+        // Control byte plus the length bytes read so far
+        if(1 + decoder.count >= size)
+            return NULL;
+
+        status = decodeRemainingLength(&decoder, encoded[decoder.count]);
     }
+    while(status == LENGTH_INCOMPLETE);
+
+    if(status == LENGTH_MALFORMED || decoder.value > (uint32_t)(size - 1 - decoder.count))
+        return NULL;
+
+    *remainingLength = decoder.value;
+
+    return &encoded[decoder.count];
+}
+
+// Forget where the broker stream was, the next segment starts on a packet
+void mqttStreamReset(void)
+{
+    stream.synced   = false;
+    stream.inLength = false;
+    stream.skip     = 0;
+}
 
-    ether->frameType = htons(0x0800); // For ipv4
+// Walk the MQTT packets of a segment from the broker, once per segment before
+// anything reads it. The end of a packet carried over from the previous
+// segment is skipped, so getMqttFrame starts on a packet boundary, and a
+// packet running past the end of this segment is remembered for the next one.
+// Such packets are not reassembled, only stepped over. packet must be the
+// frame described by rxInfo, already matched to mqttTcb by tcpFindTcb.
+void mqttStreamSegment(uint8_t packet[])
+{
+    uint8_t* data;
+    uint16_t size, offset = 0;
+    uint32_t seq, step;
+    mqttLengthStatus status;
+    bool first = true;
+
+    tcpFrame* tcp = (tcpFrame*)&packet[rxInfo.l4Offset];
+
+    streamOffset = 0;
+
+    if(rxInfo.type != PACKET_TCP || rxInfo.sourcePort != MQTT_BROKER_PORT || rxInfo.dataSize == 0)
+        return;
 
-    // Fill ipFrame
-    for (i = 0; i < IP_ADD_LENGTH; i++)
+    data = &packet[rxInfo.dataOffset];
+    size = rxInfo.dataSize;
+    seq  = htons32(tcp->seqNum);
+
+    // A retransmitted or out of order segment, the best guess is that it starts on a packet
+    if(stream.synced && seq != stream.nextSeq)
+        return;
+
+    do
     {
-        ip->destIp[i]   = mqttIpAddress[i];
-        ip->sourceIp[i] = ipAddress[i];
+        // Rest of a Remaining Length field
+        while(stream.inLength && offset < size)
+        {
+            status = decodeRemainingLength(&stream.length, data[offset++]);
+
+            if(status == LENGTH_COMPLETE)
+            {
+                stream.inLength = false;
+                stream.skip = stream.length.value;
+            }
+            else if(status == LENGTH_MALFORMED)
+            {
+                // Stream is lost, start over on the next segment
+                mqttStreamReset();
+                streamOffset = size;
+                return;
+            }
+        }
+
+        // Rest of a variable header and payload
+        step = size - offset;
+        if(stream.skip < step)
+            step = stream.skip;
+        offset += step;
+        stream.skip -= step;
+
+        // First packet that starts in this segment follows what was carried over
+        if(first)
+        {
+            streamOffset = offset;
+            first = false;
+        }
+
+        // Control byte of the next packet
+        if(offset < size)
+        {
+            offset++;
+            resetRemainingLength(&stream.length);
+            stream.inLength = true;
+        }
     }
+    while(offset < size);
 
-    // For purposes of computing the checksum, the value of the checksum field is zero. (See RFC791 Section 3.1)
-    ip->revSize        = 0x45;               // Four-bit Version field = 4 and IHL = 5 indicating the size is 20 bytes. (69 decimal or 0x45h)
-    ip->headerChecksum = 0;
-    ip->typeOfService  = 0;
-    ip->id             = htons(1);
-    ip->flagsAndOffset = 0;                  // Don't Fragment Flag Set
-    ip->ttl            = TIME_TO_LIVE;       // Time-to-Live in seconds
-    ip->protocol       = 6;                  // UDP = 17 or 0x21h (See RFC790 Assigned Internet Protocol Numbers table for list)
-
-    tcp->destPort      = htons(1883);        // Destination Port is
-    tcp->sourcePort    = htons(mqttSrcPort);
-    tcp->checksum      = 0;                  // Set checksum to zero before performing calculation
-    tcp->urgentPointer = 0;                  // Not used in this class
-    tcp->window        = htons(1024);
-    tcp->seqNum = tcb.currentSeqNum;
-    tcp->ackNum = tcb.currentAckNum;
+    stream.synced  = true;
+    stream.nextSeq = seq + size;
+}
+
+// Step getMqttFrame on to the packet after the one it gives now. Returns false
+// if there is none or it does not start whole in this segment.
+bool mqttNextPacket(uint8_t packet[])
+{
+    uint8_t* body;
+    uint16_t size;
+    uint32_t length;
+    mqttFrame* mqtt = getMqttFrame(packet, &size);
+
+    if(mqtt == NULL || (body = getMqttVariableHeader(mqtt, size, &length)) == NULL)
+        return false;
+
+    streamOffset += (body - (uint8_t*)mqtt) + length;
+
+    return streamOffset < rxInfo.dataSize;
+}
+
+// Set Remaining Length of a packet whose variable header and payload were written
+// to mqtt->data. A length over 127 needs more bytes so the data is moved up.
+// Returns size of whole MQTT packet (fixed header + remaining length).
+uint16_t setMqttRemainingLength(mqttFrame* mqtt, uint16_t length)
+{
+    uint8_t encoded[MQTT_MAX_LENGTH_BYTES], size;
+
+    size = encodeRemainingLength(encoded, length);
+
+    if(size > 1)
+        memmove(&mqtt->data[size - 1], mqtt->data, length);
+
+    memcpy(&mqtt->packetLength, encoded, size);
+
+    return 1 + size + length;
+}
+
+// Connect Variable Header Contains: Protocol Name, Protocol Level, Connect Flags, Keep Alive, and Properties
+bool sendMqttConnectMessage(uint8_t packet[], uint16_t flags)
+{
+    uint8_t i = 0;
+    uint16_t size;
+
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
+    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
+
+    // Ether, IP and TCP headers come from the broker connection template
+    tcpApplyTemplate(packet);
+    tcp->seqNum = mqttTcb->currentSeqNum;
+    tcp->ackNum = mqttTcb->currentAckNum;
     tcp->dataCtrlFields = htons(flags);
 
     // Connect Packet Type = 1, Flags = 0
@@ -255,474 +408,496 @@ void sendMqttConnectMessage(uint8_t packet[], uint16_t flags)
     mqtt->data[i++] = '-';
     mqtt->data[i++] = '1';
 
-    mqtt->packetLength = i; // MQTT Message Length
-
-    tcpSize = (sizeof(tcpFrame) + (i + 2)); // Size of Options
-
-    sum = 0;
-    ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize); // Adjust length of IP header
-    etherCalcIpChecksum(ip);
+    size = setMqttRemainingLength(mqtt, i); // MQTT Message Length
 
-    // 32-bit sum over pseudo-header
-    // TCP pseudo-header includes 4 byte source address from IP header,
-    // 4 byte destination address from IP header, 1 byte of zeros, 1 byte of protocol
-    // field from IP header, and 2 bytes for TCP length (Includes both TCP header and data).
-    sum = 0;
-    tmp16 = 0;
-    etherSumWords(ip->sourceIp, 8);
-    sum += ((tmp16 & 0xFF) << 8);
-    tmp16 = ip->protocol;
-    sum += ((tmp16 & 0xFF) << 8);
-    sum += ((tcpSize & 0xFF00));
-    sum += ((tcpSize & 0x00FF) << 8);
+    // Nothing is sent that could not be held for retransmission
+    if(!tcpRtxReady(size))
+        return false;
 
-    // Calculate TCP Header Checksum
-    etherSumWords(&tcp->sourcePort, tcpSize);
+    // Patch lengths and checksums, then send
+    arpSendPacket(packet, tcpFinishTemplate(packet, size));
 
-    tcp->checksum = getEtherChecksum(); // This value is the checksum over both the pseudo-header and the tcp segment
+    // Hold for retransmission until broker acknowledges it
+    tcpRtxQueue(packet, size);
 
-    // send packet with size = ether + udp header + ip header + udp_size + dchp header + options
-    etherPutPacket((uint8_t *)ether, 14 + ((ip->revSize & 0xF) * 4) + tcpSize);
+    return true;
 }
 
 // MQTT Connect+Ack Message
-void sendMqttDisconnectMessage(uint8_t packet[], uint16_t flags)
+bool sendMqttDisconnectMessage(uint8_t packet[], uint16_t flags)
 {
-    uint8_t i = 0;
-    uint16_t tcpSize = 0, tmp16 = 0;
-    uint32_t tmp32 = 0;
+    uint16_t size;
 
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
     mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
 
-    // Fill etherFrame
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        ether->destAddress[i]   = mqttMacAddress[i];
-        ether->sourceAddress[i] = macAddress[i];
-    }
-
-    ether->frameType = htons(0x0800); // For ipv4
-
-    // Fill ipFrame
-    for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i]   = mqttIpAddress[i];
-        ip->sourceIp[i] = ipAddress[i];
-    }
-
-    // For purposes of computing the checksum, the value of the checksum field is zero. (See RFC791 Section 3.1)
-    ip->revSize        = 0x45;            // Four-bit Version field = 4 and IHL = 5 indicating the size is 20 bytes. (69 decimal or 0x45h)
-    ip->headerChecksum = 0;
-    ip->typeOfService  = 0;
-    ip->id             = htons(1);
-    ip->flagsAndOffset = htons(0x4000);   // Don't Fragment Flag Set
-    ip->ttl            = 30;              // Time-to-Live in seconds
-    ip->protocol       = 6;               // UDP = 17 or 0x21h (See RFC790 Assigned Internet Protocol Numbers table for list)
-
-    tcp->destPort      = htons(1883);     // Destination Port is
-    tcp->sourcePort    = htons(mqttSrcPort);
-    tcp->checksum      = 0;               // Set checksum to zero before performing calculation
-    tcp->urgentPointer = 0;               // Not used in this class
-    tcp->window        = htons(1024);
+    // Ether, IP and TCP headers come from the broker connection template
+    tcpApplyTemplate(packet);
     tcp->dataCtrlFields = htons(flags);
+    tcp->seqNum = mqttTcb->currentSeqNum;
+    tcp->ackNum = mqttTcb->currentAckNum;
 
-    if(tcb.currentSeqNum != tcb.prevSeqNum)
-    {
-        tcp->seqNum = tcb.prevSeqNum = tcb.currentSeqNum;
-        tcp->ackNum = tcb.prevAckNum = tcb.currentAckNum;
-    }
-    else
-    {
-        tmp32 = htons32(tcb.prevSeqNum) + 1;
-        tcp->seqNum = tcb.currentSeqNum = tcb.prevSeqNum = htons32(tmp32);
-        tcp->ackNum = tcb.prevAckNum = tcb.currentAckNum;
-    }
-
-    i = 0;
     // DISCONNECT
     mqtt->control = 0xE0;
 
     // MQTT Message Length
-    mqtt->packetLength = 0; // No Variable Header or Payload for MQTT Disconnect
+    size = setMqttRemainingLength(mqtt, 0); // No Variable Header or Payload for MQTT Disconnect
+
+    // Nothing is sent that could not be held for retransmission
+    if(!tcpRtxReady(size))
+        return false;
+
+    // Patch lengths and checksums, then send
+    arpSendPacket(packet, tcpFinishTemplate(packet, size));
+
+    // Hold for retransmission until broker acknowledges it
+    tcpRtxQueue(packet, size);
+
+    return true;
+}
+
+bool sendMqttPingRequest(uint8_t packet[], uint16_t flags)
+{
+    uint16_t size;
 
-    tcpSize = (sizeof(tcpFrame) + (i + 2)); // Size of Options
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
+    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
+
+    // Ether, IP and TCP headers come from the broker connection template
+    tcpApplyTemplate(packet);
+    tcp->dataCtrlFields = htons(flags);
+    tcp->seqNum = mqttTcb->currentSeqNum;
+    tcp->ackNum = mqttTcb->currentAckNum;
+
+    // PING REQUEST
+    mqtt->control = 0xC0;
 
-    sum = 0;
-    ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize); // Adjust length of IP header
-    etherCalcIpChecksum(ip);
+    // MQTT Message Length
+    size = setMqttRemainingLength(mqtt, 0); // No Variable Header or Payload for MQTT Ping Request
 
-    // 32-bit sum over pseudo-header
-    // TCP pseudo-header includes 4 byte source address from IP header,
-    // 4 byte destination address from IP header, 1 byte of zeros, 1 byte of protocol
-    // field from IP header, and 2 bytes for TCP length (Includes both TCP header and data).
-    sum = 0;
-    tmp16 = 0;
-    etherSumWords(ip->sourceIp, 8);
-    sum += ((tmp16 & 0xFF) << 8);
-    tmp16 = ip->protocol;
-    sum += ((tmp16 & 0xFF) << 8);
-    sum += ((tcpSize & 0xFF00));
-    sum += ((tcpSize & 0x00FF) << 8);
+    // Nothing is sent that could not be held for retransmission
+    if(!tcpRtxReady(size))
+        return false;
 
-    // Calculate TCP Header Checksum
-    etherSumWords(&tcp->sourcePort, tcpSize);
+    // Patch lengths and checksums, then send
+    arpSendPacket(packet, tcpFinishTemplate(packet, size));
 
-    tcp->checksum = getEtherChecksum(); // This value is the checksum over both the pseudo-header and the tcp segment
+    // Hold for retransmission until broker acknowledges it
+    tcpRtxQueue(packet, size);
 
-    // send packet with size = ether + udp header + ip header + udp_size + dchp header + options
-    etherPutPacket((uint8_t *)ether, 14 + ((ip->revSize & 0xF) * 4) + tcpSize);
+    return true;
 }
 
-void sendMqttPingRequest(uint8_t packet[], uint16_t flags)
+// MQTT Publish Message
+// Only the headers are built in packet, the topic and payload are streamed
+// straight from the caller's strings into the ethernet controller's tx buffer.
+// packetId is only sent for QoS 1 and 2, dup is set when sending it again.
+// Returns false without sending if the publish cannot be held for retransmission.
+bool sendMqttPublish(uint8_t packet[], uint16_t flags, char topic[], char data[], uint8_t qos, uint16_t packetId, bool dup)
 {
     uint8_t i = 0;
-    uint16_t tcpSize = 0, tmp16 = 0;
-    uint32_t tmp32 = 0;
+    uint8_t* fixedHeader;
+    uint16_t topicLength, dataLength, remainingLength, headerSize;
+    uint32_t dataSum;
 
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
     mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
 
-    // Fill etherFrame
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        ether->destAddress[i]   = mqttMacAddress[i];
-        ether->sourceAddress[i] = macAddress[i];
-    }
+    // Ether, IP and TCP headers come from the broker connection template
+    tcpApplyTemplate(packet);
+    tcp->dataCtrlFields = htons(0x5018);
+    tcp->seqNum = mqttTcb->currentSeqNum;
+    tcp->ackNum = mqttTcb->currentAckNum;
 
-    ether->frameType = htons(0x0800); // For ipv4
+    topicLength = strlen(topic);
+    dataLength  = strlen(data);
 
-    // Fill ipFrame
-    for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i]   = mqttIpAddress[i];
-        ip->sourceIp[i] = ipAddress[i];
-    }
+    // PUBLISH Packet
+    //      |  3  |  2  1  |   0    |
+    //      | DUP |  QoS   | RETAIN |
+    mqtt->control = 0x31 | (qos << 1) | (dup ? 0x08 : 0x00); // RETAIN Flag is set
 
-    // For purposes of computing the checksum, the value of the checksum field is zero. (See RFC791 Section 3.1)
-    ip->revSize        = 0x45;               // Four-bit Version field = 4 and IHL = 5 indicating the size is 20 bytes. (69 decimal or 0x45h)
-    ip->headerChecksum = 0;
-    ip->typeOfService  = 0;
-    ip->id             = htons(1);
-    ip->flagsAndOffset = 0;                  // Don't Fragment Flag Set
-    ip->ttl            = TIME_TO_LIVE;       // Time-to-Live in seconds
-    ip->protocol       = 6;                  // UDP = 17 or 0x21h (See RFC790 Assigned Internet Protocol Numbers table for list)
-
-    tcp->destPort      = htons(1883);        // Destination Port is
-    tcp->sourcePort    = htons(mqttSrcPort);
-    tcp->checksum      = 0;                  // Set checksum to zero before performing calculation
-    tcp->urgentPointer = 0;                  // Not used in this class
-    tcp->window        = htons(1024);
-    tcp->dataCtrlFields = htons(flags);
-    tcp->seqNum = tcb.currentSeqNum;
-    tcp->ackNum = tcb.currentAckNum;
-    /*
-    if(tcb.currentSeqNum != tcb.prevSeqNum)
+    // MQTT Message Length (1-4 bytes)
+    remainingLength = 2 + topicLength + (qos ? 2 : 0) + dataLength;
+    fixedHeader = &mqtt->packetLength;
+    i = encodeRemainingLength(fixedHeader, remainingLength);
+
+    // Get TOPIC NAME Length (2 bytes in length)
+    fixedHeader[i++] = topicLength >> 8; // Length MSB
+    fixedHeader[i++] = topicLength;      // Length LSB
+
+    // Headers are summed in place, the streamed segments by their offset in the TCP data
+    headerSize = 1 + i;
+    if(!tcpRtxReady(headerSize - 2 + remainingLength))
+        return false;
+    dataSum = checksumAdd(0, mqtt, headerSize);
+    dataSum = checksumAddAt(dataSum, topic, topicLength, headerSize);
+
+    if(qos)
     {
-        //tcb.prevSeqNum = tcb.currentSeqNum;
-        //tcb.prevAckNum = tcb.currentAckNum;
-        tcp->seqNum = tcb.currentSeqNum;
-        tcp->ackNum = tcb.currentAckNum;
+        // Packet Identifier follows TOPIC NAME, so it is streamed after it
+        packetId = htons(packetId);
+        dataSum = checksumAddAt(dataSum, &packetId, 2, headerSize + topicLength);
+        dataSum = checksumAddAt(dataSum, data, dataLength, headerSize + topicLength + 2);
     }
     else
     {
-        tmp32 = htons32(tcb.prevSeqNum) + 1;
-        tcb.prevSeqNum = tcb.currentSeqNum;
-        tcb.prevAckNum = tcb.currentAckNum;
-        tcp->seqNum = tcb.currentSeqNum = htons32(tmp32);
-        tcp->ackNum = tcb.currentAckNum;
+        dataSum = checksumAddAt(dataSum, data, dataLength, headerSize + topicLength);
     }
-    */
-    i = 0;
 
-    // PING REQUEST
-    mqtt->control = 0xC0;
+    // Patch lengths and checksums, headers are everything up to the TOPIC NAME
+    tcpFinishTemplateSum(packet, headerSize - 2 + remainingLength, dataSum);
 
-    // MQTT Message Length
-    mqtt->packetLength = 0; // No Variable Header or Payload for MQTT Ping Request
+    // Streamed frames cannot wait on ARP, an unresolved one goes out on retransmission
+    if(arpResolve(packet))
+    {
+        etherTxStart();
+        etherTxWrite(packet, (uint8_t*)mqtt - packet + headerSize);
+        etherTxWrite(topic, topicLength);
+        if(qos)
+            etherTxWrite(&packetId, 2);
+        etherTxWrite(data, dataLength);
+        etherTxSend();
+    }
+
+    // Hold for retransmission until broker acknowledges it
+    tcpRtxQueue(packet, headerSize);
+    tcpRtxAppend(topic, topicLength);
+    if(qos)
+        tcpRtxAppend(&packetId, 2);
+    tcpRtxAppend(data, dataLength);
+
+    return true;
+}
+
+// Function for Sending MQTT PUBACK, PUBREC, PUBREL and PUBCOMP Messages
+bool mqttPubAckRec(uint8_t packet[], uint8_t type, uint16_t flags, uint16_t packetId)
+{
+    uint8_t i = 0;
+    uint16_t size;
 
-    tcpSize = (sizeof(tcpFrame) + (i + 2)); // Size of Options
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
+    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
+
+    // Ether, IP and TCP headers come from the broker connection template
+    tcpApplyTemplate(packet);
+    tcp->dataCtrlFields = htons(flags);
+    tcp->seqNum = mqttTcb->currentSeqNum;
+    tcp->ackNum = mqttTcb->currentAckNum;
 
-    sum = 0;
-    ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize); // Adjust length of IP header
-    etherCalcIpChecksum(ip);
+    // PUBACK, PUBREC, PUBREL or PUBCOMP Packet, PUBREL has reserved flags 0010
+    mqtt->control = (type << 4) | ((type == PUBREL) ? 0x02 : 0x00);
 
-    // 32-bit sum over pseudo-header
-    // TCP pseudo-header includes 4 byte source address from IP header,
-    // 4 byte destination address from IP header, 1 byte of zeros, 1 byte of protocol
-    // field from IP header, and 2 bytes for TCP length (Includes both TCP header and data).
-    sum = 0;
-    tmp16 = 0;
-    etherSumWords(ip->sourceIp, 8);
-    sum += ((tmp16 & 0xFF) << 8);
-    tmp16 = ip->protocol;
-    sum += ((tmp16 & 0xFF) << 8);
-    sum += ((tcpSize & 0xFF00));
-    sum += ((tcpSize & 0x00FF) << 8);
+    // MQTT Message Length
+    size = setMqttRemainingLength(mqtt, 2);
 
-    // Calculate TCP Header Checksum
-    etherSumWords(&tcp->sourcePort, tcpSize);
+    i = 0;
+    // Packet Identifer
+    mqtt->data[i++] = packetId >> 8; // ID MSB
+    mqtt->data[i++] = packetId;      // ID LSB
 
-    tcp->checksum = getEtherChecksum(); // This value is the checksum over both the pseudo-header and the tcp segment
+    // Nothing is sent that could not be held for retransmission
+    if(!tcpRtxReady(size))
+        return false;
 
-    // send packet with size = ether + udp header + ip header + udp_size + dchp header + options
-    etherPutPacket((uint8_t *)ether, 14 + ((ip->revSize & 0xF) * 4) + tcpSize);
+    // Patch lengths and checksums, then send
+    arpSendPacket(packet, tcpFinishTemplate(packet, size));
+
+    // Hold for retransmission until broker acknowledges it
+    tcpRtxQueue(packet, size);
+
+    return true;
 }
 
-// MQTT Connect+Ack Message
-void sendMqttPublish(uint8_t packet[], uint16_t flags, char topic[], char data[])
+// Packet Identifiers are handed out in order, 0 is not allowed
+uint16_t mqttNextPacketId(void)
 {
-    uint8_t i = 0, k;
-    uint16_t tcpSize = 0, tmp16 = 0, length, packetId;
+    if(++mqttPacketId == 0)
+        mqttPacketId = 1;
 
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
+    return mqttPacketId;
+}
+
+// Returns index of in-flight publish waiting in state with packetId,
+// or MQTT_MAX_INFLIGHT if there is none
+uint8_t mqttFindInflight(mqttInflightState state, uint16_t packetId)
+{
+    uint8_t i;
 
-    // Fill etherFrame
-    for (i = 0; i < HW_ADD_LENGTH; i++)
+    for(i = 0; i < MQTT_MAX_INFLIGHT; i++)
     {
-        ether->destAddress[i]   = mqttMacAddress[i];
-        ether->sourceAddress[i] = macAddress[i];
+        if(inflight[i].state == state && inflight[i].packetId == packetId)
+            break;
     }
 
-    ether->frameType = htons(0x0800); // For ipv4
+    return i;
+}
 
-    // Fill ipFrame
-    for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i]   = mqttIpAddress[i];
-        ip->sourceIp[i] = ipAddress[i];
-    }
+// Publish topic and data at QoS 0, 1 or 2. QoS 1 and 2 publishes are held
+// until acknowledged, up to mqttWindowSize at once. Returns false if the
+// window is full, the publish is too big to hold or the connection has no
+// room to hold it for retransmission.
+bool mqttPublish(uint8_t packet[], char topic[], char data[], uint8_t qos)
+{
+    uint8_t i, count = 0, slot = MQTT_MAX_INFLIGHT;
+    mqttInflight* msg;
 
-    // For purposes of computing the checksum, the value of the checksum field is zero. (See RFC791 Section 3.1)
-    ip->revSize       = 0x45;                // Four-bit Version field = 4 and IHL = 5 indicating the size is 20 bytes. (69 decimal or 0x45h)
-    ip->headerChecksum = 0;
-    ip->typeOfService  = 0;
-    ip->id             = htons(1);
-    ip->flagsAndOffset = 0;                  // Don't Fragment Flag Set
-    ip->ttl            = TIME_TO_LIVE;       // Time-to-Live in seconds
-    ip->protocol       = 6;                  // UDP = 17 or 0x21h (See RFC790 Assigned Internet Protocol Numbers table for list)
-
-    tcp->destPort      = htons(1883);        // Destination Port is
-    tcp->sourcePort    = htons(mqttSrcPort);
-    tcp->checksum      = 0;                  // Set checksum to zero before performing calculation
-    tcp->urgentPointer = 0;                  // Not used in this class
-    tcp->window        = htons(1024);
-    tcp->dataCtrlFields = htons(0x5018);
-    tcp->seqNum = tcb.currentSeqNum;
-    tcp->ackNum = tcb.currentAckNum;
+    if(qos == 0)
+        return sendMqttPublish(packet, 0x5018, topic, data, 0, 0, false);
 
-    // PUBLISH Packet
-    mqtt->control = 0x31; // RETAIN Flag is set
+    if(strlen(topic) >= MQTT_MAX_SUB_CHARS || strlen(data) >= MQTT_MAX_BUFFER_SIZE)
+        return false;
 
-    // TOPIC NAME
-    i = 2;
-    k = 0;
-    while(topic[k] != '\0')
+    // Count outstanding publishes and find a free slot
+    for(i = 0; i < MQTT_MAX_INFLIGHT; i++)
     {
-        mqtt->data[i++] = topic[k++];
+        if(inflight[i].state != INFLIGHT_FREE)
+            count++;
+        else if(slot == MQTT_MAX_INFLIGHT)
+            slot = i;
     }
-    // Get TOPIC NAME Length (2 bytes in length)
-    length = (i - 2);
-    mqtt->data[0] = length >> 8; // Length MSB
-    mqtt->data[1] = length;      // Length LSB
 
-    if((mqtt->control & 0x06) == 0x02 || (mqtt->control & 0x0F) == 0x04) // If QoS Level Set then Look for Packet Identifier
-    {
-        // Packet Identifier
-        packetId = random32();
-        mqtt->data[i++] = packetId >> 8; // ID MSB
-        mqtt->data[i++] = packetId;      // ID LSB
-    }
+    if(count >= mqttWindowSize || slot == MQTT_MAX_INFLIGHT)
+        return false;
 
-    // Payload
-    k = 0;
-    while(data[k] != '\0')
+    msg = &inflight[slot];
+    strcpy(msg->topic, topic);
+    strcpy(msg->data, data);
+    msg->qos      = (qos > 2) ? 2 : qos;
+    msg->state    = (msg->qos == 1) ? WAIT_PUBACK : WAIT_PUBREC;
+    msg->packetId = mqttNextPacketId();
+    msg->retries  = 0;
+    msg->sentTime = timerGetTicks();
+
+    // Slot is given back if the connection cannot take it now
+    if(!sendMqttPublish(packet, 0x5018, msg->topic, msg->data, msg->qos, msg->packetId, false))
     {
-        mqtt->data[i++] = data[k++];
+        msg->state = INFLIGHT_FREE;
+        return false;
     }
 
-    // MQTT Message Length
-    mqtt->packetLength = i; // No Variable Header or Payload for MQTT Disconnect
+    return true;
+}
 
-    tcpSize = (sizeof(tcpFrame) + (i+2)); // Size of Options
+// Hold an acknowledgement to send after the received segment is handled,
+// so it carries the acknowledge number for that segment.
+void mqttQueueAck(uint8_t type, uint16_t packetId)
+{
+    mqttAck* ack;
 
-    sum = 0;
-    ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize); // Adjust length of IP header
-    etherCalcIpChecksum(ip);
+    // If queue is full broker will send its packet again
+    if((uint8_t)(ackTail - ackHead) >= MQTT_ACK_QUEUE_SIZE)
+        return;
 
-    // 32-bit sum over pseudo-header
-    // TCP pseudo-header includes 4 byte source address from IP header,
-    // 4 byte destination address from IP header, 1 byte of zeros, 1 byte of protocol
-    // field from IP header, and 2 bytes for TCP length (Includes both TCP header and data).
-    sum = 0;
-    tmp16 = 0;
-    etherSumWords(ip->sourceIp, 8);
-    sum += ((tmp16 & 0xFF) << 8);
-    tmp16 = ip->protocol;
-    sum += ((tmp16 & 0xFF) << 8);
-    sum += ((tcpSize & 0xFF00));
-    sum += ((tcpSize & 0x00FF) << 8);
+    ack = &ackQueue[ackTail++ & (MQTT_ACK_QUEUE_SIZE - 1)];
+    ack->type     = type;
+    ack->packetId = packetId;
+}
 
-    // Calculate TCP Header Checksum
-    etherSumWords(&tcp->sourcePort, tcpSize);
+// Acknowledge a PUBLISH received from the broker. Returns false if it is a
+// QoS 2 publish that was already delivered and must not be processed again.
+bool mqttReceivedPublish(uint8_t control, uint16_t packetId)
+{
+    uint8_t i;
 
-    tcp->checksum = getEtherChecksum(); // This value is the checksum over both the pseudo-header and the tcp segment
+    switch((control >> 1) & 0x03)
+    {
+    case 1:
+        mqttQueueAck(PUBACK, packetId);
+        break;
+    case 2:
+        mqttQueueAck(PUBREC, packetId);
 
-    // send packet with size = ether + udp header + ip header + udp_size + dchp header + options
-    etherPutPacket((uint8_t *)ether, 14 + ((ip->revSize & 0xF) * 4) + tcpSize);
+        for(i = 0; i < MQTT_MAX_INFLIGHT; i++)
+        {
+            if(rxQos2Ids[i] == packetId)
+                return false;
+        }
+
+        // If table is full it is delivered anyway
+        for(i = 0; i < MQTT_MAX_INFLIGHT; i++)
+        {
+            if(rxQos2Ids[i] == 0)
+            {
+                rxQos2Ids[i] = packetId;
+                break;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    return true;
 }
 
-// Function for Sending MQTT PUBACK Message
-void mqttPubAckRec(uint8_t packet[], uint8_t type, uint16_t flags, uint16_t packetId)
+// Handle PUBACK, PUBREC, PUBREL and PUBCOMP from the broker. A segment can
+// carry several MQTT packets back to back so all of them are checked.
+void mqttProcessAck(uint8_t packet[])
 {
-    uint8_t i = 0;
-    uint16_t tcpSize = 0, tmp16 = 0;
-
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
+    uint8_t i;
+    uint8_t* body;
+    uint16_t size, offset, packetId;
+    uint32_t length;
+    mqttFrame* mqtt = getMqttFrame(packet, &size);
 
-    // Fill etherFrame
-    for (i = 0; i < HW_ADD_LENGTH; i++)
+    offset = 0;
+    while(mqtt != NULL && offset < size)
     {
-        ether->destAddress[i]   = 0xFF;
-        ether->sourceAddress[i] = macAddress[i];
-    }
+        if((body = getMqttVariableHeader(mqtt, size - offset, &length)) == NULL)
+            return;
 
-    ether->frameType = htons(0x0800); // For ipv4
+        packetId = (length >= 2) ? ((body[0] << 8) | body[1]) : 0;
 
-    // Fill ipFrame
-    for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i]   = mqttIpAddress[i];
-        ip->sourceIp[i] = ipAddress[i];
+        switch((length >= 2) ? (mqtt->control >> 4) : RESERVED)
+        {
+        case PUBACK:
+            if((i = mqttFindInflight(WAIT_PUBACK, packetId)) < MQTT_MAX_INFLIGHT)
+                inflight[i].state = INFLIGHT_FREE;
+            break;
+        case PUBREC:
+            if((i = mqttFindInflight(WAIT_PUBREC, packetId)) < MQTT_MAX_INFLIGHT)
+            {
+                inflight[i].state    = WAIT_PUBCOMP;
+                inflight[i].retries  = 0;
+                inflight[i].sentTime = timerGetTicks();
+            }
+            // Answered even if already answered, our PUBREL may have been lost
+            mqttQueueAck(PUBREL, packetId);
+            break;
+        case PUBREL:
+            for(i = 0; i < MQTT_MAX_INFLIGHT; i++)
+            {
+                if(rxQos2Ids[i] == packetId)
+                    rxQos2Ids[i] = 0;
+            }
+            mqttQueueAck(PUBCOMP, packetId);
+            break;
+        case PUBCOMP:
+            if((i = mqttFindInflight(WAIT_PUBCOMP, packetId)) < MQTT_MAX_INFLIGHT)
+                inflight[i].state = INFLIGHT_FREE;
+            break;
+        default:
+            break;
+        }
+
+        offset += (body - (uint8_t*)mqtt) + length;
+        mqtt = (mqttFrame*)(body + length);
     }
+}
 
-    // For purposes of computing the checksum, the value of the checksum field is zero. (See RFC791 Section 3.1)
-    ip->revSize        = 0x45;               // Four-bit Version field = 4 and IHL = 5 indicating the size is 20 bytes. (69 decimal or 0x45h)
-    ip->headerChecksum = 0;
-    ip->typeOfService  = 0;
-    ip->id             = htons(1);
-    ip->flagsAndOffset = htons(0x4000);      // Don't Fragment Flag Set
-    ip->ttl            = TIME_TO_LIVE;       // Time-to-Live in seconds
-    ip->protocol       = 6;                  // UDP = 17 or 0x21h (See RFC790 Assigned Internet Protocol Numbers table for list)
-
-    tcp->destPort      = htons(1883);        // Destination Port is
-    tcp->sourcePort    = htons(mqttSrcPort);
-    tcp->checksum      = 0;                  // Set checksum to zero before performing calculation
-    tcp->urgentPointer = 0;                  // Not used in this class
-    tcp->window        = htons(1024);
-    tcp->dataCtrlFields = htons(flags);
-    tcp->seqNum = tcb.currentSeqNum;
-    tcp->ackNum = tcb.currentAckNum;
+// Nothing to do here, the timer only has to wake the main loop from its sleep
+// so it calls mqttInflightPoll, which sends outside the timer interrupt
+void mqttRetryTimerExpired(void)
+{
+}
 
-    if(type == 4)
-    {
-        // PUBACK Packet
-        mqtt->control = 0x40;
-    }
-    else if(type == 5)
+// Called from main loop. Sends queued acknowledgements and sends publishes
+// (with DUP) or PUBRELs again if the broker has not answered in time.
+void mqttInflightPoll(uint8_t packet[])
+{
+    uint8_t i;
+    mqttAck* ack;
+    mqttInflight* msg;
+    uint32_t now, wait = 0, left;
+    bool sent;
+
+    if(mqttTcb->state != ESTABLISHED)
+        return;
+
+    // Acknowledgements that cannot be sent yet wait for the next poll
+    while(ackHead != ackTail)
     {
-        // PUBREC Packet
-        mqtt->control = 0x50;
+        ack = &ackQueue[ackHead & (MQTT_ACK_QUEUE_SIZE - 1)];
+        if(!mqttPubAckRec(packet, ack->type, 0x5018, ack->packetId))
+            break;
+        ackHead++;
     }
 
-    // MQTT Message Length
-    mqtt->packetLength = 2;
-
-    i = 0;
-    // Packet Identifer
-    mqtt->data[i++] = packetId >> 8; // ID MSB
-    mqtt->data[i++] = packetId;      // ID LSB
+    now = timerGetTicks();
+    for(i = 0; i < MQTT_MAX_INFLIGHT; i++)
+    {
+        msg = &inflight[i];
 
-    tcpSize = (sizeof(tcpFrame) + (i + 2)); // Size of Options
+        if(msg->state == INFLIGHT_FREE || (now - msg->sentTime) < MQTT_RETRY_TIME)
+            continue;
 
-    sum = 0;
-    ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize); // Adjust length of IP header
-    etherCalcIpChecksum(ip);
+        // Give up on it, frees the slot for the next publish
+        if(msg->retries >= MQTT_MAX_RETRIES)
+        {
+            msg->state = INFLIGHT_FREE;
+            continue;
+        }
 
-    // 32-bit sum over pseudo-header
-    // TCP pseudo-header includes 4 byte source address from IP header,
-    // 4 byte destination address from IP header, 1 byte of zeros, 1 byte of protocol
-    // field from IP header, and 2 bytes for TCP length (Includes both TCP header and data).
-    sum = 0;
-    tmp16 = 0;
-    etherSumWords(ip->sourceIp, 8);
-    sum += ((tmp16 & 0xFF) << 8);
-    tmp16 = ip->protocol;
-    sum += ((tmp16 & 0xFF) << 8);
-    sum += ((tcpSize & 0xFF00));
-    sum += ((tcpSize & 0x00FF) << 8);
+        if(msg->state == WAIT_PUBCOMP)
+            sent = mqttPubAckRec(packet, PUBREL, 0x5018, msg->packetId);
+        else
+            sent = sendMqttPublish(packet, 0x5018, msg->topic, msg->data, msg->qos, msg->packetId, true);
 
-    // Calculate TCP Header Checksum
-    etherSumWords(&tcp->sourcePort, tcpSize);
+        // Not counted as a try if the connection was too busy to take it
+        if(sent)
+        {
+            msg->retries++;
+            msg->sentTime = now;
+        }
+    }
 
-    tcp->checksum = getEtherChecksum(); // This value is the checksum over both the pseudo-header and the tcp segment
+    // The main loop sleeps between interrupts, have one when the next resend is due
+    for(i = 0; i < MQTT_MAX_INFLIGHT; i++)
+    {
+        msg = &inflight[i];
+        if(msg->state == INFLIGHT_FREE)
+            continue;
+
+        // A resend the connection had no room for is tried again on the next tick
+        left = now - msg->sentTime;
+        left = (left >= MQTT_RETRY_TIME) ? 1 : MQTT_RETRY_TIME - left;
+        if(wait == 0 || left < wait)
+            wait = left;
+    }
 
-    // send packet with size = ether + udp header + ip header + udp_size + dchp header + options
-    etherPutPacket((uint8_t *)ether, 14 + ((ip->revSize & 0xF) * 4) + tcpSize);
+    timerStop(mqttRetryTimer);
+    mqttRetryTimer = (wait != 0) ? timerStart(mqttRetryTimerExpired, wait, false) : TIMER_INVALID;
 }
 
-// Function for MQTT Subscribe
-void mqttSubscribe(uint8_t packet[], uint16_t flags, char topic[])
+// Forget publishes and acknowledgements from the last session
+void mqttInflightReset(void)
 {
-    uint8_t i = 0, k, offset;
-    uint16_t tcpSize = 0, tmp16 = 0, length, packetId;
-
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
+    uint8_t i;
 
-    // Fill etherFrame
-    for (i = 0; i < HW_ADD_LENGTH; i++)
+    for(i = 0; i < MQTT_MAX_INFLIGHT; i++)
     {
-        ether->destAddress[i]   = 0xFF;
-        ether->sourceAddress[i] = macAddress[i];
+        inflight[i].state = INFLIGHT_FREE;
+        rxQos2Ids[i] = 0;
     }
 
-    ether->frameType = htons(0x0800); // For ipv4
+    ackHead = ackTail = 0;
 
-    // Fill ipFrame
-    for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i]   = mqttIpAddress[i];
-        ip->sourceIp[i] = ipAddress[i];
-    }
+    mqttStreamReset();
+}
+
+// Function for MQTT Subscribe
+bool mqttSubscribe(uint8_t packet[], uint16_t flags, char topic[])
+{
+    uint16_t i = 0, k, offset;
+    uint16_t size;
+    uint16_t length, packetId;
+
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
+    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
 
-    // For purposes of computing the checksum, the value of the checksum field is zero. (See RFC791 Section 3.1)
-    ip->revSize        = 0x45;               // Four-bit Version field = 4 and IHL = 5 indicating the size is 20 bytes. (69 decimal or 0x45h)
-    ip->headerChecksum = 0;
-    ip->typeOfService  = 0;
-    ip->id             = htons(1);
-    ip->flagsAndOffset = htons(0x4000);      // Don't Fragment Flag Set
-    ip->ttl            = TIME_TO_LIVE;       // Time-to-Live in seconds
-    ip->protocol       = 6;                  // UDP = 17 or 0x21h (See RFC790 Assigned Internet Protocol Numbers table for list)
-
-    tcp->destPort      = htons(1883);        // Destination Port is
-    tcp->sourcePort    = htons(mqttSrcPort);
-    tcp->checksum      = 0;                  // Set checksum to zero before performing calculation
-    tcp->urgentPointer = 0;                  // Not used in this class
-    tcp->window        = htons(1024);
+    // Ether, IP and TCP headers come from the broker connection template
+    tcpApplyTemplate(packet);
     tcp->dataCtrlFields = htons(0x5018);
-    tcp->seqNum = tcb.currentSeqNum;
-    tcp->ackNum = tcb.currentAckNum;
-    tcb.prevSeqNum += 1;
+    tcp->seqNum = mqttTcb->currentSeqNum;
+    tcp->ackNum = mqttTcb->currentAckNum;
 
     // SUBSCRIBE Packet
     mqtt->control = 0x82;
 
     // Packet Identifier
     i = 0;
-    packetId = random32();
+    packetId = mqttNextPacketId();
     mqtt->data[i++] = packetId >> 8; // ID MSB
     mqtt->data[i++] = packetId;      // ID LSB
 
@@ -730,11 +905,15 @@ void mqttSubscribe(uint8_t packet[], uint16_t flags, char topic[])
     offset = i;
     i += 2;
     k = 0;
-    while(topic[k] != '\0')
+    while(topic[k] != '\0' && i < MQTT_MAX_SEGMENT_DATA - 1)
     {
         mqtt->data[i++] = topic[k++];
     }
 
+    // Topic that does not fit one segment with its QoS byte
+    if(topic[k] != '\0')
+        return false;
+
     // Get TOPIC NAME Length (2 bytes in length)
     length = (i - offset - 2);
     mqtt->data[offset++] = length >> 8; // Length MSB
@@ -744,88 +923,43 @@ void mqttSubscribe(uint8_t packet[], uint16_t flags, char topic[])
     mqtt->data[i++] = 0x01;
 
     // MQTT Message Length
-    mqtt->packetLength = i; // No Variable Header or Payload for MQTT Disconnect
-
-    tcpSize = (sizeof(tcpFrame) + (i+2)); // Size of Options
+    size = setMqttRemainingLength(mqtt, i); // No Variable Header or Payload for MQTT Disconnect
 
-    sum = 0;
-    ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize); // Adjust length of IP header
-    etherCalcIpChecksum(ip);
+    // Nothing is sent that could not be held for retransmission
+    if(!tcpRtxReady(size))
+        return false;
 
-    // 32-bit sum over pseudo-header
-    // TCP pseudo-header includes 4 byte source address from IP header,
-    // 4 byte destination address from IP header, 1 byte of zeros, 1 byte of protocol
-    // field from IP header, and 2 bytes for TCP length (Includes both TCP header and data).
-    sum = 0;
-    tmp16 = 0;
-    etherSumWords(ip->sourceIp, 8);
-    sum += ((tmp16 & 0xFF) << 8);
-    tmp16 = ip->protocol;
-    sum += ((tmp16 & 0xFF) << 8);
-    sum += ((tcpSize & 0xFF00));
-    sum += ((tcpSize & 0x00FF) << 8);
+    // Patch lengths and checksums, then send
+    arpSendPacket(packet, tcpFinishTemplate(packet, size));
 
-    // Calculate TCP Header Checksum
-    etherSumWords(&tcp->sourcePort, tcpSize);
+    // Hold for retransmission until broker acknowledges it
+    tcpRtxQueue(packet, size);
 
-    tcp->checksum = getEtherChecksum(); // This value is the checksum over both the pseudo-header and the tcp segment
-
-    // send packet with size = ether + udp header + ip header + udp_size + dchp header + options
-    etherPutPacket((uint8_t *)ether, 14 + ((ip->revSize & 0xF) * 4) + tcpSize);
+    return true;
 }
 
 // Function for MQTT Unsubscribe Packet
-void mqttUnsubscribe(uint8_t packet[], uint16_t flags, char topic[])
+bool mqttUnsubscribe(uint8_t packet[], uint16_t flags, char topic[])
 {
-    uint8_t i = 0, k, offset;
-    uint16_t tcpSize = 0, tmp16 = 0, length, packetId;
+    uint16_t i = 0, k, offset;
+    uint16_t size;
+    uint16_t length, packetId;
 
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
     mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
 
-    // Fill etherFrame
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        ether->destAddress[i]   = 0xFF;
-        ether->sourceAddress[i] = macAddress[i];
-    }
-
-    ether->frameType = htons(0x0800); // For ipv4
-
-    // Fill ipFrame
-    for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i]   = mqttIpAddress[i];
-        ip->sourceIp[i] = ipAddress[i];
-    }
-
-    // For purposes of computing the checksum, the value of the checksum field is zero. (See RFC791 Section 3.1)
-    ip->revSize       = 0x45;                // Four-bit Version field = 4 and IHL = 5 indicating the size is 20 bytes. (69 decimal or 0x45h)
-    ip->headerChecksum = 0;
-    ip->typeOfService  = 0;
-    ip->id             = htons(1);
-    ip->flagsAndOffset = htons(0x4000);      // Don't Fragment Flag Set
-    ip->ttl            = TIME_TO_LIVE;       // Time-to-Live in seconds
-    ip->protocol       = 6;                  // UDP = 17 or 0x21h (See RFC790 Assigned Internet Protocol Numbers table for list)
-
-    tcp->destPort      = htons(1883);        // Destination Port is
-    tcp->sourcePort    = htons(mqttSrcPort);
-    tcp->checksum      = 0;                  // Set checksum to zero before performing calculation
-    tcp->urgentPointer = 0;                  // Not used in this class
-    tcp->window        = htons(1024);
+    // Ether, IP and TCP headers come from the broker connection template
+    tcpApplyTemplate(packet);
     tcp->dataCtrlFields = htons(0x5018);
-    tcp->seqNum = tcb.prevSeqNum;
-    tcp->ackNum = tcb.prevAckNum;
-    tcb.prevSeqNum+=1;
+    tcp->seqNum = mqttTcb->currentSeqNum;
+    tcp->ackNum = mqttTcb->currentAckNum;
 
     // UNSUBSCRIBE Packet
     mqtt->control = 0xA2;
 
     // Packet Identifier
     i = 0;
-    packetId = random32();
+    packetId = mqttNextPacketId();
     mqtt->data[i++] = packetId >> 8; // ID MSB
     mqtt->data[i++] = packetId;      // ID LSB
 
@@ -833,43 +967,32 @@ void mqttUnsubscribe(uint8_t packet[], uint16_t flags, char topic[])
     offset = i;
     i += 2;
     k = 0;
-    while(topic[k] != '\0')
+    while(topic[k] != '\0' && i < MQTT_MAX_SEGMENT_DATA)
     {
         mqtt->data[i++] = topic[k++];
     }
 
+    // Topic that does not fit one segment
+    if(topic[k] != '\0')
+        return false;
+
     // Get TOPIC NAME Length (2 bytes in length)
     length = (i - offset - 2);
     mqtt->data[offset++] = length >> 8; // Length MSB
     mqtt->data[offset++] = length;      // Length LSB
 
     // MQTT Message Length
-    mqtt->packetLength = i; // No Variable Header or Payload for MQTT Disconnect
-
-    tcpSize = (sizeof(tcpFrame) + (i + 2)); // Size of Options
-
-    sum = 0;
-    ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize); // Adjust length of IP header
-    etherCalcIpChecksum(ip);
-
-    // 32-bit sum over pseudo-header
-    // TCP pseudo-header includes 4 byte source address from IP header,
-    // 4 byte destination address from IP header, 1 byte of zeros, 1 byte of protocol
-    // field from IP header, and 2 bytes for TCP length (Includes both TCP header and data).
-    sum = 0;
-    tmp16 = 0;
-    etherSumWords(ip->sourceIp, 8);
-    sum += ((tmp16 & 0xFF) << 8);
-    tmp16 = ip->protocol;
-    sum += ((tmp16 & 0xFF) << 8);
-    sum += ((tcpSize & 0xFF00));
-    sum += ((tcpSize & 0x00FF) << 8);
-
-    // Calculate TCP Header Checksum
-    etherSumWords(&tcp->sourcePort, tcpSize);
-
-    tcp->checksum = getEtherChecksum(); // This value is the checksum over both the pseudo-header and the tcp segment
-
-    // send packet with size = ether + udp header + ip header + udp_size + dchp header + options
-    etherPutPacket((uint8_t *)ether, 14 + ((ip->revSize & 0xF) * 4) + tcpSize);
+    size = setMqttRemainingLength(mqtt, i); // No Variable Header or Payload for MQTT Disconnect
+
+    // Nothing is sent that could not be held for retransmission
+    if(!tcpRtxReady(size))
+        return false;
+
+    // Patch lengths and checksums, then send
+    arpSendPacket(packet, tcpFinishTemplate(packet, size));
+
+    // Hold for retransmission until broker acknowledges it
+    tcpRtxQueue(packet, size);
+
+    return true;
 }
@@ -19,17 +19,22 @@
 #define MQTT_TIME_TO_LIVE    60
 #define MQTT_MAX_BUFFER_SIZE 125
 #define MQTT_MAX_FIELD_SIZE  8
-#define MQTT_MAX_TABLE_SIZE  10
 #define MQTT_MAX_SUB_CHARS   25
 #define MQTT_ADD_LENGTH      4
 #define MQTT_BROKER_PORT     1883
-#define MQTT_HW_ADD_LENGTH   6
+#define MQTT_MAX_LENGTH_BYTES 4   // Remaining Length field is 1-4 bytes
+#define MQTT_MAX_SEGMENT_DATA (TCP_MSS - 1 - MQTT_MAX_LENGTH_BYTES) // Bytes after the fixed header that fit one segment
+#define MQTT_MAX_INFLIGHT    4    // QoS 1/2 publishes that can wait for acknowledgement
+#define MQTT_ACK_QUEUE_SIZE  4    // PUBACK/PUBREC/PUBREL/PUBCOMP waiting to be sent, power of 2
+#define MQTT_RETRY_TIME      5000 // Resend unacknowledged publish with DUP after ms
+#define MQTT_MAX_RETRIES     5
 
 extern uint8_t mqttIpAddress[MQTT_ADD_LENGTH];
-extern uint8_t mqttMacAddress[MQTT_HW_ADD_LENGTH];
 extern uint8_t mqttMsgType;
 extern uint16_t mqttSrcPort;
 extern uint16_t mqttPacketId;
+extern uint8_t mqttPublishQos;
+extern uint8_t mqttWindowSize;
 
 typedef enum
 {
@@ -52,32 +57,100 @@ typedef enum
 typedef struct _mqttFrame
 {
   uint8_t control;      // 1st 4 MSBs are Packet Type and other 4 bits are Control Flags
-  uint8_t packetLength; // Bit 7 = Continuation Flag, bits 6-3 =
+  uint8_t packetLength; // 1st byte of Remaining Length, bit 7 = Continuation Flag, bits 6-0 = value
   uint8_t data[0];      //
 } mqttFrame;
 
-typedef struct _mqttTopics
+// Result of feeding a byte to decodeRemainingLength
+typedef enum
+{
+    LENGTH_INCOMPLETE,
+    LENGTH_COMPLETE,
+    LENGTH_MALFORMED
+} mqttLengthStatus;
+
+// State of a Remaining Length field being decoded
+typedef struct _mqttLengthDecoder
+{
+    uint32_t value;
+    uint32_t multiplier;
+    uint8_t  count;      // bytes consumed
+} mqttLengthDecoder;
+
+// Position in the byte stream from the broker, carried from one segment to
+// the next so a packet that runs past the end of a segment does not throw
+// the following ones out of step
+typedef struct _mqttStream
+{
+    bool     synced;      // nextSeq is known
+    bool     inLength;    // Remaining Length field continues in the next segment
+    uint32_t nextSeq;     // Sequence number of the next segment in order, host order
+    uint32_t skip;        // Bytes of the last packet still to come
+    mqttLengthDecoder length;
+} mqttStream;
+
+// Where a QoS 1/2 publish is in its acknowledgement exchange
+typedef enum
+{
+    INFLIGHT_FREE,
+    WAIT_PUBACK,  // QoS 1
+    WAIT_PUBREC,  // QoS 2, PUBLISH sent
+    WAIT_PUBCOMP  // QoS 2, PUBREL sent
+} mqttInflightState;
+
+// Publish held until the broker acknowledges it. Topic and payload are
+// kept so it can be sent again with DUP set.
+typedef struct _mqttInflight
+{
+    mqttInflightState state;
+    uint8_t  qos;
+    uint8_t  retries;
+    uint16_t packetId;
+    uint32_t sentTime;  // timerGetTicks() when last sent
+    char topic[MQTT_MAX_SUB_CHARS];
+    char data[MQTT_MAX_BUFFER_SIZE];
+} mqttInflight;
+
+// Acknowledgement to send once the segment that asked for it has been handled
+typedef struct _mqttAck
 {
-    bool validBit;
-    char subs[MQTT_MAX_SUB_CHARS];
-} mqttTopics;
+    uint8_t  type;
+    uint16_t packetId;
+} mqttAck;
 
-extern mqttTopics topics[MQTT_MAX_TABLE_SIZE];
+extern mqttInflight inflight[MQTT_MAX_INFLIGHT];
 
 uint8_t getMqttMsgType(uint8_t packet[]);
+uint8_t encodeRemainingLength(uint8_t encoded[], uint32_t value);
+void resetRemainingLength(mqttLengthDecoder* decoder);
+mqttLengthStatus decodeRemainingLength(mqttLengthDecoder* decoder, uint8_t encodedByte);
+uint8_t* getMqttVariableHeader(mqttFrame* mqtt, uint16_t size, uint32_t* remainingLength);
+void mqttStreamReset(void);
+void mqttStreamSegment(uint8_t packet[]);
+bool mqttNextPacket(uint8_t packet[]);
+uint16_t setMqttRemainingLength(mqttFrame* mqtt, uint16_t length);
 void setMqttAddress(uint8_t mqtt0, uint8_t mqtt1, uint8_t mqtt2, uint8_t mqtt3);
 void getMqttAddress(uint8_t mqtt[]);
+mqttFrame* getMqttFrame(uint8_t packet[], uint16_t* size);
 bool isMqttMessage(uint8_t packet[]);
-void sendMqttConnectMessage(uint8_t packet[], uint16_t flags);
+bool getMqttPublish(uint8_t packet[], char topic[], uint16_t topicSize, char payload[], uint16_t payloadSize);
+bool sendMqttConnectMessage(uint8_t packet[], uint16_t flags);
 void mqttConnectAckMessage(uint8_t packet[]);
-void sendMqttDisconnectMessage(uint8_t packet[] , uint16_t flags);
-void sendMqttPingRequest(uint8_t packet[], uint16_t flags);
-void mqttPubAckRec(uint8_t packet[], uint8_t type, uint16_t flags, uint16_t packetId);
-void sendMqttPublish(uint8_t packet[], uint16_t flags, char topic[], char data[]);
-void mqttSubscribe(uint8_t packet[], uint16_t flags, char topic[]);
-void mqttUnsubscribe(uint8_t packet[], uint16_t flags, char topic[]);
-void createEmptySlot(char info[]);
-uint8_t findEmptySlot(void);
+bool sendMqttDisconnectMessage(uint8_t packet[] , uint16_t flags);
+bool sendMqttPingRequest(uint8_t packet[], uint16_t flags);
+bool mqttPubAckRec(uint8_t packet[], uint8_t type, uint16_t flags, uint16_t packetId);
+bool sendMqttPublish(uint8_t packet[], uint16_t flags, char topic[], char data[], uint8_t qos, uint16_t packetId, bool dup);
+uint16_t mqttNextPacketId(void);
+uint8_t mqttFindInflight(mqttInflightState state, uint16_t packetId);
+bool mqttPublish(uint8_t packet[], char topic[], char data[], uint8_t qos);
+void mqttQueueAck(uint8_t type, uint16_t packetId);
+bool mqttReceivedPublish(uint8_t control, uint16_t packetId);
+void mqttProcessAck(uint8_t packet[]);
+void mqttRetryTimerExpired(void);
+void mqttInflightPoll(uint8_t packet[]);
+void mqttInflightReset(void);
+bool mqttSubscribe(uint8_t packet[], uint16_t flags, char topic[]);
+bool mqttUnsubscribe(uint8_t packet[], uint16_t flags, char topic[]);
 void mqttMessageEstablished(void);
 void mqttPingTimerExpired(void);
 
@@ -0,0 +1,125 @@
+// packet.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "packet.h"
+#include "ethernet.h"
+#include "checksum.h"
+#include "tcp.h"
+
+packetInfo rxInfo;
+packetHandler packetHandlers[PACKET_NUM_TYPES];
+
+// Every type is dropped until a handler is registered for it
+void initPackets(void)
+{
+    uint8_t i;
+
+    for(i = 0; i < PACKET_NUM_TYPES; i++)
+        packetHandlers[i] = packetDrop;
+}
+
+void packetRegister(packetType type, packetHandler handler)
+{
+    packetHandlers[type] = handler;
+}
+
+void packetDrop(packetInfo* info){return;}
+
+// Check and parse headers of a received frame into info, returns its type.
+// Lengths are taken from the headers and checked against the frame size so
+// handlers can trust the offsets.
+uint8_t packetClassify(uint8_t packet[], uint16_t size, packetInfo* info)
+{
+    uint16_t ipHeaderSize, ipLength, l4Size, headerSize;
+
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    udpFrame* udp;
+    tcpFrame* tcp;
+
+    memset(info, 0, sizeof(packetInfo));
+    info->packet = packet;
+    info->size   = size;
+    info->type   = PACKET_DROP;
+
+    if(ether->frameType == htons(0x0806))
+    {
+        if(size >= 14 + sizeof(arpFrame))
+            info->type = PACKET_ARP;
+        return info->type;
+    }
+
+    if(ether->frameType != htons(0x0800) || size < 14 + sizeof(ipFrame))
+        return info->type;
+
+    ipHeaderSize = (ip->revSize & 0xF) * 4;
+    ipLength     = htons(ip->length);
+
+    // Version 4 with all of the header and data present. Fragments are
+    // never reassembled so they are dropped.
+    if((ip->revSize >> 4) != 4 || ipHeaderSize < sizeof(ipFrame) || ipLength < ipHeaderSize ||
+       (14 + ipLength) > size || (htons(ip->flagsAndOffset) & 0x3FFF) != 0)
+        return info->type;
+
+    if(checksumFold(checksumAdd(0, &ip->revSize, ipHeaderSize)) != 0)
+        return info->type;
+
+    info->protocol = ip->protocol;
+    info->l4Offset = 14 + ipHeaderSize;
+    l4Size         = ipLength - ipHeaderSize;
+
+    switch(ip->protocol)
+    {
+    case 1: // ICMP
+        if(l4Size < 8)
+            break;
+        info->dataOffset = info->l4Offset + 8;
+        info->dataSize   = l4Size - 8;
+        info->type       = PACKET_ICMP;
+        break;
+    case 17: // UDP
+        udp = (udpFrame*)&packet[info->l4Offset];
+        if(l4Size < 8 || htons(udp->length) < 8 || htons(udp->length) > l4Size)
+            break;
+        info->sourcePort = htons(udp->sourcePort);
+        info->destPort   = htons(udp->destPort);
+        info->dataOffset = info->l4Offset + 8;
+        info->dataSize   = htons(udp->length) - 8;
+        info->type       = (info->sourcePort == 67 && info->destPort == 68) ? PACKET_DHCP : PACKET_UDP;
+        break;
+    case 6: // TCP
+        tcp = (tcpFrame*)&packet[info->l4Offset];
+        if(l4Size < sizeof(tcpFrame))
+            break;
+        info->tcpFlags = htons(tcp->dataCtrlFields);
+        headerSize     = ((info->tcpFlags & 0xF000) >> 12) * 4;
+        if(headerSize < sizeof(tcpFrame) || headerSize > l4Size)
+            break;
+        info->sourcePort = htons(tcp->sourcePort);
+        info->destPort   = htons(tcp->destPort);
+        info->dataOffset = info->l4Offset + headerSize;
+        info->dataSize   = l4Size - headerSize;
+        info->type       = PACKET_TCP;
+        break;
+    }
+
+    return info->type;
+}
+
+// Classify a received frame into rxInfo and pass it to the handler for its type
+void packetDispatch(uint8_t packet[], uint16_t size)
+{
+    (*packetHandlers[packetClassify(packet, size, &rxInfo)])(&rxInfo);
+}
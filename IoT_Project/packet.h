@@ -0,0 +1,60 @@
+// packet.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef PACKET_H_
+#define PACKET_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Received frame classifier
+// Headers of a received frame are checked and parsed once into a packetInfo,
+// which the handler registered for its type and the layers it calls read
+// instead of walking the headers again.
+
+typedef enum
+{
+    PACKET_DROP,  // Not for us, malformed or fragmented
+    PACKET_ARP,
+    PACKET_ICMP,
+    PACKET_DHCP,  // UDP from server port 67 to client port 68
+    PACKET_UDP,
+    PACKET_TCP,
+    PACKET_NUM_TYPES
+} packetType;
+
+typedef struct _packetInfo
+{
+    uint8_t*  packet;
+    uint16_t  size;        // Bytes received
+    uint8_t   type;        // packetType
+    uint8_t   protocol;    // IP protocol, 0 if not IP
+    uint16_t  l4Offset;    // ICMP, UDP or TCP header from start of frame
+    uint16_t  dataOffset;  // Data after that header from start of frame
+    uint16_t  dataSize;
+    uint16_t  sourcePort;  // Host order, UDP and TCP only
+    uint16_t  destPort;
+    uint16_t  tcpFlags;    // Host order data offset and control bits, TCP only
+} packetInfo;
+
+typedef void (*packetHandler)(packetInfo* info);
+
+// Frame being processed by the main loop
+extern packetInfo rxInfo;
+
+void initPackets(void);
+void packetRegister(packetType type, packetHandler handler);
+void packetDrop(packetInfo* info);
+uint8_t packetClassify(uint8_t packet[], uint16_t size, packetInfo* info);
+void packetDispatch(uint8_t packet[], uint16_t size);
+
+#endif
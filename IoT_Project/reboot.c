@@ -17,6 +17,7 @@
 // Device includes, defines, and assembler directives
 //-----------------------------------------------------------------------------
 
+#include "tm4c123gh6pm.h"
 #include "reboot.h"
 
 bool rebootFlag = false;
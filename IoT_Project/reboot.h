@@ -22,7 +22,6 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "tm4c123gh6pm.h"
 
 #define TIMEOUT_MS 2000 // Watchdog timeout
 
@@ -0,0 +1,589 @@
+// rules.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rules.h"
+#include "topic.h"
+#include "gpio.h"
+#include "eeprom.h"
+#include "timers.h"
+#include "uart0.h"
+#include "ethernet.h"
+#include "tcp.h"
+#include "mqtt.h"
+#include "sched.h"
+
+uint8_t ruleCode[RULE_CODE_SIZE];
+uint16_t ruleCodeSize = 0;
+uint16_t ruleOffset[RULE_MAX];              // Record of each rule in ruleCode
+uint8_t ruleNext[RULE_MAX];                 // Next rule on same filter
+uint8_t ruleHead[TOPIC_MAX_NODES];          // First rule of each trie node
+bool ruleInUse[RULE_MAX];
+uint8_t rulePulsePins = 0;                  // PORTF pins turned off by rulePulseExpired
+ruleMessage ruleQueue[RULE_QUEUE_SIZE];     // Received publishes waiting for ruleQueueRun
+uint8_t ruleQueueWrite = 0;
+uint8_t ruleQueueRead = 0;
+uint32_t ruleQueueDropped = 0;              // Publishes lost to a full queue or too long a topic
+
+// Rules used until others are defined, same as the rules that were built in
+const char* const ruleDefaults[] =
+{
+    "env/temp print",
+    "env/led/green eq on pin green 1",
+    "env/led/green eq off pin green 0",
+    "env/led/red eq on pin red 1",
+    "env/led/red eq off pin red 0",
+    "env/led/blue eq on pin blue 1",
+    "env/led/blue eq off pin blue 0",
+};
+
+// Returns next space separated token of text and its length, moving text past it
+const char* ruleNextToken(const char** text, uint8_t* length)
+{
+    const char* token;
+
+    while(**text == ' ')
+        (*text)++;
+
+    token = *text;
+    while(**text != ' ' && **text != '\0')
+        (*text)++;
+
+    *length = *text - token;
+
+    return (*length == 0) ? NULL : token;
+}
+
+// Returns true if token is word
+bool ruleTokenIs(const char* token, uint8_t length, const char word[])
+{
+    return strlen(word) == length && strncmp(token, word, length) == 0;
+}
+
+// Returns PORTF pin of LED name, or 0 if it is not one
+uint8_t ruleLedPin(const char* token, uint8_t length)
+{
+    if(ruleTokenIs(token, length, "red"))
+        return 1;
+    if(ruleTokenIs(token, length, "blue"))
+        return 2;
+    if(ruleTokenIs(token, length, "green"))
+        return 3;
+
+    return 0;
+}
+
+// Compile rule text into code, which holds RULE_MAX_RECORD bytes.
+// Returns size of compiled record, or 0 if text is not a valid rule.
+uint8_t ruleCompile(uint8_t code[], const char text[])
+{
+    const char *token, *arg;
+    uint8_t length, argLength, size, pin;
+    int32_t number;
+
+    // Topic filter
+    if((token = ruleNextToken(&text, &length)) == NULL || (length + 3) > RULE_MAX_RECORD)
+        return 0;
+
+    code[1] = length;
+    memcpy(&code[2], token, length);
+    size = 2 + length;
+
+    while((token = ruleNextToken(&text, &length)) != NULL)
+    {
+        // Leave room for the longest op and RULE_OP_END
+        if((size + 6) > RULE_MAX_RECORD)
+            return 0;
+
+        if(ruleTokenIs(token, length, "any"))
+        {
+            continue;
+        }
+        else if(ruleTokenIs(token, length, "eq") || ruleTokenIs(token, length, "ne"))
+        {
+            if((arg = ruleNextToken(&text, &argLength)) == NULL || (size + 3 + argLength) > RULE_MAX_RECORD)
+                return 0;
+
+            code[size++] = (token[0] == 'e') ? RULE_OP_EQ : RULE_OP_NE;
+            code[size++] = argLength;
+            memcpy(&code[size], arg, argLength);
+            size += argLength;
+        }
+        else if(ruleTokenIs(token, length, "gt") || ruleTokenIs(token, length, "lt"))
+        {
+            if((arg = ruleNextToken(&text, &argLength)) == NULL)
+                return 0;
+
+            number = atoi(arg);
+            code[size++] = (token[0] == 'g') ? RULE_OP_GT : RULE_OP_LT;
+            code[size++] = number;
+            code[size++] = number >> 8;
+            code[size++] = number >> 16;
+            code[size++] = number >> 24;
+        }
+        else if(ruleTokenIs(token, length, "pin") || ruleTokenIs(token, length, "pulse"))
+        {
+            if((arg = ruleNextToken(&text, &argLength)) == NULL || (pin = ruleLedPin(arg, argLength)) == 0)
+                return 0;
+            if((arg = ruleNextToken(&text, &argLength)) == NULL)
+                return 0;
+
+            number = atoi(arg);
+            if(token[1] == 'i')
+            {
+                code[size++] = RULE_OP_PIN;
+                code[size++] = pin;
+                code[size++] = (number != 0);
+            }
+            else
+            {
+                code[size++] = RULE_OP_PULSE;
+                code[size++] = pin;
+                code[size++] = number;
+                code[size++] = number >> 8;
+            }
+        }
+        else if(ruleTokenIs(token, length, "pub"))
+        {
+            if((token = ruleNextToken(&text, &length)) == NULL || (arg = ruleNextToken(&text, &argLength)) == NULL)
+                return 0;
+            if((size + 4 + length + argLength) > RULE_MAX_RECORD)
+                return 0;
+
+            code[size++] = RULE_OP_PUB;
+            code[size++] = length;
+            memcpy(&code[size], token, length);
+            size += length;
+            code[size++] = argLength;
+            memcpy(&code[size], arg, argLength);
+            size += argLength;
+        }
+        else if(ruleTokenIs(token, length, "print"))
+        {
+            code[size++] = RULE_OP_PRINT;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    code[size++] = RULE_OP_END;
+    code[0] = size;
+
+    return size;
+}
+
+// Copy filter of a compiled record into a string
+void ruleGetFilter(uint8_t record[], char filter[])
+{
+    memcpy(filter, &record[2], record[1]);
+    filter[record[1]] = '\0';
+}
+
+// Add compiled record to table and hook it on its filter.
+// Returns rule number, or RULE_NONE if table or trie is full.
+uint8_t ruleInstall(uint8_t record[])
+{
+    char filter[RULE_MAX_RECORD];
+    uint8_t rule, *link;
+    topicIndex node;
+
+    for(rule = 0; rule < RULE_MAX && ruleInUse[rule]; rule++);
+
+    if(rule == RULE_MAX || (ruleCodeSize + record[0]) > RULE_CODE_SIZE)
+        return RULE_NONE;
+
+    ruleGetFilter(record, filter);
+    if(!topicRegister(filter, ruleRun))
+        return RULE_NONE;
+    node = topicFind(filter);
+
+    memcpy(&ruleCode[ruleCodeSize], record, record[0]);
+    ruleOffset[rule] = ruleCodeSize;
+    ruleCodeSize += record[0];
+    ruleInUse[rule] = true;
+
+    // Rules of a filter run in the order they were added
+    ruleNext[rule] = RULE_NONE;
+    link = &ruleHead[node];
+    while(*link != RULE_NONE)
+        link = &ruleNext[*link];
+    *link = rule;
+
+    return rule;
+}
+
+// Compile, add and store a rule. Returns rule number, or RULE_NONE if it is
+// not valid or does not fit.
+uint8_t ruleAdd(const char text[])
+{
+    uint8_t record[RULE_MAX_RECORD], rule;
+
+    if(ruleCompile(record, text) == 0)
+        return RULE_NONE;
+
+    if((rule = ruleInstall(record)) != RULE_NONE)
+        ruleSave();
+
+    return rule;
+}
+
+// Remove a rule. Returns false if there is no such rule.
+bool ruleDelete(uint8_t rule)
+{
+    char filter[RULE_MAX_RECORD];
+    uint8_t i, *link, *record;
+    topicIndex node;
+    uint16_t offset, size;
+
+    if(rule >= RULE_MAX || !ruleInUse[rule])
+        return false;
+
+    record = &ruleCode[ruleOffset[rule]];
+    ruleGetFilter(record, filter);
+
+    // Unhook from filter, which loses its handler when no rules are left
+    node = topicFind(filter);
+    link = &ruleHead[node];
+    while(*link != rule)
+        link = &ruleNext[*link];
+    *link = ruleNext[rule];
+
+    if(ruleHead[node] == RULE_NONE)
+        topicRegister(filter, NULL);
+
+    // Close the gap in the table
+    offset = ruleOffset[rule];
+    size = record[0];
+    memmove(record, record + size, ruleCodeSize - offset - size);
+    ruleCodeSize -= size;
+    ruleInUse[rule] = false;
+
+    for(i = 0; i < RULE_MAX; i++)
+    {
+        if(ruleInUse[i] && ruleOffset[i] > offset)
+            ruleOffset[i] -= size;
+    }
+
+    ruleSave();
+
+    return true;
+}
+
+// Remove every rule
+void ruleClear(void)
+{
+    uint8_t i;
+
+    for(i = 0; i < RULE_MAX; i++)
+    {
+        if(ruleInUse[i])
+            ruleDelete(i);
+    }
+}
+
+// Returns true if payload is the text of length given
+bool rulePayloadIs(char payload[], uint8_t text[], uint8_t length)
+{
+    return strlen(payload) == length && strncmp(payload, (char*)text, length) == 0;
+}
+
+// Run program of one compiled rule against payload
+void ruleExecute(uint8_t* pc, char payload[])
+{
+    char topic[RULE_MAX_RECORD], text[RULE_MAX_RECORD];
+    int32_t number;
+
+    while(true)
+    {
+        switch(*pc++)
+        {
+        case RULE_OP_EQ:
+            if(!rulePayloadIs(payload, &pc[1], pc[0]))
+                return;
+            pc += 1 + pc[0];
+            break;
+        case RULE_OP_NE:
+            if(rulePayloadIs(payload, &pc[1], pc[0]))
+                return;
+            pc += 1 + pc[0];
+            break;
+        case RULE_OP_GT:
+        case RULE_OP_LT:
+            number = pc[0] | (pc[1] << 8) | (pc[2] << 16) | ((uint32_t)pc[3] << 24);
+            if((pc[-1] == RULE_OP_GT) ? (atoi(payload) <= number) : (atoi(payload) >= number))
+                return;
+            pc += 4;
+            break;
+        case RULE_OP_PIN:
+            setPinValue(PORTF, pc[0], pc[1]);
+            pc += 2;
+            break;
+        case RULE_OP_PULSE:
+            setPinValue(PORTF, pc[0], 1);
+            rulePulsePins |= 1 << pc[0];
+            stopTimer(rulePulseExpired);
+            startOneShotTimer(rulePulseExpired, pc[1] | (pc[2] << 8));
+            pc += 3;
+            break;
+        case RULE_OP_PUB:
+            memcpy(topic, &pc[1], pc[0]);
+            topic[pc[0]] = '\0';
+            pc += 1 + pc[0];
+            memcpy(text, &pc[1], pc[0]);
+            text[pc[0]] = '\0';
+            pc += 1 + pc[0];
+
+            // Only while connected to broker
+            if(mqttTcb->state == ESTABLISHED)
+                mqttPublish(data, topic, (strcmp(text, "payload") == 0) ? payload : text, mqttPublishQos);
+            break;
+        case RULE_OP_PRINT:
+            // Runs on received traffic, dropped rather than waited on if the console is behind
+            printfUart0(UART0_DROP, "%s\r\n", payload);
+            break;
+        default: // RULE_OP_END
+            return;
+        }
+    }
+}
+
+// Topic trie handler, runs every rule hooked on the matched filter
+void ruleRun(char topic[], char payload[], topicIndex node)
+{
+    uint8_t rule;
+
+    for(rule = ruleHead[node]; rule != RULE_NONE; rule = ruleNext[rule])
+    {
+        uint8_t* record = &ruleCode[ruleOffset[rule]];
+        ruleExecute(&record[2 + record[1]], payload);
+    }
+}
+
+// Hold a received publish for the rules level of the scheduler, so rule
+// actions do not run while the frame is still being handled. Returns false
+// if it was dropped.
+bool ruleQueuePost(const char topic[], const char payload[])
+{
+    ruleMessage* msg;
+
+    // A topic cut short could match filters the whole one does not
+    if(ruleQueueCount() == RULE_QUEUE_SIZE || strlen(topic) >= RULE_TOPIC_SIZE)
+    {
+        ruleQueueDropped++;
+        return false;
+    }
+
+    msg = &ruleQueue[ruleQueueWrite & (RULE_QUEUE_SIZE - 1)];
+    strcpy(msg->topic, topic);
+    strncpy(msg->payload, payload, RULE_PAYLOAD_SIZE - 1);
+    msg->payload[RULE_PAYLOAD_SIZE - 1] = '\0';
+    ruleQueueWrite++;
+
+    schedPost(SCHED_RULES);
+    return true;
+}
+
+// Scheduler task, runs the oldest queued publish through the topic trie
+bool ruleQueueRun(void)
+{
+    ruleMessage* msg;
+
+    if(ruleQueueCount() == 0)
+        return false;
+
+    msg = &ruleQueue[ruleQueueRead & (RULE_QUEUE_SIZE - 1)];
+    topicDispatch(msg->topic, msg->payload);
+    ruleQueueRead++;
+
+    return ruleQueueCount() != 0;
+}
+
+uint8_t ruleQueueCount(void)
+{
+    return ruleQueueWrite - ruleQueueRead;
+}
+
+// Timer callback, turns off LEDs turned on by pulse
+void rulePulseExpired(void)
+{
+    uint8_t pin;
+
+    for(pin = 1; pin <= 3; pin++)
+    {
+        if(rulePulsePins & (1 << pin))
+            setPinValue(PORTF, pin, 0);
+    }
+
+    rulePulsePins = 0;
+}
+
+// Print a compiled text argument
+void rulePrintText(uint8_t text[], uint8_t length)
+{
+    char str[RULE_MAX_RECORD];
+
+    memcpy(str, text, length);
+    str[length] = '\0';
+    sendUart0String(str);
+}
+
+// Print rules back in the form they were written
+void ruleList(void)
+{
+    const char* const leds[] = {"", "red", "blue", "green"};
+    uint8_t rule, *pc;
+    int32_t number;
+
+    sendUart0String("  Rules:\r\n");
+    for(rule = 0; rule < RULE_MAX; rule++)
+    {
+        if(!ruleInUse[rule])
+            continue;
+
+        pc = &ruleCode[ruleOffset[rule]];
+        printfUart0(UART0_BLOCK, "    %u: ", rule);
+        rulePrintText(&pc[2], pc[1]);
+        pc += 2 + pc[1];
+
+        while(*pc != RULE_OP_END)
+        {
+            switch(*pc++)
+            {
+            case RULE_OP_EQ:
+            case RULE_OP_NE:
+                sendUart0String((pc[-1] == RULE_OP_EQ) ? " eq " : " ne ");
+                rulePrintText(&pc[1], pc[0]);
+                pc += 1 + pc[0];
+                break;
+            case RULE_OP_GT:
+            case RULE_OP_LT:
+                number = pc[0] | (pc[1] << 8) | (pc[2] << 16) | ((uint32_t)pc[3] << 24);
+                printfUart0(UART0_BLOCK, (pc[-1] == RULE_OP_GT) ? " gt %ld" : " lt %ld", (long)number);
+                pc += 4;
+                break;
+            case RULE_OP_PIN:
+                printfUart0(UART0_BLOCK, " pin %s %u", leds[pc[0]], pc[1]);
+                pc += 2;
+                break;
+            case RULE_OP_PULSE:
+                printfUart0(UART0_BLOCK, " pulse %s %u", leds[pc[0]], pc[1] | (pc[2] << 8));
+                pc += 3;
+                break;
+            case RULE_OP_PUB:
+                sendUart0String(" pub ");
+                rulePrintText(&pc[1], pc[0]);
+                pc += 1 + pc[0];
+                sendUart0String(" ");
+                rulePrintText(&pc[1], pc[0]);
+                pc += 1 + pc[0];
+                break;
+            case RULE_OP_PRINT:
+                sendUart0String(" print");
+                break;
+            }
+        }
+        sendUart0String("\r\n");
+    }
+}
+
+// Store rule table in EEPROM, header word is magic, rule count and size.
+// A table too large for the EEPROM leaves the last one that fit stored.
+void ruleSave(void)
+{
+    uint16_t i, add = RULE_EEPROM_BASE + 1;
+    uint8_t rule, count = 0;
+    uint32_t word;
+
+    if(ruleCodeSize > RULE_EEPROM_SIZE)
+        return;
+
+    for(rule = 0; rule < RULE_MAX; rule++)
+        count += ruleInUse[rule];
+
+    for(i = 0; i < ruleCodeSize; i += 4)
+    {
+        word = ruleCode[i] | (ruleCode[i + 1] << 8) | (ruleCode[i + 2] << 16) | ((uint32_t)ruleCode[i + 3] << 24);
+        writeEeprom(add++, word);
+    }
+
+    writeEeprom(RULE_EEPROM_BASE, ((uint32_t)RULE_EEPROM_MAGIC << 24) | ((uint32_t)count << 16) | ruleCodeSize);
+}
+
+// Load rule table from EEPROM. Returns false if none was stored.
+bool ruleLoad(void)
+{
+    uint8_t record[RULE_MAX_RECORD];
+    uint16_t i, size, add = RULE_EEPROM_BASE + 1;
+    uint32_t word = readEeprom(RULE_EEPROM_BASE);
+
+    if((word >> 24) != RULE_EEPROM_MAGIC || (word & 0xFFFF) > RULE_CODE_SIZE)
+        return false;
+
+    size = word & 0xFFFF;
+    for(i = 0; i < size; i += 4)
+    {
+        word = readEeprom(add++);
+        ruleCode[i]     = word;
+        ruleCode[i + 1] = word >> 8;
+        ruleCode[i + 2] = word >> 16;
+        ruleCode[i + 3] = word >> 24;
+    }
+
+    // Records are installed again to hook them on their filters
+    ruleCodeSize = 0;
+    for(i = 0; i < size && ruleCode[i] >= 3 && (i + ruleCode[i]) <= size; i += record[0])
+    {
+        memcpy(record, &ruleCode[i], ruleCode[i]);
+        ruleInstall(record);
+    }
+
+    return true;
+}
+
+// MQTT handler for rules/add, payload is the rule text
+void ruleAddReceived(char topic[], char payload[], topicIndex node)
+{
+    if(ruleAdd(payload) == RULE_NONE)
+        printfUart0(UART0_DROP, "Rule not added\r\n");
+}
+
+// MQTT handler for rules/delete, payload is the rule number
+void ruleDeleteReceived(char topic[], char payload[], topicIndex node)
+{
+    ruleDelete(atoi(payload));
+}
+
+// Load rules from EEPROM, or the defaults if none are stored.
+// Topic trie must be initialized first.
+void initRules(void)
+{
+    uint8_t i;
+
+    memset(ruleHead, RULE_NONE, sizeof(ruleHead));
+    memset(ruleInUse, 0, sizeof(ruleInUse));
+    ruleCodeSize = 0;
+
+    if(!ruleLoad())
+    {
+        for(i = 0; i < (sizeof(ruleDefaults) / sizeof(ruleDefaults[0])); i++)
+            ruleAdd(ruleDefaults[i]);
+    }
+
+    // Rules can also be defined by publishing to these topics
+    topicRegister("rules/add", ruleAddReceived);
+    topicRegister("rules/delete", ruleDeleteReceived);
+}
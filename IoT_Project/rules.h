@@ -0,0 +1,92 @@
+// rules.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef RULES_H_
+#define RULES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "topic.h"
+
+// IFTTT rule engine
+// A rule is written as "FILTER OP [ARGS] OP [ARGS] ..." and compiled into a
+// record of the rule table:
+//      | size | filter length | filter | op | args | ... | RULE_OP_END |
+// Conditions stop the rule when they fail, actions run in order.
+//      any                  always true
+//      eq TEXT / ne TEXT    payload equal / not equal to TEXT
+//      gt N / lt N          payload as a number greater / less than N
+//      pin LED 0|1          LED = red, green or blue
+//      pulse LED MS         turn LED on, off again after MS ms
+//      pub TOPIC TEXT       publish TEXT to TOPIC ("payload" sends the payload)
+//      print                print payload to UART
+// The filter is registered in the topic trie, so a message runs only the
+// rules of the filters it matches.
+
+// Table sizes can be set on the compiler command line. Rule numbers are
+// 8 bits and tables that outgrow the EEPROM are not stored.
+#ifndef RULE_MAX
+#define RULE_MAX          24     // Rules that can be defined, at most 255
+#endif
+#ifndef RULE_CODE_SIZE
+#define RULE_CODE_SIZE    512    // Bytes of all compiled rules together, multiple of 4
+#endif
+#define RULE_MAX_RECORD   96     // Bytes of one compiled rule
+#define RULE_NONE         0xFF
+#define RULE_EEPROM_BASE  0x0020 // Rule table starts at EEPROM block 2
+#define RULE_EEPROM_MAGIC 0x52   // 'R' in top byte of header word
+#define RULE_EEPROM_SIZE  1916   // Bytes of rule table after the header, to the end of the EEPROM
+#define RULE_QUEUE_SIZE   4      // Received publishes waiting for the rules, power of 2
+#define RULE_TOPIC_SIZE   51     // Topic of a queued publish, MAX_CHARS + 1
+#define RULE_PAYLOAD_SIZE 300    // Payload of a queued publish, pub ... payload sends it on whole
+
+typedef enum
+{
+    RULE_OP_END,
+    RULE_OP_EQ,     // length, text
+    RULE_OP_NE,     // length, text
+    RULE_OP_GT,     // int32, LSB first
+    RULE_OP_LT,     // int32, LSB first
+    RULE_OP_PIN,    // PORTF pin, value
+    RULE_OP_PULSE,  // PORTF pin, ms LSB, ms MSB
+    RULE_OP_PUB,    // topic length, topic, text length, text
+    RULE_OP_PRINT
+} ruleOpCode;
+
+// Received publish held until the rules level of the scheduler runs it
+typedef struct _ruleMessage
+{
+    char topic[RULE_TOPIC_SIZE];
+    char payload[RULE_PAYLOAD_SIZE];
+} ruleMessage;
+
+extern uint8_t ruleCode[RULE_CODE_SIZE];
+extern uint32_t ruleQueueDropped;
+extern uint16_t ruleCodeSize;
+
+void initRules(void);
+uint8_t ruleCompile(uint8_t code[], const char text[]);
+uint8_t ruleAdd(const char text[]);
+bool ruleDelete(uint8_t rule);
+void ruleClear(void);
+void ruleRun(char topic[], char payload[], topicIndex node);
+bool ruleQueuePost(const char topic[], const char payload[]);
+bool ruleQueueRun(void);
+uint8_t ruleQueueCount(void);
+void ruleList(void);
+bool ruleLoad(void);
+void ruleSave(void);
+void rulePulseExpired(void);
+void ruleAddReceived(char topic[], char payload[], topicIndex node);
+void ruleDeleteReceived(char topic[], char payload[], topicIndex node);
+
+#endif /* RULES_H_ */
@@ -0,0 +1,157 @@
+// sched.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sched.h"
+#include "events.h"
+#include "timers.h"
+#include "uart0.h"
+
+schedEntry schedLevels[SCHED_NUM_LEVELS];
+
+// No levels until they are registered
+void initSched(void)
+{
+    memset(schedLevels, 0, sizeof(schedLevels));
+}
+
+void schedRegister(schedLevel level, const char name[], schedTask fn, schedDepth depth, uint8_t budget, uint8_t events)
+{
+    schedEntry* e = &schedLevels[level];
+
+    e->name   = name;
+    e->fn     = fn;
+    e->depth  = depth;
+    e->budget = e->credit = budget;
+    e->events = events;
+}
+
+// Mark level as having work, called from the main loop only
+void schedPost(schedLevel level)
+{
+    schedEntry* e = &schedLevels[level];
+
+    if(e->fn == NULL || e->ready)
+        return;
+
+    e->ready = true;
+    e->readyTime = timerGetCycles();
+}
+
+// Post every level woken by the interrupts in events
+void schedPostEvents(uint8_t events)
+{
+    uint8_t level;
+
+    for(level = 0; level < SCHED_NUM_LEVELS; level++)
+    {
+        if(schedLevels[level].events & events)
+            schedPost((schedLevel)level);
+    }
+}
+
+// Highest ready level with budget left, or SCHED_NUM_LEVELS if none is ready
+uint8_t schedNext(void)
+{
+    uint8_t level;
+    bool waiting = false;
+
+    for(level = 0; level < SCHED_NUM_LEVELS; level++)
+    {
+        if(schedLevels[level].ready)
+        {
+            if(schedLevels[level].credit != 0)
+                return level;
+            waiting = true;
+        }
+    }
+
+    // Every ready level has used its budget, or nothing is ready
+    for(level = 0; level < SCHED_NUM_LEVELS; level++)
+        schedLevels[level].credit = schedLevels[level].budget;
+
+    if(waiting)
+    {
+        for(level = 0; level < SCHED_NUM_LEVELS; level++)
+        {
+            if(schedLevels[level].ready)
+                return level;
+        }
+    }
+
+    return SCHED_NUM_LEVELS;
+}
+
+// Called from main loop, runs one unit of the next level or sleeps
+void schedRun(void)
+{
+    uint8_t level, depth;
+    uint32_t cycles;
+    uint64_t start;
+    schedEntry* e;
+    bool more;
+
+    schedPostEvents(eventTake());
+
+    level = schedNext();
+    if(level == SCHED_NUM_LEVELS)
+    {
+        schedPostEvents(eventWait());
+        return;
+    }
+
+    e = &schedLevels[level];
+    start = timerGetCycles();
+    cycles = start - e->readyTime;
+    if(cycles > e->maxWait)
+        e->maxWait = cycles;
+    if(e->depth != NULL && (depth = e->depth()) > e->maxDepth)
+        e->maxDepth = depth;
+
+    // Task can post its own level again while it runs
+    e->ready = false;
+    more = e->fn();
+
+    cycles = timerGetCycles() - start;
+    if(cycles > e->maxRun)
+        e->maxRun = cycles;
+    e->runs++;
+    e->credit--;
+
+    if(more)
+        schedPost((schedLevel)level);
+}
+
+void schedPrintStats(void)
+{
+    uint8_t level;
+    schedEntry* e;
+
+    sendUart0String("  Level    Runs      Max wait us  Max run us  Max depth\r\n");
+    for(level = 0; level < SCHED_NUM_LEVELS; level++)
+    {
+        e = &schedLevels[level];
+        if(e->fn == NULL)
+            continue;
+
+        printfUart0(UART0_BLOCK, "  %-8s %-9lu %-12lu %-11lu %u\r\n", e->name, (unsigned long)e->runs,
+                    (unsigned long)(e->maxWait / (TIMER_CYCLES_PER_MS / 1000)),
+                    (unsigned long)(e->maxRun / (TIMER_CYCLES_PER_MS / 1000)), e->maxDepth);
+
+        e->runs = 0;
+        e->maxWait = 0;
+        e->maxRun = 0;
+        e->maxDepth = 0;
+    }
+}
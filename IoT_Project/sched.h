@@ -0,0 +1,71 @@
+// sched.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Run-to-completion scheduler
+// Each level has a task that drains its own queue one unit at a time (a
+// frame, a batch of expired timers, a received publish, a typed character).
+// The highest ready level with budget left this round runs next, so a burst
+// of frames still leaves the console a turn every round and a long command
+// is followed by the frames that arrived meanwhile. When every ready level
+// has used its budget a new round starts. With nothing ready the core
+// sleeps in eventWait until an interrupt posts a level.
+
+typedef enum
+{
+    SCHED_NET,      // Received frames
+    SCHED_TIMER,    // Timer callbacks and protocol retries
+    SCHED_RULES,    // Received publishes run through the rules
+    SCHED_CONSOLE,  // Characters typed on UART0
+    SCHED_NUM_LEVELS
+} schedLevel;
+
+#define SCHED_NET_BUDGET     8  // Frames per round
+#define SCHED_TIMER_BUDGET   1
+#define SCHED_RULES_BUDGET   2  // Publishes per round
+#define SCHED_CONSOLE_BUDGET 8  // Characters per round
+
+typedef bool (*schedTask)(void);     // Runs one unit, returns true if more is waiting
+typedef uint8_t (*schedDepth)(void); // Units waiting, for stats
+
+typedef struct _schedEntry
+{
+    const char* name;
+    schedTask   fn;
+    schedDepth  depth;      // NULL if the level cannot tell
+    uint8_t     budget;     // Units per round
+    uint8_t     credit;     // Units left this round
+    uint8_t     events;     // Event flags that post it
+    bool        ready;
+    uint64_t    readyTime;  // Cycles when posted or when its last unit ended
+    uint32_t    runs;
+    uint32_t    maxWait;    // Cycles ready before running
+    uint32_t    maxRun;     // Cycles of longest unit
+    uint8_t     maxDepth;
+} schedEntry;
+
+extern schedEntry schedLevels[SCHED_NUM_LEVELS];
+
+void initSched(void);
+void schedRegister(schedLevel level, const char name[], schedTask fn, schedDepth depth, uint8_t budget, uint8_t events);
+void schedPost(schedLevel level);
+void schedPostEvents(uint8_t events);
+uint8_t schedNext(void);
+void schedRun(void);
+void schedPrintStats(void);
+
+#endif
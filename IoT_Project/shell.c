@@ -14,7 +14,6 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
-#include "tm4c123gh6pm.h"
 #include "shell.h"
 #include "ethernet.h"
 #include "uart0.h"
@@ -24,11 +23,13 @@
 #include "timers.h"
 #include "tcp.h"
 #include "mqtt.h"
+#include "topic.h"
+#include "rules.h"
+#include "arp.h"
+#include "events.h"
+#include "sched.h"
 
-MQTT_DATA mqttInfo = {.delimeter = true,
-                      .endOfString = false,
-                      .fieldCount = 0,
-                      .topicStartPosition = 0,
+MQTT_DATA mqttInfo = {.fieldCount = 0,
                       .msgLength = 0,
                       .topicLength = 0,
 };
@@ -38,15 +39,18 @@ bool getsUart0(USER_DATA* data)
 {
     char c;
 
-    c = UART0_DR_R & 0xFF; // Get character
+    c = getcUart0(); // Get character
 
-    UART0_ICR_R = 0xFFF; // Clear any UART0 interrupts
+    clearUart0Interrupts(); // Clear any UART0 interrupts
 
     // Determine if user input is complete
     if((c == 13) || ((data->characterCount + 1) % MAX_CHARS == data->startCount))
     {
         data->buffer[data->characterCount] = '\0';
-        data->startCount = data->characterCount = (data->characterCount + 1) % MAX_CHARS;
+
+        // Next line starts at the front, fields are read as plain strings so
+        // a line must not wrap around the end of the buffer
+        data->startCount = data->characterCount = 0;
         sendUart0String("\r\n");
         return true;
     }
@@ -105,7 +109,7 @@ void parseFields(USER_DATA* data)
     // Get current Index for field arrays
     fieldIndex = data->fieldCount;
 
-    if('a' <= c && c <= 'z' || c == '/') // Verify is character is an alpha (case sensitive)
+    if('a' <= c && c <= 'z' || c == '/' || c == '+' || c == '#') // Verify is character is an alpha (case sensitive) or part of a topic filter
     {
         if(data->delimeter)
         {
@@ -151,26 +155,6 @@ void getFieldString(USER_DATA** data, char fieldString[], uint8_t fieldNumber)
     fieldString[index] = '\0';
 }
 
-// Function to Return a Token as a String
-void getMQTTString(MQTT_DATA** data, uint8_t packet[], char str1[], uint8_t fieldNumber)
-{
-    uint8_t offset, index = 0;
-
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
-
-    // Copy characters for return
-    for(offset = (*data)->fieldPosition[fieldNumber]; offset < (*data)->msgLength; offset++, index++)
-    {
-        str1[index] = mqtt->data[offset];
-    }
-
-    // Add NULL to terminate string
-    str1[index] = '\0';
-}
-
 // Function to Return a Token as an Integer
 int32_t getFieldInteger(USER_DATA** data, uint8_t fieldNumber)
 {
@@ -234,136 +218,56 @@ char* concatPayload(char str1[], char str2[], uint8_t index)
 }
 
 // Function to process incoming MQTT Messages
+// Checks a received PUBLISH and records its Packet Identifier. fieldCount is
+// left at 0 when the publish is not to be run through the rules, which
+// ifttRulesTable checks.
 void processMqttMessage(MQTT_DATA* data, uint8_t packet[])
 {
-    char c;
-    uint8_t fieldIndex;
-    uint16_t payloadLength, i;
+    uint16_t i, packetId, size;
+    uint32_t length;
+    uint8_t* body;
 
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
+    mqttFrame *mqtt   = getMqttFrame(packet, &size);
 
-    mqttInfo.msgLength = mqtt->packetLength; // Get length of packet
+    // Variable header starts after the 1-4 byte Remaining Length
+    data->fieldCount = 0;
+    if(mqtt == NULL || (body = getMqttVariableHeader(mqtt, size, &length)) == NULL || length < 2)
+        return;
 
-    i = mqttInfo.topicLength = 0;
-    mqttInfo.topicLength |= mqtt->data[i++] << 8; // Topic Length MSB
-    mqttInfo.topicLength |= mqtt->data[i++];      // Topic Length LSB
+    data->msgLength = length; // Get length of packet
 
-    mqttInfo.topicStartPosition = i; // Don't need topicStartPosition
+    i = data->topicLength = 0;
+    data->topicLength |= body[i++] << 8; // Topic Length MSB
+    data->topicLength |= body[i++];      // Topic Length LSB
 
-    payloadLength = mqtt->packetLength - mqttInfo.topicLength - 2 - i; // Get payload Length
+    // Topic must fit in the packet
+    if((uint32_t)data->topicLength + 2 > length)
+        return;
 
-    // Get current Index for field arrays
-    fieldIndex = data->fieldCount = 0;
-    data->delimeter = true;
+    i += data->topicLength;
 
-    // Process Topic of PUBLISH Packet
-    while(i < mqttInfo.topicLength)
+    // If QoS Level Set then Packet Identifier follows the topic
+    if((mqtt->control & 0x06) != 0)
     {
-        c = mqtt->data[i++];
+        if((uint32_t)i + 2 > length)
+            return;
 
-        if('a' <= c && c <= 'z' || 'A' <= c && c <= 'Z') // Verify is character is an alpha (case sensitive)
-        {
-            if(data->delimeter)
-            {
-                data->fieldPosition[fieldIndex] = i - 1;
-                data->fieldType[fieldIndex++] = 'A';
-                data->fieldCount += 1;
-                data->delimeter = false;
-            }
-        }
-        else if('0' <= c && c <= '9') //Code executes for numerics same as alpha
-        {
-            if(data->delimeter)
-            {
-                data->fieldPosition[fieldIndex] = i - 1;
-                data->fieldType[fieldIndex++] = 'N';
-                data->fieldCount += 1;
-                data->delimeter = false;
-            }
-        }
-        else if(c == '#') //Code executes # as wild-card
-        {
-            if(data->delimeter)
-            {
-                data->fieldPosition[fieldIndex] = i - 1;
-                data->fieldType[fieldIndex++] = 'W';
-                data->fieldCount += 1;
-                data->delimeter = false;
-            }
-        }
-        else // Insert NULL('\0') into character array if NON-alphanumeric character detected
-        {
-            data->delimeter = true;
-        }
-    }
-
-    data->fieldPosition[fieldIndex] = mqttInfo.topicStartPosition + mqttInfo.topicLength + 2;
-/*
-    // If QoS Level Set then Look for Packet Identifier
-    if((mqtt->control & 0x06) == 0x02 || (mqtt->control & 0x0F) == 0x04)
-    {
-        mqttPacketId = mqtt->data[i++] << 8; // Packet Identifier MSB
-        mqttPacketId = mqtt->data[i++];      // Packet Identifier LSB
-
-        if((mqtt->control & 0x06) == 0x02) // QoS = 1
-        {
-//            sendPubackFlag = true;
-        }
-        else if((mqtt->control & 0x0F) == 0x04) // QoS = 2
-        {
-//            sendPubrecFlag = true;
-        }
-    }
-*/
-}
-
-// Function Used to Determine if Correct Command Entered
-bool isMqttCommand(MQTT_DATA** data, uint8_t packet[], const char strCommand[], uint8_t pos, uint8_t minArguments)
-{
-    int val;
-    uint8_t c1, c2, offset, index = 0;
+        packetId  = body[i++] << 8; // Packet Identifier MSB
+        packetId |= body[i++];      // Packet Identifier LSB
 
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
-    mqttFrame *mqtt   = (mqttFrame*)&tcp->data;
-
-    if((*data)->fieldCount < minArguments)
-        return false;
-
-    offset = (*data)->fieldPosition[pos];
-
-    while((c1 = strCommand[index++]) != '\0')
-    {
-        c2 = mqtt->data[offset++];
-        val = c1 - c2;
-
-        if(val != 0 || c2 == 0)
-            return false;
+        // QoS 2 publish already delivered is acknowledged but not processed again
+        if(!mqttReceivedPublish(mqtt->control, packetId))
+            return;
     }
 
-    return true;
+    data->fieldCount = 1;
 }
 
 // Function to Print Current Subscribed topics
 void printSubscribedTopics(void)
 {
-    uint8_t i = 0;
-    char str[MQTT_MAX_SUB_CHARS];
-
     sendUart0String("  List of Subscribed Topics:\r\n");
-    while(i < MQTT_MAX_TABLE_SIZE)
-    {
-        if(topics[i].validBit)
-        {
-            sprintf(str, "    %s\r\n", topics[i].subs);
-            sendUart0String(str);
-        }
-        i++;
-    }
+    topicPrint();
 }
 
 // Process shell commands here
@@ -407,7 +311,7 @@ void shellCommands(USER_DATA* userInput, uint8_t packet[])
             }
         }
     }
-    else if(isCommand(&userInput, "set", 6))
+    else if(isCommand(&userInput, "set", 3))
     {
         uint8_t i, size, add[6];
 
@@ -416,50 +320,75 @@ void shellCommands(USER_DATA* userInput, uint8_t packet[])
         // Retrieve network configuration parameter
         getFieldString(&userInput, token, 1);
 
-        // Get Network Address
-        for(i = 0; i < size; i++)
+        // Get Network Address, or the one number of QOS and WINDOW
+        for(i = 0; i < size && i < sizeof(add); i++)
         {
             add[i] = getFieldInteger(&userInput, (i + 2));
         }
 
-        if(!dhcpEnabled && strcmp(token, "ip") == 0)      // Set Internet Protocol address
+        if(!dhcpEnabled && strcmp(token, "ip") == 0 && size == 4)      // Set Internet Protocol address
         {
             etherSetIpAddress(add[0], add[1], add[2], add[3]);
             storeAddressEeprom(add, 0x0011, 4);
+            initArp();
         }
-        else if(!dhcpEnabled && strcmp(token, "gw") == 0) // Set Gateway address
+        else if(!dhcpEnabled && strcmp(token, "gw") == 0 && size == 4) // Set Gateway address
         {
             etherSetIpGatewayAddress(add[0], add[1], add[2], add[3]);
             storeAddressEeprom(add, 0x0012, 4);
+            initArp();
         }
-        else if(!dhcpEnabled && strcmp(token, "dns") == 0) // Set Domain Name System address
+        else if(!dhcpEnabled && strcmp(token, "dns") == 0 && size == 4) // Set Domain Name System address
         {
             setDnsAddress(add[0], add[1], add[2], add[3]);
             storeAddressEeprom(add, 0x0013, 4);
         }
-        else if(!dhcpEnabled && strcmp(token, "sn") == 0) // Set Sub-net Mask
+        else if(!dhcpEnabled && strcmp(token, "sn") == 0 && size == 4) // Set Sub-net Mask
         {
             etherSetIpSubnetMask(add[0], add[1], add[2], add[3]);
             storeAddressEeprom(add, 0x0014, 4);
+            initArp();
         }
-        else if(strcmp(token, "mqtt") == 0) // Set Sub-net Mask
+        else if(strcmp(token, "mqtt") == 0 && size == 4) // Set MQTT Broker IP address, its MAC comes from ARP
         {
-            if(size == 4) // Set MQTT Broker IP address
-            {
-                setMqttAddress(add[0], add[1], add[2], add[3]);
-                storeAddressEeprom(add, 0x0001, 4);
-            }
-            else if(size == 6) // Set MQTT Broker Mac Address
-            {
-                setAddressInfo(mqttMacAddress, add, 6);
-                storeAddressEeprom(add, 0x0002, 6);
-            }
+            setMqttAddress(add[0], add[1], add[2], add[3]);
+            storeAddressEeprom(add, 0x0001, 4);
+        }
+        else if(strcmp(token, "qos") == 0) // Set QoS used by publish
+        {
+            if(add[0] <= 2)
+                mqttPublishQos = add[0];
+        }
+        else if(strcmp(token, "window") == 0) // Set number of QoS 1/2 publishes in flight
+        {
+            if(add[0] >= 1 && add[0] <= MQTT_MAX_INFLIGHT)
+                mqttWindowSize = add[0];
         }
     }
     else if(isCommand(&userInput, "ifconfig", 1)) // displays current MAC, IP, GW, SN, DNS, and DHCP mode
     {
         displayIfconfigInfo();
     }
+    else if(isCommand(&userInput, "spi", 1)) // displays ethernet controller spi traffic since last time
+    {
+        etherPrintSpiStats();
+    }
+    else if(isCommand(&userInput, "idle", 1)) // displays time asleep and busy since last time
+    {
+        eventPrintStats();
+    }
+    else if(isCommand(&userInput, "sched", 1)) // displays scheduler levels since last time
+    {
+        schedPrintStats();
+    }
+    else if(isCommand(&userInput, "uart", 1)) // displays console output dropped since last time
+    {
+        printUart0Stats();
+    }
+    else if(isCommand(&userInput, "arp", 1)) // displays ARP cache
+    {
+        arpPrint();
+    }
     else if(isCommand(&userInput, "publish", 3))
     {
         uint8_t i;
@@ -476,43 +405,74 @@ void shellCommands(USER_DATA* userInput, uint8_t packet[])
         // Get MQTT topic to publish
         getFieldString(&userInput, str, 1);
 
-        // send MQTT Publish Packet
-        sendMqttPublish(packet, 0x5018, str, token);
+        // send MQTT Publish Packet at the QoS chosen with set qos
+        if(!mqttPublish(packet, str, token, mqttPublishQos))
+            sendUart0String("Publish window full or connection busy\r\n");
     }
     else if(isCommand(&userInput, "subscribe", 2))
     {
-        uint8_t index;
-
         // Copy MQTT Topic to subscribe to
         getFieldString(&userInput, token, 1);
 
-        // Find empty slot in subscribed to table
-        index = findEmptySlot();
-
-        // Copy Subscription to Table
-        strcpy(topics[index].subs, token);
-        topics[index].validBit = true;
-
-        // Send MQTT Subscribe Packet
-        mqttSubscribe(packet, 0x5018, token);
+        // Add Subscription to topic trie, then send MQTT Subscribe Packet
+        if(!topicSubscribe(token))
+            sendUart0String("Subscription table full\r\n");
+        else if(!mqttSubscribe(packet, 0x5018, token))
+        {
+            topicUnsubscribe(token);
+            sendUart0String("Connection busy, try again\r\n");
+        }
     }
     else if(isCommand(&userInput, "unsubscribe", 2))
     {
         // Retrieve network configuration parameter
         getFieldString(&userInput, token, 1);
 
-        // Remove Topic from Subscription Table
-        createEmptySlot(token);
+        // Remove Topic from topic trie
+        topicUnsubscribe(token);
 
         // Send MQTT Unsubscribe Packet
-        mqttUnsubscribe(packet, 0x5018, token);
+        if(!mqttUnsubscribe(packet, 0x5018, token))
+            sendUart0String("Connection busy, try again\r\n");
     }
-    else if(isCommand(&userInput, "connect", 1))
+    else if(isCommand(&userInput, "rule", 2))
     {
-        tcb.prevSeqNum = tcb.prevAckNum = tcb.currentAckNum = tcb.currentAckNum = 0;
+        uint8_t i;
+        char str[MAX_CHARS + 1];
+
+        getFieldString(&userInput, str, 1);
+
+        if(strcmp(str, "add") == 0) // rule add FILTER OP [ARGS] ...
+        {
+            token[0] = '\0';
+            for(i = 2; i < userInput->fieldCount; i++)
+            {
+                getFieldString(&userInput, str, i);
 
-        // Change TCP state to CLOSED
-        nextTcpState = CLOSED;
+                concatPayload(token, str, i);
+            }
+
+            if(ruleAdd(token) == RULE_NONE)
+                sendUart0String("Rule not added\r\n");
+        }
+        else if(strcmp(str, "del") == 0) // rule del N
+        {
+            if(!ruleDelete(getFieldInteger(&userInput, 2)))
+                sendUart0String("No such rule\r\n");
+        }
+        else if(strcmp(str, "list") == 0)
+        {
+            ruleList();
+        }
+        else if(strcmp(str, "clear") == 0)
+        {
+            ruleClear();
+        }
+    }
+    else if(isCommand(&userInput, "connect", 1))
+    {
+        // Set up broker connection in CLOSED state on a new source port
+        tcpOpenMqtt();
 
         // Send TCP SYN message to initiate connection with MQTT broker
         sendTcpMessage(packet, NOPE);
@@ -523,7 +483,7 @@ void shellCommands(USER_DATA* userInput, uint8_t packet[])
         stopTimer(mqttPingTimerExpired);
 
         // Change TCP State to CLOSING
-        nextTcpState = CLOSING;
+        mqttTcb->state = CLOSING;
 
         // Send MQTT Disconnect Packet
         sendMqttDisconnectMessage(packet, 0x5018);
@@ -546,7 +506,7 @@ void shellCommands(USER_DATA* userInput, uint8_t packet[])
     else if(isCommand(&userInput, "reboot", 1))
     {
         // Ensure no Read or Writes to EEPROM are occuring
-        while (EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING);
+        waitEeprom();
 
         rebootFlag = true;
     }
@@ -557,72 +517,17 @@ void shellCommands(USER_DATA* userInput, uint8_t packet[])
 }
 
 // Start of IFTTT Rules Table
+
+// Queue the received PUBLISH for the rules of every topic filter it matches
 void ifttRulesTable(MQTT_DATA* mqttInput, uint8_t packet[])
 {
-    char buffer[50];
+    char topic[RULE_TOPIC_SIZE + 1]; // Room to see a topic too long for the rules
+    char payload[RULE_PAYLOAD_SIZE];
 
-    if(isMqttCommand(&mqttInput, packet, "env", 0, 2))
-    {
-        if(isMqttCommand(&mqttInput, packet, "temp", 1, 2))
-        {
-
-            getMQTTString(&mqttInput, packet, buffer, 2);
-
-            // Send Published Temperature to UART
-            //sprintf(str, "Degrees Celsius : %u", temp);
-            sendUart0String(buffer);
-            sendUart0String("\r\n");
+    // QoS 2 publish that was already delivered
+    if(mqttInput->fieldCount == 0)
+        return;
 
-            // Update env/temp with more recent value and then MQTT Publish Packet
-            // sprintf(str, "%s", "env/temp");
-            // sprintf(buffer, "%u", instantTemp());
-            // mqttPublish(data, 0x5018, str, buffer);
-        }
-        else if(isMqttCommand(&mqttInput, packet, "led", 1, 2)) // Part of topic
-        {
-            if(isMqttCommand(&mqttInput, packet, "green", 2, 2)) // Part of topic
-            {
-                getMQTTString(&mqttInput, packet, buffer, 3);
-
-                if(strcmp(buffer, "on") == 0) // Part of payload
-                {
-                    setPinValue(GREEN_LED, 1); // Green LED ON
-                    sendUart0String("  GREEN LED ON\r\n");
-                }
-                else if(strcmp(buffer, "off") == 0) // Part of payload
-                {
-                    setPinValue(GREEN_LED, 0); // Green LED OFF
-                    sendUart0String("  GREEN LED OFF\r\n");
-                }
-            }
-            else if(isMqttCommand(&mqttInput, packet, "red", 2, 2))
-            {
-                getMQTTString(&mqttInput, packet, buffer, 3);
-                if(strcmp(buffer, "on") == 0)
-                {
-                    setPinValue(RED_LED, 1); // RedLED ON
-                    sendUart0String("  RED LED ON\r\n");
-                }
-                else if(strcmp(buffer, "off") == 0)
-                {
-                    setPinValue(RED_LED, 0); // RED LED OFF
-                    sendUart0String("  RED LED OFF\r\n");
-                }
-            }
-            else if(isMqttCommand(&mqttInput, packet, "blue", 2, 2))
-            {
-                getMQTTString(&mqttInput, packet, buffer, 3);
-                if(strcmp(buffer, "on") == 0) // Payload
-                {
-                    setPinValue(BLUE_LED, 1); // Blue LED ON
-                    sendUart0String("  BLUE LED ON\r\n");
-                }
-                else if(strcmp(buffer, "off") == 0) // Payload
-                {
-                    setPinValue(BLUE_LED, 0); // Blue LED OFF
-                    sendUart0String("  BLUE LED OFF\r\n");
-                }
-            }
-        }
-    }
+    if(getMqttPublish(packet, topic, sizeof(topic), payload, sizeof(payload)))
+        ruleQueuePost(topic, payload);
 }
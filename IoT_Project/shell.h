@@ -38,14 +38,9 @@ typedef struct _USER_DATA
 
 typedef struct _MQTT_DATA
 {
-    bool     delimeter;
-    bool     endOfString;
-    uint8_t  fieldCount;
-    uint8_t  topicStartPosition;
-    uint8_t  msgLength;
+    uint8_t  fieldCount; // 0 if the last publish is not run through the rules
+    uint16_t msgLength;
     uint16_t topicLength;
-    uint8_t  fieldPosition[MAX_FIELDS];
-    char     fieldType[MAX_FIELDS];
 } MQTT_DATA;
 
 extern MQTT_DATA mqttInfo;
@@ -57,10 +52,8 @@ bool getsUart0(USER_DATA* data);
 void parseFields(USER_DATA* data);
 bool isCommand(USER_DATA** data, const char strCommand[], uint8_t minArguments);
 void getFieldString(USER_DATA** data, char fieldString[], uint8_t fieldNumber);
-void getMQTTString(MQTT_DATA** data, uint8_t packet[], char str1[], uint8_t fieldNumber);
 int32_t getFieldInteger(USER_DATA** data, uint8_t fieldNumber);
 void processMqttMessage(MQTT_DATA* data, uint8_t packet[]);
-bool isMqttCommand(MQTT_DATA** data, uint8_t packet[], const char strCommand[], uint8_t pos, uint8_t minArguments);
 void printSubscribedTopics(void);
 void shellCommands(USER_DATA* userInput, uint8_t data[]);
 void ifttRulesTable(MQTT_DATA* mqttInput, uint8_t packet[]);
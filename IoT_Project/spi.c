@@ -35,6 +35,9 @@
 // Global variables
 //-----------------------------------------------------------------------------
 
+uint32_t spi0Bytes = 0;    // Frames clocked since last cleared, for measuring driver cost
+uint32_t spi0BitRate = 0;  // Bit rate set by setSpi0BaudRate
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -84,6 +87,7 @@ void setSpi0BaudRate(uint32_t baudRate, uint32_t fcyc)
     uint32_t divisorTimes2 = (fcyc * 2) / baudRate;    // calculate divisor (r) times 2
     SSI0_CR1_R &= ~SSI_CR1_SSE;                        // turn off SSI to allow re-configuration
     SSI0_CPSR_R = (divisorTimes2 + 1) >> 1;            // round divisor to nearest integer
+    spi0BitRate = fcyc / SSI0_CPSR_R;                  // SCR = 0 so bit rate is fcyc / CPSDVSR
     SSI0_CR1_R |= SSI_CR1_SSE;                         // turn on SSI
 }
 
@@ -101,6 +105,7 @@ void setSpi0Mode(uint8_t polarity, uint8_t phase)
 void writeSpi0Data(uint32_t data)
 {
     SSI0_DR_R = data;
+    spi0Bytes++;
     while (SSI0_SR_R & SSI_SR_BSY);
 }
 
@@ -109,3 +114,41 @@ uint32_t readSpi0Data(void)
 {
     return SSI0_DR_R;
 }
+
+// Writes a block of data keeping the tx fifo full, rx data is discarded
+// No more than SSI0_FIFO_DEPTH frames are kept in flight so the rx fifo cannot overrun
+void writeSpi0Block(const uint8_t data[], uint16_t size)
+{
+    uint16_t tx = 0, rx = 0;
+
+    spi0Bytes += size;
+    while (rx < size)
+    {
+        while (tx < size && (tx - rx) < SSI0_FIFO_DEPTH && (SSI0_SR_R & SSI_SR_TNF))
+            SSI0_DR_R = data[tx++];
+        while (SSI0_SR_R & SSI_SR_RNE)
+        {
+            readSpi0Data();
+            rx++;
+        }
+    }
+}
+
+// Reads a block of data by clocking out zeros while keeping the tx fifo full
+// No more than SSI0_FIFO_DEPTH frames are kept in flight so the rx fifo cannot overrun
+void readSpi0Block(uint8_t data[], uint16_t size)
+{
+    uint16_t tx = 0, rx = 0;
+
+    spi0Bytes += size;
+    while (rx < size)
+    {
+        while (tx < size && (tx - rx) < SSI0_FIFO_DEPTH && (SSI0_SR_R & SSI_SR_TNF))
+        {
+            SSI0_DR_R = 0;
+            tx++;
+        }
+        while (SSI0_SR_R & SSI_SR_RNE)
+            data[rx++] = readSpi0Data();
+    }
+}
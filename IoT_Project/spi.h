@@ -28,6 +28,12 @@
 #define USE_SSI0_FSS 1
 #define USE_SSI0_RX  2
 
+// SSI0 TX and RX FIFOs are each 8 frames deep
+#define SSI0_FIFO_DEPTH 8
+
+extern uint32_t spi0Bytes;
+extern uint32_t spi0BitRate;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -37,5 +43,7 @@ void setSpi0BaudRate(uint32_t clockRate, uint32_t fcyc);
 void setSpi0Mode(uint8_t polarity, uint8_t phase);
 void writeSpi0Data(uint32_t data);
 uint32_t readSpi0Data(void);
+void writeSpi0Block(const uint8_t data[], uint16_t size);
+void readSpi0Block(uint8_t data[], uint16_t size);
 
 #endif /* SPI_H_ */
@@ -15,19 +15,26 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include "tm4c123gh6pm.h"
 #include "tcp.h"
 #include "ethernet.h"
 #include "timers.h"
+#include "arp.h"
+#include "packet.h"
 #include "mqtt.h"
 
-transCtrlBlock tcb = {.currentAckNum = 0,
-                      .currentSeqNum = 0,
-                      .prevAckNum = 0,
-                      .prevSeqNum = 0
-};
+// Only the broker connection sends data, so only it holds segments for retransmission
+tcpRtxSegment mqttRtxQueue[TCP_RTX_QUEUE_SIZE];
+
+// Connections are found by hashing the 4-tuple, slot TCP_MQTT_TCB is kept for the broker
+transCtrlBlock tcbTable[TCP_MAX_CONNECTIONS] = {[TCP_MQTT_TCB] = {.inUse = false,
+                                                                  .state = CLOSED,
+                                                                  .templateValid = false,
+                                                                  .rto = TCP_RTO_INITIAL,
+                                                                  .rtxQueue = mqttRtxQueue
+}};
 
-tcpSysState nextTcpState = LISTEN;
+transCtrlBlock* const mqttTcb = &tcbTable[TCP_MQTT_TCB];
+transCtrlBlock* tcb = &tcbTable[TCP_MQTT_TCB]; // Connection being processed
 
 tcpStateMachine tcpStateTransitions [] =
 {
@@ -36,118 +43,192 @@ tcpStateMachine tcpStateTransitions [] =
     {SYN_SENT,     SYN_ACK_EVENT,      (_tcpCallback)sendTcpMessage}, //
     {SYN_RECEIVED, ACK_EVENT,          (_tcpCallback)tcpEstablished}, //
     {SYN_RECEIVED, SYN_EVENT,          (_tcpCallback)dupTcpMsg},      //
+    {ESTABLISHED,  ACK_EVENT,          (_tcpCallback)dupTcpMsg},      // ACKs handled by tcpRtxAck
     {ESTABLISHED,  PSH_ACK_EVENT,      (_tcpCallback)sendTcpMessage}, //
     {ESTABLISHED,  FIN_EVENT,          (_tcpCallback)sendTcpMessage}, //
     {ESTABLISHED,  FIN_ACK_EVENT,      (_tcpCallback)sendTcpMessage}, //
+    {FIN_WAIT_1,   ACK_EVENT,          (_tcpCallback)tcpFinWait2},    // Our FIN acknowledged
+    {FIN_WAIT_1,   FIN_EVENT,          (_tcpCallback)sendTcpMessage}, // Both closing, ACK theirs
+    {FIN_WAIT_1,   FIN_ACK_EVENT,      (_tcpCallback)sendTcpMessage}, //
+    {FIN_WAIT_2,   FIN_EVENT,          (_tcpCallback)sendTcpMessage}, //
+    {FIN_WAIT_2,   FIN_ACK_EVENT,      (_tcpCallback)sendTcpMessage}, //
     {CLOSE_WAIT,   APP_CLOSE_EVENT,    (_tcpCallback)sendTcpMessage}, //
+    {CLOSING,      ACK_EVENT,          (_tcpCallback)dupTcpMsg},      // DISCONNECT acknowledged, broker closes next
+    {CLOSING,      FIN_EVENT,          (_tcpCallback)sendTcpMessage}, //
     {CLOSING,      FIN_ACK_EVENT,      (_tcpCallback)sendTcpMessage}, //
-    {LAST_ACK,     ACK_EVENT,          (_tcpCallback)tcpClose}        //
+    {LAST_ACK,     ACK_EVENT,          (_tcpCallback)tcpClose},       //
+    {LAST_ACK,     FIN_EVENT,          (_tcpCallback)sendTcpMessage}, // Our FIN was lost, sent again
+    {LAST_ACK,     FIN_ACK_EVENT,      (_tcpCallback)sendTcpMessage}  //
 };
 
-//
-void dupTcpMsg(void){return;}
+const uint8_t tcpStateTransitionCount = sizeof(tcpStateTransitions)/sizeof(tcpStateTransitions[0]);
 
-// Determines if Packet recieved is TCP
-bool etherIsTcp(uint8_t packet[])
+// Events are TCP flags (0-31), tcpEventIndex packs them into table columns
+const tcpSysEvent tcpEvents[TCP_NUM_EVENTS - 1] =
 {
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
+    PASSIVE_OPEN_EVENT, FIN_EVENT, SYN_EVENT, RST_EVENT, APP_CLOSE_EVENT,
+    ACK_EVENT, FIN_ACK_EVENT, SYN_ACK_EVENT, PSH_ACK_EVENT
+};
+
+// tcpStateTransitions expanded by tcpInitStateTable so lookup is a single index
+uint8_t tcpEventIndex[32];
+_tcpCallback tcpStateTable[TCP_NUM_STATES][TCP_NUM_EVENTS];
 
-    if(ip->protocol == 6)
-        return true;
+//
+void dupTcpMsg(void){return;}
 
-    return false;
+// Hash of 4-tuple used as first slot to search, local IP is always ours
+uint8_t tcpHash(uint8_t remoteIp[], uint16_t remotePort, uint16_t localPort)
+{
+    return (remoteIp[2] ^ remoteIp[3] ^ remotePort ^ (remotePort >> 8) ^ localPort ^ (localPort >> 8)) & (TCP_MAX_CONNECTIONS - 1);
 }
 
-// Function to Check For Duplicate or Re-transmissions
-bool checkForDuplicates(uint8_t packet[])
+// Find connection a received segment belongs to. A SYN with no connection
+// gets a new one in LISTEN (passive open). Returns NULL if there is none.
+// packet must be the frame described by rxInfo.
+transCtrlBlock* tcpFindTcb(uint8_t packet[])
 {
+    uint8_t i, slot, start;
+    uint16_t remotePort, localPort;
+    transCtrlBlock* c;
+
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
 
-    if(tcb.prevSeqNum != htons32(tcp->seqNum))
-        return true;
+    remotePort = rxInfo.sourcePort;
+    localPort  = rxInfo.destPort;
+    start      = tcpHash(ip->sourceIp, remotePort, localPort);
 
-    return false;
-}
+    for(i = 0; i < TCP_MAX_CONNECTIONS; i++)
+    {
+        c = &tcbTable[(start + i) & (TCP_MAX_CONNECTIONS - 1)];
 
-// Function to find TCP flags
-uint16_t etherIsTcpMsgType(uint8_t packet[])
-{
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+        if(c->inUse && c->remotePort == remotePort && c->localPort == localPort &&
+           memcmp(c->remoteIp, ip->sourceIp, IP_ADD_LENGTH) == 0)
+            return c;
+    }
+
+    if((rxInfo.tcpFlags & (SYN | ACK)) != SYN)
+        return NULL;
+
+    // Broker slot is never handed out to other connections
+    for(i = 0; i < TCP_MAX_CONNECTIONS; i++)
+    {
+        slot = (start + i) & (TCP_MAX_CONNECTIONS - 1);
+        c = &tcbTable[slot];
+
+        if(!c->inUse && slot != TCP_MQTT_TCB)
+        {
+            tcb = c;
+            setUpTcb();
+            c->inUse      = true;
+            c->remotePort = remotePort;
+            c->localPort  = localPort;
+            setAddressInfo(c->remoteIp, ip->sourceIp, IP_ADD_LENGTH);
+            return c;
+        }
+    }
 
-    return (uint8_t)(htons(tcp->dataCtrlFields) & 0x001F);
+    return NULL;
 }
 
-// Function to Adjust SEQ Number and ACK Number on Receiving a TCP ACK Message
-void tcpAckReceived(uint8_t packet[])
+// Set up broker connection on a new source port before sending SYN
+void tcpOpenMqtt(void)
 {
-    uint32_t tmp32 = 0;
+    mqttSrcPort += (random32() % 256);
 
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+    tcb = mqttTcb;
+    setUpTcb();
+    mqttTcb->inUse      = true;
+    mqttTcb->state      = CLOSED;
+    mqttTcb->remotePort = MQTT_BROKER_PORT;
+    mqttTcb->localPort  = mqttSrcPort;
+    setAddressInfo(mqttTcb->remoteIp, mqttIpAddress, IP_ADD_LENGTH);
 
-    tmp32 = htons32(tcp->seqNum);
-    tcb.prevSeqNum = tcp->seqNum = tcp->ackNum;
-    tcb.prevAckNum = tcp->ackNum = htons32(tmp32);
+    tcpBuildTemplate();
 }
 
 // Set-up initial conditions for Transmission Control Block
 void setUpTcb(void)
 {
-    tcb.prevSeqNum = 0;
-    tcb.prevAckNum = 0;
-    tcb.currentAckNum = 0;
-    tcb.currentSeqNum = 0;
-    nextTcpState = LISTEN;
+    tcb->prevSeqNum = 0;
+    tcb->prevAckNum = 0;
+    tcb->currentAckNum = 0;
+    tcb->currentSeqNum = 0;
+    tcb->templateValid = false;
+    tcb->rtxHead = tcb->rtxTail = 0;
+    tcb->rtxLast = NULL;
+    tcb->srtt = tcb->rttvar = 0;
+    tcb->rto = TCP_RTO_INITIAL;
+    tcb->lastAck = 0;
+    tcb->dupAcks = 0;
+    tcb->rtxExpired = false;
+    timerStop(tcb->rtxTimer);
+    tcb->rtxTimer = TIMER_INVALID;
+    tcb->state = LISTEN;
 }
 
-// Transition to TCP closed state
+// Transition to TCP closed state, connection slot is freed
 void tcpClose(void)
 {
-    nextTcpState = CLOSED;
-
     setUpTcb();
 
+    tcb->state = CLOSED;
+    tcb->inUse = false;
+
     stopTimer(tcpClose);
 }
 
 //
 void tcpEstablished(void)
 {
-    nextTcpState = ESTABLISHED;
+    tcb->state = ESTABLISHED;
+}
+
+// Our FIN acknowledged, waiting for the peer's
+void tcpFinWait2(void)
+{
+    tcb->state = FIN_WAIT_2;
 }
 
 // Function used to send TCP messages
+// Except for NOPE (active open) packet is the segment described by rxInfo and
+// the reply is built in place over it
 void sendTcpMessage(uint8_t packet[], uint16_t flags)
 {
     uint8_t i;
-    uint16_t tcpSize = 0, tmp16;
+    uint16_t tcpSize = 0, tmp16, rxDataSize = 0, size;
     uint32_t tmp32 = 0;
+    bool useTemplate;
 
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip       = (ipFrame*)&ether->data;
-    tcpFrame *tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
+
+    if(flags != NOPE)
+    {
+        // Replies have no IP options, so the received TCP header moves up behind a 20 byte IP header
+        if(rxInfo.l4Offset != TCP_TEMPLATE_TCP)
+            memmove(tcp, &packet[rxInfo.l4Offset], sizeof(tcpFrame));
+
+        // Taken here since the reply overwrites the IP length
+        rxDataSize = rxInfo.dataSize;
+    }
 
     // Exit function if Sequence number is LT to the most recent sequence number
     // then packet is a retransmission and ignore.
-    //if(nextTcpState != CLOSED && tcp->ackNum == tcb.prevSeqNum)
+    //if(tcb->state != CLOSED && tcp->ackNum == tcb->prevSeqNum)
     //    return;
 
-    tcb.prevSeqNum = tcp->seqNum;
-    tcb.prevAckNum = tcp->ackNum;
+    tcb->prevSeqNum = tcp->seqNum;
+    tcb->prevAckNum = tcp->ackNum;
 
-    if(nextTcpState == CLOSED || nextTcpState == CLOSING)
-    {
+    // Broker connection headers come from its template, anything else replies to the sender
+    useTemplate = (tcb == mqttTcb);
 
-        setAddressInfo(&ether->destAddress, mqttMacAddress, HW_ADD_LENGTH);
-        setAddressInfo(&ether->sourceAddress, macAddress, HW_ADD_LENGTH);
-        setAddressInfo(&ip->destIp, mqttIpAddress, IP_ADD_LENGTH);
-        setAddressInfo(&ip->sourceIp, ipAddress, IP_ADD_LENGTH);
+    if(useTemplate)
+    {
+        tcpApplyTemplate(packet);
     }
     else
     {
@@ -155,35 +236,26 @@ void sendTcpMessage(uint8_t packet[], uint16_t flags)
         setAddressInfo(&ether->sourceAddress, macAddress, HW_ADD_LENGTH);
         setAddressInfo(&ip->destIp, ip->sourceIp, IP_ADD_LENGTH);
         setAddressInfo(&ip->sourceIp, ipAddress, IP_ADD_LENGTH);
-    }
 
-    ether->frameType = htons(0x0800); // For ipv4
+        ether->frameType = htons(0x0800); // For ipv4
 
-    // For purposes of computing the checksum, the value of the checksum field is zero. (See RFC791 Section 3.1)
-    ip->revSize        = 0x45;         // Four-bit Version field = 4 and IHL = 5 indicating the size is 20 bytes. (69 decimal or 0x45h)
-    ip->headerChecksum = 0;
-    ip->typeOfService  = 0;
-    ip->id             = htons(1);
-    ip->flagsAndOffset = 0;            // Don't Fragment Flag Set
-    ip->ttl            = TIME_TO_LIVE; // Time-to-Live in seconds
-    ip->protocol       = 6;            // UDP = 17 or 0x21h (See RFC790 Assigned Internet Protocol Numbers table for list)
+        // For purposes of computing the checksum, the value of the checksum field is zero. (See RFC791 Section 3.1)
+        ip->revSize        = 0x45;         // Four-bit Version field = 4 and IHL = 5 indicating the size is 20 bytes. (69 decimal or 0x45h)
+        ip->headerChecksum = 0;
+        ip->typeOfService  = 0;
+        ip->id             = htons(1);
+        ip->flagsAndOffset = 0;            // Don't Fragment Flag Set
+        ip->ttl            = TIME_TO_LIVE; // Time-to-Live in seconds
+        ip->protocol       = 6;            // UDP = 17 or 0x21h (See RFC790 Assigned Internet Protocol Numbers table for list)
 
-    if(nextTcpState == CLOSED)
-    {
-        mqttSrcPort     += (random32() % 256);
-        tcp->destPort   = htons(MQTT_BROKER_PORT);
-        tcp->sourcePort = htons(mqttSrcPort);
-    }
-    else
-    {
         tmp16 = tcp->destPort;
         tcp->destPort = tcp->sourcePort;
         tcp->sourcePort = tmp16;
-    }
 
-    tcp->checksum      = 0;            // Set checksum to zero before performing calculation
-    tcp->urgentPointer = 0;            // Not used in this class
-    tcp->window        = htons(1024);
+        tcp->checksum      = 0;            // Set checksum to zero before performing calculation
+        tcp->urgentPointer = 0;            // Not used in this class
+        tcp->window        = htons(1024);
+    }
 
     // If SYN flag = 1, then this is the initial sequence #.
     // The sequence # of actual 1st data byte and the acknowledge #
@@ -196,24 +268,33 @@ void sendTcpMessage(uint8_t packet[], uint16_t flags)
         tcp->ackNum    = 0;
         tcp->data[i++] = 0x02; // Kind = 2, Maximum Segment Size
         tcp->data[i++] = 0x04; // Length = 4
-        tcp->data[i++] = 0x04; // 1st byte of MSS
-        tcp->data[i++] = 0x00; // 2nd byte of MSS
+        tcp->data[i++] = TCP_MSS >> 8;   // 1st byte of MSS
+        tcp->data[i++] = TCP_MSS & 0xFF; // 2nd byte of MSS
         tcp->data[i++] = 0x01; // NOP
         tcp->data[i++] = 0x01; // NOP
         tcp->data[i++] = 0x04; // SACK Permitted
         tcp->data[i++] = 0x02; // Length
         tcp->dataCtrlFields = htons(0x7002); // Tx ACK
-        nextTcpState = SYN_SENT;
+        tcb->state = SYN_SENT;
         break;
     case FIN: // 1
-        tmp32 = htons32(tcp->seqNum) + 1;
-        tcp->seqNum = tcp->ackNum;
+    case FIN_ACK: // 17
+        tmp32       = htons32(tcp->seqNum) + 1;
+        tcp->seqNum = useTemplate ? tcb->currentSeqNum : tcp->ackNum;
         tcp->ackNum = htons32(tmp32);
-        tcp->dataCtrlFields = htons(0x5011); // FIN+ACK
-        if(nextTcpState == CLOSE_WAIT)
-            nextTcpState = LAST_ACK;
-        else if(nextTcpState == ESTABLISHED)
-            nextTcpState = FIN_WAIT_1;
+        if(tcb->state == FIN_WAIT_1 || tcb->state == FIN_WAIT_2)
+        {
+            // Our FIN went first, only theirs is left to acknowledge
+            tcp->dataCtrlFields = htons(0x5010); // ACK
+            tcb->state = TIME_WAIT;
+        }
+        else
+        {
+            // Peer closed, our FIN goes with the ACK of theirs and the slot
+            // is freed when it is acknowledged
+            tcp->dataCtrlFields = htons(0x5011); // FIN+ACK
+            tcb->state = LAST_ACK;
+        }
         break;
     case SYN: // 2
         tmp32       = htons32(tcp->seqNum) + 1;
@@ -222,59 +303,34 @@ void sendTcpMessage(uint8_t packet[], uint16_t flags)
         tcp->seqNum = htons32(tmp32);
         tcp->data[i++] = 0x02; // Kind = 2, Maximum Segment Size
         tcp->data[i++] = 0x04; // Length = 4
-        tcp->data[i++] = 0x04; // 1st byte of MSS
-        tcp->data[i++] = 0x00; // 2nd byte of MSS
+        tcp->data[i++] = TCP_MSS >> 8;   // 1st byte of MSS
+        tcp->data[i++] = TCP_MSS & 0xFF; // 2nd byte of MSS
         tcp->data[i++] = 0x01; // NOP
         tcp->data[i++] = 0x01; // NOP
         tcp->data[i++] = 0x04; // SACK Permitted
         tcp->data[i++] = 0x02; // Length
         tcp->dataCtrlFields = htons(0x7012); // SYN+ACK
-        nextTcpState = SYN_RECEIVED;
+        tcb->state = SYN_RECEIVED;
         break;
     case RST: // 4
         break;
     case ACK: // 16
-        nextTcpState = ESTABLISHED;
-        break;
-    case FIN_ACK: // 17
-        tmp32       = htons32(tcp->seqNum) + 1;
-        tcp->seqNum = tcp->ackNum;
-        tcp->ackNum = htons32(tmp32);
-        tcp->dataCtrlFields = htons(0x5011); // FIN+ACK
-        /*
-        switch(nextTcpState)
-        {
-        case CLOSE_WAIT:
-            nextTcpState = LAST_ACK;
-            break;
-        case CLOSING:
-            nextTcpState = TIME_WAIT;
-            startOneShotTimer(tcpClose, 2000);
-        case FIN_WAIT_1:
-            nextTcpState = TIME_WAIT;
-            startOneShotTimer(tcpClose, 2000);
-            break;
-        default:
-            break;
-        }
-        */
+        tcb->state = ESTABLISHED;
         break;
     case SYN_ACK: // SYN+ACK
         tmp32       = htons32(tcp->seqNum) + 1;
         tcp->seqNum = tcp->ackNum;
         tcp->ackNum = htons32(tmp32);
         tcp->dataCtrlFields = htons(0x5010); // Tx ACK
-        if(nextTcpState == SYN_SENT)
+        if(tcb->state == SYN_SENT)
         {
-            nextTcpState = ESTABLISHED;
+            tcb->state = ESTABLISHED;
             startOneShotTimer(mqttMessageEstablished, 10);
         }
         break;
     case PSH_ACK: //
-        // Size of TCP Data should be ip->length - size of IP Header - size of TCP Header
-        tmp16 = (htons(ip->length) - ((ip->revSize & 0xF) * 4) - ((htons(tcp->dataCtrlFields) & 0xF000) >> 12) * 4);
-        tmp32 = htons32(tcp->seqNum) + tmp16;
-        tcp->seqNum = tcp->ackNum;
+        tmp32 = htons32(tcp->seqNum) + rxDataSize;
+        tcp->seqNum = useTemplate ? tcb->currentSeqNum : tcp->ackNum;
         tcp->ackNum = htons32(tmp32);
         tcp->dataCtrlFields = htons(0x5018); // Tx PSH+ACK
         break;
@@ -282,70 +338,371 @@ void sendTcpMessage(uint8_t packet[], uint16_t flags)
         break;
     }
 
-    tcb.currentSeqNum = tcp->seqNum;
-    tcb.currentAckNum = tcp->ackNum;
+    tcb->currentSeqNum = tcp->seqNum;
+    tcb->currentAckNum = tcp->ackNum;
+
+    if(useTemplate)
+    {
+        size = tcpFinishTemplate(packet, i);
+    }
+    else
+    {
+        tcpSize = (sizeof(tcpFrame) + i); // Size of Options
+
+        sum = 0;
+        ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize); // Adjust length of IP header
+        etherCalcIpChecksum(ip);
 
-    tcpSize = (sizeof(tcpFrame) + i); // Size of Options
+        // 32-bit sum over pseudo-header
+        // TCP pseudo-header includes 4 byte source address from IP header,
+        // 4 byte destination address from IP header, 1 byte of zeros, 1 byte of protocol
+        // field from IP header, and 2 bytes for TCP length (Includes both TCP header and data).
+        sum = 0;
+        etherSumWords(ip->sourceIp, 8);
+        sum += ((ip->protocol & 0xFF) << 8);
+        sum += htons(tcpSize);
 
-    sum = 0;
-    ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize); // Adjust length of IP header
-    etherCalcIpChecksum(ip);
+        // Calculate TCP Header Checksum
+        etherSumWords(&tcp->sourcePort, tcpSize);
 
-    // 32-bit sum over pseudo-header
-    // TCP pseudo-header includes 4 byte source address from IP header,
-    // 4 byte destination address from IP header, 1 byte of zeros, 1 byte of protocol
-    // field from IP header, and 2 bytes for TCP length (Includes both TCP header and data).
-    sum = 0;
-    tmp16 = 0;
-    etherSumWords(ip->sourceIp, 8);
-    sum += ((tmp16 & 0xFF) << 8);
-    sum += ((ip->protocol & 0xFF) << 8);
-    sum += ((tcpSize & 0xFF00));
-    sum += ((tcpSize & 0x00FF) << 8);
+        tcp->checksum = getEtherChecksum(); // This value is the checksum over both the pseudo-header and the tcp segment
 
-    // Calculate TCP Header Checksum
-    etherSumWords(&tcp->sourcePort, tcpSize);
+        size = 14 + ((ip->revSize & 0xF) * 4) + tcpSize;
+    }
 
-    tcp->checksum = getEtherChecksum(); // This value is the checksum over both the pseudo-header and the tcp segment
+    // send packet with size = ether + ip header + tcp header + options
+    arpSendPacket(packet, size);
 
-    // send packet with size = ether + udp header + ip header + udp_size + dchp header + options
-    etherPutPacket((uint8_t *)ether, 14 + ((ip->revSize & 0xF) * 4) + tcpSize);
+    // No 2MSL wait, the slot is freed once the last ACK is sent
+    if(tcb->state == TIME_WAIT)
+        tcpClose();
 }
 
-// Lookup requested callback function
-_tcpCallback tcpLookup(tcpSysState state, tcpSysEvent event)
+// Build Ether, IP and TCP headers for the broker connection once. Everything
+// in the IP header except the length, and the pseudo-header plus ports,
+// window and urgent pointer of the TCP header, never change for the life of
+// the connection so their checksum contributions are summed here.
+void tcpBuildTemplate(void)
 {
-    uint8_t i, size;
+    etherFrame* ether = (etherFrame*)mqttTcb->headerTemplate;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    tcpFrame *tcp     = (tcpFrame*)&mqttTcb->headerTemplate[TCP_TEMPLATE_TCP];
 
-    size = sizeof(tcpStateTransitions)/sizeof(tcpStateTransitions[0]);
+    memset(&ether->destAddress, 0, HW_ADD_LENGTH); // Filled per frame from the ARP cache
+    setAddressInfo(&ether->sourceAddress, macAddress, HW_ADD_LENGTH);
+    setAddressInfo(&ip->destIp, mqttIpAddress, IP_ADD_LENGTH);
+    setAddressInfo(&ip->sourceIp, ipAddress, IP_ADD_LENGTH);
 
-    // Revert to LISTEN state if SYN rx'd
-    if(event == SYN)
-        state = LISTEN;
+    ether->frameType = htons(0x0800); // For ipv4
+
+    ip->revSize        = 0x45;          // Four-bit Version field = 4 and IHL = 5 indicating the size is 20 bytes. (69 decimal or 0x45h)
+    ip->typeOfService  = 0;
+    ip->length         = 0;             // Patched per segment
+    ip->id             = htons(1);
+    ip->flagsAndOffset = htons(0x4000); // Don't Fragment Flag Set
+    ip->ttl            = TIME_TO_LIVE;  // Time-to-Live in seconds
+    ip->protocol       = 6;             // TCP = 6
+    ip->headerChecksum = 0;
+
+    tcp->sourcePort     = htons(mqttSrcPort);
+    tcp->destPort       = htons(MQTT_BROKER_PORT);
+    tcp->seqNum         = 0;            // Patched per segment
+    tcp->ackNum         = 0;            // Patched per segment
+    tcp->dataCtrlFields = 0;            // Patched per segment
+    tcp->window         = htons(1024);
+    tcp->checksum       = 0;
+    tcp->urgentPointer  = 0;            // Not used in this class
 
-    for(i = 0; i < size; i++)
+    mqttTcb->ipPartialSum = checksumAdd(0, &ip->revSize, (ip->revSize & 0xF) * 4);
+
+    // Pseudo-header addresses and protocol, then the fixed TCP header fields
+    // (the per-segment fields are zero here so contribute nothing)
+    mqttTcb->tcpPartialSum = checksumAdd(0, ip->sourceIp, 8);
+    mqttTcb->tcpPartialSum += ((ip->protocol & 0xFF) << 8);
+    mqttTcb->tcpPartialSum = checksumAdd(mqttTcb->tcpPartialSum, &tcp->sourcePort, sizeof(tcpFrame));
+
+    mqttTcb->templateValid = true;
+}
+
+// Copy template headers into packet. Sequence, acknowledge and control
+// fields are left as they are so they can be read or set by the caller.
+void tcpApplyTemplate(uint8_t packet[])
+{
+    if(!mqttTcb->templateValid)
+        tcpBuildTemplate();
+
+    memcpy(packet, mqttTcb->headerTemplate, TCP_TEMPLATE_SEQ);
+    memcpy(&packet[TCP_TEMPLATE_WINDOW], &mqttTcb->headerTemplate[TCP_TEMPLATE_WINDOW], TCP_TEMPLATE_SIZE - TCP_TEMPLATE_WINDOW);
+}
+
+// Patch lengths and checksums of a segment built from the template. Only the
+// sequence, acknowledge and control fields plus the TCP data are summed.
+// Returns size of the frame to send.
+uint16_t tcpFinishTemplate(uint8_t packet[], uint16_t dataSize)
+{
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
+
+    return tcpFinishTemplateSum(packet, dataSize, checksumAdd(0, tcp->data, dataSize));
+}
+
+// Same as tcpFinishTemplate but with the sum of the TCP data supplied by the
+// caller, for segments whose data is streamed to the chip from other buffers.
+// Returns size of the headers plus data.
+uint16_t tcpFinishTemplateSum(uint8_t packet[], uint16_t dataSize, uint32_t dataSum)
+{
+    uint16_t tcpSize = sizeof(tcpFrame) + dataSize;
+    uint32_t tcpSum;
+
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
+
+    ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize);
+    ip->headerChecksum = checksumFold(mqttTcb->ipPartialSum + ip->length);
+
+    tcpSum = mqttTcb->tcpPartialSum + htons(tcpSize);
+    tcpSum = checksumAdd(tcpSum, &tcp->seqNum, 10);
+    tcpSum += dataSum;
+    tcp->checksum = checksumFold(tcpSum);
+
+    return 14 + ((ip->revSize & 0xF) * 4) + tcpSize;
+}
+
+// Build dense [state][event] table from tcpStateTransitions, must run before tcpLookup
+// Defaults for events a state does not list:
+//     - they are ignored, so a stray segment does not drop the connection
+//     - RST always closes the connection, whatever flags come with it
+void tcpInitStateTable(void)
+{
+    uint8_t i, j;
+
+    for(i = 0; i < 32; i++)
+        tcpEventIndex[i] = TCP_NUM_EVENTS - 1;
+
+    for(i = 0; i < TCP_NUM_EVENTS - 1; i++)
+        tcpEventIndex[tcpEvents[i]] = i;
+
+    // RST+ACK and other unlisted combinations with RST share the RST column
+    for(i = 0; i < 32; i++)
+    {
+        if((i & RST) && tcpEventIndex[i] == TCP_NUM_EVENTS - 1)
+            tcpEventIndex[i] = tcpEventIndex[RST_EVENT];
+    }
+
+    for(i = 0; i < TCP_NUM_STATES; i++)
     {
-        if(state == tcpStateTransitions[i].state && event == tcpStateTransitions[i].event)
+        for(j = 0; j < TCP_NUM_EVENTS; j++)
         {
-            return tcpStateTransitions[i].eventHandler;
+            if(j != TCP_NUM_EVENTS - 1 && (tcpEvents[j] & RST))
+                tcpStateTable[i][j] = (_tcpCallback)tcpClose;
+            else
+                tcpStateTable[i][j] = (_tcpCallback)dupTcpMsg;
         }
     }
 
-    nextTcpState = CLOSED; // If callback function not found in state machine revert to CLOSED state
+    for(i = 0; i < tcpStateTransitionCount; i++)
+        tcpStateTable[tcpStateTransitions[i].state][tcpEventIndex[tcpStateTransitions[i].event]] = tcpStateTransitions[i].eventHandler;
+}
 
-    return (_tcpCallback)setUpTcb;
+// Lookup requested callback function
+_tcpCallback tcpLookup(tcpSysState state, tcpSysEvent event)
+{
+    return tcpStateTable[state][tcpEventIndex[event & 0x1F]];
 }
 
-// Calculate the size of TCP header
-uint16_t getTcpHeaderSize(uint8_t size, uint16_t dataOffset)
+// Returns true if a segment with size bytes of TCP data can be held for
+// retransmission. Senders on the broker connection check this before sending
+// and hold off while it is false, so nothing goes out that could not be resent.
+bool tcpRtxReady(uint16_t size)
 {
-    uint8_t i, numOfWords = 5;
+    return size <= TCP_RTX_MAX_DATA &&
+           (uint8_t)(mqttTcb->rtxTail - mqttTcb->rtxHead) < TCP_RTX_QUEUE_SIZE;
+}
 
-    for(i = 1; i <= size; i++)
+// Hold a segment for the broker built from the template until it is
+// acknowledged, tcpRtxReady must have allowed it. size bytes of TCP data are
+// taken from packet, streamed pieces that follow are added with tcpRtxAppend.
+// Moves the next sequence number past the data.
+void tcpRtxQueue(uint8_t packet[], uint16_t size)
+{
+    tcpFrame *tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
+    tcpRtxSegment* seg;
+
+    mqttTcb->currentSeqNum = tcp->seqNum;
+
+    seg = &mqttTcb->rtxQueue[mqttTcb->rtxTail & (TCP_RTX_QUEUE_SIZE - 1)];
+    seg->seqNum   = htons32(tcp->seqNum);
+    seg->sentTime = timerGetTicks();
+    seg->flags    = tcp->dataCtrlFields;
+    seg->size     = 0;
+    seg->retries  = 0;
+    mqttTcb->rtxLast = seg;
+    mqttTcb->rtxTail++;
+
+    // First outstanding segment starts the retransmission timer
+    if((uint8_t)(mqttTcb->rtxTail - mqttTcb->rtxHead) == 1)
     {
-        if((i % 4) == 0)
-            numOfWords++;
+        timerStop(mqttTcb->rtxTimer);
+        mqttTcb->rtxTimer = timerStart(tcpRtxTimer, mqttTcb->rto, false);
     }
 
-    return (dataOffset &= numOfWords << 12);
+    tcpRtxAppend(tcp->data, size);
+}
+
+// Add streamed TCP data to the segment last queued, the total was checked
+// by tcpRtxReady
+void tcpRtxAppend(const void* data, uint16_t size)
+{
+    tcpRtxSegment* seg = mqttTcb->rtxLast;
+
+    mqttTcb->currentSeqNum = htons32(htons32(mqttTcb->currentSeqNum) + size);
+
+    if(seg == NULL)
+        return;
+
+    memcpy(&seg->data[seg->size], data, size);
+    seg->size += size;
+}
+
+// Send a held segment again with the current acknowledge number
+void tcpRtxSend(tcpRtxSegment* seg)
+{
+    tcpFrame *tcp     = (tcpFrame*)&data[TCP_TEMPLATE_TCP];
+
+    tcpApplyTemplate(data);
+    tcp->seqNum = htons32(seg->seqNum);
+    tcp->ackNum = mqttTcb->currentAckNum;
+    tcp->dataCtrlFields = seg->flags;
+    memcpy(tcp->data, seg->data, seg->size);
+
+    arpSendPacket(data, tcpFinishTemplate(data, seg->size));
+
+    seg->retries++;
+}
+
+// Update RTT estimate with a new sample (Jacobson/Karels, RFC6298 2.3)
+// srtt is kept scaled by 8 and rttvar by 4 so the gains are shifts
+void tcpRttSample(uint32_t rtt)
+{
+    int32_t delta;
+
+    if(mqttTcb->srtt == 0)
+    {
+        mqttTcb->srtt   = rtt << 3; // SRTT = R
+        mqttTcb->rttvar = rtt << 1; // RTTVAR = R/2
+    }
+    else
+    {
+        delta = rtt - (mqttTcb->srtt >> 3);
+        mqttTcb->srtt += delta;                            // SRTT += (R - SRTT)/8
+        if(delta < 0)
+            delta = -delta;
+        mqttTcb->rttvar += delta - (mqttTcb->rttvar >> 2);  // RTTVAR += (|R - SRTT| - RTTVAR)/4
+    }
+
+    // RTO = SRTT + 4*RTTVAR
+    mqttTcb->rto = (mqttTcb->srtt >> 3) + mqttTcb->rttvar;
+    if(mqttTcb->rto < TCP_RTO_MIN)
+        mqttTcb->rto = TCP_RTO_MIN;
+    else if(mqttTcb->rto > TCP_RTO_MAX)
+        mqttTcb->rto = TCP_RTO_MAX;
+}
+
+// Release segments acknowledged by a packet from the broker, sample RTT
+// and fast retransmit after repeated duplicate ACKs. packet must be the frame
+// described by rxInfo.
+void tcpRtxAck(uint8_t packet[])
+{
+    uint32_t ack;
+    uint16_t flags, size;
+    bool acked = false;
+    tcpRtxSegment* seg;
+
+    tcpFrame *tcp     = (tcpFrame*)&packet[rxInfo.l4Offset];
+
+    flags = rxInfo.tcpFlags;
+
+    if(tcb != mqttTcb || (flags & ACK) == 0)
+        return;
+
+    ack  = htons32(tcp->ackNum);
+    size = rxInfo.dataSize;
+
+    while(mqttTcb->rtxHead != mqttTcb->rtxTail)
+    {
+        seg = &mqttTcb->rtxQueue[mqttTcb->rtxHead & (TCP_RTX_QUEUE_SIZE - 1)];
+
+        if((int32_t)(ack - (seg->seqNum + seg->size)) < 0)
+            break;
+
+        // Karn's algorithm, retransmitted segments give ambiguous samples
+        if(seg->retries == 0)
+            tcpRttSample(timerGetTicks() - seg->sentTime);
+
+        if(seg == mqttTcb->rtxLast)
+            mqttTcb->rtxLast = NULL;
+
+        mqttTcb->rtxHead++;
+        acked = true;
+    }
+
+    if(acked)
+    {
+        mqttTcb->dupAcks = 0;
+
+        // Restart timer for what is still outstanding
+        timerStop(mqttTcb->rtxTimer);
+        if(mqttTcb->rtxHead != mqttTcb->rtxTail)
+            mqttTcb->rtxTimer = timerStart(tcpRtxTimer, mqttTcb->rto, false);
+    }
+    else if(ack == mqttTcb->lastAck && size == 0 && (flags & (SYN | FIN)) == 0 && mqttTcb->rtxHead != mqttTcb->rtxTail)
+    {
+        if(++mqttTcb->dupAcks == TCP_DUP_ACK_THRESHOLD)
+            tcpRtxSend(&mqttTcb->rtxQueue[mqttTcb->rtxHead & (TCP_RTX_QUEUE_SIZE - 1)]);
+    }
+    else
+    {
+        mqttTcb->dupAcks = 0;
+    }
+
+    if((int32_t)(ack - mqttTcb->lastAck) > 0)
+        mqttTcb->lastAck = ack;
+}
+
+// Retransmission timer expired, flag it for tcpRtxPoll
+void tcpRtxTimer(void)
+{
+    mqttTcb->rtxExpired = true;
+}
+
+// Called from main loop, resends oldest segment with exponential backoff
+void tcpRtxPoll(void)
+{
+    tcpRtxSegment* seg;
+
+    if(!mqttTcb->rtxExpired)
+        return;
+
+    mqttTcb->rtxExpired = false;
+
+    if(mqttTcb->rtxHead == mqttTcb->rtxTail)
+        return;
+
+    seg = &mqttTcb->rtxQueue[mqttTcb->rtxHead & (TCP_RTX_QUEUE_SIZE - 1)];
+
+    // Broker is not answering, drop the connection
+    if(seg->retries >= TCP_RTX_MAX_TRIES)
+    {
+        tcb = mqttTcb;
+        tcpClose();
+        return;
+    }
+
+    // RTO doubles on every timeout (RFC6298 5.5)
+    mqttTcb->rto <<= 1;
+    if(mqttTcb->rto > TCP_RTO_MAX)
+        mqttTcb->rto = TCP_RTO_MAX;
+
+    tcpRtxSend(seg);
+    mqttTcb->rtxTimer = timerStart(tcpRtxTimer, mqttTcb->rto, false);
 }
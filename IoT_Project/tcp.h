@@ -14,23 +14,38 @@
 #define TCP_H_
 
 #include "tcp.h"
+#include "timers.h"
 
 #define TIME_TO_LIVE 60
 
-// Transmission control block (Stores info about):
-//     - endpoints (IP and port)
-//     - status of connection
-//     - running data about the packets that are being exchanged
-//     - buffers for sending and receiving data
-typedef struct _transCtrlBlock
+#define TCP_MAX_CONNECTIONS 4 // Size of TCB table (must be a power of 2)
+#define TCP_MQTT_TCB        0 // TCB table slot kept for the broker connection
+
+#define TCP_TEMPLATE_SIZE   54 // Ether (14) + IP (20) + TCP (20) Headers
+#define TCP_TEMPLATE_TCP    34 // Offset of TCP Header in Template and in every segment sent
+#define TCP_TEMPLATE_SEQ    38 // Offset of TCP Sequence Number in Template
+#define TCP_TEMPLATE_WINDOW 48 // Offset of TCP Window in Template
+#define TCP_MSS             1024 // Maximum Segment Size advertised in SYN, largest TCP data sent
+
+// Retransmission of unacknowledged data on the broker connection
+#define TCP_RTX_QUEUE_SIZE    4     // Segments held until acknowledged (must be a power of 2)
+#define TCP_RTX_MAX_DATA      TCP_MSS // Largest TCP data held for retransmission, one full segment
+#define TCP_RTX_MAX_TRIES     8     // Give up on connection after this many timeouts
+#define TCP_DUP_ACK_THRESHOLD 3     // Duplicate ACKs before fast retransmit
+#define TCP_RTO_INITIAL       1000  // ms (RFC6298 2.1)
+#define TCP_RTO_MIN           200   // ms
+#define TCP_RTO_MAX           60000 // ms
+
+// Segment held for retransmission
+typedef struct _tcpRtxSegment
 {
-    uint32_t prevSeqNum;
-    uint32_t prevAckNum;
-    uint32_t currentSeqNum;
-    uint32_t currentAckNum;
-} transCtrlBlock;
-
-extern transCtrlBlock tcb;
+    uint32_t seqNum;   // Host byte order
+    uint32_t sentTime; // timerGetTicks() when first sent
+    uint16_t flags;    // dataCtrlFields as sent
+    uint16_t size;
+    uint8_t  retries;
+    uint8_t  data[TCP_RTX_MAX_DATA];
+} tcpRtxSegment;
 
 typedef enum
 {
@@ -62,7 +77,46 @@ typedef enum
     LAST_ACK,     //
 } tcpSysState;
 
-extern tcpSysState nextTcpState;
+// Transmission control block (Stores info about):
+//     - endpoints (IP and port), local IP is always ours
+//     - status of connection
+//     - running data about the packets that are being exchanged
+//     - buffers for sending and receiving data
+//     - pre-built headers for the broker connection, with the fixed part of
+//       the IP and TCP checksums already summed
+//     - unacknowledged segments and round trip time estimate (Jacobson/Karels)
+typedef struct _transCtrlBlock
+{
+    bool     inUse;
+    tcpSysState state;
+    uint8_t  remoteIp[4];
+    uint16_t remotePort;
+    uint16_t localPort;
+    uint32_t prevSeqNum;
+    uint32_t prevAckNum;
+    uint32_t currentSeqNum;
+    uint32_t currentAckNum;
+    bool     templateValid;
+    uint32_t ipPartialSum;
+    uint32_t tcpPartialSum;
+    uint8_t  headerTemplate[TCP_TEMPLATE_SIZE];
+    tcpRtxSegment* rtxQueue; // TCP_RTX_QUEUE_SIZE held segments, broker connection only
+    tcpRtxSegment* rtxLast;  // Segment streamed pieces are appended to
+    uint8_t  rtxHead;        // Oldest unacknowledged segment
+    uint8_t  rtxTail;        // Next free segment
+    int32_t  srtt;           // Smoothed RTT, ms scaled by 8
+    int32_t  rttvar;         // RTT variance, ms scaled by 4
+    uint32_t rto;            // Retransmission timeout, ms
+    uint32_t lastAck;        // Highest ACK seen from peer, host byte order
+    uint8_t  dupAcks;
+    volatile bool rtxExpired;
+    timerHandle rtxTimer;    // Running while segments are unacknowledged
+} transCtrlBlock;
+
+extern tcpRtxSegment mqttRtxQueue[TCP_RTX_QUEUE_SIZE];
+extern transCtrlBlock tcbTable[TCP_MAX_CONNECTIONS];
+extern transCtrlBlock* const mqttTcb;
+extern transCtrlBlock* tcb;
 
 //
 // Enumerations of Events
@@ -72,6 +126,7 @@ typedef enum
     PASSIVE_OPEN_EVENT = 0, //
     FIN_EVENT = 1,          //
     SYN_EVENT = 2,          //
+    RST_EVENT = 4,          //
     APP_CLOSE_EVENT = 7,    //
     ACK_EVENT = 16,         //
     FIN_ACK_EVENT = 17,     //
@@ -79,6 +134,9 @@ typedef enum
     PSH_ACK_EVENT = 24      //
 } tcpSysEvent;
 
+#define TCP_NUM_STATES (LAST_ACK + 1)
+#define TCP_NUM_EVENTS 10 // Events above plus any other flag combination
+
 typedef tcpSysState(*_tcpCallback)(uint8_t packet[], uint16_t flags);
 
 //
@@ -91,6 +149,9 @@ typedef struct
     _tcpCallback eventHandler;
 } tcpStateMachine;
 
+extern tcpStateMachine tcpStateTransitions[];
+extern const uint8_t tcpStateTransitionCount;
+
 typedef struct _tcpFrame // 20 Bytes in Length
 {
   uint16_t  sourcePort;     // 2
@@ -105,15 +166,27 @@ typedef struct _tcpFrame // 20 Bytes in Length
 } tcpFrame;
 
 void dupTcpMsg(void);
-bool etherIsTcp(uint8_t packet[]);
-uint16_t etherIsTcpMsgType(uint8_t packet[]);
-void tcpAckReceived(uint8_t packet[]);
 void sendTcpMessage(uint8_t packet[], uint16_t flags);
-bool checkForDuplicates(uint8_t packet[]);
+void tcpInitStateTable(void);
 _tcpCallback tcpLookup(tcpSysState state, tcpSysEvent event);
+uint8_t tcpHash(uint8_t remoteIp[], uint16_t remotePort, uint16_t localPort);
+transCtrlBlock* tcpFindTcb(uint8_t packet[]);
+void tcpOpenMqtt(void);
 void setUpTcb(void);
 void tcpEstablished(void);
+void tcpFinWait2(void);
 void tcpClose(void);
-uint16_t getTcpHeaderSize(uint8_t size, uint16_t dataOffset);
+void tcpBuildTemplate(void);
+void tcpApplyTemplate(uint8_t packet[]);
+uint16_t tcpFinishTemplate(uint8_t packet[], uint16_t dataSize);
+uint16_t tcpFinishTemplateSum(uint8_t packet[], uint16_t dataSize, uint32_t dataSum);
+bool tcpRtxReady(uint16_t size);
+void tcpRtxQueue(uint8_t packet[], uint16_t size);
+void tcpRtxAppend(const void* data, uint16_t size);
+void tcpRtxSend(tcpRtxSegment* seg);
+void tcpRttSample(uint32_t rtt);
+void tcpRtxAck(uint8_t packet[]);
+void tcpRtxPoll(void);
+void tcpRtxTimer(void);
 
 #endif /* TCP_H_ */
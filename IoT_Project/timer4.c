@@ -0,0 +1,85 @@
+// timer4.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// Timer 4
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "timer4.h"
+
+volatile uint32_t timer4High = 0;   // Times the counter has wrapped, upper half of the time base
+
+// Start counting up from zero with the match and wrap interrupts on
+void initTimer4(void)
+{
+    // Enable clocks
+    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R4;
+    _delay_cycles(3);
+
+    TIMER4_CTL_R   &= ~TIMER_CTL_TAEN;       // turn-off counter before reconfiguring
+    TIMER4_CFG_R   = TIMER_CFG_32_BIT_TIMER; // configure as 32-bit counter
+    TIMER4_TAMR_R  = TIMER_TAMR_TAMR_PERIOD | TIMER_TAMR_TACDIR | TIMER_TAMR_TAMIE; // periodic, count up, match interrupt
+    TIMER4_TAILR_R = 0xFFFFFFFF;             // free running, wraps every 107 s
+    TIMER4_TAMATCHR_R = 0xFFFFFFFF;
+    TIMER4_CTL_R   |= TIMER_CTL_TAEN;
+    TIMER4_IMR_R   |= TIMER_IMR_TATOIM | TIMER_IMR_TAMIM; // enable interrupts
+    NVIC_EN2_R     |= 1 << (INT_TIMER4A-80); // turn-on interrupt 86 (TIMER4A)
+}
+
+void timer4DisableInterrupts(void)
+{
+    TIMER4_IMR_R &= ~(TIMER_IMR_TATOIM | TIMER_IMR_TAMIM);
+}
+
+void timer4EnableInterrupts(void)
+{
+    TIMER4_IMR_R |= TIMER_IMR_TATOIM | TIMER_IMR_TAMIM;
+}
+
+// System clocks since initTimer4. A wrap tickIsr has not counted yet shows
+// up as the raw interrupt with the counter near zero.
+uint64_t timer4GetCycles(void)
+{
+    uint32_t high, low;
+
+    high = timer4High;
+    low = TIMER4_TAV_R;
+    if ((TIMER4_RIS_R & TIMER_RIS_TATORIS) && low < 0x80000000)
+        high++;
+
+    return ((uint64_t)high << 32) | low;
+}
+
+// Match at cycles, or at the wrap if that comes first
+void timer4SetMatch(uint64_t cycles)
+{
+    if ((cycles >> 32) == (timer4GetCycles() >> 32))
+        TIMER4_TAMATCHR_R = (uint32_t)cycles;
+    else
+        TIMER4_TAMATCHR_R = 0xFFFFFFFF;
+}
+
+// Clear the match and wrap interrupts, counting a wrap
+void timer4ClearInterrupt(void)
+{
+    uint32_t status = TIMER4_MIS_R;
+
+    TIMER4_ICR_R = status;
+    if (status & TIMER_MIS_TATOMIS)
+        timer4High++;
+}
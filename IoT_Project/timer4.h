@@ -0,0 +1,35 @@
+// timer4.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// Timer 4
+
+#ifndef TIMER4_H_
+#define TIMER4_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Time base under the timer wheel in timers.c
+// Timer 4 counts up freely at the system clock. Each wrap is counted to
+// extend it to 64 bits, and the match raises tickIsr at the next deadline.
+// Everything but initTimer4 is called with the interrupts disabled, or
+// from tickIsr.
+
+void initTimer4(void);
+void timer4DisableInterrupts(void);
+void timer4EnableInterrupts(void);
+uint64_t timer4GetCycles(void);
+void timer4SetMatch(uint64_t cycles);
+void timer4ClearInterrupt(void);
+
+#endif /* TIMER4_H_ */
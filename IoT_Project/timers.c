@@ -20,10 +20,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
-#include "tm4c123gh6pm.h"
 #include "gpio.h"
 #include "uart0.h"
 #include "timers.h"
+#include "timer4.h"
+#include "events.h"
 
 uint8_t dhcpRequestsSent = 0;
 uint8_t dhcpRequestType  = 0;
@@ -31,152 +32,593 @@ uint32_t leaseTime  = 0;
 //bool arpResponseRx  = false;
 //bool sendMqttPing = false;
 
-bool reload[NUM_TIMERS]     = {0};
-uint32_t period[NUM_TIMERS] = {0};
-uint32_t ticks[NUM_TIMERS]  = {0};
-_callback fn[NUM_TIMERS]    = {0};
+timerEntry timers[TIMER_MAX];
+timerIndex timerLists[TIMER_NUM_LISTS]; // First entry of each wheel slot
+uint32_t timerMap[TIMER_MAP_WORDS];  // Lists that have entries, so the next deadline is found a word at a time
+timerHandle timerQueue[TIMER_QUEUE_SIZE]; // Expired timers, filled by tickIsr and emptied by timerPoll
+volatile timerIndex timerQueueWrite = 0;
+volatile timerIndex timerQueueRead = 0;
+timerIndex timerFreeList = TIMER_NIL;
+uint8_t timerLockCount = 0;
+uint32_t wheelTime = 1;             // Next ms the wheel will process
+uint32_t timerNext = 0;             // ms the match is set for
 
 // Function To Initialize Timers
 void initTimer(void)
 {
-    uint8_t i;
+    // Start the time base
+    initTimer4();
 
-    // Enable clocks
-    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R4;
-    _delay_cycles(3);
+    // Set initial timer values
+    resetAllTimers();
+}
 
-    TIMER4_CTL_R   &= ~TIMER_CTL_TAEN;       // turn-off counter before reconfiguring
-    TIMER4_CFG_R   = TIMER_CFG_32_BIT_TIMER; // configure as 32-bit counter
-    TIMER4_TAMR_R  = TIMER_TAMR_TAMR_PERIOD; // configure for one-shot mode, count down
-    //TIMER4_TAILR_R = 40000000;
-    TIMER4_TAILR_R = 40000;                  // Need to have a 1 kHz clock
-    TIMER4_CTL_R   |= TIMER_CTL_TAEN;
-    TIMER4_IMR_R   |= TIMER_IMR_TATOIM;      // enable interrupts
-    NVIC_EN2_R     |= 1 << (INT_TIMER4A-80); // turn-on interrupt 86 (TIMER4A)
+// Keep tickIsr out while the wheel is changed, calls can be nested
+void timerLock(void)
+{
+    timer4DisableInterrupts();
+    timerLockCount++;
+}
 
-    // Set initial timer values
-    for(i = 0; i < NUM_TIMERS; i++)
+void timerUnlock(void)
+{
+    if (--timerLockCount == 0)
+        timer4EnableInterrupts();
+}
+
+// System clocks since initTimer
+uint64_t timerGetCycles(void)
+{
+    uint64_t cycles;
+
+    timerLock();
+    cycles = timer4GetCycles();
+    timerUnlock();
+
+    return cycles;
+}
+
+// ms since initTimer
+uint64_t timerGetTime(void)
+{
+    return timerGetCycles() / TIMER_CYCLES_PER_MS;
+}
+
+// ms since initTimer for time stamps, wraps every 49 days so compare by
+// subtracting
+uint32_t timerGetTicks(void)
+{
+    return (uint32_t)timerGetTime();
+}
+
+// Link entry into the wheel list its expiry time falls in
+void timerAdd(timerIndex i)
+{
+    timerEntry* t = &timers[i];
+    int32_t delta = t->expires - wheelTime;
+    uint8_t level;
+    uint16_t list;
+
+    if (delta < 0)
     {
-        period[i] = 0;
-        ticks[i]  = 0;
-        fn[i]     = NULL;
-        reload[i] = false;
+        // Already due, goes out on the next tick
+        list = wheelTime & (TIMER_WHEEL_SLOTS - 1);
     }
+    else if (delta < TIMER_WHEEL_SLOTS)
+    {
+        list = t->expires & (TIMER_WHEEL_SLOTS - 1);
+    }
+    else
+    {
+        level = 1;
+        while (level < TIMER_LEVELS && (uint32_t)delta >= (1UL << (TIMER_WHEEL_BITS + level * TIMER_LEVEL_BITS)))
+            level++;
+        list = TIMER_WHEEL_SLOTS + (level - 1) * TIMER_LEVEL_SLOTS +
+               ((t->expires >> (TIMER_WHEEL_BITS + (level - 1) * TIMER_LEVEL_BITS)) & (TIMER_LEVEL_SLOTS - 1));
+    }
+
+    t->list = list;
+    t->prev = TIMER_NIL;
+    t->next = timerLists[list];
+    if (t->next != TIMER_NIL)
+        timers[t->next].prev = i;
+    timerLists[list] = i;
+    timerMap[list >> 5] |= 1UL << (list & 31);
 }
 
-// Function to Start One Shot Timer
-bool startOneShotTimer(_callback callback, uint32_t seconds)
+// Unlink entry from its wheel list, if it is in one
+void timerRemove(timerIndex i)
+{
+    timerEntry* t = &timers[i];
+
+    if (t->list == TIMER_IDLE)
+        return;
+
+    if (t->prev == TIMER_NIL)
+        timerLists[t->list] = t->next;
+    else
+        timers[t->prev].next = t->next;
+
+    if (t->next != TIMER_NIL)
+        timers[t->next].prev = t->prev;
+
+    if (timerLists[t->list] == TIMER_NIL)
+        timerMap[t->list >> 5] &= ~(1UL << (t->list & 31));
+
+    t->list = TIMER_IDLE;
+}
+
+// Return entry to free list, its handle stops matching
+void timerFree(timerIndex i)
+{
+    timerEntry* t = &timers[i];
+
+    timerRemove(i);
+    t->fn = NULL;
+    t->flags = 0;
+    if (++t->generation == 0)
+        t->generation = 1;
+    t->next = timerFreeList;
+    timerFreeList = i;
+}
+
+// Returns entry of handle or TIMER_NIL if it has expired or been stopped
+timerIndex timerFromHandle(timerHandle handle)
+{
+    timerIndex i = (timerIndex)handle;
+
+    if (i >= TIMER_MAX || (timers[i].flags & TIMER_USED) == 0 || timers[i].generation != (handle >> TIMER_INDEX_BITS))
+        return TIMER_NIL;
+
+    return i;
+}
+
+// Move entries of the current slot of a higher level down the wheel,
+// returns that slot so the caller knows if this level wrapped too
+uint8_t timerCascade(uint8_t level)
 {
-    uint8_t i = 0;
+    timerIndex i, next;
+    uint8_t index;
+    uint16_t list;
+
+    index = (wheelTime >> (TIMER_WHEEL_BITS + (level - 1) * TIMER_LEVEL_BITS)) & (TIMER_LEVEL_SLOTS - 1);
+    list = TIMER_WHEEL_SLOTS + (level - 1) * TIMER_LEVEL_SLOTS + index;
+
+    // Detached first, an entry can be added back to the same list
+    i = timerLists[list];
+    timerLists[list] = TIMER_NIL;
+    timerMap[list >> 5] &= ~(1UL << (list & 31));
+    while (i != TIMER_NIL)
+    {
+        next = timers[i].next;
+        timerAdd(i);
+        i = next;
+    }
+
+    return index;
+}
+
+// Run the wheel slot for wheelTime. Only timers in that slot are touched,
+// plus the ones that move down a level once every 256 ms.
+void timerStep(void)
+{
+    timerIndex i, next;
+    uint8_t level;
+    uint16_t index;
+    timerEntry* t;
+
+    index = wheelTime & (TIMER_WHEEL_SLOTS - 1);
+    if (index == 0)
+    {
+        level = 1;
+        while (level <= TIMER_LEVELS && timerCascade(level) == 0)
+            level++;
+    }
+    wheelTime++;
+
+    // Detached first, a periodic entry can be added back to the same slot
+    i = timerLists[index];
+    timerLists[index] = TIMER_NIL;
+    timerMap[index >> 5] &= ~(1UL << (index & 31));
 
-    while(i < NUM_TIMERS)
+    while (i != TIMER_NIL)
     {
-        if (fn[i] == NULL)
+        t = &timers[i];
+        next = t->next;
+        t->list = TIMER_IDLE;
+
+        if (t->flags & TIMER_PERIODIC)
         {
-            period[i] = seconds;
-            ticks[i]  = seconds;
-            fn[i]     = callback;
-            reload[i] = false;
-            return true;
+            // Periods missed while the wheel was behind are skipped rather
+            // than run back to back, the timer keeps its phase
+            t->expires += t->period;
+            if (t->period != 0 && (int32_t)(t->expires - wheelTime) < 0)
+                t->expires += ((wheelTime - 1 - t->expires) / t->period + 1) * t->period;
+            timerAdd(i);
         }
-        i++;
+
+        // Callback is run by timerPoll, an entry already waiting there is
+        // not queued again so the queue can hold every entry
+        if ((t->flags & TIMER_PENDING) == 0 && (timerIndex)(timerQueueWrite - timerQueueRead) < TIMER_QUEUE_SIZE)
+        {
+            t->flags |= TIMER_PENDING;
+            timerQueue[timerQueueWrite & (TIMER_QUEUE_SIZE - 1)] = ((timerHandle)t->generation << TIMER_INDEX_BITS) | i;
+            timerQueueWrite++;
+            eventSet(EVENT_TIMER);
+        }
+
+        i = next;
     }
-    return false;
 }
 
-// Function to Start Periodic Timer
-bool startPeriodicTimer(_callback callback, uint32_t seconds)
+// Bring the wheel up to now. After a long sleep it is cheaper to file
+// every entry again than to step through each ms in between.
+void timerAdvance(uint32_t now)
 {
-    uint8_t i = 0;
+    timerIndex i;
+    uint16_t list;
 
-    while(i < NUM_TIMERS)
+    if ((int32_t)(now - wheelTime) >= TIMER_WHEEL_SLOTS)
     {
-        if (fn[i] == NULL)
+        for (list = 0; list < TIMER_NUM_LISTS; list++)
+            timerLists[list] = TIMER_NIL;
+        for (list = 0; list < TIMER_MAP_WORDS; list++)
+            timerMap[list] = 0;
+        wheelTime = now;
+        for (i = 0; i < TIMER_MAX; i++)
         {
-            period[i] = seconds;
-            ticks[i]  = seconds;
-            fn[i]     = callback;
-            reload[i] = true;
-            return true;
+            if (timers[i].list != TIMER_IDLE)
+                timerAdd(i);
         }
-        i++;
     }
-    return false;
+
+    while ((int32_t)(now - wheelTime) >= 0)
+        timerStep();
 }
 
-//
-bool stopTimer(_callback callback)
+// Index of the lowest set bit of a non-zero word (de Bruijn multiply)
+uint8_t timerLowestBit(uint32_t bits)
 {
-    uint8_t i = 0;
+    static const uint8_t position[32] =
+    {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
 
-    for(i = 0; i < NUM_TIMERS; i++)
+    return position[(uint32_t)((bits & -bits) * 0x077CB531U) >> 27];
+}
+
+// Distance from slot start to the first slot with entries among the count
+// lists from first, going forward and wrapping around. Returns count if they
+// are all empty. first and count are multiples of 32.
+uint16_t timerScan(uint16_t first, uint16_t count, uint16_t start)
+{
+    uint16_t offset, list, distance;
+    uint32_t bits;
+
+    for (offset = 0; offset < count; offset += 32 - (list & 31))
     {
-        if(fn[i] == callback)
+        list = first + ((start + offset) & (count - 1));
+        bits = timerMap[list >> 5] >> (list & 31);
+        if (bits != 0)
         {
-            period[i] = 0;
-            ticks[i]  = 0;
-            fn[i]     = NULL;
-            reload[i] = false;
-            return true;
+            // Past count is a bit before start seen again at the end
+            distance = offset + timerLowestBit(bits);
+            return (distance < count) ? distance : count;
         }
     }
-    return false;
+
+    return count;
 }
 
-// Restart Timer Previously Initialized
-bool restartTimer(_callback callback)
+// Earliest ms a timer is due, found from the lists rather than by looking at
+// every entry. A first level slot holds timers due at one ms. In a higher level
+// only the first slot with entries can hold the earliest of that level, so just
+// its short list is walked. Returns false if the wheel is empty.
+bool timerNextDeadline(uint32_t* next)
 {
-    uint8_t i = 0;
-    while(i < NUM_TIMERS)
+    timerIndex i;
+    uint8_t level, shift;
+    uint16_t distance, list;
+    uint32_t turn, time;
+    bool found = false;
+
+    distance = timerScan(0, TIMER_WHEEL_SLOTS, wheelTime & (TIMER_WHEEL_SLOTS - 1));
+    if (distance < TIMER_WHEEL_SLOTS)
     {
-        if(fn[i] == callback)
+        *next = wheelTime + distance;
+        found = true;
+    }
+
+    for (level = 1; level <= TIMER_LEVELS; level++)
+    {
+        // First slot of this level still to cascade, wheelTime itself has not been run
+        shift = TIMER_WHEEL_BITS + (level - 1) * TIMER_LEVEL_BITS;
+        turn = ((wheelTime - 1) >> shift) + 1;
+        distance = timerScan(TIMER_WHEEL_SLOTS + (level - 1) * TIMER_LEVEL_SLOTS, TIMER_LEVEL_SLOTS,
+                             turn & (TIMER_LEVEL_SLOTS - 1));
+        if (distance < TIMER_LEVEL_SLOTS)
         {
-            ticks[i] = period[i];
-            return true;
+            list = TIMER_WHEEL_SLOTS + (level - 1) * TIMER_LEVEL_SLOTS + ((turn + distance) & (TIMER_LEVEL_SLOTS - 1));
+            for (i = timerLists[list]; i != TIMER_NIL; i = timers[i].next)
+            {
+                time = timers[i].expires;
+                if (!found || (int32_t)(time - *next) < 0)
+                    *next = time;
+                found = true;
+            }
         }
-        i++;
     }
-    return false;
+
+    return found;
+}
+
+// Set the match for the earliest deadline, at least the next ms so an entry
+// filed behind wheelTime still gets its slot run. With nothing due before the
+// counter wraps the match is left at the wrap. A deadline that passed while
+// the match was written would not be seen until the wrap, so it is run here.
+void timerProgram(void)
+{
+    int32_t first;
+    uint32_t now, next;
+    uint64_t time, deadline;
+
+    while (true)
+    {
+        time = timerGetTime();
+        now = (uint32_t)time;
+        first = INT32_MAX;
+        if (timerNextDeadline(&next) && (int32_t)(next - now) < first)
+            first = next - now;
+        if (first < 1)
+            first = 1;
+
+        timerNext = now + first;
+        deadline = (time + first) * TIMER_CYCLES_PER_MS;
+        timer4SetMatch(deadline);
+
+        if (timerGetCycles() < deadline)
+            break;
+        timerAdvance(timerGetTicks());
+    }
+}
+
+// File entry to expire a period from now, moving the match in if it is
+// due before the timer the match is set for
+void timerArm(timerIndex i)
+{
+    timers[i].expires = timerGetTicks() + timers[i].period;
+    timerAdd(i);
+    if ((int32_t)(timers[i].expires - timerNext) < 0)
+        timerProgram();
+}
+
+// True if entry is armed for the ms the match is set for. Once it is
+// stopped or armed later the match is moved to the next deadline rather
+// than left to raise an interrupt for nothing.
+bool timerHoldsMatch(timerIndex i)
+{
+    return timers[i].list != TIMER_IDLE && timers[i].expires == timerNext;
+}
+
+// Take an entry and arm it to expire in ms
+timerHandle timerCreate(_callback callback, uint32_t ms, uint8_t flags)
+{
+    timerIndex i;
+    timerHandle handle = TIMER_INVALID;
+
+    timerLock();
+    if ((i = timerFreeList) != TIMER_NIL)
+    {
+        timerFreeList = timers[i].next;
+        timers[i].fn = callback;
+        timers[i].period = ms;
+        timers[i].flags = TIMER_USED | flags;
+        timerArm(i);
+        handle = ((timerHandle)timers[i].generation << TIMER_INDEX_BITS) | i;
+    }
+    timerUnlock();
+
+    return handle;
+}
+
+// Start a timer that calls callback from timerPoll after ms, and every ms
+// after that if periodic. A one-shot frees itself once its callback has run.
+// Returns TIMER_INVALID if all TIMER_MAX are in use.
+timerHandle timerStart(_callback callback, uint32_t ms, bool periodic)
+{
+    return timerCreate(callback, ms, periodic ? TIMER_PERIODIC : 0);
+}
+
+// Stop and free a timer, stale handles are ignored
+bool timerStop(timerHandle handle)
+{
+    timerIndex i;
+    bool ok, held;
+
+    timerLock();
+    i = timerFromHandle(handle);
+    ok = (i != TIMER_NIL);
+    if (ok)
+    {
+        held = timerHoldsMatch(i);
+        timerFree(i);
+        if (held)
+            timerProgram();
+    }
+    timerUnlock();
+
+    return ok;
+}
+
+// Arm a timer again for its whole period from now
+bool timerRestart(timerHandle handle)
+{
+    timerIndex i;
+    bool ok, held;
+
+    timerLock();
+    i = timerFromHandle(handle);
+    ok = (i != TIMER_NIL);
+    if (ok)
+    {
+        held = timerHoldsMatch(i);
+        timerRemove(i);
+        timerArm(i);
+        if (held)
+            timerProgram();
+    }
+    timerUnlock();
+
+    return ok;
+}
+
+bool timerIsRunning(timerHandle handle)
+{
+    timerIndex i = timerFromHandle(handle);
+
+    return i != TIMER_NIL && timers[i].list != TIMER_IDLE;
+}
+
+// First entry with callback, timers started by callback have only one owner
+// so this scan is what their start/stop/restart calls cost
+timerIndex timerFind(_callback callback)
+{
+    timerIndex i;
+
+    for (i = 0; i < TIMER_MAX; i++)
+    {
+        if ((timers[i].flags & TIMER_USED) != 0 && timers[i].fn == callback)
+            return i;
+    }
+
+    return TIMER_NIL;
+}
+
+// Function to Start One Shot Timer
+// Entry is kept after it expires until stopTimer is called
+bool startOneShotTimer(_callback callback, uint32_t seconds)
+{
+    return timerCreate(callback, seconds, TIMER_KEEP) != TIMER_INVALID;
+}
+
+// Function to Start Periodic Timer
+bool startPeriodicTimer(_callback callback, uint32_t seconds)
+{
+    return timerCreate(callback, seconds, TIMER_PERIODIC | TIMER_KEEP) != TIMER_INVALID;
+}
+
+//
+bool stopTimer(_callback callback)
+{
+    timerIndex i;
+    bool held;
+
+    timerLock();
+    i = timerFind(callback);
+    if (i != TIMER_NIL)
+    {
+        held = timerHoldsMatch(i);
+        timerFree(i);
+        if (held)
+            timerProgram();
+    }
+    timerUnlock();
+
+    return i != TIMER_NIL;
+}
+
+// Restart Timer Previously Initialized
+bool restartTimer(_callback callback)
+{
+    timerIndex i;
+    bool held;
+
+    timerLock();
+    i = timerFind(callback);
+    if (i != TIMER_NIL)
+    {
+        held = timerHoldsMatch(i);
+        timerRemove(i);
+        timerArm(i);
+        if (held)
+            timerProgram();
+    }
+    timerUnlock();
+
+    return i != TIMER_NIL;
 }
 
 // Reset all timers
 void resetAllTimers(void)
 {
-    uint8_t i;
-    for(i = 0; i < NUM_TIMERS; i++)
+    timerIndex i;
+    uint16_t list;
+
+    timerLock();
+    for (list = 0; list < TIMER_NUM_LISTS; list++)
+        timerLists[list] = TIMER_NIL;
+    for (list = 0; list < TIMER_MAP_WORDS; list++)
+        timerMap[list] = 0;
+
+    timerFreeList = TIMER_NIL;
+    for (i = TIMER_MAX; i > 0; i--)
     {
-        period[i] = 0;
-        ticks[i]  = 0;
-        fn[i]     = NULL;
-        reload[i] = false;
+        timers[i - 1].list = TIMER_IDLE;
+        timerFree(i - 1);
     }
+    wheelTime = timerGetTicks() + 1;
+    timerQueueRead = timerQueueWrite;
+    timerProgram();
+    timerUnlock();
 }
 
 // Function to handle Timer Interrupts
+// Raised by the match at the next deadline or by the counter wrapping,
+// a handful of times a minute instead of every ms
 void tickIsr(void)
 {
-    uint8_t i;
-    for (i = 0; i < NUM_TIMERS; i++)
+    timer4ClearInterrupt();
+
+    timerAdvance(timerGetTicks());
+    timerProgram();
+}
+
+// Called from main loop, runs callbacks of timers tickIsr found expired.
+// A timer stopped after it expired but before it got here is skipped.
+void timerPoll(void)
+{
+    timerIndex i;
+    timerHandle handle;
+    _callback callback;
+
+    while (timerQueueRead != timerQueueWrite)
     {
-        if (ticks[i] > 0)
+        handle = timerQueue[timerQueueRead & (TIMER_QUEUE_SIZE - 1)];
+        timerQueueRead++;
+
+        callback = NULL;
+        timerLock();
+        if ((i = timerFromHandle(handle)) != TIMER_NIL)
         {
-            ticks[i]--;
-            if (ticks[i] == 0)
-            {
-                if (reload[i])
-                    ticks[i] = period[i];
-                (*fn[i])();
-            }
+            callback = timers[i].fn;
+            timers[i].flags &= ~TIMER_PENDING;
+
+            // One-shot started by handle is done with its entry
+            if ((timers[i].flags & (TIMER_PERIODIC | TIMER_KEEP)) == 0 && timers[i].list == TIMER_IDLE)
+                timerFree(i);
         }
-    }
+        timerUnlock();
 
-    TIMER4_ICR_R = TIMER_ICR_TATOCINT;
+        if (callback != NULL)
+            (*callback)();
+    }
 }
 
 // Placeholder random number function
 uint32_t random32(void)
 {
-    return TIMER4_TAV_R;
+    return (uint32_t)timer4GetCycles();
 }
 
 // Turn off on board Red LED after elapsed time
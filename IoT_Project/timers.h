@@ -16,30 +16,96 @@
 #ifndef TIMERS_H_
 #define TIMERS_H_
 
-#include "timers.h"
+#include <stdint.h>
+#include <stdbool.h>
 
-#define NUM_TIMERS  10
 #define MULT_FACTOR 1000
 
+// Timers are kept in a hierarchical timing wheel (Varghese and Lauck) so
+// starting and stopping one is O(1) and each tick only touches timers that
+// expire or move down a level. The first level has a slot for each of the
+// next 256 ms, every higher level 64 slots each covering a whole turn of
+// the level below, 8 + 4 * 6 = 32 bits of ms in all.
+// tickIsr only queues the timers that expire, their callbacks are run by
+// timerPoll from the main loop so they are free to use data and the SPI bus.
+// Timer 4 counts freely and is not a periodic tick. Its match is set for
+// the next deadline and its wrap every 2^32 clocks extends the count to a
+// 64-bit time base, the wheel catches up to the time when either goes off.
+#ifndef TIMER_MAX
+#define TIMER_MAX         24      // Timers that can exist at once, at most 65534
+#endif
+#define TIMER_WHEEL_BITS  8       // First level slots, 1 ms apart
+#define TIMER_LEVEL_BITS  6       // Slots in each higher level
+#define TIMER_LEVELS      4       // Levels above the first
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_LEVEL_SLOTS (1 << TIMER_LEVEL_BITS)
+#define TIMER_NUM_LISTS   (TIMER_WHEEL_SLOTS + TIMER_LEVELS * TIMER_LEVEL_SLOTS)
+#define TIMER_MAP_WORDS   (TIMER_NUM_LISTS / 32) // One bit per list, set while it has entries
+#define TIMER_CYCLES_PER_MS 40000 // System clock / 1000
+#ifndef TIMER_QUEUE_SIZE
+#define TIMER_QUEUE_SIZE  32      // Expired timers waiting for timerPoll, power of 2 >= TIMER_MAX
+#endif
+#define TIMER_IDLE        0xFFFF  // List of a timer that is not armed
+#define TIMER_INVALID     0       // Handle never given out
+
+#define TIMER_USED        0x01
+#define TIMER_PERIODIC    0x02
+#define TIMER_KEEP        0x04    // One-shot keeps its entry after expiring so it can be restarted
+#define TIMER_PENDING     0x08    // Expired, callback waiting in timerQueue
+
 //extern bool arpResponseRx;
 //extern bool sendMqttPing;
 extern uint32_t leaseTime;
 extern uint8_t dhcpRequestType;
 
 typedef void(*_callback)(void);
-extern _callback fn[NUM_TIMERS];
-extern uint32_t period[NUM_TIMERS];
-extern uint32_t ticks[NUM_TIMERS];
-extern bool reload[NUM_TIMERS];
+
+// Entry index, pools of 256 timers or more need 16 bits for loops over them
+// to end. The handle has the generation above the index, so the handle of a
+// timer that has expired or been stopped no longer matches its entry.
+#if TIMER_MAX > 255
+typedef uint16_t timerIndex;
+typedef uint32_t timerHandle;
+#define TIMER_NIL         0xFFFF  // End of a list
+#define TIMER_INDEX_BITS  16
+#else
+typedef uint8_t timerIndex;
+typedef uint16_t timerHandle;
+#define TIMER_NIL         0xFF    // End of a list
+#define TIMER_INDEX_BITS  8
+#endif
+
+typedef struct _timerEntry
+{
+    _callback fn;
+    uint32_t  expires;    // timerGetTicks() when due
+    uint32_t  period;     // ms
+    uint16_t  list;       // Wheel list holding entry or TIMER_IDLE
+    timerIndex next;      // Next entry in list or free list
+    timerIndex prev;
+    uint8_t   generation;
+    uint8_t   flags;
+} timerEntry;
+
 extern uint8_t dhcpRequestsSent;
 
 void initTimer(void);
+void timerLock(void);
+void timerUnlock(void);
+uint64_t timerGetCycles(void);
+uint64_t timerGetTime(void);
+uint32_t timerGetTicks(void);
+timerHandle timerStart(_callback callback, uint32_t ms, bool periodic);
+bool timerStop(timerHandle handle);
+bool timerRestart(timerHandle handle);
+bool timerIsRunning(timerHandle handle);
 bool startOneShotTimer(_callback callback, uint32_t seconds);
 bool startPeriodicTimer(_callback callback, uint32_t seconds);
 bool stopTimer(_callback callback);
 bool restartTimer(_callback callback);
 void resetAllTimers(void);
 void tickIsr(void);
+void timerPoll(void);
 uint32_t random32(void);
 void clearRedLed(void);
 void clearBlueLed(void);
@@ -59,6 +59,7 @@ extern void tickIsr(void);
 extern void watchdogIsr(void);
 extern void uart0Isr(void);
 extern void rtcIsr(void);
+extern void etherIsr(void);
 
 //*****************************************************************************
 //
@@ -89,7 +90,7 @@ void (* const g_pfnVectors[])(void) =
     IntDefaultHandler,                      // The SysTick handler
     IntDefaultHandler,                      // GPIO Port A
     IntDefaultHandler,                      // GPIO Port B
-    IntDefaultHandler,                      // GPIO Port C
+    etherIsr,                               // GPIO Port C
     IntDefaultHandler,                      // GPIO Port D
     IntDefaultHandler,                      // GPIO Port E
     uart0Isr,                               // UART0 Rx and Tx
@@ -0,0 +1,387 @@
+// topic.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "topic.h"
+#include "uart0.h"
+
+topicNode topicNodes[TOPIC_MAX_NODES];
+char topicArena[TOPIC_ARENA_SIZE + 1]; // Spare byte lets the last level be terminated for printing
+uint16_t topicArenaUsed = 0;
+topicIndex topicFreeList = TOPIC_NONE;
+
+// Empty trie, every node except the root on the free list
+void initTopics(void)
+{
+    topicIndex i;
+
+    memset(topicNodes, 0, sizeof(topicNodes));
+    topicArenaUsed = 0;
+
+    topicFreeList = TOPIC_NONE;
+    for(i = TOPIC_MAX_NODES - 1; i > 0; i--)
+    {
+        topicNodes[i].sibling = topicFreeList;
+        topicFreeList = i;
+    }
+}
+
+// Returns length of the level starting at level (up to '/' or end of string)
+uint8_t topicLevelLength(const char level[])
+{
+    uint8_t length = 0;
+
+    while(level[length] != '/' && level[length] != '\0')
+        length++;
+
+    return length;
+}
+
+// Returns true if node holds the level of given length
+bool topicLevelEquals(topicNode* node, const char level[], uint8_t length)
+{
+    return node->length == length && strncmp(&topicArena[node->start], level, length) == 0;
+}
+
+// Returns true if level is a '+' or '#' wildcard
+bool topicIsWildcard(const char level[], uint8_t length)
+{
+    return length == 1 && (level[0] == '+' || level[0] == '#');
+}
+
+// Returns child of parent holding level, or TOPIC_NONE
+topicIndex topicFindChild(topicIndex parent, const char level[], uint8_t length)
+{
+    topicIndex i = topicNodes[parent].child;
+
+    while(i != TOPIC_NONE && !topicLevelEquals(&topicNodes[i], level, length))
+        i = topicNodes[i].sibling;
+
+    return i;
+}
+
+// Squeeze out characters of freed nodes. Live levels are moved down in
+// order of where they start, so moves never overwrite a level not yet moved.
+void topicCompact(void)
+{
+    topicIndex i, next;
+    uint16_t write = 0;
+
+    while(true)
+    {
+        next = TOPIC_NONE;
+        for(i = 1; i < TOPIC_MAX_NODES; i++)
+        {
+            if(topicNodes[i].length != 0 && topicNodes[i].start >= write &&
+               (next == TOPIC_NONE || topicNodes[i].start < topicNodes[next].start))
+                next = i;
+        }
+
+        if(next == TOPIC_NONE)
+            break;
+
+        memmove(&topicArena[write], &topicArena[topicNodes[next].start], topicNodes[next].length);
+        topicNodes[next].start = write;
+        write += topicNodes[next].length;
+    }
+
+    topicArenaUsed = write;
+}
+
+// Add child of parent holding level. Returns TOPIC_NONE if out of nodes or characters.
+// Wildcards are kept ahead of the other children so topicMatch can stop at
+// the child that equals the level.
+topicIndex topicAddChild(topicIndex parent, const char level[], uint8_t length)
+{
+    topicIndex i, *link;
+
+    if((topicArenaUsed + length) > TOPIC_ARENA_SIZE)
+        topicCompact();
+
+    if(topicFreeList == TOPIC_NONE || (topicArenaUsed + length) > TOPIC_ARENA_SIZE)
+        return TOPIC_NONE;
+
+    i = topicFreeList;
+    topicFreeList = topicNodes[i].sibling;
+
+    memcpy(&topicArena[topicArenaUsed], level, length);
+    topicNodes[i].start   = topicArenaUsed;
+    topicNodes[i].length  = length;
+    topicNodes[i].flags   = 0;
+    topicNodes[i].handler = NULL;
+    topicNodes[i].child   = TOPIC_NONE;
+    topicArenaUsed += length;
+
+    link = &topicNodes[parent].child;
+    if(!topicIsWildcard(level, length))
+    {
+        while(*link != TOPIC_NONE && topicIsWildcard(&topicArena[topicNodes[*link].start], topicNodes[*link].length))
+            link = &topicNodes[*link].sibling;
+    }
+    topicNodes[i].sibling = *link;
+    *link = i;
+
+    return i;
+}
+
+// Returns node for filter, adding levels that are missing. Returns TOPIC_NONE
+// if trie is full. Levels added before running out are left for topicRemove.
+topicIndex topicInsert(const char filter[])
+{
+    topicIndex node = 0, next;
+    uint8_t length, depth = 0;
+
+    while(true)
+    {
+        length = topicLevelLength(filter);
+
+        // Empty levels ("a//b") are legal but can not be stored in the arena
+        if(length == 0 || ++depth > TOPIC_MAX_LEVELS)
+            return TOPIC_NONE;
+
+        if((next = topicFindChild(node, filter, length)) == TOPIC_NONE)
+        {
+            if((next = topicAddChild(node, filter, length)) == TOPIC_NONE)
+                return TOPIC_NONE;
+        }
+        node = next;
+
+        if(filter[length] == '\0')
+            return node;
+
+        filter += length + 1;
+    }
+}
+
+// Returns node for filter, or TOPIC_NONE if it is not in trie
+topicIndex topicFind(const char filter[])
+{
+    topicIndex node = 0;
+    uint8_t length;
+
+    while(true)
+    {
+        length = topicLevelLength(filter);
+
+        if(length == 0 || (node = topicFindChild(node, filter, length)) == TOPIC_NONE)
+            return TOPIC_NONE;
+
+        if(filter[length] == '\0')
+            return node;
+
+        filter += length + 1;
+    }
+}
+
+// Remove levels of filter that no longer lead to a subscription or handler
+void topicRemove(const char filter[])
+{
+    topicIndex path[TOPIC_MAX_LEVELS + 1], node, parent, *link;
+    uint8_t depth = 0, length;
+
+    // Record path from root down to filter, or as far as it was inserted
+    // before the trie ran out
+    path[depth++] = node = 0;
+    while(depth <= TOPIC_MAX_LEVELS)
+    {
+        length = topicLevelLength(filter);
+
+        if(length == 0 || (node = topicFindChild(node, filter, length)) == TOPIC_NONE)
+            break;
+
+        path[depth++] = node;
+
+        if(filter[length] == '\0')
+            break;
+
+        filter += length + 1;
+    }
+
+    // Free unused nodes from the bottom up, characters are reclaimed by topicCompact
+    while(--depth > 0)
+    {
+        node = path[depth];
+        parent = path[depth - 1];
+
+        if(topicNodes[node].flags != 0 || topicNodes[node].handler != NULL || topicNodes[node].child != TOPIC_NONE)
+            break;
+
+        link = &topicNodes[parent].child;
+        while(*link != node)
+            link = &topicNodes[*link].sibling;
+        *link = topicNodes[node].sibling;
+
+        topicNodes[node].length  = 0;
+        topicNodes[node].sibling = topicFreeList;
+        topicFreeList = node;
+    }
+}
+
+// Record a filter subscribed to at the broker. Returns false if trie is full.
+bool topicSubscribe(const char filter[])
+{
+    topicIndex node = topicInsert(filter);
+
+    if(node == TOPIC_NONE)
+    {
+        topicRemove(filter);
+        return false;
+    }
+
+    topicNodes[node].flags |= TOPIC_SUBSCRIBED;
+    return true;
+}
+
+void topicUnsubscribe(const char filter[])
+{
+    topicIndex node = topicFind(filter);
+
+    if(node == TOPIC_NONE)
+        return;
+
+    topicNodes[node].flags &= ~TOPIC_SUBSCRIBED;
+    topicRemove(filter);
+}
+
+// Call handler for topics matching filter, NULL removes it. Returns false if trie is full.
+bool topicRegister(const char filter[], topicHandler handler)
+{
+    topicIndex node = topicInsert(filter);
+
+    if(node == TOPIC_NONE)
+    {
+        topicRemove(filter);
+        return false;
+    }
+
+    topicNodes[node].handler = handler;
+
+    if(handler == NULL)
+        topicRemove(filter);
+
+    return true;
+}
+
+// Run handler of a matched node, returns 1 if it had one
+uint8_t topicCall(topicIndex node, char topic[], char payload[])
+{
+    if(topicNodes[node].handler == NULL)
+        return 0;
+
+    (*topicNodes[node].handler)(topic, payload, node);
+    return 1;
+}
+
+// Match levels of topic starting at level against children of node.
+// Only the exact, '+' and '#' children are followed at each level so the
+// cost grows with the number of levels, not the number of filters.
+uint8_t topicMatch(topicIndex node, const char level[], char topic[], char payload[])
+{
+    topicIndex i, hash;
+    uint8_t length, count = 0;
+    bool last, exact = false;
+
+    length = topicLevelLength(level);
+    last = (level[length] == '\0');
+
+    for(i = topicNodes[node].child; i != TOPIC_NONE; i = topicNodes[i].sibling)
+    {
+        // Wildcards do not match topics starting with '$' (MQTT 3.1.1 Section 4.7.2)
+        if(node == 0 && level[0] == '$' && topicArena[topicNodes[i].start] != '$')
+            continue;
+
+        if(topicLevelEquals(&topicNodes[i], "#", 1))
+        {
+            // Multi-level wildcard matches the rest of the topic
+            count += topicCall(i, topic, payload);
+        }
+        else if(topicLevelEquals(&topicNodes[i], "+", 1) || (exact = topicLevelEquals(&topicNodes[i], level, length)))
+        {
+            if(last)
+            {
+                count += topicCall(i, topic, payload);
+
+                // "a/#" also matches "a"
+                if((hash = topicFindChild(i, "#", 1)) != TOPIC_NONE)
+                    count += topicCall(hash, topic, payload);
+            }
+            else
+            {
+                count += topicMatch(i, &level[length + 1], topic, payload);
+            }
+
+            // Siblings hold different levels and the wildcards come first
+            if(exact)
+                break;
+        }
+    }
+
+    return count;
+}
+
+// Call handlers of every filter topic matches. Returns number of handlers called.
+uint8_t topicDispatch(char topic[], char payload[])
+{
+    if(topic[0] == '\0')
+        return 0;
+
+    return topicMatch(0, topic, topic, payload);
+}
+
+// Print level of node, terminated in place for the time it is sent
+void topicPrintLevel(topicIndex node)
+{
+    uint16_t end = topicNodes[node].start + topicNodes[node].length;
+    char saved = topicArena[end];
+
+    topicArena[end] = '\0';
+    sendUart0String(&topicArena[topicNodes[node].start]);
+    topicArena[end] = saved;
+}
+
+// Print subscribed filters, rebuilding each from the levels above it
+void topicPrint(void)
+{
+    topicIndex path[TOPIC_MAX_LEVELS], node;
+    uint8_t depth = 0, i;
+
+    node = topicNodes[0].child;
+    while(node != TOPIC_NONE)
+    {
+        if(topicNodes[node].flags & TOPIC_SUBSCRIBED)
+        {
+            sendUart0String("    ");
+            for(i = 0; i < depth; i++)
+            {
+                topicPrintLevel(path[i]);
+                sendUart0String("/");
+            }
+            topicPrintLevel(node);
+            sendUart0String("\r\n");
+        }
+
+        // Depth first, down to children then across to siblings
+        if(topicNodes[node].child != TOPIC_NONE && depth < TOPIC_MAX_LEVELS)
+        {
+            path[depth++] = node;
+            node = topicNodes[node].child;
+        }
+        else
+        {
+            while(topicNodes[node].sibling == TOPIC_NONE && depth > 0)
+                node = path[--depth];
+            node = topicNodes[node].sibling;
+        }
+    }
+}
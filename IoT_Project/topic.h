@@ -0,0 +1,67 @@
+// topic.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL Evaluation Board
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef TOPIC_H_
+#define TOPIC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// MQTT topic trie
+// Each node is one topic level ("env", "+", "#"), its characters are kept in
+// a shared arena. Nodes and characters come from fixed pools, freed nodes
+// go on a free list and the arena is compacted when it runs out.
+
+// Pool sizes can be set on the compiler command line, the nodes hold all
+// levels of all filters and the arena their characters (up to 65535)
+#ifndef TOPIC_MAX_NODES
+#define TOPIC_MAX_NODES   64   // Node 0 is the root
+#endif
+#ifndef TOPIC_ARENA_SIZE
+#define TOPIC_ARENA_SIZE  512  // Characters of all levels together
+#endif
+#define TOPIC_MAX_LEVELS  16   // Deepest filter printed by topicPrint
+#define TOPIC_NONE        0    // No child/sibling, root is never either
+
+#define TOPIC_SUBSCRIBED  0x01 // Filter was subscribed to at the broker
+
+// Node index, pools of 256 nodes or more need 16 bits for loops over them to end
+#if TOPIC_MAX_NODES > 255
+typedef uint16_t topicIndex;
+#else
+typedef uint8_t topicIndex;
+#endif
+
+// Called for every filter a received topic matches, node is the filter's node
+typedef void (*topicHandler)(char topic[], char payload[], topicIndex node);
+
+typedef struct _topicNode
+{
+    uint16_t start;      // First character in arena
+    uint8_t  length;     // Characters in level
+    uint8_t  flags;
+    topicIndex child;    // First child node
+    topicIndex sibling;  // Next node with same parent
+    topicHandler handler;
+} topicNode;
+
+void initTopics(void);
+topicIndex topicInsert(const char filter[]);
+topicIndex topicFind(const char filter[]);
+void topicRemove(const char filter[]);
+bool topicSubscribe(const char filter[]);
+void topicUnsubscribe(const char filter[]);
+bool topicRegister(const char filter[], topicHandler handler);
+uint8_t topicDispatch(char topic[], char payload[]);
+void topicPrint(void);
+
+#endif /* TOPIC_H_ */
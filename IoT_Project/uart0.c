@@ -12,12 +12,15 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include <string.h>
 #include "tm4c123gh6pm.h"
 #include "gpio.h"
 #include "uart0.h"
+#include "events.h"
 
-UART0_BUFFER uart0Info = {0};
+// uDMA channel control table, only the primary entry of UART0_DMA_CHANNEL
+// is used. The controller needs it on a 1 KiB boundary.
+#pragma DATA_ALIGN(uart0DmaTable, 1024)
+uint32_t uart0DmaTable[128];
 
 // Initialize UART0
 void initUart0(uint32_t baudRate, uint32_t fcyc)
@@ -41,6 +44,19 @@ void initUart0(uint32_t baudRate, uint32_t fcyc)
 
     // Setup UART0 Baud Rate
     setUart0BaudRate(baudRate, fcyc);
+
+    // uDMA feeds the TX fifo, it asks for 4 bytes at a time once the fifo
+    // is at most half full
+    SYSCTL_RCGCDMA_R |= SYSCTL_RCGCDMA_R0;
+    _delay_cycles(3);
+    UDMA_CFG_R = UDMA_CFG_MASTEN;
+    UDMA_CTLBASE_R = (uint32_t)uart0DmaTable;
+    UDMA_CHMAP1_R &= ~UDMA_CHMAP1_CH9SEL_M;                 // channel 9 is UART0 TX
+    UDMA_PRIOCLR_R = 1 << UART0_DMA_CHANNEL;
+    UDMA_ALTCLR_R = 1 << UART0_DMA_CHANNEL;
+    UDMA_USEBURSTCLR_R = 1 << UART0_DMA_CHANNEL;
+    UDMA_REQMASKCLR_R = 1 << UART0_DMA_CHANNEL;
+    UART0_DMACTL_R = UART_DMACTL_TXDMAE;
 }
 
 // Set baud rate as function of instruction cycle frequency
@@ -53,7 +69,7 @@ void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc)
     UART0_FBRD_R = ((divisorTimes128 + 1) >> 1) & 63;   // set fractional value to round(fract(r)*64)
     UART0_LCRH_R = UART_LCRH_WLEN_8;                    // configure for 8N1 w/ 16-level FIFO
     UART0_CTL_R  = UART_CTL_TXE | UART_CTL_RXE | UART_CTL_UARTEN; // turn-on UART0
-    UART0_IM_R   = UART_IM_TXIM;                        // turn-on TX interrupt
+    UART0_IM_R   = UART_IM_RXIM | UART_IM_RTIM;         // turn-on RX and RX timeout interrupts, uDMA sends
     NVIC_EN0_R   |= 1 << (INT_UART0-16);                // turn-on interrupt 21 (UART0)
 }
 
@@ -70,135 +86,64 @@ char getcUart0(void)
     return UART0_DR_R & 0xFF; // get character from fifo
 }
 
-// Add characters to UART0 TX FIFO
-void sendUart0String(char str[])
+// Clear any pending UART0 interrupts
+void clearUart0Interrupts(void)
 {
-    int i = 0;
-
-    // Write string to Tx Ring Buffer
-    while(str[i] != '\0')
-    {
-        // If NOT full write next Character
-        if(!(fullRingBuffer()))
-        {
-            writeToQueue(str[i]);
-            i++;
-        }
-    }
-
-    UART0_ICR_R = 0x00000FFF;
-
-    // Check to see if UART Tx holding register is empty
-    if(UART0_FR_R & UART_FR_TXFE  && !(emptyRingBuffer()))
-        UART0_DR_R = readFromQueue(); // "Prime Pump" by writing 1st char to Uart0
-}
-
-// Add characters to UART0 TX FIFO
-void sendUart0StringLiteral(const char str[])
-{
-    int i = 0;
-
-    // Write string to Tx Ring Buffer
-    while(str[i] != '\0')
-    {
-        // If NOT full write next Character
-        if(!(fullRingBuffer()))
-        {
-            writeToQueue(str[i]);
-            i++;
-        }
-    }
-
-    UART0_ICR_R = 0x00000FFF;
-
-    // Check to see if UART Tx holding register is empty
-    if(UART0_FR_R & UART_FR_TXFE  && !(emptyRingBuffer()))
-        UART0_DR_R = readFromQueue(); // "Prime Pump" by writing 1st char to Uart0
+    UART0_ICR_R = 0xFFF;
 }
 
-// Update current position of writeIndex variable for Ring Buffer
-void writeToQueue(char c)
+// Keep uart0Isr out while a transfer is started from the main loop
+void uart0Lock(void)
 {
-    uart0Info.uart0String[uart0Info.writeIndex] = c;
-    uart0Info.writeIndex = (uart0Info.writeIndex + 1) % QUEUE_BUFFER_LENGTH;
+    NVIC_DIS0_R = 1 << (INT_UART0-16);
 }
 
-// Update current position of readIndex variable for Ring Buffer
-char readFromQueue(void)
+void uart0Unlock(void)
 {
-    char c;
-    c = uart0Info.uart0String[uart0Info.readIndex];
-    uart0Info.readIndex = (uart0Info.readIndex + 1) % QUEUE_BUFFER_LENGTH;
-    return c;
+    NVIC_EN0_R = 1 << (INT_UART0-16);
 }
 
-// Returns true if ring buffer is EMPTY
-bool emptyRingBuffer(void)
+// Start a transfer of the bytes waiting up to the end of the ring if none is
+// under way, called from uart0Isr or with it locked out
+void uart0TxStart(void)
 {
-    if(uart0Info.writeIndex == uart0Info.readIndex)
-        return true;
-
-    return false;
-}
+    uint16_t start, size;
+    uint32_t* entry = &uart0DmaTable[UART0_DMA_CHANNEL * 4];
 
-// Returns true if ring buffer is FULL
-bool fullRingBuffer(void)
-{
-    if(((uart0Info.writeIndex + 1) % QUEUE_BUFFER_LENGTH) == uart0Info.readIndex)
-        return true;
+    if(uart0Info.dmaSize != 0 || uart0Info.writeIndex == uart0Info.readIndex)
+        return;
 
-    return false;
-}
-
-// Function to Print Main Menu
-void printMainMenu(void)
-{
-    // Output to terminal configuration info
-    displayConnectionInfo();
-
-    sendUart0String("\r\nCommands:\r\n");
-    sendUart0String("  dhcp ON|OFF|REFRESH|RELEASE\r\n");
-    sendUart0String("  set IP|GW|DNS|SN|MQTT w.x.y.z\r\n");
-    sendUart0String("  ifconfig\r\n");
-    sendUart0String("  publish TOPIC DATA\r\n");
-    sendUart0String("  subscribe TOPIC\r\n");
-    sendUart0String("  unsubscribe TOPIC\r\n");
-    sendUart0String("  connect\r\n");
-    sendUart0String("  disconnect\r\n");
-    sendUart0String("  help Inputs\r\n");
-    sendUart0String("  help Outputs\r\n");
-    sendUart0String("  help Subs\r\n");
-    sendUart0String("  reboot\r\n\r\n");
-}
+    start = uart0Info.readIndex & (QUEUE_BUFFER_LENGTH - 1);
+    size = uart0Info.writeIndex - uart0Info.readIndex;
+    if(size > QUEUE_BUFFER_LENGTH - start)
+        size = QUEUE_BUFFER_LENGTH - start;
 
-// Function to Print Help Inputs
-void printHelpInputs(void)
-{
-    sendUart0String("\r\n  Local Input Topics to MQTT Client:\r\n");
-    sendUart0String("    env/pb\r\n");
-    sendUart0String("    env/temp\r\n");
-    sendUart0String("    env/led/green on|off\r\n");
-    sendUart0String("    env/led/red   on|off\r\n");
-    sendUart0String("    env/led/blue  on|off\r\n");
-}
+    // Source and destination are given by their last byte
+    entry[0] = (uint32_t)&uart0Info.uart0String[start + size - 1];
+    entry[1] = (uint32_t)&UART0_DR_R;
+    entry[2] = UDMA_CHCTL_DSTINC_NONE | UDMA_CHCTL_DSTSIZE_8 | UDMA_CHCTL_SRCINC_8 | UDMA_CHCTL_SRCSIZE_8 |
+               UDMA_CHCTL_ARBSIZE_4 | ((uint32_t)(size - 1) << UDMA_CHCTL_XFERSIZE_S) | UDMA_CHCTL_XFERMODE_BASIC;
 
-// Function to Print Help Outputs
-void printHelpOututs(void)
-{
-    sendUart0String("\r\n  Local Output Topics to MQTT Client:\r\n");
-    sendUart0String("    env/uart\r\n");
-    sendUart0String("    env/led/green STATUS\r\n");
-    sendUart0String("    env/led/red   STATUS\r\n");
-    sendUart0String("    env/led/blue  STATUS\r\n");
+    uart0Info.dmaSize = size;
+    UDMA_ENASET_R = 1 << UART0_DMA_CHANNEL;
 }
 
 // Handle UART0 Interrupts
 void uart0Isr(void)
 {
+    // Characters are read by the main loop, wake it
+    if(UART0_MIS_R & (UART_MIS_RXMIS | UART_MIS_RTMIS))
+        eventSet(EVENT_UART);
+
     // Writing a 1 to the bits in this register clears the bits in the UARTRIS and UARTMIS registers
     UART0_ICR_R = 0xFFF;
 
-    // Check to see if UART Tx holding register is empty and send next byte of data
-    if((UART0_FR_R & UART_FR_TXFE) && !(emptyRingBuffer()))
-        UART0_DR_R = readFromQueue();
+    // Transfer done, its bytes are free and the next one can start
+    if(UDMA_CHIS_R & (1 << UART0_DMA_CHANNEL))
+    {
+        UDMA_CHIS_R = 1 << UART0_DMA_CHANNEL;
+        uart0Info.readIndex += uart0Info.dmaSize;
+        uart0Info.dmaSize = 0;
+        uart0TxStart();
+    }
 }
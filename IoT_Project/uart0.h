@@ -22,7 +22,17 @@
 //
 #define UART0_TX PORTA,1
 #define UART0_RX PORTA,0
-#define QUEUE_BUFFER_LENGTH 80
+
+// Transmit ring, sent by uDMA channel 9 straight from the ring to the UART
+// data register. Each transfer covers the bytes up to the end of the ring,
+// its completion interrupt on the UART0 vector starts the next one.
+// A message either waits for room (console output) or is dropped whole if
+// it does not fit (output made while handling network traffic).
+#define QUEUE_BUFFER_LENGTH 1024    // Power of 2, at most 1024 (one uDMA transfer)
+#define UART0_FORMAT_SIZE   128     // Longest message printfUart0 makes
+#define UART0_DMA_CHANNEL   9       // UART0 TX, encoding 0
+#define UART0_BLOCK         0       // Wait for room in the ring
+#define UART0_DROP          1       // Drop message if the ring is too full
 
 //
 // Structure Definition
@@ -30,23 +40,30 @@
 typedef struct _UART0_BUFFER
 {
     char uart0String[QUEUE_BUFFER_LENGTH];
-    uint8_t writeIndex;
-    uint8_t readIndex;
+    volatile uint16_t writeIndex;   // Free running, masked to index the ring
+    volatile uint16_t readIndex;    // Advanced when a transfer completes
+    volatile uint16_t dmaSize;      // Bytes in the transfer under way, 0 if idle
 } UART0_BUFFER;
 
 extern UART0_BUFFER uart0Info;
+extern uint32_t uart0DroppedBytes;
+extern uint32_t uart0DroppedMessages;
 
 //
 // Subroutines
 //
 void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc);
-void writeToQueue(char c);
+void uart0Lock(void);
+void uart0Unlock(void);
+void uart0TxStart(void);
+uint16_t uart0TxSpace(void);
+bool uart0Write(const char str[], uint16_t size, uint8_t policy);
+void printfUart0(uint8_t policy, const char fmt[], ...);
+void printUart0Stats(void);
 bool kbhitUart0(void);
 char getcUart0(void);
+void clearUart0Interrupts(void);
 void initUart0(uint32_t baudRate, uint32_t fcyc);
-char readFromQueue(void);
-bool emptyRingBuffer(void);
-bool fullRingBuffer(void);
 void printMainMenu(void);
 void printHelpInputs(void);
 void printHelpOututs(void);
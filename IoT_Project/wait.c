@@ -12,6 +12,7 @@
 // Device includes, defines, and assembler directives
 //-----------------------------------------------------------------------------
 
+#include "tm4c123gh6pm.h"
 #include "wait.h"
 
 //-----------------------------------------------------------------------------
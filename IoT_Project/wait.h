@@ -9,7 +9,7 @@
 #define WAIT_H_
 
 #include <stdint.h>
-#include "tm4c123gh6pm.h"
+#include <stdint.h>
 
 void waitMicrosecond(uint32_t us);
 
@@ -0,0 +1,79 @@
+// checksumbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Times checksumAdd against the byte at a time sum it replaced, for the
+// frame sizes the stack sends and receives, at even and odd addresses.
+// Host times only rank the two, count cycles on the target for its numbers.
+// Usage: checksumbench [RUNS], 100000 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "checksum.h"
+
+uint8_t buffer[1600];
+volatile uint32_t sink;
+
+// Same as the old etherSumWords, first byte of each pair low
+uint32_t byteAdd(uint32_t sum, const uint8_t data[], uint16_t size)
+{
+    uint16_t i;
+
+    for (i = 0; i < size; i++)
+        sum += (i & 1) ? data[i] << 8 : data[i];
+
+    return sum;
+}
+
+double nsPerCall(bool words, uint16_t offset, uint16_t size, uint32_t runs)
+{
+    struct timespec start, end;
+    uint32_t i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < runs; i++)
+    {
+        if (words)
+            sink += checksumAdd(i, buffer + offset, size);
+        else
+            sink += byteAdd(i, buffer + offset, size);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / runs;
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t sizes[] = {20, 40, 64, 590, 1460};
+    uint32_t runs = 100000;
+    double bytes, words;
+    uint16_t i, offset;
+
+    if (argc > 1)
+        runs = strtoul(argv[1], NULL, 0);
+    for (i = 0; i < sizeof(buffer); i++)
+        buffer[i] = rand();
+
+    printf("%6s %6s %10s %10s %8s\n", "Size", "Offset", "Bytes ns", "Words ns", "Speedup");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        for (offset = 0; offset < 2; offset++)
+        {
+            bytes = nsPerCall(false, offset, sizes[i], runs);
+            words = nsPerCall(true, offset, sizes[i], runs);
+            printf("%6u %6u %10.1f %10.1f %8.2f\n", sizes[i], offset, bytes, words, bytes / words);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+// eeprom.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   IoT_Project/eeprom.c
+
+// The 2 KB EEPROM is kept in the file named by IOT_EEPROM (eeprom.bin by
+// default). Words never written read as erased (0xFFFFFFFF), and each write
+// goes to the file straight away so settings survive a restart.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "eeprom.h"
+
+#define EEPROM_WORDS 512
+
+uint32_t eepromWords[EEPROM_WORDS];
+FILE* eepromFile = NULL;
+
+void initEeprom(void)
+{
+    const char* name = getenv("IOT_EEPROM");
+    uint16_t i;
+
+    for (i = 0; i < EEPROM_WORDS; i++)
+        eepromWords[i] = 0xFFFFFFFF;
+
+    if (name == NULL)
+        name = "eeprom.bin";
+    if ((eepromFile = fopen(name, "r+b")) == NULL)
+        eepromFile = fopen(name, "w+b");
+    if (eepromFile == NULL)
+    {
+        perror(name);
+        return;
+    }
+
+    fread(eepromWords, sizeof(uint32_t), EEPROM_WORDS, eepromFile);
+}
+
+void writeEeprom(uint16_t add, uint32_t data)
+{
+    if (add >= EEPROM_WORDS)
+        return;
+
+    eepromWords[add] = data;
+    if (eepromFile != NULL)
+    {
+        fseek(eepromFile, 0, SEEK_SET);
+        fwrite(eepromWords, sizeof(uint32_t), EEPROM_WORDS, eepromFile);
+        fflush(eepromFile);
+    }
+}
+
+uint32_t readEeprom(uint16_t add)
+{
+    if (add >= EEPROM_WORDS)
+        return 0xFFFFFFFF;
+
+    return eepromWords[add];
+}
+
+void waitEeprom(void)
+{
+}
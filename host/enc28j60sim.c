@@ -0,0 +1,444 @@
+// enc28j60sim.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   ENC28J60 on SPI0
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "host.h"
+#include "gpio.h"
+#include "ethernet.h"
+#include "enc28j60.h"
+#include "enc28j60sim.h"
+
+// Registers and bits the driver leaves to their reset values
+#define SIM_AUTOINC       0x80    // ECON2
+#define SIM_BSEL          0x03    // ECON1
+#define SIM_RSV_SIZE      6       // Next pointer, byte count and status ahead of each frame
+#define SIM_TSV_SIZE      7       // Status vector written after a sent frame
+#define SIM_CRC_SIZE      4
+#define SIM_MIN_FRAME     60
+#define SIM_WIRE_BYTE_NS  800     // 10 Mb/s
+#define SIM_WIRE_OVERHEAD 24      // Preamble, CRC and inter-frame gap bytes
+
+// Transaction states, set by the command byte after CS falls
+typedef enum _simState
+{
+    SIM_COMMAND,
+    SIM_READ_REG,
+    SIM_WRITE_REG,
+    SIM_SET_BITS,
+    SIM_CLEAR_BITS,
+    SIM_READ_MEM,
+    SIM_WRITE_MEM,
+    SIM_IGNORE
+} simState;
+
+enc28j60SimStats enc28j60Sim;
+
+uint8_t simRegs[4][32];           // Common registers 0x1B-0x1F are kept in bank 0
+uint16_t simPhy[32];
+uint8_t simMemory[ENC28J60SIM_MEMORY];
+simState simBusState = SIM_COMMAND;
+uint8_t simAddress = 0;           // Register of the transaction under way
+bool simSelected = false;
+enc28j60SimWire simWire = NULL;
+uint32_t simSpiByteNs = 0;        // SPI byte time, 0 if frames are sent at once
+uint64_t simTime = 0;             // ns, advanced by SPI bytes and enc28j60SimElapse
+uint64_t simTxDone = 0;           // End of the frame on the wire while TXRTS is set
+enc28j60SimSource simSource = NULL;
+
+// Register by its 7-bit driver address (bank in bits 5-6), the bank is
+// ignored for the common registers
+uint8_t* simReg(uint8_t reg)
+{
+    if ((reg & 0x1F) >= EIE)
+        return &simRegs[0][reg & 0x1F];
+
+    return &simRegs[(reg >> 5) & 0x03][reg & 0x1F];
+}
+
+// Register the bank selected in ECON1 maps a 5-bit SPI address to, common
+// registers are given by their bank 0 address so side effects see them
+uint8_t simBanked(uint8_t address)
+{
+    if ((address & 0x1F) >= EIE)
+        return address & 0x1F;
+
+    return ((*simReg(ECON1) & SIM_BSEL) << 5) | (address & 0x1F);
+}
+
+uint16_t simGet16(uint8_t low)
+{
+    return *simReg(low) | (*simReg(low + 1) << 8);
+}
+
+void simSet16(uint8_t low, uint16_t value)
+{
+    *simReg(low) = value & 0xFF;
+    *simReg(low + 1) = value >> 8;
+}
+
+// Next address in the rx fifo, which wraps from ERXND to ERXST
+uint16_t simRxNext(uint16_t address)
+{
+    if (address == simGet16(ERXNDL))
+        return simGet16(ERXSTL);
+
+    return (address + 1) & (ENC28J60SIM_MEMORY - 1);
+}
+
+// Sends the frame from ETXST to ETXND and appends the status vector
+void simTransmit(void)
+{
+    uint16_t start = simGet16(ETXSTL), end = simGet16(ETXNDL);
+    uint8_t frame[MAX_PACKET_SIZE];
+    uint16_t size = 0, i;
+
+    // Skip the per-packet control byte, MACON3 settings apply
+    for (i = start + 1; i <= end && size < sizeof(frame); i++)
+        frame[size++] = simMemory[i & (ENC28J60SIM_MEMORY - 1)];
+    if ((*simReg(MACON3) & PAD60) != 0)
+        while (size < SIM_MIN_FRAME)
+            frame[size++] = 0;
+
+    memset(&simMemory[(end + 1) & (ENC28J60SIM_MEMORY - 1)], 0, SIM_TSV_SIZE);
+    simMemory[(end + 1) & (ENC28J60SIM_MEMORY - 1)] = size & 0xFF;
+    simMemory[(end + 2) & (ENC28J60SIM_MEMORY - 1)] = size >> 8;
+
+    enc28j60Sim.transmitted++;
+    if (simWire != NULL)
+        simWire(frame, size);
+
+    *simReg(ECON1) &= ~TXRTS;
+    *simReg(ESTAT) &= ~TXABORT;
+    *simReg(EIR) |= TXIF;
+}
+
+// Keeps TXRTS set for the frame's time on the wire if timing is on
+void simTransmitStart(void)
+{
+    uint16_t size = simGet16(ETXNDL) - simGet16(ETXSTL);
+
+    if (simSpiByteNs == 0)
+    {
+        simTransmit();
+        return;
+    }
+
+    if (size < SIM_MIN_FRAME)
+        size = SIM_MIN_FRAME;
+    simTxDone = simTime + (uint64_t)(size + SIM_WIRE_OVERHEAD) * SIM_WIRE_BYTE_NS;
+}
+
+// Advances the clock and ends the frame on the wire once its time is up
+void simElapse(uint64_t ns)
+{
+    simTime += ns;
+    if (simTxDone != 0 && simTime >= simTxDone)
+    {
+        simTxDone = 0;
+        simTransmit();
+    }
+    if (simSource != NULL && ns != 0)
+        simSource(simTime);
+}
+
+// Side effects of writing a register, old is its value before the write
+void simWritten(uint8_t reg, uint8_t old)
+{
+    uint8_t value = *simReg(reg);
+
+    switch (reg)
+    {
+        case ECON1:
+            if (((old ^ value) & SIM_BSEL) != 0)
+                enc28j60Sim.bankSwitches++;
+            if ((value & TXRST) != 0)
+            {
+                *simReg(ECON1) &= ~TXRTS;
+                simTxDone = 0;
+            }
+            else if ((value & TXRTS) != 0 && (old & TXRTS) == 0)
+                simTransmitStart();
+            break;
+        case ECON2:
+            if ((value & PKTDEC) != 0)
+            {
+                if (*simReg(EPKTCNT) != 0)
+                    (*simReg(EPKTCNT))--;
+                *simReg(ECON2) &= ~PKTDEC;
+            }
+            break;
+        case MICMD:
+            if ((value & MIIRD) != 0)
+            {
+                *simReg(MIRDL) = simPhy[*simReg(MIREGADR) & 0x1F] & 0xFF;
+                *simReg(MIRDH) = simPhy[*simReg(MIREGADR) & 0x1F] >> 8;
+            }
+            break;
+        case MIWRH:
+            simPhy[*simReg(MIREGADR) & 0x1F] = *simReg(MIWRL) | (value << 8);
+            break;
+        case ERDPTL:
+        case ERDPTH:
+        case EWRPTL:
+        case EWRPTH:
+            simSet16(reg & ~1, simGet16(reg & ~1) & (ENC28J60SIM_MEMORY - 1));
+            break;
+    }
+}
+
+// Power on state, the parts of it the driver depends on
+void simReset(void)
+{
+    memset(simRegs, 0, sizeof(simRegs));
+    memset(simPhy, 0, sizeof(simPhy));
+    *simReg(ESTAT) = CLKRDY;
+    *simReg(ECON2) = SIM_AUTOINC;
+    simSet16(ERXNDL, 0x1FFF);
+    simSet16(ERDPTL, 0x05FA);
+    simPhy[PHSTAT1] = LSTAT;
+    simBusState = SIM_COMMAND;
+}
+
+// Exchanges one byte with the chip, called by host/spi.c for each frame
+uint8_t simSpi(uint8_t data)
+{
+    uint8_t reply = 0xFF, old;
+    uint16_t pointer;
+
+    simElapse(simSpiByteNs);
+    if (!simSelected)
+        return reply;
+
+    enc28j60Sim.bytes++;
+    switch (simBusState)
+    {
+        case SIM_COMMAND:
+            simAddress = simBanked(data);
+            switch (data >> 5)
+            {
+                case 0: simBusState = SIM_READ_REG; break;
+                case 2: simBusState = SIM_WRITE_REG; break;
+                case 4: simBusState = SIM_SET_BITS; break;
+                case 5: simBusState = SIM_CLEAR_BITS; break;
+                case 1: simBusState = SIM_READ_MEM; break;
+                case 3: simBusState = SIM_WRITE_MEM; break;
+                default:
+                    simReset();
+                    simBusState = SIM_IGNORE;
+                    break;
+            }
+            break;
+        case SIM_READ_REG:
+            reply = *simReg(simAddress);
+            if (simAddress == EIR && *simReg(EPKTCNT) != 0)
+                reply |= PKTIF;
+            simBusState = SIM_IGNORE;
+            break;
+        case SIM_WRITE_REG:
+        case SIM_SET_BITS:
+        case SIM_CLEAR_BITS:
+            old = *simReg(simAddress);
+            if (simBusState == SIM_WRITE_REG)
+                *simReg(simAddress) = data;
+            else if (simBusState == SIM_SET_BITS)
+                *simReg(simAddress) |= data;
+            else
+                *simReg(simAddress) &= ~data;
+            simWritten(simAddress, old);
+            simBusState = SIM_IGNORE;
+            break;
+        case SIM_READ_MEM:
+            pointer = simGet16(ERDPTL);
+            reply = simMemory[pointer];
+            if ((*simReg(ECON2) & SIM_AUTOINC) != 0)
+                simSet16(ERDPTL, simRxNext(pointer));
+            break;
+        case SIM_WRITE_MEM:
+            pointer = simGet16(EWRPTL);
+            simMemory[pointer] = data;
+            if ((*simReg(ECON2) & SIM_AUTOINC) != 0)
+                simSet16(EWRPTL, (pointer + 1) & (ENC28J60SIM_MEMORY - 1));
+            break;
+        case SIM_IGNORE:
+            break;
+    }
+
+    return reply;
+}
+
+// CS is PORTA,3, each falling edge starts a transaction
+void simPin(PORT port, uint8_t pin, bool value)
+{
+    if (port != PORTA || pin != 3)
+        return;
+
+    if (!value && !simSelected)
+    {
+        enc28j60Sim.selects++;
+        simBusState = SIM_COMMAND;
+    }
+    simSelected = !value;
+}
+
+// INT is PORTC,6, the driver masks it with the pin interrupt enable
+bool simIntAsserted(void)
+{
+    return gpioInterruptEnabled(PORTC, 6) && enc28j60SimInterrupt();
+}
+
+// Takes over the SPI0 bus and CS pin and raises etherIsr on INT, wire is
+// called with each frame sent
+void initEnc28j60Sim(enc28j60SimWire wire)
+{
+    simReset();
+    memset(simMemory, 0, sizeof(simMemory));
+    simSelected = false;
+    simWire = wire;
+    simSpiByteNs = 0;
+    simTime = simTxDone = 0;
+    simSource = NULL;
+    spiDevice = simSpi;
+    gpioHook = simPin;
+    hostRemoveSource(etherIsr);
+    hostAddSource(-1, simIntAsserted, etherIsr);
+    enc28j60SimClearStats();
+}
+
+void enc28j60SimClearStats(void)
+{
+    memset(&enc28j60Sim, 0, sizeof(enc28j60Sim));
+}
+
+// True if the frame passes the ERXFCON filter for the address in MAADR
+bool simAccept(const uint8_t frame[])
+{
+    static const uint8_t maadr[HW_ADD_LENGTH] = {MAADR5, MAADR4, MAADR3, MAADR2, MAADR1, MAADR0};
+    uint8_t filter = *simReg(ERXFCON);
+    uint8_t i;
+    bool unicast = true, broadcast = true;
+
+    for (i = 0; i < HW_ADD_LENGTH; i++)
+    {
+        if (frame[i] != *simReg(maadr[i]))
+            unicast = false;
+        if (frame[i] != 0xFF)
+            broadcast = false;
+    }
+
+    if (unicast)
+        return (filter & ETHER_UNICAST) != 0;
+    if (broadcast)
+        return (filter & ETHER_BROADCAST) != 0;
+    if (frame[0] & 1)
+        return (filter & ETHER_MULTICAST) != 0;
+
+    return false;
+}
+
+// Frame arriving from the wire, written to the rx fifo behind its receive
+// status vector. Returns false if it was filtered out or did not fit.
+bool enc28j60SimReceive(const uint8_t frame[], uint16_t size)
+{
+    uint16_t start = simGet16(ERXSTL), end = simGet16(ERXNDL);
+    uint16_t write = simGet16(ERXWRPTL), read = simGet16(ERXRDPTL);
+    uint16_t space, total, next, count, i;
+    uint8_t header[SIM_RSV_SIZE];
+
+    if ((*simReg(ECON1) & RXEN) == 0 || size < 14 || !simAccept(frame))
+    {
+        enc28j60Sim.dropped++;
+        return false;
+    }
+
+    // Frames are stored from an even address, the byte count includes the CRC
+    count = size + SIM_CRC_SIZE;
+    total = SIM_RSV_SIZE + count;
+    if (write > read)
+        space = (end - start) - (write - read);
+    else if (write == read)
+        space = end - start;
+    else
+        space = read - write - 1;
+    if (total + 1 > space)
+    {
+        *simReg(EIR) |= RXERIF;
+        enc28j60Sim.dropped++;
+        return false;
+    }
+
+    next = write;
+    for (i = 0; i < total + (total & 1); i++)
+        next = simRxNext(next);
+
+    header[0] = next & 0xFF;
+    header[1] = next >> 8;
+    header[2] = count & 0xFF;
+    header[3] = count >> 8;
+    header[4] = RSV_RX_OK;
+    header[5] = 0;
+
+    for (i = 0; i < SIM_RSV_SIZE; i++, write = simRxNext(write))
+        simMemory[write] = header[i];
+    for (i = 0; i < size; i++, write = simRxNext(write))
+        simMemory[write] = frame[i];
+    for (i = 0; i < SIM_CRC_SIZE; i++, write = simRxNext(write))
+        simMemory[write] = 0;
+
+    simSet16(ERXWRPTL, next);
+    (*simReg(EPKTCNT))++;
+    enc28j60Sim.received++;
+
+    return true;
+}
+
+// INT pin, asserted while an enabled flag is set and INTIE is on
+bool enc28j60SimInterrupt(void)
+{
+    uint8_t flags = *simReg(EIR);
+
+    if (*simReg(EPKTCNT) != 0)
+        flags |= PKTIF;
+
+    return (*simReg(EIE) & INTIE) != 0 && (flags & *simReg(EIE) & ~INTIE) != 0;
+}
+
+// Frames take their time on a 10 Mb/s wire, TXRTS staying set meanwhile, on a
+// clock each SPI byte advances at this bit rate. 0 sends frames at once.
+void enc28j60SimTiming(uint32_t spiBitRate)
+{
+    simSpiByteNs = (spiBitRate == 0) ? 0 : 8000000000ULL / spiBitRate;
+}
+
+// Called with the time each time the clock moves, to put the frames due by
+// then on the wire, so they find the rx fifo as it is at that SPI byte
+void enc28j60SimArrivals(enc28j60SimSource source)
+{
+    simSource = source;
+}
+
+// Time the firmware spends away from the SPI bus
+void enc28j60SimElapse(uint32_t ns)
+{
+    simElapse(ns);
+}
+
+// ns since initEnc28j60Sim on the enc28j60SimTiming clock
+uint64_t enc28j60SimTime(void)
+{
+    return simTime;
+}
+
+uint8_t enc28j60SimPacketCount(void)
+{
+    return *simReg(EPKTCNT);
+}
@@ -0,0 +1,59 @@
+// enc28j60sim.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   ENC28J60 on SPI0
+
+#ifndef ENC28J60SIM_H_
+#define ENC28J60SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Register level model of the ENC28J60, so the driver in enc28j60.c runs
+// on the host unchanged over host/spi.c
+// It keeps the four register banks, the PHY registers, the 8K buffer memory
+// and its rx and tx pointers, and follows the SPI commands the driver uses
+// (RCR, WCR, RBM, WBM, BFS, BFC, SRC). Frames are given to it as if from
+// the wire and those it transmits are passed to a callback. Operations
+// complete at once, MISTAT BUSY is never set and TXRTS clears as soon as
+// it is set, unless enc28j60SimTiming keeps it set for the frame's time
+// on the wire. INT raises etherIsr from hostPoll while the PC6 interrupt is
+// enabled.
+// Registers read in the byte after the command, without the dummy byte the
+// chip puts before MAC and MII registers, as the driver expects.
+
+#define ENC28J60SIM_MEMORY  0x2000
+
+typedef void (*enc28j60SimWire)(const uint8_t frame[], uint16_t size);
+typedef void (*enc28j60SimSource)(uint64_t ns);
+
+// Bus traffic since initEnc28j60Sim or the last enc28j60SimClearStats
+typedef struct _enc28j60SimStats
+{
+    uint32_t bytes;         // SPI bytes exchanged with CS low
+    uint32_t selects;       // CS falling edges, one per transaction
+    uint32_t bankSwitches;  // ECON1 writes that changed BSEL
+    uint32_t received;      // Frames written to the rx fifo
+    uint32_t dropped;       // Frames filtered out or lost to a full fifo
+    uint32_t transmitted;   // Frames sent by TXRTS
+} enc28j60SimStats;
+
+extern enc28j60SimStats enc28j60Sim;
+
+void initEnc28j60Sim(enc28j60SimWire wire);
+void enc28j60SimClearStats(void);
+bool enc28j60SimReceive(const uint8_t frame[], uint16_t size);
+bool enc28j60SimInterrupt(void);
+uint8_t enc28j60SimPacketCount(void);
+void enc28j60SimTiming(uint32_t spiBitRate);
+void enc28j60SimArrivals(enc28j60SimSource source);
+void enc28j60SimElapse(uint32_t ns);
+uint64_t enc28j60SimTime(void);
+
+#endif /* ENC28J60SIM_H_ */
@@ -0,0 +1,124 @@
+// encbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Counts the SPI traffic of each ENC28J60 driver operation against the
+// model in host/enc28j60sim.c, and the time it takes on the wire at the
+// SPI clock the target would get from the SSI0 prescaler.
+// Usage: encbench [SPI_CLOCK_HZ], 4 MHz if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "spi.h"
+#include "ethernet.h"
+#include "enc28j60.h"
+#include "enc28j60sim.h"
+
+#define FCYC 40000000
+
+uint8_t mac[HW_ADD_LENGTH];
+uint8_t frame[MAX_PACKET_SIZE];
+
+void start(void)
+{
+    enc28j60SimClearStats();
+    spi0Bytes = 0;
+}
+
+void report(const char name[])
+{
+    uint32_t wireTime = ((uint64_t)spi0Bytes * 8 * 1000000) / spi0BitRate;
+
+    printf("%-28s %6u %6u %6u %8u\n", name, enc28j60Sim.bytes, enc28j60Sim.selects,
+           enc28j60Sim.bankSwitches, wireTime);
+}
+
+void discard(const uint8_t frame[], uint16_t size)
+{
+}
+
+void receive(const char name[], uint16_t size)
+{
+    memcpy(frame, mac, HW_ADD_LENGTH);
+    memset(frame + HW_ADD_LENGTH, 0x02, size - HW_ADD_LENGTH);
+    enc28j60SimReceive(frame, size);
+
+    start();
+    etherIsr();
+    etherFreeRxBuffer();
+    report(name);
+}
+
+void transmit(const char name[], uint16_t size)
+{
+    memcpy(frame, mac, HW_ADD_LENGTH);
+    memset(frame + HW_ADD_LENGTH, 0x02, size - HW_ADD_LENGTH);
+
+    start();
+    etherPutPacket(frame, size);
+    etherIsr();
+    report(name);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t clock = 4000000;
+
+    if (argc > 1)
+        clock = strtoul(argv[1], NULL, 0);
+
+    initEnc28j60Sim(discard);
+    initSpi0(USE_SSI0_RX, clock, FCYC);
+    printf("SPI clock %u Hz (%u Hz asked)\n\n", spi0BitRate, clock);
+    printf("%-28s %6s %6s %6s %8s\n", "Operation", "Bytes", "CS", "Banks", "Wire us");
+
+    start();
+    etherInit(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
+    report("etherInit");
+    etherGetMacAddress(mac);
+
+    start();
+    etherReadReg(EIR);
+    report("etherReadReg");
+
+    etherSetBank(ERXFCON);
+    start();
+    etherSetBank(ERXFCON);
+    report("etherSetBank, same bank");
+
+    start();
+    etherSetBank(MACON3);
+    report("etherSetBank, bank 1 to 2");
+
+    start();
+    etherSetBank(ERXSTL);
+    report("etherSetBank, bank 2 to 0");
+
+    start();
+    etherReadPhy(PHSTAT1);
+    report("etherReadPhy");
+
+    start();
+    etherIsLinkUp();
+    report("etherIsLinkUp");
+
+    receive("rx 64 bytes", 64);
+    receive("rx 590 bytes", 590);
+    receive("rx 1518 bytes", 1518);
+
+    transmit("tx 60 bytes", 60);
+    transmit("tx 590 bytes", 590);
+    transmit("tx 1514 bytes", 1514);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+// events.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   IoT_Project/events.c
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <poll.h>
+#include "host.h"
+#include "events.h"
+#include "timers.h"
+#include "uart0.h"
+
+typedef struct _hostSource
+{
+    int      fd;
+    hostGate gate;
+    hostIsr  isr;
+} hostSource;
+
+hostSource hostSources[HOST_MAX_SOURCES];
+uint8_t hostSourceCount = 0;
+
+volatile uint8_t eventFlags = 0;
+
+// Idle counters, shown and cleared by eventPrintStats
+uint64_t eventSleepCycles = 0;
+uint64_t eventStatsStart = 0;
+uint32_t eventWakeups = 0;
+
+void hostAddSource(int fd, hostGate gate, hostIsr isr)
+{
+    if (hostSourceCount < HOST_MAX_SOURCES)
+    {
+        hostSources[hostSourceCount].fd = fd;
+        hostSources[hostSourceCount].gate = gate;
+        hostSources[hostSourceCount].isr = isr;
+        hostSourceCount++;
+    }
+}
+
+void hostRemoveSource(hostIsr isr)
+{
+    uint8_t i;
+
+    for (i = 0; i < hostSourceCount; i++)
+    {
+        if (hostSources[i].isr == isr)
+        {
+            hostSources[i] = hostSources[--hostSourceCount];
+            return;
+        }
+    }
+}
+
+// Wait up to timeoutMs (-1 for ever) for a source or the Timer 4 match,
+// then run the isr of each that is ready
+void hostPoll(int32_t timeoutMs)
+{
+    struct pollfd fds[HOST_MAX_SOURCES];
+    hostIsr ready[HOST_MAX_SOURCES];
+    uint8_t i, j, count = 0, readyCount = 0;
+
+    for (i = 0; i < hostSourceCount; i++)
+    {
+        if (hostSources[i].gate != NULL && !hostSources[i].gate())
+            continue;
+        if (hostSources[i].fd < 0)
+        {
+            ready[readyCount++] = hostSources[i].isr;
+            continue;
+        }
+        fds[count].fd = hostSources[i].fd;
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+        count++;
+    }
+
+    if (readyCount != 0 || timer4Pending())
+        timeoutMs = 0;
+
+    if (poll(fds, count, timeoutMs) > 0)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (fds[i].revents == 0)
+                continue;
+            for (j = 0; j < hostSourceCount; j++)
+                if (hostSources[j].fd == fds[i].fd)
+                    ready[readyCount++] = hostSources[j].isr;
+        }
+    }
+
+    if (timer4Pending())
+        tickIsr();
+
+    for (i = 0; i < readyCount; i++)
+        ready[i]();
+}
+
+// Called from interrupts, the main loop only clears flags with them masked
+void eventSet(uint8_t events)
+{
+    eventFlags |= events;
+}
+
+// Return the events since the last call without sleeping
+uint8_t eventTake(void)
+{
+    uint8_t events;
+
+    hostPoll(0);
+    events = eventFlags;
+    eventFlags = 0;
+
+    return events;
+}
+
+// Sleep until a source sets an event or the next timer deadline, unless one
+// already has, and return the events since the last call
+uint8_t eventWait(void)
+{
+    uint8_t events;
+    uint64_t start;
+
+    if (eventFlags == 0)
+    {
+        start = timerGetCycles();
+        hostPoll(timer4Timeout());
+        eventSleepCycles += timerGetCycles() - start;
+        eventWakeups++;
+    }
+    events = eventFlags;
+    eventFlags = 0;
+
+    return events;
+}
+
+void eventPrintStats(void)
+{
+    uint64_t now = timerGetCycles();
+    uint64_t total = now - eventStatsStart;
+    uint32_t percent = 0;
+
+    if (total != 0)
+        percent = (eventSleepCycles * 100) / total;
+
+    printfUart0(UART0_BLOCK, "  Asleep:  %lu ms (%lu%%)\r\n", (unsigned long)(eventSleepCycles / TIMER_CYCLES_PER_MS), (unsigned long)percent);
+    printfUart0(UART0_BLOCK, "  Busy:    %lu ms\r\n", (unsigned long)((total - eventSleepCycles) / TIMER_CYCLES_PER_MS));
+    printfUart0(UART0_BLOCK, "  Wakeups: %lu\r\n", (unsigned long)eventWakeups);
+
+    eventSleepCycles = 0;
+    eventWakeups = 0;
+    eventStatsStart = now;
+}
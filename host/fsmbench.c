@@ -0,0 +1,119 @@
+// fsmbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Times tcpLookup and dhcpLookup against the linear scans of the transition
+// arrays they replaced, over every state and event in turn.
+// Host times only rank the two, count cycles on the target for its numbers.
+// Usage: fsmbench [RUNS], 100000 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "tcp.h"
+#include "dhcp.h"
+
+volatile uintptr_t sink;
+
+// Same as the old tcpLookup, a miss restarts the connection
+_tcpCallback tcpScan(tcpSysState state, tcpSysEvent event)
+{
+    uint8_t i;
+
+    for (i = 0; i < tcpStateTransitionCount; i++)
+    {
+        if (tcpStateTransitions[i].state == state && tcpStateTransitions[i].event == event)
+            return tcpStateTransitions[i].eventHandler;
+    }
+
+    return (_tcpCallback)setUpTcb;
+}
+
+// Same as the old dhcpLookup, a miss gave NULL
+_dhcpCallback dhcpScan(dhcpSysState state, dhcpSysEvent event)
+{
+    uint8_t i;
+
+    for (i = 0; i < stateTransitionCount; i++)
+    {
+        if (stateTransitions[i].state == state && stateTransitions[i].event == event)
+            return stateTransitions[i].eventHandler;
+    }
+
+    return NULL;
+}
+
+double seconds(const struct timespec* start, const struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+double nsPerTcp(bool table, uint32_t runs)
+{
+    struct timespec start, end;
+    uint32_t i;
+    uint8_t state, event;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < runs; i++)
+    {
+        for (state = 0; state < TCP_NUM_STATES; state++)
+        {
+            for (event = 0; event < 32; event++)
+                sink += (uintptr_t)(table ? tcpLookup(state, event) : tcpScan(state, event));
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return seconds(&start, &end) * 1e9 / ((double)runs * TCP_NUM_STATES * 32);
+}
+
+double nsPerDhcp(bool table, uint32_t runs)
+{
+    struct timespec start, end;
+    uint32_t i;
+    uint8_t state, event;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < runs; i++)
+    {
+        for (state = 0; state < DHCP_NUM_STATES; state++)
+        {
+            for (event = 0; event < DHCP_NUM_EVENTS; event++)
+                sink += (uintptr_t)(table ? dhcpLookup(state, event) : dhcpScan(state, event));
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return seconds(&start, &end) * 1e9 / ((double)runs * DHCP_NUM_STATES * DHCP_NUM_EVENTS);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t runs = 100000;
+    double scan, table;
+
+    if (argc > 1)
+        runs = strtoul(argv[1], NULL, 0);
+
+    tcpInitStateTable();
+    dhcpInitStateTable();
+
+    printf("%6s %10s %10s %8s\n", "FSM", "Scan ns", "Table ns", "Speedup");
+    scan  = nsPerTcp(false, runs);
+    table = nsPerTcp(true, runs);
+    printf("%6s %10.2f %10.2f %8.2f\n", "TCP", scan, table, scan / table);
+    scan  = nsPerDhcp(false, runs);
+    table = nsPerDhcp(true, runs);
+    printf("%6s %10.2f %10.2f %8.2f\n", "DHCP", scan, table, scan / table);
+
+    return 0;
+}
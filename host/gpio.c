@@ -0,0 +1,105 @@
+// gpio.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   IoT_Project/gpio.c
+
+// Pins only keep the value last written, so the LEDs can be read back.
+// A pin with its pullup enabled reads high, as the push button does when
+// it is not pressed. Writes are passed to gpioHook for a device model, and
+// the interrupt enables are kept so its interrupt source can be masked.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "gpio.h"
+#include "host.h"
+
+volatile uint32_t hostSysctlRcc = 0;
+
+uint8_t gpioValues[6] = {0};
+uint8_t gpioInterrupts[6] = {0};
+
+hostPinHook gpioHook = NULL;
+
+uint8_t gpioIndex(PORT port)
+{
+    switch (port)
+    {
+        case PORTA: return 0;
+        case PORTB: return 1;
+        case PORTC: return 2;
+        case PORTD: return 3;
+        case PORTE: return 4;
+        default:    return 5;
+    }
+}
+
+void enablePort(PORT port) {}
+void disablePort(PORT port) {}
+void enablePortInterrupt(PORT port) {}
+void selectPinPushPullOutput(PORT port, uint8_t pin) {}
+void selectPinOpenDrainOutput(PORT port, uint8_t pin) {}
+void selectPinDigitalInput(PORT port, uint8_t pin) {}
+void selectPinAnalogInput(PORT port, uint8_t pin) {}
+void setPinCommitControl(PORT port, uint8_t pin) {}
+void disablePinPullup(PORT port, uint8_t pin) {}
+void enablePinPulldown(PORT port, uint8_t pin) {}
+void disablePinPulldown(PORT port, uint8_t pin) {}
+void setPinAuxFunction(PORT port, uint8_t pin, uint32_t fn) {}
+void selectPinInterruptRisingEdge(PORT port, uint8_t pin) {}
+void selectPinInterruptFallingEdge(PORT port, uint8_t pin) {}
+void selectPinInterruptBothEdges(PORT port, uint8_t pin) {}
+void selectPinInterruptHighLevel(PORT port, uint8_t pin) {}
+void selectPinInterruptLowLevel(PORT port, uint8_t pin) {}
+void clearPinInterrupt(PORT port, uint8_t pin) {}
+
+void enablePinInterrupt(PORT port, uint8_t pin)
+{
+    gpioInterrupts[gpioIndex(port)] |= 1 << pin;
+}
+
+void disablePinInterrupt(PORT port, uint8_t pin)
+{
+    gpioInterrupts[gpioIndex(port)] &= ~(1 << pin);
+}
+
+bool gpioInterruptEnabled(PORT port, uint8_t pin)
+{
+    return (gpioInterrupts[gpioIndex(port)] >> pin) & 1;
+}
+
+void enablePinPullup(PORT port, uint8_t pin)
+{
+    setPinValue(port, pin, 1);
+}
+
+void setPinValue(PORT port, uint8_t pin, bool value)
+{
+    if (value)
+        gpioValues[gpioIndex(port)] |= 1 << pin;
+    else
+        gpioValues[gpioIndex(port)] &= ~(1 << pin);
+    if (gpioHook != NULL)
+        gpioHook(port, pin, value);
+}
+
+bool getPinValue(PORT port, uint8_t pin)
+{
+    return (gpioValues[gpioIndex(port)] >> pin) & 1;
+}
+
+void setPortValue(PORT port, uint8_t value)
+{
+    gpioValues[gpioIndex(port)] = value;
+}
+
+uint8_t getPortValue(PORT port)
+{
+    return gpioValues[gpioIndex(port)];
+}
@@ -0,0 +1,57 @@
+// host.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   NVIC, Timer 4 and what is wired to the pins
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gpio.h"
+
+// Interrupts
+// There are no interrupts on the host. Each driver registers a source that
+// eventTake and eventWait poll, and its isr is called from there, so handlers
+// run between main loop tasks just as they would on the target when the
+// main loop is not holding a lock. A source with an fd is ready when the fd
+// is readable, one without (fd < 0) whenever its gate says so. The gate, if
+// any, keeps a source from being polled while its driver has no room.
+
+#define HOST_MAX_SOURCES 4
+
+typedef void (*hostIsr)(void);
+typedef bool (*hostGate)(void);
+
+void hostAddSource(int fd, hostGate gate, hostIsr isr);
+void hostRemoveSource(hostIsr isr);
+void hostPoll(int32_t timeoutMs);
+
+// Timer 4, kept by host/timer4.c on the monotonic clock, or on a
+// simulation's clock of system clock cycles once it is given one
+typedef uint64_t (*hostClock)(void);
+
+void timer4SetClock(hostClock clock);
+bool timer4Pending(void);
+int32_t timer4Timeout(void);
+
+// Devices on the pins and SPI0 bus
+// A model of a chip attaches here. gpioHook sees every pin written and
+// spiDevice exchanges each frame clocked on SPI0, with the reply read back
+// by readSpi0Data or readSpi0Block.
+
+typedef void (*hostPinHook)(PORT port, uint8_t pin, bool value);
+typedef uint8_t (*hostSpiDevice)(uint8_t data);
+
+extern hostPinHook gpioHook;
+extern hostSpiDevice spiDevice;
+
+bool gpioInterruptEnabled(PORT port, uint8_t pin);
+
+#endif /* HOST_H_ */
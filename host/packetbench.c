@@ -0,0 +1,343 @@
+// packetbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Times packetClassify against the etherIsX chain the main loop ran on each
+// frame before it, on a replay of mixed traffic: MQTT publishes and ACKs
+// from the broker, ARP, DHCP, pings, other UDP and frames of other types.
+// The chain is kept here as it was, each test finding the headers again
+// and the TCP ones assuming 20 byte IP headers, with the MQTT, TCB and
+// retransmission lookups that each read the TCP header once more.
+// Host times only rank the two, count cycles on the target for its numbers.
+// Usage: packetbench [RUNS], 100000 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ethernet.h"
+#include "checksum.h"
+#include "tcp.h"
+#include "packet.h"
+
+#define MIX_SIZE 100
+
+typedef struct _mixEntry
+{
+    const char* name;
+    uint8_t     count;   // Frames of this kind in every MIX_SIZE
+} mixEntry;
+
+const mixEntry mix[] =
+{
+    {"mqtt publish", 40},
+    {"tcp ack", 25},
+    {"arp", 15},
+    {"icmp echo", 5},
+    {"dhcp", 5},
+    {"udp", 5},
+    {"ipv6", 5},
+};
+
+uint8_t frames[MIX_SIZE][MAX_PACKET_SIZE];
+uint16_t sizes[MIX_SIZE];
+uint8_t kinds[MIX_SIZE];
+uint8_t replay[MIX_SIZE];    // Frames timed, in order
+uint8_t replaySize;
+packetInfo info;
+volatile uint32_t sink;
+
+// Same tests as the old etherIsIp, etherIsTcp, getMqttFrame, etherIsDhcp,
+// etherIsArp and etherIsArpRequest/Response
+bool oldIsIp(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip = (ipFrame*)&ether->data;
+
+    if (ether->frameType != htons(0x0800))
+        return false;
+
+    return checksumFold(checksumAdd(0, &ip->revSize, (ip->revSize & 0xF) * 4)) == 0;
+}
+
+bool oldIsTcp(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip = (ipFrame*)&ether->data;
+
+    return ip->protocol == 6;
+}
+
+uint8_t* oldGetMqttFrame(uint8_t packet[], uint16_t* size)
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    tcpFrame* tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+    uint16_t index;
+
+    index = ((htons(tcp->dataCtrlFields) & 0xF000) >> 12) * 4;
+    *size = htons(ip->length) - ((ip->revSize & 0xF) * 4) - index;
+
+    if (htons(tcp->sourcePort) != 1883 || *size == 0)
+        return NULL;
+
+    return (uint8_t*)tcp + index;
+}
+
+uint16_t oldPorts(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    tcpFrame* tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+
+    return htons(tcp->sourcePort) ^ htons(tcp->destPort);
+}
+
+uint32_t oldAck(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    tcpFrame* tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+
+    return htons32(tcp->ackNum);
+}
+
+uint16_t oldTcpMsgType(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    tcpFrame* tcp     = (tcpFrame*)((uint8_t*)ip + ((0x45 & 0xF) * 4));
+
+    return (uint8_t)(htons(tcp->dataCtrlFields) & 0x001F);
+}
+
+bool oldIsDhcp(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    udpFrame* udp     = (udpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
+
+    return htons(udp->destPort) == 68 && htons(udp->sourcePort) == 67;
+}
+
+bool oldIsArp(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+
+    return ether->frameType == htons(0x0806);
+}
+
+bool oldIsArpOp(uint8_t packet[], uint16_t op)
+{
+    etherFrame* ether = (etherFrame*)packet;
+    arpFrame* arp = (arpFrame*)&ether->data;
+    uint8_t i;
+
+    if (ether->frameType != htons(0x0806) || arp->op != htons(op))
+        return false;
+
+    for (i = 0; i < IP_ADD_LENGTH; i++)
+        if (arp->destIp[i] != ipAddress[i])
+            return false;
+
+    return true;
+}
+
+// The old main loop's tests, in its order
+uint8_t chainClassify(uint8_t packet[])
+{
+    uint8_t* mqtt;
+    uint16_t size;
+
+    if (oldIsIp(packet))
+    {
+        if (oldIsTcp(packet))
+        {
+            mqtt = oldGetMqttFrame(packet, &size);              // isMqttMessage
+            if (mqtt != NULL && (mqtt[0] & 0xF0) == 0x30)
+                sink += size;
+            mqtt = oldGetMqttFrame(packet, &size);              // mqttProcessAck
+            sink += (mqtt != NULL) ? mqtt[0] : 0;
+            sink += oldPorts(packet);                           // tcpFindTcb
+            sink += oldAck(packet);                             // tcpRtxAck
+            sink += oldTcpMsgType(packet);
+            return PACKET_TCP;
+        }
+        if (oldIsDhcp(packet))
+            return PACKET_DHCP;
+        return PACKET_DROP;
+    }
+    if (oldIsArp(packet))
+    {
+        if (oldIsArpOp(packet, 1) || oldIsArpOp(packet, 2))
+            sink++;
+        return PACKET_ARP;
+    }
+
+    return PACKET_DROP;
+}
+
+// The same reads of the TCP header made from the parsed info
+uint8_t infoClassify(uint8_t packet[], uint16_t size)
+{
+    tcpFrame* tcp;
+
+    packetClassify(packet, size, &info);
+    if (info.type == PACKET_TCP)
+    {
+        tcp = (tcpFrame*)&packet[info.l4Offset];
+        if (info.sourcePort == 1883 && info.dataSize != 0 && (packet[info.dataOffset] & 0xF0) == 0x30)
+            sink += info.dataSize;
+        sink += (info.sourcePort == 1883 && info.dataSize != 0) ? packet[info.dataOffset] : 0;
+        sink += info.sourcePort ^ info.destPort;
+        sink += htons32(tcp->ackNum);
+        sink += info.tcpFlags & 0x1F;
+    }
+
+    return info.type;
+}
+
+uint16_t putIp(uint8_t packet[], uint8_t protocol, uint16_t l4Size)
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+
+    memset(ether->destAddress, 0x02, HW_ADD_LENGTH);
+    ether->frameType   = htons(0x0800);
+    ip->revSize        = 0x45;
+    ip->length         = htons(sizeof(ipFrame) + l4Size);
+    ip->flagsAndOffset = htons(0x4000);
+    ip->ttl            = 64;
+    ip->protocol       = protocol;
+    ip->headerChecksum = checksumFold(checksumAdd(0, &ip->revSize, sizeof(ipFrame)));
+
+    return 34 + l4Size;
+}
+
+uint16_t putTcp(uint8_t packet[], uint16_t dataSize)
+{
+    tcpFrame* tcp = (tcpFrame*)&packet[34];
+
+    tcp->sourcePort     = htons(1883);
+    tcp->destPort       = htons(49152);
+    tcp->ackNum         = htons32(1000);
+    tcp->dataCtrlFields = htons((5 << 12) | ((dataSize != 0) ? 0x18 : 0x10));
+    if (dataSize != 0)
+        tcp->data[0] = 0x30;
+
+    return putIp(packet, 6, sizeof(tcpFrame) + dataSize);
+}
+
+uint16_t putUdp(uint8_t packet[], uint16_t sourcePort, uint16_t destPort, uint16_t dataSize)
+{
+    udpFrame* udp = (udpFrame*)&packet[34];
+
+    udp->sourcePort = htons(sourcePort);
+    udp->destPort   = htons(destPort);
+    udp->length     = htons(8 + dataSize);
+
+    return putIp(packet, 17, 8 + dataSize);
+}
+
+// Frame of mix entry kind
+uint16_t putFrame(uint8_t packet[], uint8_t kind)
+{
+    etherFrame* ether = (etherFrame*)packet;
+    arpFrame* arp = (arpFrame*)&ether->data;
+
+    memset(packet, 0, MAX_PACKET_SIZE);
+    switch (kind)
+    {
+        case 0: return putTcp(packet, 40);
+        case 1: return putTcp(packet, 0);
+        case 2:
+            memset(ether->destAddress, 0xFF, HW_ADD_LENGTH);
+            ether->frameType = htons(0x0806);
+            arp->op = htons(1);
+            return 14 + sizeof(arpFrame);
+        case 3: return putIp(packet, 1, 8 + 32);
+        case 4: return putUdp(packet, 67, 68, 300);
+        case 5: return putUdp(packet, 5353, 5353, 100);
+        default:
+            ether->frameType = htons(0x86DD);
+            return 100;
+    }
+}
+
+// Replays the frames of one kind, or all of them in mix order if kind is
+// past the end of the mix
+void selectKind(uint8_t kind)
+{
+    uint8_t i;
+
+    replaySize = 0;
+    for (i = 0; i < MIX_SIZE; i++)
+        if (kind >= sizeof(mix) / sizeof(mix[0]) || kinds[i] == kind)
+            replay[replaySize++] = i;
+}
+
+double nsPerFrame(bool chain, uint32_t runs)
+{
+    struct timespec start, end;
+    uint32_t i;
+    uint8_t j;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < runs; i++)
+    {
+        j = replay[i % replaySize];
+        if (chain)
+            sink += chainClassify(frames[j]);
+        else
+            sink += infoClassify(frames[j], sizes[j]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / runs;
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t runs = 100000;
+    double chain, classify;
+    uint8_t i, j, n = 0;
+
+    if (argc > 1)
+        runs = strtoul(argv[1], NULL, 0);
+
+    // Kinds interleaved so the replay is not sorted by type
+    for (i = 0; n < MIX_SIZE; i++)
+    {
+        for (j = 0; j < sizeof(mix) / sizeof(mix[0]) && n < MIX_SIZE; j++)
+        {
+            if (i < mix[j].count)
+            {
+                kinds[n] = j;
+                sizes[n] = putFrame(frames[n], j);
+                n++;
+            }
+        }
+    }
+
+    printf("Mix per %u frames:", MIX_SIZE);
+    for (j = 0; j < sizeof(mix) / sizeof(mix[0]); j++)
+        printf(" %u %s%s", mix[j].count, mix[j].name, (j + 1 < sizeof(mix) / sizeof(mix[0])) ? "," : "\n\n");
+
+    printf("%-14s %10s %12s %8s\n", "Frames", "Chain ns", "Classify ns", "Speedup");
+    for (j = 0; j <= sizeof(mix) / sizeof(mix[0]); j++)
+    {
+        selectKind(j);
+        chain = nsPerFrame(true, runs);
+        classify = nsPerFrame(false, runs);
+        printf("%-14s %10.1f %12.1f %8.2f\n", (j < sizeof(mix) / sizeof(mix[0])) ? mix[j].name : "mixed",
+               chain, classify, chain / classify);
+    }
+
+    return 0;
+}
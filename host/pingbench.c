@@ -0,0 +1,246 @@
+// pingbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Floods the device with pings while the broker sends it a segment every
+// 10 ms, on the ENC28J60 model with SPI transfers and frames on the wire
+// taking their time, and Timer 4 on the same clock. The main loop takes
+// frames from the rx ring, spends 20 us on each besides the SPI bus and
+// dispatches them by packetClassify, answering pings in place with and
+// without the etherPingAllowed rate limit. It prints the time from each
+// broker segment reaching the chip to its handler running, on average and
+// at worst, with the replies sent and the frames the chip dropped, and
+// checks the checksum of every reply.
+// Usage: pingbench [RUN_MS], 1000 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "spi.h"
+#include "checksum.h"
+#include "ethernet.h"
+#include "enc28j60.h"
+#include "enc28j60sim.h"
+#include "packet.h"
+#include "tcp.h"
+#include "timers.h"
+
+#define FCYC           40000000
+#define SPI_CLOCK      4000000
+#define MQTT_PERIOD_US 10000
+#define PROCESS_US     20
+#define PING_DATA      56
+#define MQTT_DATA      40
+#define MQTT_MAX       1000       // Broker segments a run can send
+#define WIRE_US(size)  (((size) + 24) * 0.8)
+
+uint8_t deviceIp[IP_ADD_LENGTH] = {192, 168, 1, 106};
+uint8_t peerIp[IP_ADD_LENGTH]   = {192, 168, 1, 1};
+uint8_t peerMac[HW_ADD_LENGTH]  = {2, 0, 0, 0, 0, 1};
+uint8_t ping[MAX_PACKET_SIZE];
+uint8_t segment[MAX_PACKET_SIZE];
+uint16_t pingSize, segmentSize;
+
+double   mqttArrival[MQTT_MAX];
+uint32_t mqttSent, mqttHandled;
+double   latencyTotal, latencyWorst;
+uint32_t replies, badReplies;
+bool     limited;
+double   pingPeriod, nextPing, nextMqtt, runEnd;
+
+// Counts echo replies and those whose patched checksum does not verify
+void wire(const uint8_t frame[], uint16_t size)
+{
+    uint16_t icmpSize = ((frame[16] << 8) | frame[17]) - sizeof(ipFrame);
+
+    if (size < 35 || frame[23] != 1 || frame[34] != 0)
+        return;
+
+    replies++;
+    if (checksumFold(checksumAdd(0, &frame[34], icmpSize)) != 0)
+        badReplies++;
+}
+
+uint64_t simCycles(void)
+{
+    return enc28j60SimTime() * (FCYC / 1000000) / 1000;
+}
+
+double now(void)
+{
+    return enc28j60SimTime() / 1000.0;
+}
+
+uint16_t putIp(uint8_t frame[], uint8_t protocol, uint16_t l4Size)
+{
+    etherFrame* ether = (etherFrame*)frame;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+
+    memset(frame, 0, MAX_PACKET_SIZE);
+    memcpy(ether->destAddress, macAddress, HW_ADD_LENGTH);
+    memcpy(ether->sourceAddress, peerMac, HW_ADD_LENGTH);
+    ether->frameType = htons(0x0800);
+    ip->revSize      = 0x45;
+    ip->length       = htons(sizeof(ipFrame) + l4Size);
+    ip->ttl          = 64;
+    ip->protocol     = protocol;
+    memcpy(ip->sourceIp, peerIp, IP_ADD_LENGTH);
+    memcpy(ip->destIp, deviceIp, IP_ADD_LENGTH);
+    ip->headerChecksum = checksumFold(checksumAdd(0, &ip->revSize, sizeof(ipFrame)));
+
+    return 14 + sizeof(ipFrame) + l4Size;
+}
+
+void makeFrames(void)
+{
+    icmpFrame* icmp = (icmpFrame*)&ping[34];
+    tcpFrame* tcp = (tcpFrame*)&segment[34];
+
+    pingSize = putIp(ping, 1, 8 + PING_DATA);
+    icmp->type = 8;
+    icmp->id = htons(1);
+    memset(&icmp->data, 'x', PING_DATA);
+    icmp->check = checksumFold(checksumAdd(0, icmp, 8 + PING_DATA));
+
+    segmentSize = putIp(segment, 6, sizeof(tcpFrame) + MQTT_DATA);
+    tcp->sourcePort     = htons(1883);
+    tcp->destPort       = htons(49152);
+    tcp->dataCtrlFields = htons((5 << 12) | 0x18);
+    tcp->data[0]        = 0x30;
+}
+
+void icmpHandler(packetInfo* info)
+{
+    if (etherIsPingRequest(info->packet) && (!limited || etherPingAllowed()))
+        etherSendPingResponse(info->packet);
+}
+
+// Segment number is in the sequence field
+void tcpHandler(packetInfo* info)
+{
+    tcpFrame* tcp = (tcpFrame*)&info->packet[info->l4Offset];
+    double latency = now() - mqttArrival[htons32(tcp->seqNum)];
+
+    latencyTotal += latency;
+    if (latency > latencyWorst)
+        latencyWorst = latency;
+    mqttHandled++;
+}
+
+// Puts the pings and broker segments due by ns on the wire, in order
+void arrivals(uint64_t ns)
+{
+    tcpFrame* tcp = (tcpFrame*)&segment[34];
+    double us = ns / 1000.0;
+
+    while ((nextPing <= us && nextPing < runEnd) || (nextMqtt <= us && nextMqtt < runEnd))
+    {
+        if (nextPing <= nextMqtt)
+        {
+            enc28j60SimReceive(ping, pingSize);
+            nextPing += pingPeriod;
+        }
+        else
+        {
+            mqttArrival[mqttSent] = nextMqtt;
+            tcp->seqNum = htons32(mqttSent++);
+            enc28j60SimReceive(segment, segmentSize);
+            nextMqtt += MQTT_PERIOD_US;
+        }
+    }
+}
+
+void service(void)
+{
+    while (enc28j60SimInterrupt())
+        etherIsr();
+}
+
+void run(uint32_t pingRate, bool limit, uint32_t runMs)
+{
+    double next;
+    uint8_t* frame;
+
+    initEnc28j60Sim(wire);
+    etherInit(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
+    enc28j60SimTiming(spi0BitRate);
+    initTimer();
+    memcpy(ipAddress, deviceIp, IP_ADD_LENGTH);
+    makeFrames();
+    enc28j60SimClearStats();
+
+    limited = limit;
+    mqttSent = mqttHandled = replies = 0;
+    latencyTotal = latencyWorst = 0;
+    runEnd = now() + runMs * 1000.0;
+    pingPeriod = (pingRate == 0) ? 0 : 1000000.0 / pingRate;
+    if (pingPeriod < WIRE_US(pingSize))
+        pingPeriod = WIRE_US(pingSize);
+    nextPing = (pingRate == 0) ? runEnd : now() + pingPeriod / 3;
+    nextMqtt = now() + MQTT_PERIOD_US;
+    enc28j60SimArrivals(arrivals);
+
+    while (true)
+    {
+        service();
+
+        if ((frame = etherGetRxBuffer()) == NULL)
+        {
+            next = (nextPing < nextMqtt) ? nextPing : nextMqtt;
+            if (next >= runEnd && enc28j60SimPacketCount() == 0)
+                break;
+            if (next > now())
+                enc28j60SimElapse((next - now()) * 1000 + 1);
+            continue;
+        }
+
+        enc28j60SimElapse(PROCESS_US * 1000);
+        packetDispatch(frame, etherGetRxSize());
+        etherFreeRxBuffer();
+    }
+
+    printf("%8u %6s %8u %8u %10.0f %10.0f %8u\n", pingRate, limit ? "yes" : "no", replies, mqttHandled,
+           mqttHandled ? latencyTotal / mqttHandled : 0, latencyWorst, enc28j60Sim.dropped);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint32_t rates[] = {0, 100, 1000, 3000, 10000};
+    uint32_t runMs = 1000;
+    uint8_t i;
+
+    if (argc > 1)
+        runMs = strtoul(argv[1], NULL, 0);
+    if (runMs > MQTT_MAX * (MQTT_PERIOD_US / 1000))
+        runMs = MQTT_MAX * (MQTT_PERIOD_US / 1000);
+
+    initSpi0(USE_SSI0_RX, SPI_CLOCK, FCYC);
+    timer4SetClock(simCycles);
+    initPackets();
+    packetRegister(PACKET_ICMP, icmpHandler);
+    packetRegister(PACKET_TCP, tcpHandler);
+
+    printf("SPI clock %u Hz, a broker segment every %u ms for %u ms, pings limited to %u/s\n\n",
+           spi0BitRate, MQTT_PERIOD_US / 1000, runMs, ETHER_PING_RATE);
+    printf("%8s %6s %8s %8s %10s %10s %8s\n", "Pings/s", "Limit", "Replies", "Segments", "Mean us", "Worst us", "Dropped");
+    for (i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+    {
+        run(rates[i], false, runMs);
+        if (rates[i] != 0)
+            run(rates[i], true, runMs);
+    }
+
+    if (badReplies != 0)
+    {
+        printf("FAIL %u replies with a bad ICMP checksum\n", badReplies);
+        return 1;
+    }
+    return 0;
+}
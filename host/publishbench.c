@@ -0,0 +1,203 @@
+// publishbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Times building a PUBLISH for the broker from the connection's header
+// template against filling every Ether, IP and TCP header field and summing
+// the whole segment as the MQTT senders did before, for a range of payload
+// sizes, and checks both give the same frame. Both use checksumAdd so only
+// the header work differs. The time etherPutPacket then takes to move the
+// frame over SPI, the same for both, is counted on the ENC28J60 model.
+// Host times only rank the two, count cycles on the target for its numbers.
+// Usage: publishbench [RUNS], 100000 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "spi.h"
+#include "checksum.h"
+#include "ethernet.h"
+#include "tcp.h"
+#include "mqtt.h"
+#include "enc28j60sim.h"
+
+#define FCYC 40000000
+
+uint8_t brokerMac[HW_ADD_LENGTH] = {2, 0, 0, 0, 0, 1};
+uint8_t brokerIp[IP_ADD_LENGTH]  = {192, 168, 1, 1};
+uint8_t frame[MAX_PACKET_SIZE];
+uint8_t templateFrame[MAX_PACKET_SIZE];
+uint8_t payload[TCP_MSS];
+const char topic[] = "env/temp";
+volatile uint32_t sink;
+
+void discard(const uint8_t frame[], uint16_t size)
+{
+}
+
+// PUBLISH QoS 0 of topic and size bytes of payload, returns its size
+uint16_t putPublish(uint8_t data[], uint16_t size)
+{
+    uint16_t length = 2 + sizeof(topic) - 1 + size;
+    uint16_t i = 0;
+
+    data[i++] = 0x30;
+    if (length > 127)
+    {
+        data[i++] = (length & 0x7F) | 0x80;
+        data[i++] = length >> 7;
+    }
+    else
+        data[i++] = length;
+    data[i++] = 0;
+    data[i++] = sizeof(topic) - 1;
+    memcpy(&data[i], topic, sizeof(topic) - 1);
+    i += sizeof(topic) - 1;
+    memcpy(&data[i], payload, size);
+
+    return i + size;
+}
+
+// Same fields and sums as the old sendMqttPublish
+uint16_t rebuild(uint8_t packet[], uint16_t size)
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    tcpFrame* tcp     = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
+    uint16_t tcpSize;
+    uint32_t sum;
+    uint8_t i;
+
+    for (i = 0; i < HW_ADD_LENGTH; i++)
+    {
+        ether->destAddress[i]   = brokerMac[i];
+        ether->sourceAddress[i] = macAddress[i];
+    }
+    ether->frameType = htons(0x0800);
+
+    for (i = 0; i < IP_ADD_LENGTH; i++)
+    {
+        ip->destIp[i]   = mqttIpAddress[i];
+        ip->sourceIp[i] = ipAddress[i];
+    }
+    ip->revSize        = 0x45;
+    ip->headerChecksum = 0;
+    ip->typeOfService  = 0;
+    ip->id             = htons(1);
+    ip->flagsAndOffset = htons(0x4000);
+    ip->ttl            = TIME_TO_LIVE;
+    ip->protocol       = 6;
+
+    tcp->destPort      = htons(MQTT_BROKER_PORT);
+    tcp->sourcePort    = htons(mqttSrcPort);
+    tcp->seqNum        = mqttTcb->currentSeqNum;
+    tcp->ackNum        = mqttTcb->currentAckNum;
+    tcp->dataCtrlFields = htons(0x5018);
+    tcp->checksum      = 0;
+    tcp->urgentPointer = 0;
+    tcp->window        = htons(1024);
+
+    size = putPublish(tcp->data, size);
+    tcpSize = sizeof(tcpFrame) + size;
+
+    ip->length = htons(((ip->revSize & 0xF) * 4) + tcpSize);
+    ip->headerChecksum = checksumFold(checksumAdd(0, &ip->revSize, 20));
+
+    sum = checksumAdd(0, ip->sourceIp, 8);
+    sum += (ip->protocol & 0xFF) << 8;
+    sum += htons(tcpSize);
+    sum = checksumAdd(sum, &tcp->sourcePort, tcpSize);
+    tcp->checksum = checksumFold(sum);
+
+    return 14 + ((ip->revSize & 0xF) * 4) + tcpSize;
+}
+
+// Same as sendMqttPublish now, with the destination arpResolve would fill
+uint16_t fromTemplate(uint8_t packet[], uint16_t size)
+{
+    tcpFrame* tcp = (tcpFrame*)&packet[TCP_TEMPLATE_TCP];
+
+    tcpApplyTemplate(packet);
+    memcpy(packet, brokerMac, HW_ADD_LENGTH);
+    tcp->seqNum = mqttTcb->currentSeqNum;
+    tcp->ackNum = mqttTcb->currentAckNum;
+    tcp->dataCtrlFields = htons(0x5018);
+
+    size = putPublish(tcp->data, size);
+
+    return tcpFinishTemplate(packet, size);
+}
+
+double nsPerPublish(bool useTemplate, uint16_t size, uint32_t runs)
+{
+    struct timespec start, end;
+    uint32_t i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < runs; i++)
+    {
+        mqttTcb->currentSeqNum = i;
+        if (useTemplate)
+            sink += fromTemplate(templateFrame, size);
+        else
+            sink += rebuild(frame, size);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / runs;
+}
+
+// Microseconds etherPutPacket keeps the SPI bus busy with the frame
+double spiTime(uint16_t size)
+{
+    spi0Bytes = 0;
+    etherPutPacket(frame, size);
+    etherTxPoll();
+
+    return (double)spi0Bytes * 8 * 1000000 / spi0BitRate;
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t sizes[] = {4, 32, 128, 512, 1000};
+    uint32_t runs = 100000;
+    double rebuilt, templated;
+    uint16_t i, size;
+
+    if (argc > 1)
+        runs = strtoul(argv[1], NULL, 0);
+    for (i = 0; i < sizeof(payload); i++)
+        payload[i] = rand();
+
+    initEnc28j60Sim(discard);
+    initSpi0(USE_SSI0_RX, 4000000, FCYC);
+    etherInit(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
+    memcpy(mqttIpAddress, brokerIp, IP_ADD_LENGTH);
+    mqttSrcPort = 49152;
+    mqttTcb->currentAckNum = htons32(1000);
+    tcpBuildTemplate();
+
+    printf("%8s %12s %12s %8s %12s\n", "Payload", "Rebuild ns", "Template ns", "Speedup", "SPI us");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        mqttTcb->currentSeqNum = 0;
+        size = rebuild(frame, sizes[i]);
+        if (fromTemplate(templateFrame, sizes[i]) != size || memcmp(frame, templateFrame, size) != 0)
+        {
+            printf("FAIL frames differ for %u bytes of payload\n", sizes[i]);
+            return 1;
+        }
+        rebuilt = nsPerPublish(false, sizes[i], runs);
+        templated = nsPerPublish(true, sizes[i], runs);
+        printf("%8u %12.1f %12.1f %8.2f %12.1f\n", sizes[i], rebuilt, templated, rebuilt / templated, spiTime(size));
+    }
+
+    return 0;
+}
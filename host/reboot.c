@@ -0,0 +1,31 @@
+// reboot.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   IoT_Project/reboot.c
+
+// There is no watchdog, so as on the target without initWatchdog the reboot
+// command only sets rebootFlag.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "reboot.h"
+
+bool rebootFlag = false;
+
+void initWatchdog()
+{
+}
+
+void resetWatchdog()
+{
+}
+
+void watchdogIsr()
+{
+}
@@ -0,0 +1,153 @@
+// rulesbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Times running 10000 publishes through the rules by one topicDispatch
+// against comparing the topic with the filter of every rule in turn, as the
+// if/else chain of ifttRulesTable did. Rules are added until the table is
+// full. rulesbench has the target's table of RULE_MAX rules, rulesbench_large
+// is built with one for 250. Both must run the same rules.
+// Host times only rank the two, count cycles on the target for its numbers.
+// Usage: rulesbench [RUNS], 10 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "host.h"
+#include "gpio.h"
+#include "eeprom.h"
+#include "topic.h"
+#include "rules.h"
+
+#define MESSAGES   10000
+#define TOPIC_SIZE 16
+
+// Table in rules.c
+extern uint16_t ruleOffset[];
+extern bool ruleInUse[];
+void ruleExecute(uint8_t* pc, char payload[]);
+
+char topics[MESSAGES][TOPIC_SIZE];
+char payloads[MESSAGES][4];
+uint8_t ruleCount = 0;
+uint32_t fired = 0;
+
+// Red is set by every rule whose condition holds
+void countPin(PORT port, uint8_t pin, bool value)
+{
+    fired++;
+}
+
+// Rules on a device each, the gt condition holds for half the payloads
+void addRules(void)
+{
+    char text[48];
+
+    ruleClear();
+    while (true)
+    {
+        snprintf(text, sizeof(text), "dev%u/temp gt 49 pin red 1", ruleCount);
+        if (ruleAdd(text) == RULE_NONE)
+            break;
+        ruleCount++;
+    }
+}
+
+// Publishes from twice as many devices as have rules, so half run none
+void makeMessages(void)
+{
+    uint16_t i;
+
+    srand(1);
+    for (i = 0; i < MESSAGES; i++)
+    {
+        snprintf(topics[i], TOPIC_SIZE, "dev%u/temp", rand() % (2 * ruleCount));
+        snprintf(payloads[i], sizeof(payloads[i]), "%u", rand() % 100);
+    }
+}
+
+// Every rule whose filter is the topic, as the old chain of strcmp
+void scan(char topic[], char payload[])
+{
+    uint8_t rule, *record;
+
+    for (rule = 0; rule < RULE_MAX; rule++)
+    {
+        if (!ruleInUse[rule])
+            continue;
+        record = &ruleCode[ruleOffset[rule]];
+        if (strlen(topic) == record[1] && strncmp(topic, (char*)&record[2], record[1]) == 0)
+            ruleExecute(&record[2 + record[1]], payload);
+    }
+}
+
+double seconds(const struct timespec* start, const struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Returns ns per message, rules whose action ran counted in fired
+double nsPerMessage(bool trie, uint32_t runs)
+{
+    struct timespec start, end;
+    uint32_t i;
+    uint16_t j;
+
+    fired = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < runs; i++)
+    {
+        for (j = 0; j < MESSAGES; j++)
+        {
+            if (trie)
+                topicDispatch(topics[j], payloads[j]);
+            else
+                scan(topics[j], payloads[j]);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return seconds(&start, &end) * 1e9 / ((double)runs * MESSAGES);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t runs = 10, scanFired;
+    double scanNs, trieNs;
+
+    if (argc > 1)
+        runs = strtoul(argv[1], NULL, 0);
+
+    // Rules are not kept between runs
+    setenv("IOT_EEPROM", "/dev/null", 1);
+    initEeprom();
+    initTopics();
+    initRules();
+    addRules();
+    makeMessages();
+    gpioHook = countPin;
+
+    scanNs = nsPerMessage(false, runs);
+    scanFired = fired;
+    trieNs = nsPerMessage(true, runs);
+    if (fired != scanFired)
+    {
+        printf("trie ran %u, scan ran %u\n", fired, scanFired);
+        return 1;
+    }
+
+    printf("%u rules, %u messages, %u rules fired\n", ruleCount, MESSAGES, fired / runs);
+    printf("%10s %10s %8s\n", "Scan ns", "Trie ns", "Speedup");
+    printf("%10.2f %10.2f %8.2f\n", scanNs, trieNs, scanNs / trieNs);
+
+    return 0;
+}
@@ -0,0 +1,270 @@
+// rxbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Replays a burst of frames into the ENC28J60 model in host/enc28j60sim.c
+// on a simulated clock and counts the frames the chip drops with its rx
+// fifo full, for the old main loop that polled etherIsDataAvailable and
+// read one frame into a single buffer, and for etherIsr draining the chip
+// into the rx ring as frames arrive. Frames arrive back to back at 10 Mb/s,
+// or at the times in the pcap file, SPI transfers take their time at the
+// given clock, 4 MHz as main.c asks for by default, and the main loop
+// spends 50 or 500 us on each frame it takes. Frames neither broadcast nor for the device are left
+// out, the chip would filter them.
+// Usage: rxbench [SPI_CLOCK_HZ [PCAP_FILE]]
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "spi.h"
+#include "ethernet.h"
+#include "enc28j60.h"
+#include "enc28j60sim.h"
+
+#define FCYC            40000000
+#define PCAP_MAGIC      0xA1B2C3D4
+#define PCAP_MAGIC_NS   0xA1B23C4D
+#define BURST_MAX       1024
+#define WIRE_OVERHEAD   24          // CRC, preamble and inter-frame gap bytes
+#define WIRE_US_PER_BYTE 0.8        // 10 Mb/s
+
+uint8_t  mac[HW_ADD_LENGTH];
+uint8_t  frame[MAX_PACKET_SIZE];
+uint8_t  burst[BURST_MAX][MAX_PACKET_SIZE];
+uint16_t burstSize[BURST_MAX];
+double   burstTime[BURST_MAX];
+uint16_t burstCount;
+uint16_t burstNext;
+uint32_t handled;
+
+void discard(const uint8_t frame[], uint16_t size)
+{
+}
+
+void reset(void)
+{
+    initEnc28j60Sim(discard);
+    etherInit(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
+    enc28j60SimClearStats();
+    spi0Bytes = 0;
+    burstNext = 0;
+    handled = 0;
+}
+
+// Microseconds the SPI bus was busy since the last call
+double spiTime(void)
+{
+    double us = (double)spi0Bytes * 8 * 1000000 / spi0BitRate;
+
+    spi0Bytes = 0;
+    return us;
+}
+
+// Puts the next frame on the wire
+void deliver(void)
+{
+    enc28j60SimReceive(burst[burstNext], burstSize[burstNext]);
+    burstNext++;
+}
+
+// Puts every frame that arrived by now on the wire
+void deliverUntil(double now)
+{
+    while (burstNext < burstCount && burstTime[burstNext] <= now)
+        deliver();
+}
+
+// Runs etherIsr for as long as INT is asserted, returns the time it took
+double interrupt(void)
+{
+    double us = 0;
+
+    while (enc28j60SimInterrupt())
+    {
+        etherIsr();
+        us += spiTime();
+    }
+    return us;
+}
+
+// Old main loop, one etherIsDataAvailable read every pass and one frame at
+// a time read into frame
+void runPolling(double process)
+{
+    double now = 0;
+
+    reset();
+    while (burstNext < burstCount || enc28j60SimPacketCount() > 0)
+    {
+        deliverUntil(now);
+        if (enc28j60SimPacketCount() == 0 && burstNext < burstCount && burstTime[burstNext] > now)
+        {
+            now = burstTime[burstNext];
+            continue;
+        }
+        if (etherIsDataAvailable())
+        {
+            etherIsOverflow();
+            etherGetPacket(frame, MAX_PACKET_SIZE);
+            handled++;
+            now += process;
+        }
+        now += spiTime();
+    }
+}
+
+// etherIsr on every arrival, taking time from the frame the main loop is on
+void runIsr(double process)
+{
+    double now = 0, left;
+
+    reset();
+    while (burstNext < burstCount || etherGetRxCount() > 0 || enc28j60SimPacketCount() > 0)
+    {
+        if (etherGetRxBuffer() == NULL)
+        {
+            if (burstNext < burstCount && burstTime[burstNext] > now)
+                now = burstTime[burstNext];
+            deliverUntil(now);
+            now += interrupt();
+            continue;
+        }
+        left = process;
+        while (burstNext < burstCount && burstTime[burstNext] < now + left)
+        {
+            if (burstTime[burstNext] > now)
+            {
+                left -= burstTime[burstNext] - now;
+                now = burstTime[burstNext];
+            }
+            deliver();
+            now += interrupt();
+        }
+        now += left;
+        etherFreeRxBuffer();
+        handled++;
+        now += interrupt();
+    }
+}
+
+// Burst of count frames of size bytes back to back, broadcast
+void makeBurst(uint16_t count, uint16_t size)
+{
+    uint16_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        memset(burst[i], 0xFF, HW_ADD_LENGTH);
+        memset(&burst[i][HW_ADD_LENGTH], 0x02, size - HW_ADD_LENGTH);
+        burstSize[i] = size;
+        burstTime[i] = (i == 0) ? 0 : burstTime[i - 1] + (burstSize[i - 1] + WIRE_OVERHEAD) * WIRE_US_PER_BYTE;
+    }
+    burstCount = count;
+}
+
+// Frames of an Ethernet pcap file, no closer than the wire allows
+bool readBurst(const char name[])
+{
+    uint32_t header[6], record[4];
+    double first = 0, time;
+    bool swapped, ns;
+    uint32_t size;
+    FILE* file = fopen(name, "rb");
+
+    if (file == NULL || fread(header, sizeof(header), 1, file) != 1)
+    {
+        fprintf(stderr, "%s: cannot read\n", name);
+        return false;
+    }
+    swapped = (header[0] == htons32(PCAP_MAGIC) || header[0] == htons32(PCAP_MAGIC_NS));
+    ns = (header[0] == PCAP_MAGIC_NS || header[0] == htons32(PCAP_MAGIC_NS));
+    burstCount = 0;
+    while (burstCount < BURST_MAX && fread(record, sizeof(record), 1, file) == 1)
+    {
+        if (swapped)
+        {
+            record[0] = htons32(record[0]);
+            record[1] = htons32(record[1]);
+            record[2] = htons32(record[2]);
+        }
+        size = record[2];
+        if (size > MAX_PACKET_SIZE || fread(burst[burstCount], 1, size, file) != size)
+            break;
+        if (size < 14 || (memcmp(burst[burstCount], mac, HW_ADD_LENGTH) != 0 && burst[burstCount][0] != 0xFF))
+            continue;
+
+        time = record[0] * 1000000.0 + (ns ? record[1] / 1000.0 : record[1]);
+        if (burstCount == 0)
+            first = time;
+        time -= first;
+        if (burstCount > 0 && time < burstTime[burstCount - 1] + (burstSize[burstCount - 1] + WIRE_OVERHEAD) * WIRE_US_PER_BYTE)
+            time = burstTime[burstCount - 1] + (burstSize[burstCount - 1] + WIRE_OVERHEAD) * WIRE_US_PER_BYTE;
+        burstTime[burstCount] = time;
+        burstSize[burstCount] = size;
+        burstCount++;
+    }
+    fclose(file);
+    return burstCount > 0;
+}
+
+void report(const char name[], double process)
+{
+    uint32_t polled, isr;
+
+    runPolling(process);
+    polled = enc28j60Sim.dropped;
+    runIsr(process);
+    isr = enc28j60Sim.dropped;
+    printf("%-20s %6u %10.0f %8u %8u\n", name, burstCount, process, polled, isr);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint16_t sizes[] = {60, 590, 1514};
+    static const uint16_t counts[] = {32, 128, 512};
+    static const double processes[] = {50, 500};
+    uint32_t clock = 4000000;
+    char name[32];
+    uint8_t s, c, p;
+
+    if (argc > 1)
+        clock = strtoul(argv[1], NULL, 0);
+
+    initSpi0(USE_SSI0_RX, clock, FCYC);
+    reset();
+    etherGetMacAddress(mac);
+
+    printf("SPI clock %u Hz, rx fifo %u bytes, rx ring %u frames\n\n", spi0BitRate, ETHER_RX_END + 1, ETHER_RX_RING_SIZE);
+    printf("%-20s %6s %10s %8s %8s\n", "Burst", "Frames", "Process us", "Polled", "ISR");
+
+    if (argc > 2)
+    {
+        if (!readBurst(argv[2]))
+            return 1;
+        for (p = 0; p < sizeof(processes) / sizeof(processes[0]); p++)
+            report("pcap", processes[p]);
+        return 0;
+    }
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+        {
+            makeBurst(counts[c], sizes[s]);
+            snprintf(name, sizeof(name), "%u byte frames", sizes[s]);
+            for (p = 0; p < sizeof(processes) / sizeof(processes[0]); p++)
+                report(name, processes[p]);
+        }
+    }
+
+    return 0;
+}
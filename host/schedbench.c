@@ -0,0 +1,415 @@
+// schedbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Simulates the main loop under mixed load on a clock that only moves by
+// the time each unit of work takes: frames arriving at random with bursts
+// of 16 every second, a quarter of them publishes from the broker that the
+// rules then run, timers due every 10 ms and commands typed on the console,
+// every other one taking 20 ms as erasing the EEPROM does. It runs the old
+// loop, one frame, one character, then the timers and retries on each pass
+// with the rules run inside the frame's handler, against sched.c with the
+// levels and budgets main.c registers, the rules queued for their level.
+// Work is not preempted in either. It prints the time from a frame reaching
+// the chip to its handler on average, at the 99th percentile and at worst,
+// the worst time from a publish arriving to its rules having run and from
+// a key press to its character being taken, and the frames lost with the
+// rx fifo and ring full and the publishes lost with the rules queue full.
+// Then the scheduler's own statistics for the heaviest load.
+// Usage: schedbench [SECONDS], 10 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "host.h"
+#include "ethernet.h"
+#include "rules.h"
+#include "sched.h"
+#include "timers.h"
+
+#define US                (TIMER_CYCLES_PER_MS / 1000)
+#define NET_QUEUE         (ETHER_RX_RING_SIZE + 5120 / 256) // Ring and rx fifo, in 256 byte frames
+#define FRAME_US          100     // Handling a frame
+#define RULES_US          400     // Running a publish through the rules
+#define TIMER_US          5       // Timer level with nothing due
+#define CALLBACKS_US      100     // Timer callbacks due every 10 ms
+#define CHAR_US           20      // Taking and echoing a character
+#define COMMAND_US        500
+#define LONG_COMMAND_US   20000   // eraseAddressEeprom
+#define BURST_FRAMES      16
+#define BURST_GAP_US      100     // Small frames back to back on the wire
+#define COMMAND_CHARS     8       // With the Enter
+#define CHAR_GAP_US       20000
+#define COMMAND_PERIOD_US 2000000
+#define LATENCY_MAX       65536
+
+typedef struct _arrival
+{
+    uint64_t time;
+    bool     publish;
+} arrival;
+
+uint64_t clockCycles, runEnd;
+double frameGap;
+uint64_t nextFrame, nextBurst, nextChar, nextCallbacks;
+uint8_t burstLeft, charsTyped;
+uint32_t charsTaken;
+
+arrival netQueue[NET_QUEUE];
+uint8_t netRead, netCount;
+uint64_t rulesQueue[RULE_QUEUE_SIZE];
+uint8_t rulesRead, rulesCount;
+uint64_t charTimes[COMMAND_CHARS];
+uint8_t charRead, charCount;
+bool callbacksDue;
+
+uint32_t latencies[LATENCY_MAX];
+uint32_t latencyCount, framesDropped, publishesDropped;
+uint64_t worstRules, worstChar;
+
+uint64_t simCycles(void)
+{
+    return clockCycles;
+}
+
+void spend(uint32_t us)
+{
+    clockCycles += (uint64_t)us * US;
+}
+
+uint64_t gap(void)
+{
+    // Uniform from 0 to twice the mean
+    return (uint64_t)(frameGap * (rand() % 1000 + 1) / 500.0);
+}
+
+void pushFrame(uint64_t time)
+{
+    if (netCount == NET_QUEUE)
+    {
+        framesDropped++;
+        return;
+    }
+    netQueue[(netRead + netCount) % NET_QUEUE].time = time;
+    netQueue[(netRead + netCount) % NET_QUEUE].publish = (rand() % 4) == 0;
+    netCount++;
+}
+
+// Earliest of the next frame, burst frame, key press and timer deadline
+uint64_t nextArrival(void)
+{
+    uint64_t next = nextFrame;
+
+    if (nextBurst < next)
+        next = nextBurst;
+    if (nextChar < next)
+        next = nextChar;
+    if (nextCallbacks < next)
+        next = nextCallbacks;
+
+    return next;
+}
+
+// Everything that arrived by now, as the interrupts would have queued it
+void deliver(void)
+{
+    uint64_t next;
+
+    while ((next = nextArrival()) <= clockCycles && next < runEnd)
+    {
+        if (next == nextFrame)
+        {
+            pushFrame(nextFrame);
+            nextFrame += gap();
+        }
+        else if (next == nextBurst)
+        {
+            pushFrame(nextBurst);
+            if (burstLeft == 0)
+                burstLeft = BURST_FRAMES;
+            if (--burstLeft == 0)
+                nextBurst += 1000000ULL * US - (BURST_FRAMES - 1) * BURST_GAP_US * US;
+            else
+                nextBurst += BURST_GAP_US * US;
+        }
+        else if (next == nextChar)
+        {
+            charTimes[(charRead + charCount) % COMMAND_CHARS] = nextChar;
+            charCount++;
+            if (++charsTyped == COMMAND_CHARS)
+            {
+                charsTyped = 0;
+                nextChar += COMMAND_PERIOD_US * US - (COMMAND_CHARS - 1) * CHAR_GAP_US * US;
+            }
+            else
+                nextChar += CHAR_GAP_US * US;
+        }
+        else
+        {
+            callbacksDue = true;
+            nextCallbacks += 10000 * US;
+        }
+    }
+}
+
+void recordFrame(arrival* frame)
+{
+    if (latencyCount < LATENCY_MAX)
+        latencies[latencyCount++] = (clockCycles - frame->time) / US;
+}
+
+void recordRules(uint64_t time)
+{
+    if (clockCycles - time > worstRules)
+        worstRules = clockCycles - time;
+}
+
+// One character, and the command when it is the Enter
+void takeChar(void)
+{
+    uint64_t time = charTimes[charRead];
+
+    charRead = (charRead + 1) % COMMAND_CHARS;
+    charCount--;
+    if (clockCycles - time > worstChar)
+        worstChar = clockCycles - time;
+
+    spend(CHAR_US);
+    if (++charsTaken % COMMAND_CHARS == 0)
+        spend((charsTaken % (2 * COMMAND_CHARS) == 0) ? LONG_COMMAND_US : COMMAND_US);
+}
+
+void runTimers(void)
+{
+    spend(TIMER_US);
+    if (callbacksDue)
+    {
+        spend(CALLBACKS_US);
+        callbacksDue = false;
+    }
+}
+
+// Levels as main.c registers them
+
+bool netTask(void)
+{
+    arrival* frame;
+
+    if (netCount == 0)
+        return false;
+
+    frame = &netQueue[netRead];
+    recordFrame(frame);
+    spend(FRAME_US);
+    if (frame->publish)
+    {
+        if (rulesCount == RULE_QUEUE_SIZE)
+            publishesDropped++;
+        else
+        {
+            rulesQueue[(rulesRead + rulesCount) % RULE_QUEUE_SIZE] = frame->time;
+            rulesCount++;
+            schedPost(SCHED_RULES);
+        }
+    }
+    netRead = (netRead + 1) % NET_QUEUE;
+    netCount--;
+    schedPost(SCHED_TIMER);
+
+    return netCount != 0;
+}
+
+uint8_t netDepth(void)
+{
+    return netCount;
+}
+
+bool timerTask(void)
+{
+    runTimers();
+    return false;
+}
+
+bool rulesTask(void)
+{
+    if (rulesCount == 0)
+        return false;
+
+    spend(RULES_US);
+    recordRules(rulesQueue[rulesRead]);
+    rulesRead = (rulesRead + 1) % RULE_QUEUE_SIZE;
+    rulesCount--;
+    schedPost(SCHED_TIMER);
+
+    return rulesCount != 0;
+}
+
+uint8_t rulesDepth(void)
+{
+    return rulesCount;
+}
+
+bool consoleTask(void)
+{
+    if (charCount == 0)
+        return false;
+
+    takeChar();
+    schedPost(SCHED_TIMER);
+
+    return charCount != 0;
+}
+
+// Posts the levels with work delivered, as eventTake's flags would
+void post(void)
+{
+    if (netCount != 0)
+        schedPost(SCHED_NET);
+    if (callbacksDue)
+        schedPost(SCHED_TIMER);
+    if (charCount != 0)
+        schedPost(SCHED_CONSOLE);
+}
+
+bool anyReady(void)
+{
+    uint8_t level;
+
+    for (level = 0; level < SCHED_NUM_LEVELS; level++)
+    {
+        if (schedLevels[level].ready)
+            return true;
+    }
+    return false;
+}
+
+// The loop before sched.c, a frame with its rules, a character, then the
+// timers and retries
+void oldPass(void)
+{
+    arrival* frame;
+
+    if (netCount != 0)
+    {
+        frame = &netQueue[netRead];
+        recordFrame(frame);
+        spend(FRAME_US);
+        if (frame->publish)
+        {
+            spend(RULES_US);
+            recordRules(frame->time);
+        }
+        netRead = (netRead + 1) % NET_QUEUE;
+        netCount--;
+    }
+    deliver();
+
+    if (charCount != 0)
+        takeChar();
+    deliver();
+
+    runTimers();
+    deliver();
+}
+
+int compareLatency(const void* a, const void* b)
+{
+    return (*(const uint32_t*)a > *(const uint32_t*)b) - (*(const uint32_t*)a < *(const uint32_t*)b);
+}
+
+void run(bool sched, uint32_t framesPerSecond, uint32_t seconds)
+{
+    double mean = 0;
+    uint32_t i;
+
+    srand(framesPerSecond);
+    clockCycles = 0;
+    initTimer();
+    runEnd = (uint64_t)seconds * 1000000 * US;
+    frameGap = (double)TIMER_CYCLES_PER_MS * 1000 / framesPerSecond;
+    nextFrame = gap();
+    nextBurst = 500000 * US;
+    nextChar = 100000 * US;
+    nextCallbacks = 10000 * US;
+    burstLeft = charsTyped = 0;
+    charsTaken = 0;
+    netRead = netCount = rulesRead = rulesCount = charRead = charCount = 0;
+    callbacksDue = false;
+    latencyCount = framesDropped = publishesDropped = 0;
+    worstRules = worstChar = 0;
+
+    initSched();
+    schedRegister(SCHED_NET, "net", netTask, netDepth, SCHED_NET_BUDGET, 0);
+    schedRegister(SCHED_TIMER, "timer", timerTask, NULL, SCHED_TIMER_BUDGET, 0);
+    schedRegister(SCHED_RULES, "rules", rulesTask, rulesDepth, SCHED_RULES_BUDGET, 0);
+    schedRegister(SCHED_CONSOLE, "console", consoleTask, NULL, SCHED_CONSOLE_BUDGET, 0);
+
+    while (clockCycles < runEnd || netCount != 0 || rulesCount != 0 || charCount != 0)
+    {
+        deliver();
+        if (sched)
+        {
+            post();
+            if (anyReady())
+            {
+                schedRun();
+                continue;
+            }
+        }
+        else if (netCount != 0 || charCount != 0 || callbacksDue)
+        {
+            oldPass();
+            continue;
+        }
+
+        // Sleep to the next interrupt
+        if (nextArrival() >= runEnd)
+            break;
+        clockCycles = nextArrival();
+    }
+
+    qsort(latencies, latencyCount, sizeof(latencies[0]), compareLatency);
+    for (i = 0; i < latencyCount; i++)
+        mean += latencies[i];
+    mean /= (latencyCount != 0) ? latencyCount : 1;
+
+    printf("%8u %6s %9.0f %9u %9u %10.0f %9.0f %8u %9u\n", framesPerSecond, sched ? "sched" : "old", mean,
+           latencyCount ? latencies[latencyCount * 99 / 100] : 0, latencyCount ? latencies[latencyCount - 1] : 0,
+           (double)worstRules / US, (double)worstChar / US, framesDropped, publishesDropped);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint32_t rates[] = {100, 500, 1000, 1500};
+    uint32_t seconds = 10;
+    uint8_t i;
+
+    if (argc > 1)
+        seconds = strtoul(argv[1], NULL, 0);
+    if (seconds == 0)
+        seconds = 1;
+
+    timer4SetClock(simCycles);
+
+    printf("Bursts of %u frames every second, a quarter of frames publishes, a %u ms command every 4 s,\n"
+           "rx fifo and ring hold %u frames, rules queue %u publishes, %u s simulated, times in us\n\n",
+           BURST_FRAMES, LONG_COMMAND_US / 1000, NET_QUEUE, RULE_QUEUE_SIZE, seconds);
+    printf("%8s %6s %9s %9s %9s %10s %9s %8s %9s\n", "Frames/s", "Loop", "Mean", "99%", "Worst",
+           "Rules wst", "Char wst", "Dropped", "Pub drop");
+    for (i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+    {
+        run(false, rates[i], seconds);
+        run(true, rates[i], seconds);
+    }
+
+    printf("\nScheduler statistics at %u frames/s\n", rates[i - 1]);
+    fflush(stdout);
+    schedPrintStats();
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+// spi.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   IoT_Project/spi.c
+
+// Frames go to the device attached in spiDevice, if any. Without one
+// nothing is on the bus (the tap backend replaces the ENC28J60 driver), so
+// frames are only counted and read back as idle (all ones).
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "spi.h"
+#include "host.h"
+
+uint32_t spi0Bytes = 0;    // Frames clocked since last cleared, for measuring driver cost
+uint32_t spi0BitRate = 0;  // Bit rate set by setSpi0BaudRate
+
+hostSpiDevice spiDevice = NULL;
+uint8_t spi0Rx = 0xFF;      // Frame clocked in by the last write
+
+void initSpi0(uint32_t pinMask, uint32_t baudRate, uint32_t fcyc)
+{
+    setSpi0BaudRate(baudRate, fcyc);
+}
+
+// Same rounding as the SSI0 prescaler, so wire times match the target
+void setSpi0BaudRate(uint32_t baudRate, uint32_t fcyc)
+{
+    uint32_t divisorTimes2 = (fcyc * 2) / baudRate;
+
+    spi0BitRate = fcyc / ((divisorTimes2 + 1) >> 1);
+}
+
+void setSpi0Mode(uint8_t polarity, uint8_t phase)
+{
+}
+
+// Clocks one frame out and the reply in
+uint8_t spi0Exchange(uint8_t data)
+{
+    if (spiDevice == NULL)
+        return 0xFF;
+
+    return spiDevice(data);
+}
+
+void writeSpi0Data(uint32_t data)
+{
+    spi0Bytes++;
+    spi0Rx = spi0Exchange(data);
+}
+
+uint32_t readSpi0Data(void)
+{
+    return spi0Rx;
+}
+
+void writeSpi0Block(const uint8_t data[], uint16_t size)
+{
+    uint16_t i;
+
+    spi0Bytes += size;
+    for (i = 0; i < size; i++)
+        spi0Exchange(data[i]);
+}
+
+// Clocks out zeros as the target does
+void readSpi0Block(uint8_t data[], uint16_t size)
+{
+    uint16_t i;
+
+    spi0Bytes += size;
+    for (i = 0; i < size; i++)
+        data[i] = spi0Exchange(0);
+}
@@ -0,0 +1,407 @@
+// tap.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   IoT_Project/enc28j60.c
+
+// Frames are exchanged with a Linux TAP interface, or replayed from a pcap
+// file so a run can be repeated exactly:
+//   IOT_TAP         Interface to attach to, tap0 by default. Create it first
+//                   with "ip tuntap add dev tap0 mode tap user $USER" and
+//                   "ip link set tap0 up".
+//   IOT_PCAP        Replay the frames in this file (Ethernet link type)
+//                   instead, as fast as the rx ring takes them. The program
+//                   exits IOT_PCAP_LINGER ms (500 by default) after the last.
+//   IOT_PCAP_OUT    Write every transmitted frame to this file.
+//   IOT_FD          Exchange frames on this inherited descriptor instead, a
+//                   SOCK_SEQPACKET socket carrying one frame per message,
+//                   so a test can play the rest of the network. The program
+//                   exits when the other end is closed.
+// Received frames are filtered by the etherInit mode as the chip does, and
+// transmitted frames are padded to 60 bytes like PAD60 does.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include "host.h"
+#include "ethernet.h"
+#include "timers.h"
+#include "events.h"
+
+#define PCAP_MAGIC          0xA1B2C3D4
+#define PCAP_MAGIC_NS       0xA1B23C4D
+#define PCAP_LINK_ETHERNET  1
+#define PCAP_LINGER_MS      500
+#define TAP_MIN_FRAME       60      // Without the CRC
+
+typedef struct _pcapHeader
+{
+    uint32_t magic;
+    uint16_t major;
+    uint16_t minor;
+    int32_t  zone;
+    uint32_t sigfigs;
+    uint32_t snapLength;
+    uint32_t linkType;
+} pcapHeader;
+
+typedef struct _pcapRecord
+{
+    uint32_t seconds;
+    uint32_t fraction;
+    uint32_t size;
+    uint32_t wireSize;
+} pcapRecord;
+
+uint8_t  tapRxPacket[ETHER_RX_RING_SIZE][MAX_PACKET_SIZE];
+uint16_t tapRxSize[ETHER_RX_RING_SIZE];
+uint8_t  tapRxWrite = 0;
+uint8_t  tapRxRead = 0;
+uint8_t  tapTxFrame[MAX_PACKET_SIZE];
+uint16_t tapTxSize = 0;
+uint16_t tapMode = 0;
+int      tapFd = -1;
+FILE*    pcapIn = NULL;
+FILE*    pcapOut = NULL;
+bool     pcapSwapped = false;
+
+// Shown and cleared by etherPrintSpiStats
+uint32_t tapRxFrames = 0;
+uint32_t tapTxFrames = 0;
+uint32_t tapFiltered = 0;
+
+uint32_t pcapSwap(uint32_t value)
+{
+    return pcapSwapped ? htons32(value) : value;
+}
+
+// Room in the rx ring, the backend is not read while it is full
+bool tapRxRoom(void)
+{
+    return (uint8_t)(tapRxWrite - tapRxRead) < ETHER_RX_RING_SIZE;
+}
+
+bool pcapRxReady(void)
+{
+    return tapRxRoom() && pcapIn != NULL;
+}
+
+// Unicast to us, broadcast and multicast as enabled by the etherInit mode
+bool tapAccept(const uint8_t frame[], uint16_t size)
+{
+    if (size < 14)
+        return false;
+    if (memcmp(frame, macAddress, HW_ADD_LENGTH) == 0)
+        return (tapMode & ETHER_UNICAST) != 0;
+    if (memcmp(frame, broadcastAddress, HW_ADD_LENGTH) == 0)
+        return (tapMode & ETHER_BROADCAST) != 0;
+    if (frame[0] & 1)
+        return (tapMode & ETHER_MULTICAST) != 0;
+    return false;
+}
+
+// Replay or peer finished, the run is over
+void tapDone(void)
+{
+    if (pcapOut != NULL)
+        fclose(pcapOut);
+    exit(0);
+}
+
+// Next frame of the replay into slot, false at the end of the file
+bool pcapRead(uint8_t slot)
+{
+    pcapRecord record;
+    uint32_t size;
+
+    if (fread(&record, sizeof(record), 1, pcapIn) != 1)
+        return false;
+
+    size = pcapSwap(record.size);
+    if (size > MAX_PACKET_SIZE)
+    {
+        fseek(pcapIn, size - MAX_PACKET_SIZE, SEEK_CUR);
+        size = MAX_PACKET_SIZE;
+    }
+    if (fread(tapRxPacket[slot], 1, size, pcapIn) != size)
+        return false;
+
+    tapRxSize[slot] = size;
+    return true;
+}
+
+void pcapWrite(const uint8_t frame[], uint16_t size)
+{
+    pcapRecord record;
+    uint64_t us = timerGetCycles() / (TIMER_CYCLES_PER_MS / 1000);
+
+    record.seconds = us / 1000000;
+    record.fraction = us % 1000000;
+    record.size = size;
+    record.wireSize = size;
+    fwrite(&record, sizeof(record), 1, pcapOut);
+    fwrite(frame, 1, size, pcapOut);
+    fflush(pcapOut);
+}
+
+void tapOpen(void)
+{
+    const char* name = getenv("IOT_TAP");
+    struct ifreq ifr;
+
+    if (name == NULL)
+        name = "tap0";
+
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    if ((tapFd = open("/dev/net/tun", O_RDWR | O_NONBLOCK)) < 0 || ioctl(tapFd, TUNSETIFF, &ifr) < 0)
+    {
+        perror(name);
+        exit(1);
+    }
+
+    hostAddSource(tapFd, tapRxRoom, etherIsr);
+}
+
+void peerOpen(const char* fd)
+{
+    // A write after the peer is gone fails with EPIPE instead of killing us
+    signal(SIGPIPE, SIG_IGN);
+
+    tapFd = atoi(fd);
+    if (fcntl(tapFd, F_SETFL, fcntl(tapFd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        perror("IOT_FD");
+        exit(1);
+    }
+
+    hostAddSource(tapFd, tapRxRoom, etherIsr);
+}
+
+void pcapOpen(const char* name)
+{
+    pcapHeader header;
+
+    if ((pcapIn = fopen(name, "rb")) == NULL || fread(&header, sizeof(header), 1, pcapIn) != 1)
+    {
+        perror(name);
+        exit(1);
+    }
+
+    pcapSwapped = (header.magic == htons32(PCAP_MAGIC) || header.magic == htons32(PCAP_MAGIC_NS));
+    if ((pcapSwap(header.magic) != PCAP_MAGIC && pcapSwap(header.magic) != PCAP_MAGIC_NS) || pcapSwap(header.linkType) != PCAP_LINK_ETHERNET)
+    {
+        fprintf(stderr, "%s: not an Ethernet pcap file\n", name);
+        exit(1);
+    }
+
+    hostAddSource(-1, pcapRxReady, etherIsr);
+}
+
+void etherInit(uint16_t mode)
+{
+    const char* name;
+    pcapHeader header = {PCAP_MAGIC, 2, 4, 0, 0, MAX_PACKET_SIZE, PCAP_LINK_ETHERNET};
+
+    tapMode = mode;
+    tapRxWrite = tapRxRead = 0;
+
+    // Backend stays open if the interface is brought up again
+    if (tapFd >= 0 || pcapIn != NULL)
+        return;
+
+    if ((name = getenv("IOT_PCAP_OUT")) != NULL)
+    {
+        if ((pcapOut = fopen(name, "wb")) == NULL)
+        {
+            perror(name);
+            exit(1);
+        }
+        fwrite(&header, sizeof(header), 1, pcapOut);
+    }
+
+    if ((name = getenv("IOT_FD")) != NULL)
+        peerOpen(name);
+    else if ((name = getenv("IOT_PCAP")) != NULL)
+        pcapOpen(name);
+    else
+        tapOpen();
+}
+
+bool etherIsLinkUp(void)
+{
+    return true;
+}
+
+bool etherIsDataAvailable(void)
+{
+    return tapRxWrite != tapRxRead;
+}
+
+// The kernel queues for the tap and the replay waits for room, so nothing
+// is ever lost to an overflow
+bool etherIsOverflow(void)
+{
+    return false;
+}
+
+// Moves waiting frames into the rx ring, called when the tap is readable or
+// the replay has frames left
+void etherIsr(void)
+{
+    uint8_t slot;
+    ssize_t size;
+    bool queued = false;
+
+    while (tapRxRoom())
+    {
+        slot = tapRxWrite & (ETHER_RX_RING_SIZE - 1);
+        if (pcapIn != NULL)
+        {
+            if (!pcapRead(slot))
+            {
+                fclose(pcapIn);
+                pcapIn = NULL;
+                hostRemoveSource(etherIsr);
+                timerStart(tapDone, getenv("IOT_PCAP_LINGER") ? atoi(getenv("IOT_PCAP_LINGER")) : PCAP_LINGER_MS, false);
+                break;
+            }
+        }
+        else
+        {
+            if ((size = read(tapFd, tapRxPacket[slot], MAX_PACKET_SIZE)) == 0)
+                tapDone();
+            if (size < 0)
+                break;
+            tapRxSize[slot] = size;
+        }
+
+        if (!tapAccept(tapRxPacket[slot], tapRxSize[slot]))
+        {
+            tapFiltered++;
+            continue;
+        }
+
+        tapRxWrite++;
+        tapRxFrames++;
+        queued = true;
+    }
+
+    if (queued)
+        eventSet(EVENT_ETHER);
+}
+
+uint8_t* etherGetRxBuffer(void)
+{
+    if (tapRxWrite == tapRxRead)
+        return NULL;
+
+    return tapRxPacket[tapRxRead & (ETHER_RX_RING_SIZE - 1)];
+}
+
+uint16_t etherGetRxSize(void)
+{
+    return tapRxSize[tapRxRead & (ETHER_RX_RING_SIZE - 1)];
+}
+
+uint8_t etherGetRxCount(void)
+{
+    return tapRxWrite - tapRxRead;
+}
+
+void etherFreeRxBuffer(void)
+{
+    tapRxRead++;
+}
+
+uint16_t etherGetPacket(uint8_t packet[], uint16_t maxSize)
+{
+    uint16_t size;
+
+    if (tapRxWrite == tapRxRead)
+        return 0;
+
+    size = etherGetRxSize();
+    if (size > maxSize)
+        size = maxSize;
+    memcpy(packet, etherGetRxBuffer(), size);
+    etherFreeRxBuffer();
+
+    return size;
+}
+
+// Frames go out as soon as they are finished, there is no tx queue to run
+void etherTxKick(void)
+{
+}
+
+void etherTxPoll(void)
+{
+}
+
+void etherTxStart(void)
+{
+    tapTxSize = 0;
+}
+
+void etherTxWrite(const void* data, uint16_t size)
+{
+    if (size > MAX_PACKET_SIZE - tapTxSize)
+        size = MAX_PACKET_SIZE - tapTxSize;
+    memcpy(&tapTxFrame[tapTxSize], data, size);
+    tapTxSize += size;
+}
+
+void etherTxSend(void)
+{
+    if (tapTxSize < TAP_MIN_FRAME)
+    {
+        memset(&tapTxFrame[tapTxSize], 0, TAP_MIN_FRAME - tapTxSize);
+        tapTxSize = TAP_MIN_FRAME;
+    }
+
+    if (pcapOut != NULL)
+        pcapWrite(tapTxFrame, tapTxSize);
+    if (tapFd >= 0 && write(tapFd, tapTxFrame, tapTxSize) < 0)
+    {
+        if (errno == EPIPE)
+            tapDone();
+        perror("tap");
+    }
+
+    tapTxFrames++;
+}
+
+void etherPutPacket(uint8_t packet[], uint16_t size)
+{
+    etherTxStart();
+    etherTxWrite(packet, size);
+    etherTxSend();
+}
+
+// No SPI on the host, show the frame counts instead
+void etherPrintSpiStats(void)
+{
+    printfUart0(UART0_BLOCK, "  Frames in:     %lu\r\n", (unsigned long)tapRxFrames);
+    printfUart0(UART0_BLOCK, "  Frames out:    %lu\r\n", (unsigned long)tapTxFrames);
+    printfUart0(UART0_BLOCK, "  Filtered:      %lu\r\n", (unsigned long)tapFiltered);
+
+    tapRxFrames = 0;
+    tapTxFrames = 0;
+    tapFiltered = 0;
+}
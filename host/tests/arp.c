@@ -0,0 +1,310 @@
+// arp.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Checks the ARP cache against a simulated LAN on the ENC28J60 model: frames
+// for hosts off the subnet wait on the gateway and go out to its MAC when it
+// answers, the pending queue holds ARP_PENDING_SLOTS frames and drops the
+// rest, aged entries are refreshed by a unicast request while their MAC is
+// still used, and unanswered requests give up on the host and its frames.
+// Last an entry evicted from a full probe window takes its queued frame
+// with it. Entries are aged by moving their time back rather than waiting.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "host.h"
+#include "ethernet.h"
+#include "enc28j60sim.h"
+#include "timers.h"
+#include "arp.h"
+
+#define ETHER_ARP 0x0806
+#define ETHER_IP  0x0800
+
+// Frames the device put on the wire
+typedef struct _wireLog
+{
+    uint16_t requests;         // ARP requests
+    uint16_t broadcasts;       // ARP requests to the broadcast MAC
+    uint16_t frames;           // IP frames
+    uint8_t  requestIp[4];     // Address asked for by the last request
+    uint8_t  frameMac[6];      // Destination of the last IP frame
+    uint8_t  frameTag;         // Last byte of the last IP frame
+} wireLog;
+
+uint8_t gatewayMac[HW_ADD_LENGTH] = {0x02, 0, 0, 0, 0, 1};
+uint16_t failures = 0;
+wireLog seen;
+
+void check(bool ok, const char what[])
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+void wire(const uint8_t frame[], uint16_t size)
+{
+    uint16_t type = (frame[12] << 8) | frame[13];
+
+    if (type == ETHER_ARP)
+    {
+        seen.requests++;
+        seen.broadcasts += frame[0] == 0xFF;
+        memcpy(seen.requestIp, &frame[38], IP_ADD_LENGTH);
+    }
+    else if (type == ETHER_IP)
+    {
+        seen.frames++;
+        memcpy(seen.frameMac, frame, HW_ADD_LENGTH);
+        seen.frameTag = frame[size - 1];
+    }
+}
+
+// Let the tx ring send everything queued, etherIsr does this on the device
+void drain(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < 8; i++)
+        etherTxPoll();
+}
+
+void clearLog(void)
+{
+    drain();
+    memset(&seen, 0, sizeof(seen));
+}
+
+// Empty cache and queue on the 192.168.1.0/24 subnet
+void start(void)
+{
+    clearLog();
+    initArp();
+}
+
+uint8_t* host(uint8_t last)
+{
+    static uint8_t ip[IP_ADD_LENGTH];
+
+    ip[0] = 192;
+    ip[1] = 168;
+    ip[2] = 1;
+    ip[3] = last;
+    return ip;
+}
+
+// UDP sized IP frame to ip, its last byte tells the frames apart
+void sendTo(const uint8_t ip[], uint16_t size, uint8_t tag)
+{
+    uint8_t frame[MAX_PACKET_SIZE];
+    etherFrame* ether = (etherFrame*)frame;
+    ipFrame* ipHeader = (ipFrame*)&ether->data;
+
+    memset(frame, 0, size);
+    memcpy(ether->sourceAddress, macAddress, HW_ADD_LENGTH);
+    ether->frameType = htons(ETHER_IP);
+    ipHeader->revSize = 0x45;
+    memcpy(ipHeader->sourceIp, ipAddress, IP_ADD_LENGTH);
+    memcpy(ipHeader->destIp, ip, IP_ADD_LENGTH);
+    frame[size - 1] = tag;
+
+    arpSendPacket(frame, size);
+    drain();
+}
+
+// ARP reply from ip at mac, addressed to the device
+void reply(const uint8_t ip[], const uint8_t mac[])
+{
+    uint8_t frame[42];
+    etherFrame* ether = (etherFrame*)frame;
+    arpFrame* arp     = (arpFrame*)&ether->data;
+
+    memcpy(ether->destAddress, macAddress, HW_ADD_LENGTH);
+    memcpy(ether->sourceAddress, mac, HW_ADD_LENGTH);
+    ether->frameType   = htons(ETHER_ARP);
+    arp->hardwareType  = htons(1);
+    arp->protocolType  = htons(ETHER_IP);
+    arp->hardwareSize  = 6;
+    arp->protocolSize  = 4;
+    arp->op            = htons(2);
+    memcpy(arp->sourceAddress, mac, HW_ADD_LENGTH);
+    memcpy(arp->sourceIp, ip, IP_ADD_LENGTH);
+    memcpy(arp->destAddress, macAddress, HW_ADD_LENGTH);
+    memcpy(arp->destIp, ipAddress, IP_ADD_LENGTH);
+
+    arpReceived(frame);
+    drain();
+}
+
+// Host answering at a MAC made from its last octet
+void answer(uint8_t last)
+{
+    uint8_t mac[HW_ADD_LENGTH] = {0x02, 0, 0, 0, 0, last};
+
+    reply(host(last), mac);
+}
+
+// Entry for a host that answered just now, without any frames
+void resolved(uint8_t last)
+{
+    arpEntry* entry = arpInsert(host(last));
+
+    memset(entry->mac, 0x02, HW_ADD_LENGTH);
+    entry->state = ARP_RESOLVED;
+    entry->time  = timerGetTicks();
+}
+
+// Run arpPoll as if ms had passed for every entry
+void age(uint32_t ms)
+{
+    uint8_t i;
+
+    for (i = 0; i < ARP_CACHE_SIZE; i++)
+        arpCache[i].time -= ms;
+    arpPoll();
+    drain();
+}
+
+void testGateway(void)
+{
+    uint8_t remote[IP_ADD_LENGTH] = {8, 8, 8, 8};
+    uint8_t mac[HW_ADD_LENGTH];
+
+    start();
+    sendTo(remote, 100, 1);
+    check(seen.requests == 1 && seen.broadcasts == 1 && memcmp(seen.requestIp, ipGwAddress, IP_ADD_LENGTH) == 0,
+          "off subnet host resolved through the gateway");
+    check(seen.frames == 0, "frame waits on the gateway");
+    check(arpFind(remote) == NULL, "no entry for the host off the subnet");
+
+    reply(ipGwAddress, gatewayMac);
+    check(seen.frames == 1 && seen.frameTag == 1 && memcmp(seen.frameMac, gatewayMac, HW_ADD_LENGTH) == 0,
+          "waiting frame sent to the gateway's MAC");
+
+    // Later frames off the subnet go straight out
+    clearLog();
+    remote[0] = 1;
+    sendTo(remote, 100, 2);
+    check(seen.requests == 0 && seen.frames == 1 && memcmp(seen.frameMac, gatewayMac, HW_ADD_LENGTH) == 0,
+          "resolved gateway used for every host off the subnet");
+
+    // Broadcasts need no ARP
+    check(arpLookup(host(255), mac) && mac[0] == 0xFF && seen.requests == 0, "subnet broadcast");
+}
+
+void testPending(void)
+{
+    uint8_t i;
+
+    start();
+    sendTo(host(10), 100, 1);
+    sendTo(host(10), 100, 2);
+    sendTo(host(10), 100, 3);
+    sendTo(host(10), ARP_PENDING_SIZE + 1, 4);
+    check(seen.requests == 1, "one request for several frames");
+
+    answer(10);
+    check(seen.frames == ARP_PENDING_SLOTS && seen.frameTag == ARP_PENDING_SLOTS,
+          "queue holds its slots, frames beyond them dropped");
+
+    // Slots are free again
+    clearLog();
+    for (i = 0; i < ARP_PENDING_SLOTS; i++)
+        sendTo(host(11), 100, i + 1);
+    answer(11);
+    check(seen.frames == ARP_PENDING_SLOTS, "slots used again after a reply");
+}
+
+void testAging(void)
+{
+    arpEntry* entry;
+    uint8_t mac[HW_ADD_LENGTH];
+
+    start();
+    sendTo(host(20), 100, 1);
+    answer(20);
+    entry = arpFind(host(20));
+    check(entry != NULL && entry->state == ARP_RESOLVED, "host resolved");
+
+    clearLog();
+    age(ARP_ENTRY_TIME - 10);
+    check(seen.requests == 0 && entry->state == ARP_RESOLVED, "entry kept until it ages");
+
+    age(10);
+    check(seen.requests == 1 && seen.broadcasts == 0 && entry->state == ARP_REFRESH, "aged entry refreshed by unicast");
+    check(arpLookup(host(20), mac) && mac[5] == 20, "MAC still used while refreshing");
+
+    answer(20);
+    check(entry->state == ARP_RESOLVED && entry->retries == 0, "refresh answered");
+
+    // Host gone, requests repeat and then the entry is dropped
+    clearLog();
+    age(ARP_ENTRY_TIME);
+    while (entry->state != ARP_FREE && seen.requests <= ARP_MAX_RETRIES + 1)
+        age(ARP_RETRY_TIME);
+    check(entry->state == ARP_FREE && seen.requests == ARP_MAX_RETRIES + 1, "unanswered refresh drops the entry");
+
+    // Frames waiting on a host that never answers are dropped with it
+    start();
+    sendTo(host(21), 100, 1);
+    while (arpFind(host(21)) != NULL && seen.requests <= ARP_MAX_RETRIES + 1)
+        age(ARP_RETRY_TIME);
+    check(arpFind(host(21)) == NULL && seen.requests == ARP_MAX_RETRIES + 1, "unanswered request gives up");
+    answer(21);
+    check(seen.frames == 0, "frames of a host given up on dropped");
+}
+
+// Hosts .2, .18, .34, .50 and .66 share a probe window
+void testEvict(void)
+{
+    uint8_t i;
+
+    start();
+    sendTo(host(2), 100, 1);
+    for (i = 1; i < ARP_PROBE_SLOTS; i++)
+    {
+        age(1);
+        resolved(2 + 16 * i);
+    }
+    check(arpFind(host(2)) != NULL, "waiting host in a full window");
+
+    // The oldest entry, with the frame, makes way
+    age(1);
+    resolved(2 + 16 * ARP_PROBE_SLOTS);
+    check(arpFind(host(2)) == NULL, "oldest entry evicted");
+
+    answer(2);
+    check(seen.frames == 0, "frame of an evicted entry dropped");
+    clearLog();
+    for (i = 0; i < ARP_PENDING_SLOTS; i++)
+        sendTo(host(100), 100, i + 1);
+    answer(100);
+    check(seen.frames == ARP_PENDING_SLOTS, "evicted entry leaves no slot taken");
+}
+
+int main(void)
+{
+    initEnc28j60Sim(wire);
+    etherInit(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
+    initTimer();
+
+    testGateway();
+    testPending();
+    testAging();
+    testEvict();
+
+    if (failures == 0)
+        printf("arp: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+// checksum.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Checks the word at a time checksum in checksum.c against a byte at a
+// time sum of the data in memory order (first byte low, as etherSumWords
+// summed it), for every alignment and size, with partial sums carried in,
+// data summed out of place with checksumAddAt, and incremental updates.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checksum.h"
+
+#define RUNS 20000
+
+uint16_t failures = 0;
+
+void check(bool ok, const char what[], uint32_t run)
+{
+    if (!ok && failures++ < 10)
+        printf("FAIL %s (run %u)\n", what, run);
+}
+
+uint32_t referenceAdd(uint32_t sum, const uint8_t data[], uint16_t size)
+{
+    uint16_t i;
+
+    for (i = 0; i < size; i++)
+        sum += (i & 1) ? data[i] << 8 : data[i];
+
+    return sum;
+}
+
+uint16_t referenceFold(uint32_t sum)
+{
+    while ((sum >> 16) != 0)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return ~sum;
+}
+
+// 0 and 0xFFFF are the same value in 1's complement
+bool sameChecksum(uint16_t a, uint16_t b)
+{
+    return a == b || (a == 0 && b == 0xFFFF) || (a == 0xFFFF && b == 0);
+}
+
+int main(void)
+{
+    static const uint8_t rfc1071[8] = {0x00, 0x01, 0xF2, 0x03, 0xF4, 0xF5, 0xF6, 0xF7};
+    uint8_t buffer[1600 + 8], joined[1600];
+    uint32_t run, sum, start, oldValue, newValue;
+    uint16_t offset, size, split, field, before;
+
+    srand(1);
+
+    // Example from RFC 1071 1.4, 0xDDF2 in network order
+    check(checksumFold(checksumAdd(0, rfc1071, 8)) == (uint16_t)~0xF2DD, "RFC 1071 example", 0);
+    check(checksumFold(checksumAdd(0x1234, rfc1071, 0)) == referenceFold(0x1234), "empty data", 0);
+
+    for (run = 0; run < RUNS; run++)
+    {
+        offset = rand() % 8;
+        size = rand() % 1600;
+        start = rand() % 0x100000;
+        for (split = 0; split < size + 8; split++)
+            buffer[split] = rand();
+
+        sum = checksumAdd(start, buffer + offset, size);
+        check(checksumFold(sum) == referenceFold(referenceAdd(start, buffer + offset, size)), "checksumAdd", run);
+
+        // Header summed in place, payload from a buffer at another alignment
+        split = size == 0 ? 0 : rand() % (size + 1);
+        memcpy(joined, buffer + offset, size);
+        sum = checksumAdd(start, joined, split);
+        sum = checksumAddAt(sum, buffer + offset + split, size - split, split);
+        check(sameChecksum(checksumFold(sum), referenceFold(referenceAdd(start, buffer + offset, size))),
+              "checksumAddAt", run);
+
+        // A 16 or 32-bit field on a 16-bit boundary changes
+        if (size >= 4)
+        {
+            field = (rand() % ((size - 2) / 2)) * 2;
+            before = checksumFold(checksumAdd(0, joined, size));
+            if (field + 4 <= size && (run & 1) != 0)
+            {
+                memcpy(&oldValue, joined + field, 4);
+                newValue = rand() ^ (rand() << 16);
+                memcpy(joined + field, &newValue, 4);
+                check(sameChecksum(checksumUpdate32(before, oldValue, newValue), checksumFold(checksumAdd(0, joined, size))),
+                      "checksumUpdate32", run);
+            }
+            else
+            {
+                oldValue = joined[field] | (joined[field + 1] << 8);
+                newValue = rand() & 0xFFFF;
+                joined[field] = newValue & 0xFF;
+                joined[field + 1] = newValue >> 8;
+                check(sameChecksum(checksumUpdate16(before, oldValue, newValue), checksumFold(checksumAdd(0, joined, size))),
+                      "checksumUpdate16", run);
+            }
+        }
+    }
+
+    if (failures == 0)
+        printf("checksum: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+// enc28j60.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Runs the ENC28J60 driver against the register level model in
+// host/enc28j60sim.c and checks that frames go through the rx fifo and the
+// tx slots unchanged, including around the end of the rx fifo and with the
+// rx ring stalled, and that the driver keeps to the SPI traffic it is
+// meant to (bank cache hits, one burst per frame).
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "host.h"
+#include "ethernet.h"
+#include "enc28j60.h"
+#include "enc28j60sim.h"
+
+#define CRC_SIZE 4
+
+uint8_t wireFrames[4][MAX_PACKET_SIZE];
+uint16_t wireSizes[4];
+uint8_t wireCount = 0;
+uint8_t mac[HW_ADD_LENGTH];
+uint16_t failures = 0;
+
+void check(bool ok, const char what[])
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+void wire(const uint8_t frame[], uint16_t size)
+{
+    if (wireCount < 4)
+    {
+        memcpy(wireFrames[wireCount], frame, size);
+        wireSizes[wireCount] = size;
+    }
+    wireCount++;
+}
+
+// Frame of size bytes to dest, the payload is numbered by seed
+void makeFrame(uint8_t frame[], uint16_t size, const uint8_t dest[], uint8_t seed)
+{
+    uint16_t i;
+
+    memcpy(frame, dest, HW_ADD_LENGTH);
+    memset(frame + HW_ADD_LENGTH, 0x02, HW_ADD_LENGTH);
+    frame[12] = 0x08;
+    frame[13] = 0x00;
+    for (i = 14; i < size; i++)
+        frame[i] = seed + i * 7;
+}
+
+// Next frame from the rx ring matches the one sent, CRC included in the size
+bool takeFrame(const uint8_t frame[], uint16_t size)
+{
+    uint8_t* packet = etherGetRxBuffer();
+    bool ok;
+
+    if (packet == NULL)
+        return false;
+
+    ok = etherGetRxSize() == size + CRC_SIZE && memcmp(packet, frame, size) == 0;
+    etherFreeRxBuffer();
+    return ok;
+}
+
+void testReceive(void)
+{
+    static const uint8_t broadcast[HW_ADD_LENGTH] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    static const uint8_t multicast[HW_ADD_LENGTH] = {0x01, 0x00, 0x5E, 0x00, 0x00, 0x01};
+    uint8_t frame[MAX_PACKET_SIZE];
+    uint16_t sizes[] = {60, 64, 590, 1518, 61, 999};
+    uint16_t i;
+    bool ok;
+
+    makeFrame(frame, 64, mac, 1);
+    check(enc28j60SimReceive(frame, 64), "unicast accepted");
+    hostPoll(0);
+    check(takeFrame(frame, 64), "unicast frame");
+
+    makeFrame(frame, 300, broadcast, 2);
+    check(enc28j60SimReceive(frame, 300), "broadcast accepted");
+    hostPoll(0);
+    check(takeFrame(frame, 300), "broadcast frame");
+
+    makeFrame(frame, 64, multicast, 3);
+    check(!enc28j60SimReceive(frame, 64), "multicast filtered");
+
+    // Enough frames to go around the 5K fifo several times
+    ok = true;
+    for (i = 0; i < 60; i++)
+    {
+        makeFrame(frame, sizes[i % 6], mac, i);
+        ok &= enc28j60SimReceive(frame, sizes[i % 6]);
+        hostPoll(0);
+        ok &= takeFrame(frame, sizes[i % 6]);
+    }
+    check(ok, "frames around the rx fifo");
+    check(enc28j60SimPacketCount() == 0, "EPKTCNT drained");
+}
+
+// Frames left in the chip while the rx ring is full are drained as it is freed
+void testStall(void)
+{
+    uint8_t frame[MAX_PACKET_SIZE];
+    uint8_t i;
+    bool ok = true;
+
+    for (i = 0; i < ETHER_RX_RING_SIZE + 2; i++)
+    {
+        makeFrame(frame, 500, mac, 100 + i);
+        ok &= enc28j60SimReceive(frame, 500);
+    }
+    check(ok, "burst accepted");
+
+    hostPoll(0);
+    check(etherGetRxCount() == ETHER_RX_RING_SIZE, "ring filled");
+    check(enc28j60SimPacketCount() == 2, "rest left in the chip");
+    hostPoll(0);
+    check(enc28j60SimPacketCount() == 2, "INT masked while stalled");
+
+    for (i = 0; i < ETHER_RX_RING_SIZE + 2; i++)
+    {
+        makeFrame(frame, 500, mac, 100 + i);
+        ok &= takeFrame(frame, 500);
+        hostPoll(0);
+    }
+    check(ok, "frames in order after the stall");
+    check(etherGetRxBuffer() == NULL, "ring empty");
+}
+
+void testTransmit(void)
+{
+    uint8_t frame[MAX_PACKET_SIZE], second[MAX_PACKET_SIZE];
+    uint8_t zeros[60] = {0};
+    uint8_t i;
+
+    wireCount = 0;
+    makeFrame(frame, 42, mac, 7);
+    etherPutPacket(frame, 42);
+    check(wireCount == 1 && wireSizes[0] == 60, "short frame padded to 60");
+    check(memcmp(wireFrames[0], frame, 42) == 0 && memcmp(wireFrames[0] + 42, zeros, 18) == 0, "short frame");
+    hostPoll(0);
+    check(!txRing.busy && txRing.sendIndex == txRing.writeIndex, "slot retired by etherIsr");
+
+    // Headers and payload written as separate segments
+    wireCount = 0;
+    makeFrame(frame, 1514, mac, 8);
+    etherTxStart();
+    etherTxWrite(frame, 34);
+    etherTxWrite(frame + 34, 1514 - 34);
+    etherTxSend();
+    makeFrame(second, 100, mac, 9);
+    etherPutPacket(second, 100);
+    hostPoll(0);
+    check(wireCount == 2, "two frames sent");
+    check(wireSizes[0] == 1514 && memcmp(wireFrames[0], frame, 1514) == 0, "segmented frame");
+    check(wireSizes[1] == 100 && memcmp(wireFrames[1], second, 100) == 0, "second slot");
+
+    // One slot is queued behind the one on the wire, each INT moves one on
+    for (i = 0; i < 5; i++)
+        etherPutPacket(frame, 1514);
+    for (i = 0; i < ETHER_TX_SLOTS && txRing.busy; i++)
+        hostPoll(0);
+    check(wireCount == 7 && txRing.sendIndex == txRing.writeIndex, "back to back frames");
+}
+
+// SPI traffic of the driver operations, as counted by the model
+void testTraffic(void)
+{
+    uint8_t frame[MAX_PACKET_SIZE];
+    uint32_t small;
+
+    check(etherIsLinkUp(), "link up from PHSTAT1");
+
+    enc28j60SimClearStats();
+    etherIsDataAvailable();
+    check(enc28j60Sim.selects == 1 && enc28j60Sim.bytes == 2, "common register read is one transaction");
+
+    etherSetBank(ERXFCON);
+    enc28j60SimClearStats();
+    etherSetBank(ERXFCON);
+    etherSetBank(EIR);
+    check(enc28j60Sim.selects == 0, "bank cache hit sends nothing");
+    etherSetBank(ERXSTL);
+    check(enc28j60Sim.selects == 1, "bank 1 to 0 clears BSEL in one transaction");
+
+    // Second of two, so both start with the same bank selected
+    makeFrame(frame, 64, mac, 10);
+    enc28j60SimReceive(frame, 64);
+    hostPoll(0);
+    takeFrame(frame, 64);
+    enc28j60SimReceive(frame, 64);
+    enc28j60SimClearStats();
+    hostPoll(0);
+    small = enc28j60Sim.selects;
+    takeFrame(frame, 64);
+
+    makeFrame(frame, 1518, mac, 11);
+    enc28j60SimReceive(frame, 1518);
+    enc28j60SimClearStats();
+    hostPoll(0);
+    check(enc28j60Sim.selects == small, "frame read in one burst whatever its size");
+    takeFrame(frame, 1518);
+}
+
+int main(void)
+{
+    initEnc28j60Sim(wire);
+    etherInit(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
+    etherGetMacAddress(mac);
+
+    testReceive();
+    testStall();
+    testTransmit();
+    testTraffic();
+
+    if (failures == 0)
+        printf("enc28j60: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+// fsm.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Checks every state against every event of the TCP and DHCP state
+// machines: the dense tables give the handler listed in the transition
+// arrays or the default for anything unlisted, and DHCP never gives NULL.
+// Then every TCP flag combination is received on a connection in each state
+// and the connection must be left as the defaults say: stray segments are
+// ignored and RST closes from any state. Last the closing states are walked
+// through, each FIN answered before the connection is freed.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "host.h"
+#include "ethernet.h"
+#include "enc28j60sim.h"
+#include "packet.h"
+#include "checksum.h"
+#include "timers.h"
+#include "arp.h"
+#include "tcp.h"
+#include "dhcp.h"
+
+uint8_t remoteIp[IP_ADD_LENGTH] = {192, 168, 1, 2};
+uint16_t failures = 0;
+uint8_t sentFlags = 0;    // TCP flags of the last segment the device sent
+
+void check(bool ok, const char what[])
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Only the flags of TCP segments the device sends are looked at
+void wire(const uint8_t frame[], uint16_t size)
+{
+    if (size >= 54 && frame[12] == 0x08 && frame[13] == 0x00 && frame[23] == 6)
+        sentFlags = frame[47];
+}
+
+// State machine step of tcpHandler in main.c
+void tcpStep(packetInfo* info)
+{
+    transCtrlBlock* connection;
+    uint16_t event = info->tcpFlags & 0x001F;
+
+    if ((connection = tcpFindTcb(info->packet)) != NULL)
+    {
+        tcb = connection;
+        (*tcpLookup(tcb->state, (tcpSysEvent)event))(info->packet, event);
+    }
+}
+
+_tcpCallback expectedTcp(tcpSysState state, uint8_t flags)
+{
+    uint8_t i;
+
+    for (i = 0; i < tcpStateTransitionCount; i++)
+    {
+        if (tcpStateTransitions[i].state == state && tcpStateTransitions[i].event == flags)
+            return tcpStateTransitions[i].eventHandler;
+    }
+
+    if (flags & RST)
+        return (_tcpCallback)tcpClose;
+    return (_tcpCallback)dupTcpMsg;
+}
+
+_dhcpCallback expectedDhcp(dhcpSysState state, uint8_t event)
+{
+    uint8_t i;
+
+    for (i = 0; i < stateTransitionCount; i++)
+    {
+        if (stateTransitions[i].state == state && stateTransitions[i].event == event)
+            return stateTransitions[i].eventHandler;
+    }
+
+    return (_dhcpCallback)dhcpIgnoreEvent;
+}
+
+void testTables(void)
+{
+    uint16_t state, event;
+    uint16_t wrong = 0, missing = 0;
+
+    for (state = 0; state < TCP_NUM_STATES; state++)
+    {
+        for (event = 0; event < 32; event++)
+            wrong += tcpLookup(state, event) != expectedTcp(state, event);
+    }
+    check(wrong == 0, "TCP table matches transitions and defaults");
+
+    wrong = 0;
+    for (state = 0; state < DHCP_NUM_STATES; state++)
+    {
+        for (event = 0; event < 256; event++)
+        {
+            missing += dhcpLookup(state, event) == NULL;
+            wrong += dhcpLookup(state, event) != expectedDhcp(state, event);
+        }
+    }
+    check(missing == 0, "DHCP lookup never NULL");
+    check(wrong == 0, "DHCP table matches transitions and defaults");
+}
+
+// Segment from 192.168.1.2 port 40000 to port 8080 with one byte of data
+uint16_t makeSegment(uint8_t frame[], uint8_t flags)
+{
+    etherFrame* ether = (etherFrame*)frame;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    tcpFrame* tcp     = (tcpFrame*)&frame[14 + sizeof(ipFrame)];
+
+    memset(frame, 0, MAX_PACKET_SIZE);
+    memcpy(ether->destAddress, macAddress, HW_ADD_LENGTH);
+    memset(ether->sourceAddress, 0x02, HW_ADD_LENGTH);
+    ether->frameType = htons(0x0800);
+
+    ip->revSize  = 0x45;
+    ip->length   = htons(sizeof(ipFrame) + sizeof(tcpFrame) + 1);
+    ip->ttl      = 64;
+    ip->protocol = 6;
+    memcpy(ip->sourceIp, remoteIp, IP_ADD_LENGTH);
+    memcpy(ip->destIp, ipAddress, IP_ADD_LENGTH);
+    ip->headerChecksum = checksumFold(checksumAdd(0, &ip->revSize, sizeof(ipFrame)));
+
+    tcp->sourcePort     = htons(40000);
+    tcp->destPort       = htons(8080);
+    tcp->seqNum         = htons32(1000);
+    tcp->ackNum         = htons32(2000);
+    tcp->dataCtrlFields = htons(0x5000 | flags);
+    tcp->window         = htons(1024);
+    tcp->data[0]        = 'x';
+
+    return 14 + sizeof(ipFrame) + sizeof(tcpFrame) + 1;
+}
+
+// Connection to 192.168.1.2 port 40000 from port 8080 in state
+transCtrlBlock* openConnection(tcpSysState state)
+{
+    tcb = &tcbTable[TCP_MQTT_TCB + 1];
+    setUpTcb();
+    tcb->inUse      = true;
+    tcb->state      = state;
+    tcb->remotePort = 40000;
+    tcb->localPort  = 8080;
+    memcpy(tcb->remoteIp, remoteIp, IP_ADD_LENGTH);
+    return tcb;
+}
+
+void testSegments(void)
+{
+    uint8_t frame[MAX_PACKET_SIZE];
+    uint16_t state, flags, size;
+    uint16_t invalid = 0, ignoredWrong = 0, closedWrong = 0;
+    _tcpCallback handler;
+    transCtrlBlock* c;
+
+    packetRegister(PACKET_TCP, tcpStep);
+
+    for (state = 0; state < TCP_NUM_STATES; state++)
+    {
+        for (flags = 0; flags < 32; flags++)
+        {
+            c = openConnection(state);
+            handler = expectedTcp(state, flags);
+            size = makeSegment(frame, flags);
+            packetDispatch(frame, size);
+
+            invalid += c->state >= TCP_NUM_STATES;
+            if (handler == (_tcpCallback)dupTcpMsg)
+                ignoredWrong += !c->inUse || c->state != state;
+            else if (handler == (_tcpCallback)tcpClose)
+                closedWrong += c->inUse || c->state != CLOSED;
+        }
+    }
+    check(invalid == 0, "connections stay in a valid state");
+    check(ignoredWrong == 0, "stray segments ignored in every state");
+    check(closedWrong == 0, "RST closes the connection");
+
+    // A few listed transitions through the same path
+    c = openConnection(LISTEN);
+    packetDispatch(frame, makeSegment(frame, SYN));
+    check(c->state == SYN_RECEIVED && c->inUse, "SYN in LISTEN moves to SYN_RECEIVED");
+    packetDispatch(frame, makeSegment(frame, ACK));
+    check(c->state == ESTABLISHED, "ACK in SYN_RECEIVED establishes");
+    packetDispatch(frame, makeSegment(frame, RST | ACK));
+    check(c->state == CLOSED && !c->inUse, "RST+ACK in ESTABLISHED closes");
+}
+
+// Segment with flags received on c, returns true if the device answered with reply
+bool answered(uint8_t flags, uint8_t reply)
+{
+    uint8_t frame[MAX_PACKET_SIZE];
+
+    sentFlags = 0;
+    packetDispatch(frame, makeSegment(frame, flags));
+
+    // Retire the frame on the wire and start the one queued, etherIsr does this on the device
+    etherTxPoll();
+    return sentFlags == reply;
+}
+
+void testClosing(void)
+{
+    transCtrlBlock* c;
+    arpEntry* entry;
+
+    // Replies go out without waiting on ARP, earlier ones left a request outstanding
+    if ((entry = arpFind(remoteIp)) == NULL)
+        entry = arpInsert(remoteIp);
+    memset(entry->mac, 0x02, HW_ADD_LENGTH);
+    entry->state = ARP_RESOLVED;
+    entry->time  = timerGetTicks();
+
+    // Peer closes first, its FIN is answered with ours
+    c = openConnection(ESTABLISHED);
+    check(answered(FIN | ACK, FIN | ACK) && c->state == LAST_ACK, "FIN+ACK in ESTABLISHED answered with FIN+ACK");
+    check(answered(FIN | ACK, FIN | ACK) && c->state == LAST_ACK, "repeated FIN+ACK answered again");
+    check(answered(ACK, 0) && !c->inUse, "ACK of our FIN frees the connection");
+
+    c = openConnection(ESTABLISHED);
+    check(answered(FIN, FIN | ACK) && c->state == LAST_ACK, "FIN in ESTABLISHED answered with FIN+ACK");
+
+    // Our FIN went first
+    c = openConnection(FIN_WAIT_1);
+    check(answered(ACK, 0) && c->state == FIN_WAIT_2 && c->inUse, "ACK in FIN_WAIT_1 waits for the peer's FIN");
+    check(answered(FIN | ACK, ACK) && !c->inUse, "FIN+ACK in FIN_WAIT_2 acknowledged and freed");
+
+    c = openConnection(FIN_WAIT_1);
+    check(answered(FIN | ACK, ACK) && !c->inUse, "FIN+ACK in FIN_WAIT_1 acknowledged and freed");
+
+    // DISCONNECT sent, the broker acknowledges it and then closes
+    c = openConnection(CLOSING);
+    check(answered(ACK, 0) && c->state == CLOSING && c->inUse, "ACK in CLOSING kept");
+    check(answered(FIN | ACK, FIN | ACK) && c->state == LAST_ACK, "FIN+ACK in CLOSING answered with FIN+ACK");
+
+    // Stray segments leave the other states as they are
+    c = openConnection(SYN_SENT);
+    check(answered(ACK, 0) && c->state == SYN_SENT && c->inUse, "stray ACK in SYN_SENT ignored");
+}
+
+int main(void)
+{
+    initEnc28j60Sim(wire);
+    etherInit(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
+    initTimer();
+    initPackets();
+    initArp();
+    tcpInitStateTable();
+    dhcpInitStateTable();
+
+    testTables();
+    testSegments();
+    testClosing();
+
+    if (failures == 0)
+        printf("fsm: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+// mqtt.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Plays the MQTT broker to the host build of the firmware and checks how
+// MQTT packets are framed in the TCP stream: Remaining Lengths over 127 in
+// and out, a publish of more than 256 bytes out, several packets in one segment, and packets or their Remaining
+// Length split across segments, which are stepped over without losing the
+// packets after them.
+// Usage: mqtt IOT_PROGRAM WORK_DIRECTORY
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "peer.h"
+
+#define QOS0 0x30
+
+// Device acknowledged everything the broker sent
+bool acked(const peerConnection* c)
+{
+    peerSegment segment;
+
+    return peerReceiveTcp(&segment, 500) && segment.host == PEER_BROKER && segment.ack == c->hostSeq;
+}
+
+// Payload of size bytes that can be found in the console output
+void fill(char payload[], uint16_t size, char first)
+{
+    uint16_t i;
+
+    for (i = 0; i < size; i++)
+        payload[i] = first + i % 26;
+    payload[size] = '\0';
+}
+
+void testLongIn(peerConnection* c)
+{
+    uint8_t packet[300];
+    char payload[201];
+    uint16_t size;
+
+    // Remaining Length of 210 takes two bytes, the print rule shows the start
+    fill(payload, 200, 'a');
+    size = peerMakePublish(packet, QOS0, "env/temp", 0, payload, 200);
+    check(packet[1] == (0x80 | (210 % 128)) && packet[2] == 210 / 128, "two byte Remaining Length sent");
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet, size);
+    check(acked(c), "long publish acknowledged");
+
+    payload[100] = '\0';
+    check(peerOutput(payload, 1000), "long publish delivered");
+}
+
+void testLongOut(peerConnection* c)
+{
+    uint8_t packet[300];
+    char payload[121];
+    peerSegment segment;
+    uint16_t size;
+
+    // Payload sent on by a rule, 2 + 7 + 120 = 129 bytes of Remaining Length.
+    // The rule is listed so it is known to be in before the publish comes.
+    peerCommand("rule add env/big pub out/big payload");
+    peerCommand("rule list");
+    check(peerOutput("env/big pub out/big payload", 1000), "rule added");
+    fill(payload, 120, 'A');
+    size = peerMakePublish(packet, QOS0, "env/big", 0, payload, 120);
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet, size);
+    check(acked(c), "publish for the rule acknowledged");
+
+    check(peerReceiveMqtt(c, &segment, 1000), "long publish sent");
+    check(segment.size == 3 + 129 && (segment.data[0] & 0xF0) == QOS0 && segment.data[1] == 0x81 && segment.data[2] == 0x01,
+          "two byte Remaining Length received");
+    check(memcmp(segment.data + 3, "\x00\x07out/big", 9) == 0 && memcmp(segment.data + 12, payload, 120) == 0,
+          "long publish topic and payload");
+}
+
+// Publish of more than 256 bytes goes out whole in one segment,
+// 2 + 8 + 290 = 300 bytes of Remaining Length
+void testSegmentOut(peerConnection* c)
+{
+    uint8_t packet[400];
+    char payload[291];
+    peerSegment segment;
+    uint16_t size;
+
+    peerCommand("rule add env/huge pub out/huge payload");
+    peerCommand("rule list");
+    check(peerOutput("env/huge pub out/huge payload", 1000), "rule for a long payload added");
+    fill(payload, 290, 'a');
+    size = peerMakePublish(packet, QOS0, "env/huge", 0, payload, 290);
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet, size);
+    check(acked(c), "publish for the long payload rule acknowledged");
+
+    check(peerReceiveMqtt(c, &segment, 1000), "publish over 256 bytes sent");
+    check(segment.size == 3 + 300 && segment.data[1] == (0x80 | (300 % 128)) && segment.data[2] == 300 / 128,
+          "publish over 256 bytes in one segment");
+    check(memcmp(segment.data + 3, "\x00\x08out/huge", 10) == 0 && memcmp(segment.data + 13, payload, 290) == 0,
+          "publish over 256 bytes topic and payload");
+}
+
+void testSeveral(peerConnection* c)
+{
+    uint8_t packet[300];
+    uint16_t size;
+
+    size  = peerMakePublish(packet, QOS0, "env/temp", 0, "31", 2);
+    size += peerMakePublish(packet + size, QOS0, "env/temp", 0, "32", 2);
+    size += peerMakePublish(packet + size, QOS0, "env/temp", 0, "33", 2);
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet, size);
+    check(acked(c), "three publishes acknowledged");
+
+    check(peerOutput("31", 1000), "first publish of a segment delivered");
+    check(peerOutput("32", 1000), "second publish of a segment delivered");
+    check(peerOutput("33", 1000), "third publish of a segment delivered");
+}
+
+// Publish of 200 bytes cut after split bytes, the rest goes in the next
+// segment followed by a publish of next
+void testSplit(peerConnection* c, uint16_t split, const char next[])
+{
+    uint8_t packet[600];
+    char payload[201];
+    uint16_t size;
+
+    fill(payload, 200, 'a');
+    size  = peerMakePublish(packet, QOS0, "env/temp", 0, payload, 200);
+    size += peerMakePublish(packet + size, QOS0, "env/temp", 0, next, strlen(next));
+
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet, split);
+    check(acked(c), "first part acknowledged");
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet + split, size - split);
+    check(acked(c), "second part acknowledged");
+
+    check(peerOutput(next, 1000), "publish after a split packet delivered");
+}
+
+int main(int argc, char* argv[])
+{
+    peerConnection broker;
+
+    if (argc != 3)
+        return 2;
+
+    check(peerStart(argv[1], argv[2]), "device started");
+    check(peerConnectBroker(&broker), "broker connection");
+
+    if (failures == 0)
+    {
+        testLongIn(&broker);
+        testLongOut(&broker);
+        testSegmentOut(&broker);
+        testSeveral(&broker);
+        testSplit(&broker, 60, "77");
+        testSplit(&broker, 2, "78");
+    }
+
+    check(peerStop(), "device exited cleanly");
+
+    if (failures == 0)
+        printf("mqtt: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+// mqttlength.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Checks the MQTT Remaining Length codec against the table in section
+// 2.2.3 of the MQTT 3.1.1 spec, then against a reference decoder for random
+// values and random bytes, fed a byte at a time as they come off segments,
+// and that getMqttVariableHeader never gives a packet that runs past the
+// bytes it was handed.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mqtt.h"
+
+#define RUNS 100000
+
+typedef struct
+{
+    uint32_t value;
+    uint8_t  size;
+    uint8_t  encoded[MQTT_MAX_LENGTH_BYTES];
+} lengthCase;
+
+// First and last value of each field size
+const lengthCase spec[] =
+{
+    {0,         1, {0x00}},
+    {127,       1, {0x7F}},
+    {128,       2, {0x80, 0x01}},
+    {16383,     2, {0xFF, 0x7F}},
+    {16384,     3, {0x80, 0x80, 0x01}},
+    {2097151,   3, {0xFF, 0xFF, 0x7F}},
+    {2097152,   4, {0x80, 0x80, 0x80, 0x01}},
+    {268435455, 4, {0xFF, 0xFF, 0xFF, 0x7F}}
+};
+
+uint16_t failures = 0;
+
+void check(bool ok, const char what[])
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Decodes the field at encoded a byte at a time, returns its size or 0 if
+// it is malformed
+uint8_t decode(const uint8_t encoded[], uint32_t* value)
+{
+    mqttLengthDecoder decoder;
+    mqttLengthStatus status;
+    uint8_t i = 0;
+
+    resetRemainingLength(&decoder);
+    do
+        status = decodeRemainingLength(&decoder, encoded[i++]);
+    while (status == LENGTH_INCOMPLETE);
+
+    *value = decoder.value;
+    return status == LENGTH_COMPLETE ? i : 0;
+}
+
+// Decoding as the spec writes it, 0 if malformed
+uint8_t reference(const uint8_t encoded[], uint32_t* value)
+{
+    uint8_t i;
+
+    *value = 0;
+    for (i = 0; i < MQTT_MAX_LENGTH_BYTES; i++)
+    {
+        *value += (uint32_t)(encoded[i] & 127) << (7 * i);
+        if ((encoded[i] & 128) == 0)
+            return i + 1;
+    }
+
+    return 0;
+}
+
+uint32_t randomValue(void)
+{
+    return ((uint32_t)rand() << 16) ^ rand();
+}
+
+void testSpec(void)
+{
+    uint8_t encoded[MQTT_MAX_LENGTH_BYTES + 1];
+    uint32_t value;
+    uint8_t i;
+
+    for (i = 0; i < sizeof(spec) / sizeof(spec[0]); i++)
+    {
+        memset(encoded, 0xEE, sizeof(encoded));
+        check(encodeRemainingLength(encoded, spec[i].value) == spec[i].size &&
+              memcmp(encoded, spec[i].encoded, spec[i].size) == 0 && encoded[spec[i].size] == 0xEE,
+              "encoding in the spec table");
+        check(decode(spec[i].encoded, &value) == spec[i].size && value == spec[i].value,
+              "decoding in the spec table");
+    }
+
+    memset(encoded, 0xFF, sizeof(encoded));
+    check(decode(encoded, &value) == 0, "fifth byte is malformed");
+}
+
+void testRandom(void)
+{
+    uint8_t encoded[MQTT_MAX_LENGTH_BYTES];
+    uint32_t value, expected, i;
+    uint8_t size, j;
+    uint16_t wrong = 0, mismatch = 0;
+
+    for (i = 0; i < RUNS; i++)
+    {
+        // Spread over all four sizes
+        value = randomValue() >> (4 + 7 * (i & 3));
+        size = encodeRemainingLength(encoded, value);
+        wrong += decode(encoded, &expected) != size || expected != value ||
+                 size != (value < 128 ? 1 : value < 16384 ? 2 : value < 2097152 ? 3 : 4);
+
+        for (j = 0; j < MQTT_MAX_LENGTH_BYTES; j++)
+            encoded[j] = rand();
+        size = reference(encoded, &expected);
+        mismatch += decode(encoded, &value) != size || (size != 0 && value != expected);
+    }
+
+    check(wrong == 0, "random values round trip in the fewest bytes");
+    check(mismatch == 0, "random bytes decode as the spec says");
+}
+
+void testBounds(void)
+{
+    uint8_t packet[MQTT_MAX_LENGTH_BYTES + 300];
+    uint8_t* body;
+    uint32_t length, value, i;
+    uint16_t size;
+    uint8_t fieldSize;
+    uint16_t wrong = 0;
+
+    for (i = 0; i < RUNS; i++)
+    {
+        // Control byte and a field of random bytes, or one for a packet near the size
+        for (size = 0; size < sizeof(packet); size++)
+            packet[size] = rand();
+        if (i & 1)
+            encodeRemainingLength(packet + 1, rand() % 300);
+        size = 1 + rand() % (sizeof(packet) - 1);
+
+        fieldSize = reference(packet + 1, &value);
+        body = getMqttVariableHeader((mqttFrame*)packet, size, &length);
+
+        if (fieldSize == 0 || 1 + fieldSize + value > size)
+            wrong += body != NULL;
+        else
+            wrong += body != packet + 1 + fieldSize || length != value;
+    }
+
+    check(wrong == 0, "packets are only given whole");
+}
+
+int main(void)
+{
+    srand(1);
+
+    testSpec();
+    testRandom();
+    testBounds();
+
+    if (failures == 0)
+        printf("mqttlength: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+// packet.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Checks packetClassify on frames of every type it sorts, with IP and TCP
+// options moving the offsets, and on frames it must drop: truncated ARP,
+// a bad IP header checksum, fragments, lengths past the end of the frame
+// and other Ethernet types. Last packetDispatch passes each type to the
+// handler registered for it and drops types with none.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "ethernet.h"
+#include "checksum.h"
+#include "tcp.h"
+#include "packet.h"
+
+uint16_t failures = 0;
+uint8_t frame[MAX_PACKET_SIZE];
+packetInfo info;
+uint8_t handled[PACKET_NUM_TYPES];
+
+void check(bool ok, const char what[])
+{
+    if (!ok && failures++ < 10)
+        printf("FAIL %s\n", what);
+}
+
+// IPv4 header with ipOptions bytes of options and l4Size bytes after it,
+// returns the offset of the ICMP, UDP or TCP header
+uint16_t putIp(uint8_t protocol, uint8_t ipOptions, uint16_t l4Size)
+{
+    etherFrame* ether = (etherFrame*)frame;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    uint16_t headerSize = sizeof(ipFrame) + ipOptions;
+
+    memset(frame, 0, sizeof(frame));
+    memset(ether->destAddress, 0x02, HW_ADD_LENGTH);
+    ether->frameType   = htons(0x0800);
+    ip->revSize        = 0x40 | (headerSize / 4);
+    ip->length         = htons(headerSize + l4Size);
+    ip->flagsAndOffset = htons(0x4000);
+    ip->ttl            = 64;
+    ip->protocol       = protocol;
+    ip->headerChecksum = checksumFold(checksumAdd(0, &ip->revSize, headerSize));
+
+    return 14 + headerSize;
+}
+
+uint16_t putUdp(uint16_t sourcePort, uint16_t destPort, uint16_t dataSize)
+{
+    uint16_t offset = putIp(17, 0, 8 + dataSize);
+    udpFrame* udp = (udpFrame*)&frame[offset];
+
+    udp->sourcePort = htons(sourcePort);
+    udp->destPort   = htons(destPort);
+    udp->length     = htons(8 + dataSize);
+
+    return offset + 8 + dataSize;
+}
+
+uint16_t putTcp(uint8_t ipOptions, uint8_t tcpOptions, uint16_t flags, uint16_t dataSize)
+{
+    uint16_t headerSize = sizeof(tcpFrame) + tcpOptions;
+    uint16_t offset = putIp(6, ipOptions, headerSize + dataSize);
+    tcpFrame* tcp = (tcpFrame*)&frame[offset];
+
+    tcp->sourcePort     = htons(1883);
+    tcp->destPort       = htons(49152);
+    tcp->dataCtrlFields = htons(((headerSize / 4) << 12) | flags);
+
+    return offset + headerSize + dataSize;
+}
+
+void testTypes(void)
+{
+    etherFrame* ether = (etherFrame*)frame;
+    uint16_t size;
+
+    memset(frame, 0, sizeof(frame));
+    ether->frameType = htons(0x0806);
+    check(packetClassify(frame, 14 + sizeof(arpFrame), &info) == PACKET_ARP, "arp");
+    check(packetClassify(frame, 14 + sizeof(arpFrame) - 1, &info) == PACKET_DROP, "truncated arp dropped");
+
+    size = putIp(1, 0, 8 + 32) + 8 + 32;
+    check(packetClassify(frame, size, &info) == PACKET_ICMP && info.protocol == 1, "icmp");
+    check(info.l4Offset == 34 && info.dataOffset == 42 && info.dataSize == 32, "icmp offsets");
+
+    size = putUdp(67, 68, 300);
+    check(packetClassify(frame, size, &info) == PACKET_DHCP, "dhcp");
+    check(info.dataOffset == 42 && info.dataSize == 300, "dhcp offsets");
+
+    size = putUdp(68, 67, 300);
+    check(packetClassify(frame, size, &info) == PACKET_UDP, "udp to server port is not dhcp");
+    check(info.sourcePort == 68 && info.destPort == 67, "udp ports");
+
+    size = putTcp(0, 0, 0x18, 100);
+    check(packetClassify(frame, size, &info) == PACKET_TCP, "tcp");
+    check(info.sourcePort == 1883 && info.destPort == 49152, "tcp ports");
+    check((info.tcpFlags & 0x1F) == 0x18 && info.l4Offset == 34, "tcp flags");
+    check(info.dataOffset == 54 && info.dataSize == 100, "tcp offsets");
+
+    // Frame padded past the IP length, as short frames are on the wire
+    size = putTcp(0, 0, 0x10, 0);
+    check(packetClassify(frame, 60, &info) == PACKET_TCP && info.dataSize == 0, "padded ack has no data");
+}
+
+void testOptions(void)
+{
+    uint16_t size;
+
+    size = putTcp(4, 12, 0x18, 10);
+    check(packetClassify(frame, size, &info) == PACKET_TCP, "tcp with options");
+    check(info.l4Offset == 38, "ip options move the tcp header");
+    check(info.dataOffset == 38 + 32 && info.dataSize == 10, "tcp options move the data");
+
+    size = putIp(1, 8, 8) + 8;
+    check(packetClassify(frame, size, &info) == PACKET_ICMP && info.l4Offset == 42, "icmp after ip options");
+}
+
+void testDrops(void)
+{
+    etherFrame* ether = (etherFrame*)frame;
+    ipFrame* ip       = (ipFrame*)&ether->data;
+    tcpFrame* tcp;
+    udpFrame* udp;
+    uint16_t size;
+
+    size = putTcp(0, 0, 0x18, 100);
+    ip->headerChecksum ^= 0x0100;
+    check(packetClassify(frame, size, &info) == PACKET_DROP, "bad ip checksum dropped");
+
+    size = putTcp(0, 0, 0x18, 100);
+    check(packetClassify(frame, size - 1, &info) == PACKET_DROP, "ip length past frame dropped");
+
+    size = putTcp(0, 0, 0x18, 100);
+    ip->flagsAndOffset = htons(0x2000);
+    ip->headerChecksum = 0;
+    ip->headerChecksum = checksumFold(checksumAdd(0, &ip->revSize, 20));
+    check(packetClassify(frame, size, &info) == PACKET_DROP, "first fragment dropped");
+
+    size = putTcp(0, 0, 0x18, 100);
+    ip->flagsAndOffset = htons(0x0010);
+    ip->headerChecksum = 0;
+    ip->headerChecksum = checksumFold(checksumAdd(0, &ip->revSize, 20));
+    check(packetClassify(frame, size, &info) == PACKET_DROP, "later fragment dropped");
+
+    size = putTcp(0, 0, 0x18, 8);
+    tcp = (tcpFrame*)&frame[34];
+    tcp->dataCtrlFields = htons((8 << 12) | 0x18);
+    check(packetClassify(frame, size, &info) == PACKET_DROP, "tcp header past ip length dropped");
+    tcp->dataCtrlFields = htons((4 << 12) | 0x18);
+    check(packetClassify(frame, size, &info) == PACKET_DROP, "tcp header under 20 bytes dropped");
+
+    size = putUdp(67, 68, 20);
+    udp = (udpFrame*)&frame[34];
+    udp->length = htons(8 + 21);
+    check(packetClassify(frame, size, &info) == PACKET_DROP, "udp length past ip length dropped");
+
+    size = putIp(1, 0, 4) + 4;
+    check(packetClassify(frame, size, &info) == PACKET_DROP, "short icmp dropped");
+
+    size = putTcp(0, 0, 0x18, 100);
+    ether->frameType = htons(0x86DD);
+    check(packetClassify(frame, size, &info) == PACKET_DROP, "ipv6 dropped");
+
+    size = putTcp(0, 0, 0x18, 100);
+    check(packetClassify(frame, 14 + sizeof(ipFrame) - 1, &info) == PACKET_DROP, "short ip dropped");
+}
+
+void countArp(packetInfo* info)
+{
+    handled[PACKET_ARP]++;
+}
+
+void countTcp(packetInfo* info)
+{
+    handled[PACKET_TCP]++;
+    check(info == &rxInfo && info->dataSize == 100, "handler given rxInfo");
+}
+
+void testDispatch(void)
+{
+    etherFrame* ether = (etherFrame*)frame;
+    uint16_t size;
+
+    initPackets();
+    packetRegister(PACKET_ARP, countArp);
+    packetRegister(PACKET_TCP, countTcp);
+    memset(handled, 0, sizeof(handled));
+
+    size = putTcp(0, 0, 0x18, 100);
+    packetDispatch(frame, size);
+    size = putUdp(67, 68, 300);
+    packetDispatch(frame, size);
+    memset(frame, 0, sizeof(frame));
+    ether->frameType = htons(0x0806);
+    packetDispatch(frame, 60);
+
+    check(handled[PACKET_TCP] == 1 && handled[PACKET_ARP] == 1, "registered handlers called once");
+    check(rxInfo.type == PACKET_ARP, "rxInfo holds the last frame");
+}
+
+int main(void)
+{
+    testTypes();
+    testOptions();
+    testDrops();
+    testDispatch();
+
+    if (failures == 0)
+        printf("packet: ok\n");
+    return failures == 0 ? 0 : 1;
+}
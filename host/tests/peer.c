@@ -0,0 +1,416 @@
+// peer.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "peer.h"
+
+#define PEER_OUTPUT_SIZE 65536
+
+uint8_t deviceMac[6] = {2, 3, 4, 5, 6, 106};
+uint8_t deviceIp[4]  = {192, 168, 1, 106};
+uint16_t failures = 0;
+
+pid_t peerPid = -1;
+int peerSocket = -1;
+int peerStdin = -1;
+int peerStdout = -1;
+char peerText[PEER_OUTPUT_SIZE];
+uint32_t peerTextSize = 0;
+uint32_t peerTextMark = 0;      // Output before this was matched by peerOutput
+char peerEeprom[512];
+
+void check(bool ok, const char what[])
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+uint32_t peerNow(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+uint16_t get16(const uint8_t data[])
+{
+    return (data[0] << 8) | data[1];
+}
+
+uint32_t get32(const uint8_t data[])
+{
+    return ((uint32_t)get16(data) << 16) | get16(data + 2);
+}
+
+void put16(uint8_t data[], uint16_t value)
+{
+    data[0] = value >> 8;
+    data[1] = value;
+}
+
+void put32(uint8_t data[], uint32_t value)
+{
+    put16(data, value >> 16);
+    put16(data + 2, value);
+}
+
+uint32_t sumAdd(uint32_t sum, const uint8_t data[], uint16_t size)
+{
+    uint16_t i;
+
+    for (i = 0; i + 1 < size; i += 2)
+        sum += get16(data + i);
+    if (size & 1)
+        sum += data[size - 1] << 8;
+
+    return sum;
+}
+
+uint16_t sumFold(uint32_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return ~sum & 0xFFFF;
+}
+
+// TCP checksum over the pseudo-header and segment of an IP packet
+uint16_t tcpSum(const uint8_t ip[], uint16_t tcpSize)
+{
+    uint32_t sum = sumAdd(0, ip + 12, 8);
+
+    sum += 6 + tcpSize;
+    return sumFold(sumAdd(sum, ip + (ip[0] & 0x0F) * 4, tcpSize));
+}
+
+void hostMac(uint8_t mac[], uint8_t host)
+{
+    static const uint8_t base[6] = {2, 0, 0, 0, 0, 0};
+
+    memcpy(mac, base, 6);
+    mac[5] = host;
+}
+
+// Console output seen so far is kept for peerOutput
+void peerReadOutput(void)
+{
+    ssize_t size;
+
+    while (peerTextSize < PEER_OUTPUT_SIZE - 1 &&
+           (size = read(peerStdout, peerText + peerTextSize, PEER_OUTPUT_SIZE - 1 - peerTextSize)) > 0)
+        peerTextSize += size;
+    peerText[peerTextSize] = '\0';
+}
+
+// Erased EEPROM leaves the device on its static address, 192.168.1.106
+bool peerStart(const char program[], const char workDirectory[])
+{
+    int pair[2], in[2], out[2];
+    char fd[16];
+    uint8_t frame[PEER_MAX_FRAME];
+
+    snprintf(peerEeprom, sizeof(peerEeprom), "%s/peer_eeprom_%d.bin", workDirectory, (int)getpid());
+    unlink(peerEeprom);
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair) < 0 || pipe(in) < 0 || pipe(out) < 0)
+        return false;
+    signal(SIGPIPE, SIG_IGN);
+
+    if ((peerPid = fork()) == 0)
+    {
+        snprintf(fd, sizeof(fd), "%d", pair[1]);
+        setenv("IOT_FD", fd, 1);
+        setenv("IOT_EEPROM", peerEeprom, 1);
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        close(pair[0]);
+        close(in[1]);
+        close(out[0]);
+        execl(program, program, (char*)NULL);
+        _exit(127);
+    }
+
+    close(pair[1]);
+    close(in[0]);
+    close(out[1]);
+    peerSocket = pair[0];
+    peerStdin = in[1];
+    peerStdout = out[0];
+    fcntl(peerStdout, F_SETFL, O_NONBLOCK);
+    if (peerPid < 0)
+        return false;
+
+    // Booted once it announces its address
+    return peerReceiveFrame(frame, 2000) != 0 && peerOutput("reboot", 2000);
+}
+
+// Closing its end of the socket pair ends the program
+bool peerStop(void)
+{
+    int status;
+
+    close(peerSocket);
+    close(peerStdin);
+    if (waitpid(peerPid, &status, 0) != peerPid)
+        return false;
+    peerReadOutput();
+    close(peerStdout);
+    unlink(peerEeprom);
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void peerCommand(const char line[])
+{
+    if (write(peerStdin, line, strlen(line)) < 0 || write(peerStdin, "\n", 1) < 0)
+        check(false, "console write");
+}
+
+// Waits for text in the console output written since the last match
+bool peerOutput(const char text[], uint32_t timeoutMs)
+{
+    uint32_t start = peerNow();
+    char* found;
+
+    do
+    {
+        peerReadOutput();
+        if ((found = strstr(peerText + peerTextMark, text)) != NULL)
+        {
+            peerTextMark = found + strlen(text) - peerText;
+            return true;
+        }
+        usleep(1000);
+    }
+    while (peerNow() - start < timeoutMs);
+
+    return false;
+}
+
+void peerSendFrame(const uint8_t frame[], uint16_t size)
+{
+    if (write(peerSocket, frame, size) < 0)
+        check(false, "frame write");
+}
+
+// Next frame from the device, 0 if none came in time
+uint16_t peerReceiveFrame(uint8_t frame[], uint32_t timeoutMs)
+{
+    struct pollfd fds = {peerSocket, POLLIN, 0};
+    ssize_t size;
+
+    if (poll(&fds, 1, timeoutMs) <= 0 || (size = read(peerSocket, frame, PEER_MAX_FRAME)) <= 0)
+        return 0;
+
+    return size;
+}
+
+// Says host is at its MAC
+void peerArpReply(const uint8_t request[])
+{
+    uint8_t frame[60] = {0};
+
+    memcpy(frame, request + 6, 6);
+    hostMac(frame + 6, request[41]);
+    frame[12] = 0x08; frame[13] = 0x06;
+    frame[15] = 1; frame[16] = 0x08; frame[18] = 6; frame[19] = 4; frame[21] = 2;
+    memcpy(frame + 22, frame + 6, 6);
+    memcpy(frame + 28, request + 38, 4);
+    memcpy(frame + 32, request + 22, 10);
+    peerSendFrame(frame, sizeof(frame));
+}
+
+void peerSendTcpAt(const peerConnection* c, uint32_t seq, uint32_t ack, uint8_t flags, const void* data, uint16_t size)
+{
+    uint8_t frame[PEER_MAX_FRAME] = {0};
+    uint8_t* ip = frame + 14;
+    uint8_t* tcp = ip + 20;
+
+    memcpy(frame, deviceMac, 6);
+    hostMac(frame + 6, c->host);
+    frame[12] = 0x08;
+
+    ip[0] = 0x45;
+    put16(ip + 2, 40 + size);
+    ip[8] = 64;
+    ip[9] = 6;
+    memcpy(ip + 12, deviceIp, 4);
+    ip[15] = c->host;
+    memcpy(ip + 16, deviceIp, 4);
+    put16(ip + 10, sumFold(sumAdd(0, ip, 20)));
+
+    put16(tcp, c->hostPort);
+    put16(tcp + 2, c->devicePort);
+    put32(tcp + 4, seq);
+    put32(tcp + 8, ack);
+    tcp[12] = 0x50;
+    tcp[13] = flags;
+    put16(tcp + 14, 8192);
+    memcpy(tcp + 20, data, size);
+    put16(tcp + 16, tcpSum(ip, 20 + size));
+
+    peerSendFrame(frame, 54 + size < 60 ? 60 : 54 + size);
+}
+
+// Segment at the connection's sequence numbers, which move past its data
+void peerSendTcp(const peerConnection* c, uint8_t flags, const void* data, uint16_t size)
+{
+    peerSendTcpAt(c, c->hostSeq, c->deviceSeq, flags, data, size);
+    ((peerConnection*)c)->hostSeq += size + ((flags & (PEER_SYN | PEER_FIN)) ? 1 : 0);
+}
+
+// Next TCP segment from the device. ARP requests are answered on the way,
+// other frames are passed over.
+bool peerReceiveTcp(peerSegment* segment, uint32_t timeoutMs)
+{
+    uint8_t frame[PEER_MAX_FRAME];
+    uint8_t *ip = frame + 14, *tcp;
+    uint32_t start = peerNow(), elapsed;
+    uint16_t size, ipSize, tcpSize;
+
+    while ((elapsed = peerNow() - start) < timeoutMs)
+    {
+        if ((size = peerReceiveFrame(frame, timeoutMs - elapsed)) < 14)
+            continue;
+
+        if (frame[12] == 0x08 && frame[13] == 0x06 && size >= 42 && get16(frame + 20) == 1 &&
+            memcmp(frame + 38, deviceIp, 3) == 0 && frame[41] != deviceIp[3])
+        {
+            peerArpReply(frame);
+            continue;
+        }
+        if (frame[12] != 0x08 || frame[13] != 0x00 || ip[9] != 6)
+            continue;
+
+        ipSize = get16(ip + 2);
+        tcp = ip + (ip[0] & 0x0F) * 4;
+        tcpSize = ipSize - (ip[0] & 0x0F) * 4;
+        check(sumFold(sumAdd(0, ip, (ip[0] & 0x0F) * 4)) == 0, "IP checksum");
+        check(tcpSum(ip, tcpSize) == 0, "TCP checksum");
+
+        segment->host = ip[19];
+        segment->sourcePort = get16(tcp);
+        segment->destPort = get16(tcp + 2);
+        segment->seq = get32(tcp + 4);
+        segment->ack = get32(tcp + 8);
+        segment->flags = tcp[13];
+        segment->size = tcpSize - (tcp[12] >> 4) * 4;
+        memcpy(segment->data, tcp + (tcp[12] >> 4) * 4, segment->size);
+        return true;
+    }
+
+    return false;
+}
+
+// True if the device sends no TCP segment for timeoutMs
+bool peerQuiet(uint32_t timeoutMs)
+{
+    peerSegment segment;
+
+    return !peerReceiveTcp(&segment, timeoutMs);
+}
+
+// Points the device at the broker and accepts its connection and CONNECT
+bool peerConnectBroker(peerConnection* c)
+{
+    static const uint8_t connack[4] = {0x20, 0x02, 0x00, 0x00};
+    peerSegment segment;
+
+    peerCommand("set mqtt 192.168.1.1");
+    peerCommand("connect");
+
+    if (!peerReceiveTcp(&segment, 2000) || segment.flags != PEER_SYN || segment.destPort != PEER_BROKER_PORT)
+        return false;
+
+    c->host = PEER_BROKER;
+    c->hostPort = PEER_BROKER_PORT;
+    c->devicePort = segment.sourcePort;
+    c->deviceSeq = segment.seq + 1;
+    c->hostSeq = 0x10000000;
+    peerSendTcp(c, PEER_SYN | PEER_ACK, NULL, 0);
+
+    // ACK of the SYN, then the CONNECT
+    if (!peerReceiveTcp(&segment, 1000) || segment.flags != PEER_ACK || segment.ack != c->hostSeq)
+        return false;
+    if (!peerReceiveTcp(&segment, 1000) || segment.size == 0 || segment.data[0] != 0x10 || segment.seq != c->deviceSeq)
+        return false;
+
+    c->deviceSeq += segment.size;
+    peerSendTcp(c, PEER_PSH | PEER_ACK, connack, sizeof(connack));
+
+    // CONNACK is acknowledged
+    return peerReceiveTcp(&segment, 1000) && segment.ack == c->hostSeq && segment.size == 0;
+}
+
+// PUBLISH packet from the broker, with a packet identifier if qos is 1 or 2.
+// The Remaining Length is encoded here, not by the device's codec.
+uint16_t peerMakePublish(uint8_t packet[], uint8_t control, const char topic[], uint16_t id,
+                         const void* payload, uint16_t size)
+{
+    uint16_t topicSize = strlen(topic), i = 1;
+    uint32_t length = 2 + topicSize + ((control & 0x06) ? 2 : 0) + size;
+
+    packet[0] = control;
+    do
+    {
+        packet[i] = length % 128;
+        length /= 128;
+        packet[i++] |= (length > 0) ? 0x80 : 0;
+    }
+    while (length > 0);
+
+    put16(packet + i, topicSize);
+    memcpy(packet + i + 2, topic, topicSize);
+    i += 2 + topicSize;
+    if (control & 0x06)
+    {
+        put16(packet + i, id);
+        i += 2;
+    }
+    memcpy(packet + i, payload, size);
+
+    return i + size;
+}
+
+// Next segment with data on the broker connection, acknowledged at once
+bool peerReceiveMqtt(peerConnection* c, peerSegment* segment, uint32_t timeoutMs)
+{
+    uint32_t start = peerNow();
+
+    while (peerNow() - start < timeoutMs)
+    {
+        if (!peerReceiveTcp(segment, timeoutMs - (peerNow() - start)))
+            return false;
+        if (segment->size == 0 || segment->destPort != PEER_BROKER_PORT)
+            continue;
+
+        if (segment->seq == c->deviceSeq)
+            c->deviceSeq += segment->size;
+        peerSendTcp(c, PEER_ACK, NULL, 0);
+        return true;
+    }
+
+    return false;
+}
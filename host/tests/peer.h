@@ -0,0 +1,82 @@
+// peer.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Runs the host build of the firmware with its Ethernet on one end of a
+// socket pair (IOT_FD) and its console on pipes, so a test can play the
+// hosts it talks to. ARP requests for other hosts on 192.168.1.0/24 are
+// answered as they arrive, each host x at MAC 02:00:00:00:00:x, and every
+// IP and TCP checksum the device sends is checked.
+
+#ifndef PEER_H_
+#define PEER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PEER_MAX_FRAME   1522
+#define PEER_BROKER      1       // Host number of the broker, 192.168.1.1
+#define PEER_BROKER_PORT 1883
+
+#define PEER_FIN 0x01
+#define PEER_SYN 0x02
+#define PEER_RST 0x04
+#define PEER_PSH 0x08
+#define PEER_ACK 0x10
+
+extern uint8_t deviceMac[6];
+extern uint8_t deviceIp[4];
+extern uint16_t failures;
+
+// TCP segment sent by the device
+typedef struct _peerSegment
+{
+    uint8_t  host;           // Host it was sent to
+    uint16_t sourcePort;
+    uint16_t destPort;
+    uint32_t seq;
+    uint32_t ack;
+    uint8_t  flags;
+    uint16_t size;           // Bytes of data
+    uint8_t  data[PEER_MAX_FRAME];
+} peerSegment;
+
+// One end of a TCP connection with the device, sequence numbers are the
+// next each side will send
+typedef struct _peerConnection
+{
+    uint8_t  host;
+    uint16_t hostPort;
+    uint16_t devicePort;
+    uint32_t hostSeq;
+    uint32_t deviceSeq;
+} peerConnection;
+
+void check(bool ok, const char what[]);
+uint32_t peerNow(void);
+
+bool peerStart(const char program[], const char workDirectory[]);
+bool peerStop(void);
+
+void peerCommand(const char line[]);
+bool peerOutput(const char text[], uint32_t timeoutMs);
+
+void peerSendFrame(const uint8_t frame[], uint16_t size);
+uint16_t peerReceiveFrame(uint8_t frame[], uint32_t timeoutMs);
+void peerSendTcp(const peerConnection* c, uint8_t flags, const void* data, uint16_t size);
+void peerSendTcpAt(const peerConnection* c, uint32_t seq, uint32_t ack, uint8_t flags, const void* data, uint16_t size);
+bool peerReceiveTcp(peerSegment* segment, uint32_t timeoutMs);
+bool peerQuiet(uint32_t timeoutMs);
+
+bool peerConnectBroker(peerConnection* c);
+bool peerReceiveMqtt(peerConnection* c, peerSegment* segment, uint32_t timeoutMs);
+uint16_t peerMakePublish(uint8_t packet[], uint8_t control, const char topic[], uint16_t id,
+                         const void* payload, uint16_t size);
+
+#endif /* PEER_H_ */
@@ -0,0 +1,267 @@
+// qos.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Plays the MQTT broker to the host build of the firmware and checks QoS 1
+// and 2 delivery both ways: publishes are held in the in-flight window with
+// sequential packet identifiers until PUBACK or PUBREC/PUBCOMP, resent with
+// DUP when not acknowledged, and received publishes are acknowledged and
+// delivered once. Then prints messages per second at each QoS through a
+// broker that answers at once.
+// Usage: qos IOT_PROGRAM WORK_DIRECTORY
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "peer.h"
+
+#define PUBLISH 0x30
+#define PUBACK  0x40
+#define PUBREC  0x50
+#define PUBREL  0x62
+#define PUBCOMP 0x70
+#define DUP     0x08
+#define QOS1    0x02
+#define QOS2    0x04
+
+#define RETRY_TIME 5000
+#define RUNS       1000
+
+// Publish sent by the device
+typedef struct _publish
+{
+    uint8_t  control;
+    uint16_t id;
+    char     topic[64];
+} publish;
+
+// Next MQTT packet on the broker connection, one per segment
+bool receive(peerConnection* c, peerSegment* segment, uint32_t timeoutMs)
+{
+    return peerReceiveMqtt(c, segment, timeoutMs) && segment->size >= 2;
+}
+
+// No MQTT packet for timeoutMs, TCP acknowledgements aside
+bool quiet(peerConnection* c, uint32_t timeoutMs)
+{
+    peerSegment segment;
+
+    return !peerReceiveMqtt(c, &segment, timeoutMs);
+}
+
+bool receivePublish(peerConnection* c, publish* p, uint32_t timeoutMs)
+{
+    peerSegment segment;
+    uint16_t topicSize;
+    uint8_t qos;
+
+    if (!receive(c, &segment, timeoutMs) || (segment.data[0] & 0xF0) != PUBLISH || segment.size < 4)
+        return false;
+
+    // Remaining Length is one byte for the short publishes here, QoS 0 has no identifier
+    topicSize = (segment.data[2] << 8) | segment.data[3];
+    qos = segment.data[0] & (QOS1 | QOS2);
+    if (topicSize >= sizeof(p->topic) || 4 + topicSize + (qos ? 2 : 0) > segment.size)
+        return false;
+
+    p->control = segment.data[0];
+    memcpy(p->topic, segment.data + 4, topicSize);
+    p->topic[topicSize] = '\0';
+    p->id = qos ? (segment.data[4 + topicSize] << 8) | segment.data[5 + topicSize] : 0;
+    return true;
+}
+
+// Acknowledgement of type for id, from either side
+void makeAck(uint8_t packet[], uint8_t type, uint16_t id)
+{
+    packet[0] = type;
+    packet[1] = 2;
+    packet[2] = id >> 8;
+    packet[3] = id;
+}
+
+void sendAck(peerConnection* c, uint8_t type, uint16_t id)
+{
+    uint8_t packet[4];
+
+    makeAck(packet, type, id);
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet, sizeof(packet));
+}
+
+bool receiveAck(peerConnection* c, uint8_t type, uint16_t id, uint32_t timeoutMs)
+{
+    uint8_t packet[4];
+    peerSegment segment;
+
+    makeAck(packet, type, id);
+    return receive(c, &segment, timeoutMs) && segment.size == 4 && memcmp(segment.data, packet, 4) == 0;
+}
+
+// Console command, then waits until the console has taken it
+void command(const char line[])
+{
+    peerCommand(line);
+    peerCommand("sched");
+    check(peerOutput("Max depth", 1000), line);
+}
+
+void testQos1Out(peerConnection* c)
+{
+    publish first, second, again;
+    uint32_t sent;
+
+    command("set qos 1");
+    command("set window 1");
+
+    peerCommand("publish env/q one");
+    check(receivePublish(c, &first, 1000) && first.control == (PUBLISH | QOS1 | 1), "QoS 1 publish sent");
+    sent = peerNow();
+
+    // Window of one is full until the PUBACK
+    peerCommand("publish env/q two");
+    check(peerOutput("Publish window full", 1000), "window full");
+
+    // Not acknowledged, sent again with DUP and the same identifier
+    check(receivePublish(c, &again, RETRY_TIME + 2000), "QoS 1 publish resent");
+    check(again.control == (first.control | DUP) && again.id == first.id && strcmp(again.topic, "env/q") == 0,
+          "resent with DUP and the same identifier");
+    check(peerNow() - sent >= RETRY_TIME - 500, "resent after the retry time");
+
+    sendAck(c, PUBACK, first.id);
+    peerCommand("publish env/q three");
+    check(receivePublish(c, &second, 1000) && second.control == first.control, "PUBACK frees the window");
+    check(second.id == first.id + 1, "packet identifiers are sequential");
+    sendAck(c, PUBACK, second.id);
+
+    // Window of two takes two at once
+    command("set window 2");
+    peerCommand("publish env/q four");
+    peerCommand("publish env/q five");
+    check(receivePublish(c, &first, 1000) && receivePublish(c, &second, 1000), "two publishes in flight");
+    sendAck(c, PUBACK, first.id);
+    sendAck(c, PUBACK, second.id);
+    check(quiet(c, RETRY_TIME + 500), "acknowledged publishes not resent");
+}
+
+void testQos2Out(peerConnection* c)
+{
+    publish p;
+
+    command("set qos 2");
+    command("set window 1");
+
+    peerCommand("publish env/q six");
+    check(receivePublish(c, &p, 1000) && p.control == (PUBLISH | QOS2 | 1), "QoS 2 publish sent");
+    sendAck(c, PUBREC, p.id);
+    check(receiveAck(c, PUBREL, p.id, 1000), "PUBREC answered with PUBREL");
+
+    // A lost PUBREL is sent again for a repeated PUBREC
+    sendAck(c, PUBREC, p.id);
+    check(receiveAck(c, PUBREL, p.id, 1000), "repeated PUBREC answered again");
+
+    sendAck(c, PUBCOMP, p.id);
+    peerCommand("publish env/q seven");
+    check(receivePublish(c, &p, 1000), "PUBCOMP frees the window");
+    sendAck(c, PUBREC, p.id);
+    check(receiveAck(c, PUBREL, p.id, 1000), "second PUBREL");
+    sendAck(c, PUBCOMP, p.id);
+    check(quiet(c, RETRY_TIME + 500), "completed publish not resent");
+}
+
+void testIn(peerConnection* c)
+{
+    uint8_t packet[64];
+    uint16_t size;
+
+    size = peerMakePublish(packet, PUBLISH | QOS1, "env/temp", 7, "51", 2);
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet, size);
+    check(receiveAck(c, PUBACK, 7, 1000), "QoS 1 publish answered with PUBACK");
+    check(peerOutput("51", 1000), "QoS 1 publish delivered");
+
+    size = peerMakePublish(packet, PUBLISH | QOS2, "env/temp", 8, "52", 2);
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet, size);
+    check(receiveAck(c, PUBREC, 8, 1000), "QoS 2 publish answered with PUBREC");
+    check(peerOutput("52", 1000), "QoS 2 publish delivered");
+
+    // PUBREC lost, the broker sends it again with DUP
+    size = peerMakePublish(packet, PUBLISH | QOS2 | DUP, "env/temp", 8, "53", 2);
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet, size);
+    check(receiveAck(c, PUBREC, 8, 1000), "repeated QoS 2 publish answered with PUBREC");
+
+    sendAck(c, PUBREL, 8);
+    check(receiveAck(c, PUBCOMP, 8, 1000), "PUBREL answered with PUBCOMP");
+    check(!peerOutput("53", 500), "repeated QoS 2 publish delivered once");
+
+    // Identifier is free again once released
+    size = peerMakePublish(packet, PUBLISH | QOS2, "env/temp", 8, "54", 2);
+    peerSendTcp(c, PEER_PSH | PEER_ACK, packet, size);
+    check(receiveAck(c, PUBREC, 8, 1000), "released identifier used again");
+    check(peerOutput("54", 1000), "publish on a released identifier delivered");
+    sendAck(c, PUBREL, 8);
+    check(receiveAck(c, PUBCOMP, 8, 1000), "second PUBCOMP");
+}
+
+// One publish at a time through a broker that acknowledges at once
+void measure(peerConnection* c, uint8_t qos)
+{
+    char line[32];
+    publish p;
+    uint32_t start, i;
+
+    snprintf(line, sizeof(line), "set qos %u", qos);
+    command(line);
+
+    start = peerNow();
+    for (i = 0; i < RUNS && failures == 0; i++)
+    {
+        peerCommand("publish env/rate x");
+        check(receivePublish(c, &p, 1000), "measured publish sent");
+        if (qos == 1)
+            sendAck(c, PUBACK, p.id);
+        if (qos == 2)
+        {
+            sendAck(c, PUBREC, p.id);
+            check(receiveAck(c, PUBREL, p.id, 1000), "measured PUBREL");
+            sendAck(c, PUBCOMP, p.id);
+        }
+    }
+
+    printf("qos %u: %.0f messages/s\n", qos, RUNS * 1000.0 / (peerNow() - start + 1));
+}
+
+int main(int argc, char* argv[])
+{
+    peerConnection broker;
+
+    if (argc != 3)
+        return 2;
+
+    check(peerStart(argv[1], argv[2]), "device started");
+    check(peerConnectBroker(&broker), "broker connection");
+
+    if (failures == 0)
+    {
+        testQos1Out(&broker);
+        testQos2Out(&broker);
+        testIn(&broker);
+    }
+    if (failures == 0)
+    {
+        measure(&broker, 0);
+        measure(&broker, 1);
+        measure(&broker, 2);
+    }
+
+    check(peerStop(), "device exited cleanly");
+
+    if (failures == 0)
+        printf("qos: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// replay.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Runs the host build of the firmware on a pcap replay of an ARP request
+// and a ping for its static address, then checks the frames it sent for
+// the ARP reply and the echo reply.
+// Usage: replay IOT_PROGRAM WORK_DIRECTORY
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define PCAP_MAGIC 0xA1B2C3D4
+
+uint8_t deviceMac[6] = {2, 3, 4, 5, 6, 106};
+uint8_t peerMac[6]   = {2, 0, 0, 0, 0, 1};
+uint8_t deviceIp[4]  = {192, 168, 1, 106};
+uint8_t peerIp[4]    = {192, 168, 1, 1};
+
+uint16_t sum16(const uint8_t data[], uint16_t size)
+{
+    uint32_t sum = 0;
+    uint16_t i;
+
+    for (i = 0; i + 1 < size; i += 2)
+        sum += (data[i] << 8) | data[i + 1];
+    if (size & 1)
+        sum += data[size - 1] << 8;
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return ~sum & 0xFFFF;
+}
+
+void putRecord(FILE* file, const uint8_t frame[], uint32_t size)
+{
+    uint32_t record[4] = {0, 0, size, size};
+
+    fwrite(record, sizeof(record), 1, file);
+    fwrite(frame, 1, size, file);
+}
+
+void writeInput(const char name[])
+{
+    uint32_t header[6] = {PCAP_MAGIC, 0x00040002, 0, 0, 65535, 1};
+    uint8_t frame[128];
+    uint16_t check;
+    FILE* file = fopen(name, "wb");
+
+    fwrite(header, sizeof(header), 1, file);
+
+    // Who has 192.168.1.106
+    memset(frame, 0, sizeof(frame));
+    memset(frame, 0xFF, 6);
+    memcpy(&frame[6], peerMac, 6);
+    frame[12] = 0x08; frame[13] = 0x06;
+    frame[15] = 1; frame[16] = 0x08; frame[18] = 6; frame[19] = 4; frame[21] = 1;
+    memcpy(&frame[22], peerMac, 6);
+    memcpy(&frame[28], peerIp, 4);
+    memcpy(&frame[38], deviceIp, 4);
+    putRecord(file, frame, 42);
+
+    // Echo request with 32 bytes of data
+    memset(frame, 0, sizeof(frame));
+    memcpy(frame, deviceMac, 6);
+    memcpy(&frame[6], peerMac, 6);
+    frame[12] = 0x08;
+    frame[14] = 0x45; frame[17] = 60; frame[19] = 1; frame[22] = 64; frame[23] = 1;
+    memcpy(&frame[26], peerIp, 4);
+    memcpy(&frame[30], deviceIp, 4);
+    check = sum16(&frame[14], 20);
+    frame[24] = check >> 8; frame[25] = check;
+    frame[34] = 8; frame[38] = 0x12; frame[39] = 0x34; frame[41] = 1;
+    memset(&frame[42], 'x', 32);
+    check = sum16(&frame[34], 40);
+    frame[36] = check >> 8; frame[37] = check;
+    putRecord(file, frame, 74);
+
+    fclose(file);
+}
+
+int main(int argc, char* argv[])
+{
+    char input[512], output[512], eeprom[512];
+    uint8_t frame[2048];
+    uint32_t header[6], record[4];
+    bool arpReply = false, echoReply = false;
+    FILE* file;
+    pid_t pid;
+    int status;
+
+    if (argc != 3)
+        return 2;
+
+    snprintf(input, sizeof(input), "%s/replay_in.pcap", argv[2]);
+    snprintf(output, sizeof(output), "%s/replay_out.pcap", argv[2]);
+    snprintf(eeprom, sizeof(eeprom), "%s/replay_eeprom.bin", argv[2]);
+    writeInput(input);
+    unlink(eeprom);
+
+    // Erased EEPROM leaves the device on its static address
+    if ((pid = fork()) == 0)
+    {
+        setenv("IOT_PCAP", input, 1);
+        setenv("IOT_PCAP_OUT", output, 1);
+        setenv("IOT_EEPROM", eeprom, 1);
+        freopen("/dev/null", "r", stdin);
+        freopen("/dev/null", "w", stdout);
+        execl(argv[1], argv[1], (char*)NULL);
+        _exit(127);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        printf("FAIL program did not exit cleanly\n");
+        return 1;
+    }
+
+    if ((file = fopen(output, "rb")) == NULL || fread(header, sizeof(header), 1, file) != 1)
+    {
+        printf("FAIL no output\n");
+        return 1;
+    }
+    while (fread(record, sizeof(record), 1, file) == 1 && record[2] <= sizeof(frame))
+    {
+        if (fread(frame, 1, record[2], file) != record[2])
+            break;
+        if (memcmp(frame, peerMac, 6) != 0)
+            continue;
+
+        // ARP reply saying 192.168.1.106 is at our MAC
+        if (frame[12] == 0x08 && frame[13] == 0x06 && frame[21] == 2 &&
+            memcmp(&frame[22], deviceMac, 6) == 0 && memcmp(&frame[28], deviceIp, 4) == 0)
+            arpReply = true;
+
+        // Echo reply with the request's id, sequence and data, checksums intact
+        if (frame[12] == 0x08 && frame[13] == 0x00 && frame[23] == 1 && frame[34] == 0 &&
+            frame[38] == 0x12 && frame[39] == 0x34 && frame[41] == 1 && frame[42] == 'x' && frame[73] == 'x' &&
+            sum16(&frame[14], 20) == 0 && sum16(&frame[34], 40) == 0)
+            echoReply = true;
+    }
+    fclose(file);
+
+    printf("ARP reply:  %s\n", arpReply ? "ok" : "missing");
+    printf("Echo reply: %s\n", echoReply ? "ok" : "missing");
+
+    return (arpReply && echoReply) ? 0 : 1;
+}
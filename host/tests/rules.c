@@ -0,0 +1,249 @@
+// rules.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Checks the rule engine: the defaults on an erased EEPROM, the eq, ne, gt
+// and lt conditions gating the pin and pulse actions, several rules on a
+// filter running in order, rules that do not compile or fit, deleting rules
+// from the middle of the table, publishes whose topic is too long for the
+// queue being dropped rather than cut short, and rules surviving a restart
+// through the EEPROM file.
+// Usage: rules WORK_DIRECTORY
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gpio.h"
+#include "eeprom.h"
+#include "timers.h"
+#include "topic.h"
+#include "rules.h"
+
+#define RED   1
+#define BLUE  2
+#define GREEN 3
+
+char eepromName[512];
+uint16_t failures = 0;
+
+void check(bool ok, const char what[])
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Publish received from the broker
+void receive(const char topic[], const char payload[])
+{
+    char t[RULE_TOPIC_SIZE], p[RULE_PAYLOAD_SIZE];
+
+    snprintf(t, sizeof(t), "%s", topic);
+    snprintf(p, sizeof(p), "%s", payload);
+    topicDispatch(t, p);
+}
+
+bool led(uint8_t pin)
+{
+    return getPinValue(PORTF, pin);
+}
+
+void leds(bool value)
+{
+    setPinValue(PORTF, RED, value);
+    setPinValue(PORTF, BLUE, value);
+    setPinValue(PORTF, GREEN, value);
+}
+
+// Power up with what the EEPROM file holds
+void restart(void)
+{
+    initEeprom();
+    initTopics();
+    initRules();
+    leds(0);
+}
+
+// Deletes every rule one at a time, returns how many there were
+uint8_t deleteAll(void)
+{
+    uint8_t rule, count = 0;
+
+    for (rule = 0; rule < RULE_MAX; rule++)
+        count += ruleDelete(rule);
+    return count;
+}
+
+void testDefaults(void)
+{
+    unlink(eepromName);
+    restart();
+
+    receive("env/led/red", "on");
+    check(led(RED), "default rule turns red on");
+    receive("env/led/red", "off");
+    check(!led(RED), "default rule turns red off");
+    receive("env/led/blue", "on");
+    receive("env/led/green", "on");
+    check(led(BLUE) && led(GREEN), "default blue and green rules");
+    receive("env/led/green", "dim");
+    check(led(GREEN), "payload matching no rule");
+}
+
+void testConditions(void)
+{
+    ruleClear();
+    leds(0);
+
+    check(ruleAdd("env/temp gt 30 pin red 1") != RULE_NONE, "gt rule added");
+    check(ruleAdd("env/temp lt 10 pin blue 1") != RULE_NONE, "lt rule added");
+    check(ruleAdd("env/door ne shut pin green 1") != RULE_NONE, "ne rule added");
+    check(ruleAdd("env/door eq shut pin green 0") != RULE_NONE, "eq rule added");
+
+    receive("env/temp", "30");
+    check(!led(RED) && !led(BLUE), "gt and lt are strict");
+    receive("env/temp", "31");
+    check(led(RED) && !led(BLUE), "gt");
+    receive("env/temp", "-5");
+    check(led(BLUE), "lt on a negative number");
+    receive("env/door", "open");
+    check(led(GREEN), "ne");
+    receive("env/door", "shut");
+    check(!led(GREEN), "eq");
+    receive("env/doors", "open");
+    check(!led(GREEN), "rule runs only on its filter");
+
+    // Rules on one filter run in the order added, both conditions must hold
+    leds(0);
+    check(ruleAdd("env/+/level gt 5 lt 9 pin red 1 pin blue 1") != RULE_NONE, "two conditions");
+    check(ruleAdd("env/+/level any pin blue 0") != RULE_NONE, "any");
+    receive("env/tank/level", "7");
+    check(led(RED) && !led(BLUE), "rules of a wildcard filter run in order");
+    leds(0);
+    receive("env/tank/level", "9");
+    check(!led(RED), "second condition stops the rule");
+
+    // Pulse turns the LED on until the timer runs out
+    check(ruleAdd("env/bell pulse green 50") != RULE_NONE, "pulse rule added");
+    receive("env/bell", "x");
+    check(led(GREEN), "pulse turns the LED on");
+    rulePulseExpired();
+    check(!led(GREEN), "pulse turns the LED off again");
+}
+
+void testLimits(void)
+{
+    char text[RULE_MAX_RECORD + 16];
+    uint8_t rule, added = 0;
+
+    ruleClear();
+    check(ruleAdd("env/x bogus") == RULE_NONE, "unknown op");
+    check(ruleAdd("env/x pin purple 1") == RULE_NONE, "unknown LED");
+    check(ruleAdd("env/x eq") == RULE_NONE, "missing argument");
+    check(ruleAdd("") == RULE_NONE, "empty rule");
+    memset(text, 'a', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    check(ruleAdd(text) == RULE_NONE, "record too long");
+
+    // One filter, so the table runs out before the trie
+    for (rule = 0; rule <= RULE_MAX; rule++)
+    {
+        snprintf(text, sizeof(text), "env/many eq %u pin red 1", rule);
+        added += ruleAdd(text) != RULE_NONE;
+    }
+    check(added == RULE_MAX, "table full");
+
+    // Taking one from the middle moves the rest down, which still run
+    check(ruleDelete(1), "rule deleted");
+    check(!ruleDelete(1), "deleted rule gone");
+    check(!ruleDelete(RULE_MAX), "rule out of range");
+    receive("env/many", "1");
+    check(!led(RED), "deleted rule not run");
+    receive("env/many", "2");
+    check(led(RED), "rules after a deleted one still run");
+    leds(0);
+    check(ruleAdd("env/other eq 1 pin blue 1") != RULE_NONE, "freed rule used again");
+    receive("env/other", "1");
+    check(led(BLUE), "rule in freed space runs");
+
+    check(deleteAll() == added, "every rule deleted");
+    check(ruleCodeSize == 0, "table empty");
+    check(topicFind("env/many") == TOPIC_NONE, "filter freed with its last rule");
+}
+
+void testQueue(void)
+{
+    char topic[RULE_TOPIC_SIZE + 8];
+    uint32_t dropped = ruleQueueDropped;
+
+    ruleClear();
+    leds(0);
+    check(ruleAdd("env/# any pin red 1") != RULE_NONE, "rule on every env topic added");
+
+    // Cut to fit, this topic would have matched the rule
+    memset(topic, 'a', sizeof(topic) - 1);
+    memcpy(topic, "env/", 4);
+    topic[sizeof(topic) - 1] = '\0';
+    check(!ruleQueuePost(topic, "1") && ruleQueueDropped == dropped + 1, "topic too long dropped");
+    topic[RULE_TOPIC_SIZE - 1] = '\0';
+    check(ruleQueuePost(topic, "1"), "longest topic queued");
+    while (ruleQueueRun());
+    check(led(RED) && ruleQueueCount() == 0, "longest topic run by the rules");
+}
+
+void testRestart(void)
+{
+    ruleClear();
+    check(ruleAdd("env/a eq on pin red 1") != RULE_NONE, "first rule added");
+    check(ruleAdd("env/b eq on pin blue 1") != RULE_NONE, "second rule added");
+    check(ruleAdd("env/c eq on pin green 1") != RULE_NONE, "third rule added");
+    check(ruleDelete(1), "middle rule deleted");
+
+    restart();
+    receive("env/a", "on");
+    receive("env/b", "on");
+    receive("env/c", "on");
+    check(led(RED) && !led(BLUE) && led(GREEN), "rules reloaded from EEPROM");
+    receive("env/led/red", "off");
+    check(led(RED), "defaults not added to stored rules");
+
+    // Cleared table is stored too, and not replaced by the defaults
+    ruleClear();
+    restart();
+    receive("env/a", "on");
+    receive("env/led/red", "on");
+    check(!led(RED), "cleared table reloaded empty");
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+        return 2;
+
+    snprintf(eepromName, sizeof(eepromName), "%s/rules.eeprom", argv[1]);
+    setenv("IOT_EEPROM", eepromName, 1);
+    initTimer();
+
+    testDefaults();
+    testConditions();
+    testLimits();
+    testQueue();
+    testRestart();
+
+    unlink(eepromName);
+
+    if (failures == 0)
+        printf("rules: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+// sched.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Checks the run-to-completion scheduler with tasks that log each unit they
+// run and take time on a simulated clock: the highest ready level runs
+// first, a level that has used its budget waits for the others, a new round
+// starts once every ready level is out of budget, a task's true return
+// and its own posts run it again, event flags post the levels they are
+// registered for, and the statistics record runs, waits, unit lengths and
+// queue depths.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "host.h"
+#include "events.h"
+#include "sched.h"
+#include "timers.h"
+
+#define LOG_SIZE 64
+#define US       (TIMER_CYCLES_PER_MS / 1000)
+
+uint16_t failures = 0;
+uint64_t clockCycles;
+uint8_t waiting[SCHED_NUM_LEVELS];   // Units queued for each level's task
+uint32_t unitUs[SCHED_NUM_LEVELS];   // Time each unit takes
+char runLog[LOG_SIZE + 1];           // Letter of each level run, in order
+uint8_t logCount;
+
+void check(bool ok, const char what[])
+{
+    if (!ok && failures++ < 10)
+        printf("FAIL %s\n", what);
+}
+
+uint64_t simCycles(void)
+{
+    return clockCycles;
+}
+
+bool unit(schedLevel level)
+{
+    if (logCount < LOG_SIZE)
+        runLog[logCount++] = "ntrc"[level];
+    clockCycles += (uint64_t)unitUs[level] * US;
+    if (waiting[level] != 0)
+        waiting[level]--;
+
+    return waiting[level] != 0;
+}
+
+bool netTask(void)
+{
+    return unit(SCHED_NET);
+}
+
+// Posts itself again rather than returning true, as the timer level is
+// posted by the others
+bool timerTask(void)
+{
+    bool more = unit(SCHED_TIMER);
+
+    if (more)
+        schedPost(SCHED_TIMER);
+    return false;
+}
+
+bool rulesTask(void)
+{
+    return unit(SCHED_RULES);
+}
+
+bool consoleTask(void)
+{
+    return unit(SCHED_CONSOLE);
+}
+
+uint8_t netDepth(void)
+{
+    return waiting[SCHED_NET];
+}
+
+void reset(void)
+{
+    clockCycles = 0;
+    initTimer();
+    memset(waiting, 0, sizeof(waiting));
+    memset(unitUs, 0, sizeof(unitUs));
+    memset(runLog, 0, sizeof(runLog));
+    logCount = 0;
+
+    initSched();
+    schedRegister(SCHED_NET, "net", netTask, netDepth, 3, EVENT_ETHER);
+    schedRegister(SCHED_TIMER, "timer", timerTask, NULL, 1, EVENT_TIMER);
+    schedRegister(SCHED_RULES, "rules", rulesTask, NULL, 2, 0);
+    schedRegister(SCHED_CONSOLE, "console", consoleTask, NULL, 1, EVENT_UART);
+}
+
+// Queues units for level and posts it
+void give(schedLevel level, uint8_t units)
+{
+    waiting[level] += units;
+    schedPost(level);
+}
+
+// Runs units while any level is ready, eventWait is never reached
+void drain(void)
+{
+    uint8_t level;
+    bool ready = true;
+
+    while (ready && logCount < LOG_SIZE)
+    {
+        ready = false;
+        for (level = 0; level < SCHED_NUM_LEVELS; level++)
+            ready = ready || schedLevels[level].ready;
+        if (ready)
+            schedRun();
+    }
+}
+
+void testPriority(void)
+{
+    reset();
+    give(SCHED_CONSOLE, 1);
+    give(SCHED_RULES, 1);
+    give(SCHED_TIMER, 1);
+    give(SCHED_NET, 1);
+    drain();
+    check(strcmp(runLog, "ntrc") == 0, "levels run highest first");
+}
+
+// Net has 3 a round, rules 2, console 1, with all of them busy
+void testBudgets(void)
+{
+    reset();
+    give(SCHED_NET, 7);
+    give(SCHED_RULES, 3);
+    give(SCHED_CONSOLE, 2);
+    drain();
+    check(strcmp(runLog, "nnnrrcnnnrcn") == 0, "each level gets its budget every round");
+    check(schedNext() == SCHED_NUM_LEVELS, "nothing ready after the queues empty");
+}
+
+// Alone a level is not held to its budget
+void testNewRound(void)
+{
+    reset();
+    give(SCHED_NET, 5);
+    drain();
+    check(strcmp(runLog, "nnnnn") == 0, "level alone runs on in new rounds");
+
+    reset();
+    give(SCHED_NET, 4);
+    drain();
+    give(SCHED_CONSOLE, 1);
+    give(SCHED_NET, 1);
+    drain();
+    check(strcmp(runLog, "nnnnnc") == 0, "credits restored once every ready level is out");
+}
+
+void testOwnPost(void)
+{
+    reset();
+    give(SCHED_TIMER, 3);
+    give(SCHED_CONSOLE, 2);
+    drain();
+    check(strcmp(runLog, "tctct") == 0, "task posting itself runs again after its budget");
+}
+
+void testEvents(void)
+{
+    reset();
+    waiting[SCHED_NET] = 1;
+    waiting[SCHED_CONSOLE] = 1;
+    schedPostEvents(EVENT_ETHER | EVENT_UART);
+    check(schedLevels[SCHED_NET].ready && schedLevels[SCHED_CONSOLE].ready, "events post their levels");
+    check(!schedLevels[SCHED_TIMER].ready && !schedLevels[SCHED_RULES].ready, "other levels not posted");
+
+    // Flags set as an interrupt would are taken by schedRun
+    reset();
+    waiting[SCHED_CONSOLE] = 1;
+    eventSet(EVENT_UART);
+    schedRun();
+    check(strcmp(runLog, "c") == 0, "schedRun takes the interrupt's events");
+
+    // A level with no task is never ready
+    initSched();
+    schedPost(SCHED_NET);
+    check(!schedLevels[SCHED_NET].ready, "unregistered level not posted");
+}
+
+void testStats(void)
+{
+    schedEntry* net = &schedLevels[SCHED_NET];
+    schedEntry* console = &schedLevels[SCHED_CONSOLE];
+
+    reset();
+    unitUs[SCHED_NET] = 100;
+    unitUs[SCHED_CONSOLE] = 20000;
+    give(SCHED_CONSOLE, 1);
+    drain();
+    give(SCHED_NET, 4);
+    clockCycles += 50 * US;
+    drain();
+
+    check(net->runs == 4 && console->runs == 1, "runs counted");
+    check(console->maxRun == 20000 * US && net->maxRun == 100 * US, "longest unit");
+    check(net->maxWait == 50 * US, "longest wait while ready");
+    check(net->maxDepth == 4, "deepest queue");
+    check(console->maxDepth == 0, "no depth without a depth function");
+}
+
+int main(void)
+{
+    timer4SetClock(simCycles);
+
+    testPriority();
+    testBudgets();
+    testNewRound();
+    testOwnPost();
+    testEvents();
+    testStats();
+
+    if (failures == 0)
+        printf("sched: ok\n");
+    return failures == 0 ? 0 : 1;
+}
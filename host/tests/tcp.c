@@ -0,0 +1,272 @@
+// tcp.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Plays the MQTT broker to the host build of the firmware and checks the
+// TCP side of the broker connection: unacknowledged data is sent again
+// after an RTO taken from the measured round trip, backed off on each
+// timeout and not sampled again until new data is acknowledged (Karn), and
+// three duplicate ACKs resend at once. A second host then opens, uses and
+// closes connections to the device while the broker connection carries on,
+// and publishes sent from port 1883 of anything but the broker connection
+// are not delivered. Last it prints the goodput of publishes sent one at a
+// time over a link that loses 0 to 10% of the segments each way.
+// Usage: tcp IOT_PROGRAM WORK_DIRECTORY
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "peer.h"
+
+#define LOSS_MESSAGES 50
+
+// Publishes a QoS 0 message and returns the segment carrying it
+bool publish(const char command[], peerSegment* segment)
+{
+    peerCommand(command);
+    return peerReceiveTcp(segment, 1000) && segment->size != 0 && (segment->data[0] & 0xF0) == 0x30;
+}
+
+// Same data at the same sequence number, acknowledging what we sent since
+bool resent(const peerSegment* first, const peerSegment* again, const peerConnection* c)
+{
+    return again->seq == first->seq && again->size == first->size &&
+           memcmp(again->data, first->data, first->size) == 0 && again->ack == c->hostSeq;
+}
+
+void testTimeout(peerConnection* c)
+{
+    peerSegment first, again;
+    uint32_t sent, rto1, rto2;
+
+    // CONNECT was acknowledged at once, so the RTO is down at its 200 ms floor
+    check(publish("publish env/a 1", &first), "publish sent");
+    sent = peerNow();
+    check(peerReceiveTcp(&again, 2000) && resent(&first, &again, c), "resent after a timeout");
+    rto1 = peerNow() - sent;
+    check(rto1 >= 150 && rto1 < 700, "RTO from the measured round trip");
+
+    sent = peerNow();
+    check(peerReceiveTcp(&again, 2000) && resent(&first, &again, c), "resent after a second timeout");
+    rto2 = peerNow() - sent;
+    check(rto2 > rto1 * 3 / 2, "RTO backed off");
+
+    c->deviceSeq += first.size;
+    peerSendTcp(c, PEER_ACK, NULL, 0);
+    check(peerQuiet(rto2 * 2), "nothing resent once acknowledged");
+
+    // Acknowledging resent data gives no sample, the backed off RTO stays
+    check(publish("publish env/b 2", &first), "second publish sent");
+    sent = peerNow();
+    check(peerReceiveTcp(&again, 3000) && resent(&first, &again, c), "second publish resent");
+    check(peerNow() - sent > rto1 * 3 / 2, "RTO not sampled from resent data");
+    c->deviceSeq += first.size;
+    peerSendTcp(c, PEER_ACK, NULL, 0);
+    peerQuiet(100);
+}
+
+void testFastRetransmit(peerConnection* c)
+{
+    peerSegment first, second, again;
+
+    check(publish("publish env/c 3", &first), "third publish sent");
+    check(publish("publish env/d 4", &second), "fourth publish sent");
+    check(second.seq == first.seq + first.size, "segments in sequence");
+
+    // Receiver missed the first, every later segment repeats its ACK
+    peerSendTcp(c, PEER_ACK, NULL, 0);
+    peerSendTcp(c, PEER_ACK, NULL, 0);
+    check(peerQuiet(50), "two duplicate ACKs are not enough");
+    peerSendTcp(c, PEER_ACK, NULL, 0);
+    check(peerReceiveTcp(&again, 100) && resent(&first, &again, c), "third duplicate ACK resends at once");
+
+    c->deviceSeq += first.size + second.size;
+    peerSendTcp(c, PEER_ACK, NULL, 0);
+    check(peerQuiet(1000), "nothing resent once acknowledged");
+}
+
+// Opens a connection from host to a device port, returns false if the
+// device does not answer the SYN
+bool accept(peerConnection* c, uint8_t host, uint16_t hostPort, uint16_t devicePort)
+{
+    peerSegment segment;
+
+    c->host = host;
+    c->hostPort = hostPort;
+    c->devicePort = devicePort;
+    c->hostSeq = 0x20000000 + hostPort;
+    c->deviceSeq = 0;
+    peerSendTcp(c, PEER_SYN, NULL, 0);
+
+    if (!peerReceiveTcp(&segment, 500) || segment.flags != (PEER_SYN | PEER_ACK) || segment.host != host ||
+        segment.sourcePort != devicePort || segment.destPort != hostPort || segment.ack != c->hostSeq)
+        return false;
+
+    c->deviceSeq = segment.seq + 1;
+    peerSendTcp(c, PEER_ACK, NULL, 0);
+    return true;
+}
+
+void testTwoConnections(peerConnection* broker)
+{
+    static const uint8_t temp[] = {0x30, 0x0C, 0x00, 0x08, 'e', 'n', 'v', '/', 't', 'e', 'm', 'p', '4', '2'};
+    peerConnection other;
+    peerSegment segment;
+    uint8_t i;
+
+    // Every slot but the broker's is used and given back in turn
+    for (i = 0; i < 4; i++)
+    {
+        check(accept(&other, 2, 40000 + i, 8080), "second connection accepted");
+        if (failures != 0)
+            return;
+
+        // Broker traffic in between, on its own sequence numbers
+        check(publish("publish env/e 5", &segment) && segment.host == PEER_BROKER && segment.seq == broker->deviceSeq,
+              "broker publish during second connection");
+        broker->deviceSeq += segment.size;
+        peerSendTcp(broker, PEER_ACK, NULL, 0);
+
+        peerSendTcp(&other, PEER_PSH | PEER_ACK, "GET /\r\n", 7);
+        check(peerReceiveTcp(&segment, 500) && segment.host == 2 && segment.destPort == other.hostPort &&
+              segment.seq == other.deviceSeq && segment.ack == other.hostSeq && segment.size == 0,
+              "second connection data acknowledged");
+
+        peerSendTcp(broker, PEER_PSH | PEER_ACK, temp, sizeof(temp));
+        check(peerReceiveTcp(&segment, 500) && segment.host == PEER_BROKER && segment.ack == broker->hostSeq,
+              "broker publish acknowledged");
+        check(peerOutput("42", 500), "broker publish delivered");
+
+        // Closed by the host, the device answers FIN with FIN
+        peerSendTcp(&other, PEER_FIN | PEER_ACK, NULL, 0);
+        check(peerReceiveTcp(&segment, 500) && segment.host == 2 && (segment.flags & PEER_FIN) &&
+              segment.ack == other.hostSeq, "second connection closed");
+        other.deviceSeq++;
+        peerSendTcp(&other, PEER_ACK, NULL, 0);
+    }
+
+    // Segments for a connection that is gone are not answered
+    peerSendTcp(&other, PEER_PSH | PEER_ACK, "x", 1);
+    check(peerQuiet(200), "closed connection forgotten");
+
+    check(publish("publish env/f 6", &segment) && segment.seq == broker->deviceSeq, "broker connection still up");
+    broker->deviceSeq += segment.size;
+    peerSendTcp(broker, PEER_ACK, NULL, 0);
+    peerQuiet(100);
+}
+
+// Publish from port 1883 of another host, and of the broker to another port
+void testSpoofed(peerConnection* broker)
+{
+    uint8_t packet[64];
+    uint16_t size;
+    peerSegment segment;
+    peerConnection other = *broker;
+
+    size = peerMakePublish(packet, 0x30, "env/temp", 0, "66", 2);
+    other.host = 2;
+    peerSendTcp(&other, PEER_PSH | PEER_ACK, packet, size);
+    other = *broker;
+    other.devicePort++;
+    peerSendTcp(&other, PEER_PSH | PEER_ACK, packet, size);
+    check(!peerOutput("66", 500), "publish from another connection not delivered");
+
+    size = peerMakePublish(packet, 0x30, "env/temp", 0, "67", 2);
+    peerSendTcp(broker, PEER_PSH | PEER_ACK, packet, size);
+    check(peerReceiveTcp(&segment, 500) && segment.host == PEER_BROKER && segment.ack == broker->hostSeq,
+          "broker publish acknowledged after spoofed ones");
+    check(peerOutput("67", 500), "broker publish delivered after spoofed ones");
+}
+
+// Segment or ACK lost on the link, percent in 100 of them
+bool lost(uint8_t percent)
+{
+    return rand() % 100 < percent;
+}
+
+// Publishes one at a time, percent of the segments the device sends and of
+// the ACKs back are dropped. Prints MQTT bytes the broker received per second.
+void testLoss(peerConnection* c, uint8_t percent)
+{
+    peerSegment segment;
+    uint32_t start, elapsed, first = c->deviceSeq, bytes = 0, sent = 0, i;
+    bool acked;
+
+    start = peerNow();
+    for (i = 0; i < LOSS_MESSAGES; i++)
+    {
+        peerCommand("publish env/loss 12345678");
+
+        // Until the broker has the publish and the device has its ACK
+        acked = false;
+        while (!acked)
+        {
+            if (!peerReceiveTcp(&segment, 5000))
+            {
+                check(false, "publish resent until it gets through the lossy link");
+                return;
+            }
+            if (segment.host != PEER_BROKER || segment.size == 0)
+                continue;
+            sent++;
+            if (lost(percent))
+                continue;
+
+            if (segment.seq == c->deviceSeq)
+            {
+                c->deviceSeq += segment.size;
+                bytes += segment.size;
+            }
+
+            if (lost(percent))
+                continue;
+            peerSendTcp(c, PEER_ACK, NULL, 0);
+            acked = segment.seq + segment.size == c->deviceSeq;
+        }
+    }
+
+    check(c->deviceSeq - first == bytes && bytes != 0, "every publish received once over the lossy link");
+    elapsed = peerNow() - start;
+    printf("loss %2u%%: %6.0f bytes/s, %2u resends in %u ms\n", percent, bytes * 1000.0 / (elapsed + 1), sent - LOSS_MESSAGES, elapsed);
+}
+
+int main(int argc, char* argv[])
+{
+    peerConnection broker;
+
+    if (argc != 3)
+        return 2;
+
+    check(peerStart(argv[1], argv[2]), "device started");
+    check(peerConnectBroker(&broker), "broker connection");
+
+    if (failures == 0)
+    {
+        testTimeout(&broker);
+        testFastRetransmit(&broker);
+        testTwoConnections(&broker);
+        testSpoofed(&broker);
+    }
+    if (failures == 0)
+    {
+        srand(1);
+        testLoss(&broker, 0);
+        testLoss(&broker, 1);
+        testLoss(&broker, 5);
+        testLoss(&broker, 10);
+    }
+
+    check(peerStop(), "device exited cleanly");
+
+    if (failures == 0)
+        printf("tcp: ok\n");
+    return failures == 0 ? 0 : 1;
+}
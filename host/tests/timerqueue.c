@@ -0,0 +1,233 @@
+// timerqueue.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Stress test of the deferred timer queue. The main loop builds frame after
+// frame in data, the buffer the DHCP, ARP and MQTT timer callbacks build
+// theirs in, and the simulated clock moves between each step so Timer 4
+// interrupts land at every point of the work. Twenty timers, most of them
+// periodic and every callback writing over data, expire all through it
+// while one-shots are stopped and started again between frames. Checks no
+// frame is changed under the main loop, no callback runs in tickIsr, every
+// period runs its callback once and within a frame of its ms and a timer
+// stopped while queued never runs. Last the same run with the callbacks
+// called from the interrupt, as tickIsr used to, must corrupt frames, which
+// shows the test reaches the window it guards.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "ethernet.h"
+#include "timers.h"
+
+#define FRAMES        20000
+#define FRAME_SIZE    600
+#define STEPS         64      // Points in a frame an interrupt can land
+#define STEP_US_MAX   25      // Frame takes up to 1.6 ms
+#define PERIODICS     8
+#define ONESHOTS      4
+#define FILLERS       8       // More periodic timers sharing one callback
+
+uint16_t failures = 0;
+uint64_t clockCycles;
+bool inIsr;
+bool direct;                  // Callbacks run from the interrupt
+uint32_t periods[PERIODICS];
+uint32_t periodicRuns[PERIODICS];
+timerHandle oneShots[ONESHOTS];
+bool stopped[ONESHOTS];
+uint32_t oneShotRuns, isrRuns, lateRuns, stoppedRuns, queuedStops;
+
+void check(bool ok, const char what[])
+{
+    if (!ok && failures++ < 10)
+        printf("FAIL %s\n", what);
+}
+
+uint64_t simCycles(void)
+{
+    return clockCycles;
+}
+
+// What renewalTimer or arpResponseTimer does to data
+void buildOwnFrame(uint8_t tag)
+{
+    memset(data, tag, FRAME_SIZE);
+    if (inIsr && !direct)
+        isrRuns++;
+}
+
+// Period n of timer k is due at n * periods[k] ms after initTimer
+void periodicRan(uint8_t k)
+{
+    uint32_t late;
+
+    periodicRuns[k]++;
+    late = timerGetTicks() - periodicRuns[k] * periods[k];
+    if (late > (STEPS * STEP_US_MAX) / 1000 + 1)
+        lateRuns++;
+    buildOwnFrame(0xA0 + k);
+}
+
+void periodic0(void) { periodicRan(0); }
+void periodic1(void) { periodicRan(1); }
+void periodic2(void) { periodicRan(2); }
+void periodic3(void) { periodicRan(3); }
+void periodic4(void) { periodicRan(4); }
+void periodic5(void) { periodicRan(5); }
+void periodic6(void) { periodicRan(6); }
+void periodic7(void) { periodicRan(7); }
+
+const _callback periodicFns[PERIODICS] =
+{
+    periodic0, periodic1, periodic2, periodic3, periodic4, periodic5, periodic6, periodic7
+};
+
+void oneShotRan(uint8_t k)
+{
+    if (stopped[k])
+        stoppedRuns++;
+    oneShotRuns++;
+    buildOwnFrame(0xB0 + k);
+}
+
+void oneShot0(void) { oneShotRan(0); }
+void oneShot1(void) { oneShotRan(1); }
+void oneShot2(void) { oneShotRan(2); }
+void oneShot3(void) { oneShotRan(3); }
+
+const _callback oneShotFns[ONESHOTS] = {oneShot0, oneShot1, oneShot2, oneShot3};
+
+void filler(void)
+{
+    buildOwnFrame(0xCC);
+}
+
+// Timer 4 interrupt if its match has passed
+void interrupt(void)
+{
+    if (!timer4Pending())
+        return;
+
+    inIsr = true;
+    tickIsr();
+    if (direct)
+        timerPoll();
+    inIsr = false;
+}
+
+// Builds frame seq in data a step at a time, returns true if it was
+// changed before the main loop was done with it
+bool buildFrame(uint32_t seq)
+{
+    uint16_t i, step;
+
+    for (step = 0; step < STEPS; step++)
+    {
+        for (i = step * (FRAME_SIZE / STEPS); i < (step + 1) * (FRAME_SIZE / STEPS); i++)
+            data[i] = (uint8_t)(seq * 31 + i);
+        clockCycles += (rand() % (STEP_US_MAX + 1)) * (TIMER_CYCLES_PER_MS / 1000);
+        interrupt();
+    }
+
+    for (i = 0; i < (FRAME_SIZE / STEPS) * STEPS; i++)
+    {
+        if (data[i] != (uint8_t)(seq * 31 + i))
+            return true;
+    }
+    return false;
+}
+
+// Returns frames corrupted
+uint32_t run(bool fromIsr)
+{
+    uint32_t seq, corrupted = 0, expected;
+    uint8_t k;
+
+    srand(1);
+    direct = fromIsr;
+    clockCycles = 0;
+    initTimer();
+    oneShotRuns = isrRuns = lateRuns = stoppedRuns = queuedStops = 0;
+
+    for (k = 0; k < PERIODICS; k++)
+    {
+        periods[k] = 3 + k * 2;
+        periodicRuns[k] = 0;
+        timerStart(periodicFns[k], periods[k], true);
+    }
+    for (k = 0; k < FILLERS; k++)
+        timerStart(filler, 1 + k, true);
+    for (k = 0; k < ONESHOTS; k++)
+    {
+        oneShots[k] = timerStart(oneShotFns[k], 2 + k, false);
+        stopped[k] = false;
+    }
+
+    for (seq = 0; seq < FRAMES; seq++)
+    {
+        if (buildFrame(seq))
+            corrupted++;
+
+        // Stop a one-shot that may be queued already, or start it again.
+        // Stopping one that expired succeeds only while it is queued.
+        k = rand() % ONESHOTS;
+        if (!stopped[k] && !timerIsRunning(oneShots[k]) && (rand() & 1))
+        {
+            if (timerStop(oneShots[k]))
+                queuedStops++;
+            stopped[k] = true;
+        }
+        else if (!timerIsRunning(oneShots[k]))
+        {
+            oneShots[k] = timerStart(oneShotFns[k], 1 + rand() % 4, false);
+            stopped[k] = false;
+        }
+
+        timerPoll();
+    }
+
+    interrupt();
+    timerPoll();
+
+    if (!fromIsr)
+    {
+        check(corrupted == 0, "no frame changed under the main loop");
+        check(isrRuns == 0, "no callback run in tickIsr");
+        check(lateRuns == 0, "callbacks run within a frame of their ms");
+        check(queuedStops > 0 && stoppedRuns == 0, "timer stopped while queued does not run");
+        check(oneShotRuns > FRAMES / 4, "one-shots ran");
+        for (k = 0; k < PERIODICS; k++)
+        {
+            expected = timerGetTicks() / periods[k];
+            check(periodicRuns[k] == expected, "every period runs its callback once");
+        }
+    }
+
+    return corrupted;
+}
+
+int main(void)
+{
+    uint32_t corrupted;
+
+    timer4SetClock(simCycles);
+
+    run(false);
+    corrupted = run(true);
+    printf("callbacks run from the interrupt changed %u of %u frames\n", corrupted, FRAMES);
+    check(corrupted > 0, "stress reaches frames being built");
+
+    if (failures == 0)
+        printf("timerqueue: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,296 @@
+// timers.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Checks the timer wheel with Timer 4 on a simulated clock, taking tickIsr
+// when the match is reached and running timerPoll every ms as the main loop
+// would: one-shot and periodic timers run on the ms they are due, timers far
+// enough out to start in every level of the wheel too, stopped and stale
+// handles are ignored, restarting re-arms for a whole period, two timers can
+// share a callback and a full pool refuses a start. Stopping or restarting
+// the timer the match is set for moves the match. Then the old calls that
+// find a timer by its callback, a callback stopping a timer already queued
+// and the clock jumping past a deadline in one step.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "host.h"
+#include "timers.h"
+
+#define FIRES_MAX 8
+
+uint16_t failures = 0;
+uint64_t clockCycles;
+uint32_t fires[FIRES_MAX];     // ms of the last callbacks, in order
+uint8_t fireCount;
+uint32_t otherCount;
+timerHandle pair[2];
+
+void check(bool ok, const char what[])
+{
+    if (!ok && failures++ < 10)
+        printf("FAIL %s\n", what);
+}
+
+uint64_t simCycles(void)
+{
+    return clockCycles;
+}
+
+void fired(void)
+{
+    if (fireCount < FIRES_MAX)
+        fires[fireCount] = timerGetTicks();
+    fireCount++;
+}
+
+void otherFired(void)
+{
+    otherCount++;
+}
+
+// Both of pair due on the same ms, the first one run stops the other. Its
+// own entry is already freed so its handle is stale.
+void stopPair(void)
+{
+    fired();
+    timerStop(pair[0]);
+    timerStop(pair[1]);
+}
+
+void reset(void)
+{
+    clockCycles = 0;
+    initTimer();
+    fireCount = 0;
+    otherCount = 0;
+}
+
+void advance(uint32_t ms)
+{
+    while (ms-- > 0)
+    {
+        clockCycles += TIMER_CYCLES_PER_MS;
+        if (timer4Pending())
+            tickIsr();
+        timerPoll();
+    }
+}
+
+void testOneShot(void)
+{
+    timerHandle handle;
+
+    reset();
+    handle = timerStart(fired, 50, false);
+    check(handle != TIMER_INVALID && timerIsRunning(handle), "one-shot started");
+    advance(49);
+    check(fireCount == 0, "one-shot not early");
+    advance(1);
+    check(fireCount == 1 && fires[0] == 50, "one-shot on its ms");
+    check(!timerIsRunning(handle) && !timerStop(handle), "one-shot freed after its callback");
+    advance(100);
+    check(fireCount == 1, "one-shot runs once");
+}
+
+void testPeriodic(void)
+{
+    timerHandle handle;
+    uint8_t i;
+    bool ok = true;
+
+    reset();
+    handle = timerStart(fired, 30, true);
+    advance(240);
+    for (i = 0; i < FIRES_MAX; i++)
+        ok = ok && fires[i] == 30 * (i + 1);
+    check(fireCount == 8 && ok, "periodic on every multiple of its period");
+    check(timerStop(handle) && !timerIsRunning(handle), "periodic stopped");
+    advance(100);
+    check(fireCount == 8, "stopped periodic does not run");
+    check(!timerStop(handle), "second stop ignored");
+}
+
+void testRestart(void)
+{
+    timerHandle handle;
+
+    reset();
+    handle = timerStart(fired, 100, false);
+    advance(60);
+    check(timerRestart(handle), "restart");
+    advance(99);
+    check(fireCount == 0, "restart re-arms for a whole period");
+    advance(1);
+    check(fireCount == 1 && fires[0] == 160, "restarted one-shot on its ms");
+    check(!timerRestart(handle), "restart of expired one-shot ignored");
+}
+
+// A timer stopped or armed later does not leave the match at its deadline
+void testMatch(void)
+{
+    timerHandle first, second;
+
+    reset();
+    first = timerStart(fired, 100, false);
+    second = timerStart(fired, 1000, false);
+    check(timer4Timeout() == 100, "match at the first deadline");
+    timerStop(first);
+    check(timer4Timeout() == 1000, "stop moves the match to the next deadline");
+    advance(500);
+    timerRestart(second);
+    check(timer4Timeout() == 1000, "restart moves the match out");
+    check(startOneShotTimer(otherFired, 200) && timer4Timeout() == 200, "earlier start moves the match in");
+    check(stopTimer(otherFired) && timer4Timeout() == 1000, "old stop moves the match");
+}
+
+void testSharedCallback(void)
+{
+    timerHandle first, second;
+
+    reset();
+    first = timerStart(fired, 10, true);
+    second = timerStart(fired, 25, false);
+    check(first != second, "two timers on one callback");
+    advance(20);
+    check(timerStop(first), "stop one of two on a callback");
+    advance(20);
+    check(fireCount == 3 && fires[2] == 25, "other timer on the callback still runs");
+}
+
+// Expiries in the first level and each level above it
+void testLevels(void)
+{
+    static const uint32_t due[] = {200, 5000, 300000, 20000000, 1500000000};
+    uint32_t now = 0;
+    uint8_t i;
+
+    reset();
+    for (i = 0; i < sizeof(due) / sizeof(due[0]); i++)
+        timerStart(fired, due[i], false);
+    for (i = 0; i < sizeof(due) / sizeof(due[0]); i++)
+    {
+        // Clock moved in big steps and the interrupt taken only when the
+        // match is reached, as on the target, so hours pass quickly
+        while (fireCount == i && now < due[i] + 1000)
+        {
+            clockCycles = (uint64_t)++now * TIMER_CYCLES_PER_MS;
+            if (timer4Pending())
+                tickIsr();
+            timerPoll();
+            if (fireCount == i && timer4Timeout() > 1)
+            {
+                now += timer4Timeout() - 1;
+                clockCycles = (uint64_t)now * TIMER_CYCLES_PER_MS;
+            }
+        }
+        check(fireCount == i + 1 && fires[i] == due[i], "timer on its ms from every level");
+    }
+}
+
+void testFullPool(void)
+{
+    timerHandle handles[TIMER_MAX];
+    uint16_t i;
+    bool ok = true;
+
+    reset();
+    for (i = 0; i < TIMER_MAX; i++)
+        ok = ok && (handles[i] = timerStart(fired, 1000 + i, false)) != TIMER_INVALID;
+    check(ok, "all TIMER_MAX start");
+    check(timerStart(fired, 10, false) == TIMER_INVALID, "start with a full pool refused");
+    check(!startOneShotTimer(fired, 10), "old start with a full pool refused");
+
+    timerStop(handles[3]);
+    handles[3] = timerStart(otherFired, 10, false);
+    check(handles[3] != TIMER_INVALID, "stopped entry taken again");
+    advance(10);
+    check(otherCount == 1 && fireCount == 0, "reused entry runs its new callback");
+}
+
+void testStaleHandle(void)
+{
+    timerHandle first, second;
+
+    reset();
+    first = timerStart(fired, 10, false);
+    timerStop(first);
+    second = timerStart(otherFired, 20, false);
+    check(!timerStop(first) && !timerRestart(first), "stale handle ignored");
+    check(timerIsRunning(second), "stale handle leaves the new timer");
+    advance(20);
+    check(fireCount == 0 && otherCount == 1, "only the new timer runs");
+}
+
+// startOneShotTimer keeps its entry so restartTimer can run it again
+void testOldCalls(void)
+{
+    reset();
+    check(startOneShotTimer(fired, 20), "old one-shot started");
+    advance(20);
+    check(fireCount == 1, "old one-shot ran");
+    check(restartTimer(fired), "old one-shot kept for restart");
+    advance(20);
+    check(fireCount == 2 && fires[1] == 40, "old one-shot ran again");
+    check(stopTimer(fired) && !stopTimer(fired), "old stop frees it once");
+
+    check(startPeriodicTimer(otherFired, 15), "old periodic started");
+    advance(45);
+    check(otherCount == 3, "old periodic ran every period");
+    resetAllTimers();
+    advance(45);
+    check(otherCount == 3 && !stopTimer(otherFired), "resetAllTimers stops everything");
+}
+
+void testStopQueued(void)
+{
+    reset();
+    pair[0] = timerStart(stopPair, 10, false);
+    pair[1] = timerStart(stopPair, 10, false);
+    advance(10);
+    check(fireCount == 1, "timer stopped after it expired is skipped");
+}
+
+void testJump(void)
+{
+    reset();
+    timerStart(fired, 1000, false);
+    timerStart(otherFired, 100, true);
+    clockCycles = 5000ULL * TIMER_CYCLES_PER_MS;
+    check(timer4Pending(), "match passed in a jump");
+    tickIsr();
+    timerPoll();
+    check(fireCount == 1 && fires[0] == 5000, "one-shot runs after a jump past it");
+    check(otherCount == 1, "periodic queued once for a jump over many periods");
+    otherCount = 0;
+    advance(300);
+    check(otherCount == 3, "periodic keeps its period after a jump");
+}
+
+int main(void)
+{
+    timer4SetClock(simCycles);
+
+    testOneShot();
+    testPeriodic();
+    testRestart();
+    testMatch();
+    testSharedCallback();
+    testLevels();
+    testFullPool();
+    testStaleHandle();
+    testOldCalls();
+    testStopQueued();
+    testJump();
+
+    if (failures == 0)
+        printf("timers: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+// topic.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Checks the topic trie: '+' and '#' wildcards, '#' matching its parent
+// level, '$' topics kept from wildcards at the first level, handlers taken
+// off again, filters that do not fit leaving no levels behind, freed nodes
+// coming back off the free list and freed characters coming back when the
+// arena is compacted.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "topic.h"
+
+#define ROUNDS 20
+#define LEVELS 16
+
+// Pools in topic.c
+extern topicNode topicNodes[];
+extern uint16_t topicArenaUsed;
+extern topicIndex topicFreeList;
+
+uint16_t failures = 0;
+uint8_t hits = 0;
+char lastTopic[64];
+char lastPayload[64];
+
+void check(bool ok, const char what[])
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+void count(char topic[], char payload[], topicIndex node)
+{
+    hits++;
+    snprintf(lastTopic, sizeof(lastTopic), "%s", topic);
+    snprintf(lastPayload, sizeof(lastPayload), "%s", payload);
+}
+
+// Handlers called for topic, each counted
+uint8_t dispatch(const char topic[])
+{
+    char copy[64], payload[] = "x";
+
+    snprintf(copy, sizeof(copy), "%s", topic);
+    hits = 0;
+    if (topicDispatch(copy, payload) != hits)
+        return 0xFF;
+    return hits;
+}
+
+uint16_t freeNodes(void)
+{
+    topicIndex i;
+    uint16_t n = 0;
+
+    for (i = topicFreeList; i != TOPIC_NONE; i = topicNodes[i].sibling)
+        n++;
+    return n;
+}
+
+void testWildcards(void)
+{
+    char topic[] = "env/temp", payload[] = "21";
+
+    initTopics();
+    topicRegister("env/led/+", count);
+    topicRegister("env/#", count);
+    topicRegister("env/temp", count);
+    topicRegister("sport/#", count);
+    topicRegister("+/+/+", count);
+    topicRegister("$SYS/#", count);
+
+    check(topicDispatch(topic, payload) == 2 && hits == 2, "exact and '#' filters matched");
+    check(strcmp(lastTopic, "env/temp") == 0 && strcmp(lastPayload, "21") == 0, "handler given topic and payload");
+    check(dispatch("env/led/green") == 3, "'+' matches one level");
+    check(dispatch("env/led/green/x") == 1, "'+' does not match two levels");
+    check(dispatch("env") == 1, "'#' matches its parent level");
+    check(dispatch("sport/a/b/c") == 1, "'#' matches several levels");
+    check(dispatch("other/x") == 0, "unmatched topic");
+    check(dispatch("a/b/c") == 1, "'+' at every level");
+    check(dispatch("env/") == 1, "'#' matches an empty last level");
+    check(dispatch("") == 0, "empty topic");
+    check(dispatch("$SYS/broker") == 1, "'$' topic matched by its own filter");
+    check(dispatch("$SYS/a/b") == 1, "'$' topic not matched by a first level wildcard");
+    check(topicFind("env/led/+") != TOPIC_NONE && topicFind("env/led") != TOPIC_NONE, "filter levels found");
+    check(topicFind("env/led/red") == TOPIC_NONE, "missing filter not found");
+}
+
+void testRemove(void)
+{
+    uint16_t before;
+
+    initTopics();
+    topicRegister("env/#", count);
+    topicRegister("env/temp", count);
+    before = freeNodes();
+
+    // Subscribed and handled share a node, it stays until both are gone
+    check(topicSubscribe("env/temp"), "subscribed");
+    check(topicRegister("env/temp", NULL), "handler taken off");
+    check(dispatch("env/temp") == 1, "handler taken off no longer called");
+    check(topicFind("env/temp") != TOPIC_NONE, "subscribed filter kept");
+    topicUnsubscribe("env/temp");
+    check(topicFind("env/temp") == TOPIC_NONE && freeNodes() == before + 1, "unsubscribed filter freed");
+
+    // Levels above a filter go with it, unless something else needs them
+    check(topicSubscribe("a/b/c/d"), "deep filter subscribed");
+    check(freeNodes() == before - 3, "deep filter takes a node per level");
+    topicUnsubscribe("a/b/c/d");
+    check(freeNodes() == before + 1 && topicFind("a") == TOPIC_NONE, "every level of a deep filter freed");
+    check(dispatch("env/x") == 1, "other filters kept");
+    topicUnsubscribe("never/subscribed");
+    check(freeNodes() == before + 1, "unsubscribing a missing filter");
+}
+
+void testFull(void)
+{
+    char filter[32];
+    uint16_t i = 0;
+
+    initTopics();
+    check(freeNodes() == TOPIC_MAX_NODES - 1, "every node but the root free");
+
+    // One node each until the pool runs out
+    do
+        snprintf(filter, sizeof(filter), "f%u", i++);
+    while (topicSubscribe(filter));
+    check(i == TOPIC_MAX_NODES, "pool holds one node less than its size");
+    check(freeNodes() == 0, "pool empty");
+
+    // A filter that does not fit leaves nothing behind
+    topicUnsubscribe("f0");
+    topicUnsubscribe("f1");
+    check(!topicSubscribe("a/b/c") && freeNodes() == 2 && topicFind("a") == TOPIC_NONE,
+          "levels of a filter that does not fit freed");
+    check(topicRegister("a/b", count) && freeNodes() == 0, "freed nodes used again");
+    check(dispatch("a/b") == 1, "handler on reused nodes");
+    check(!topicSubscribe("a/b/c"), "still full");
+    check(dispatch("a/b") == 1 && topicFind("a/b/c") == TOPIC_NONE, "handler kept when a longer filter does not fit");
+}
+
+void testCompact(void)
+{
+    char filter[48];
+    uint16_t round, i, added = 0;
+
+    initTopics();
+    topicRegister("env/temp", count);
+
+    // 16 levels of 28 characters fit in the arena, 20 rounds of them only
+    // when the characters of each round are reclaimed for the next
+    for (round = 0; round < ROUNDS; round++)
+    {
+        for (i = 0; i < LEVELS; i++)
+        {
+            snprintf(filter, sizeof(filter), "x/level%02u-%02u-abcdefghijklmnopq", i, round);
+            added += topicSubscribe(filter);
+        }
+        for (i = 0; i < LEVELS; i++)
+        {
+            snprintf(filter, sizeof(filter), "x/level%02u-%02u-abcdefghijklmnopq", i, round);
+            check(topicFind(filter) != TOPIC_NONE, "filter found before unsubscribe");
+            topicUnsubscribe(filter);
+        }
+    }
+    check(added == ROUNDS * LEVELS, "arena compacted to make room");
+    check(topicArenaUsed <= TOPIC_ARENA_SIZE, "arena in bounds");
+    check(dispatch("env/temp") == 1, "levels moved by compaction still match");
+
+    // Arena full of live levels, 20 of 29 characters do not fit
+    for (i = 0; i < 20; i++)
+    {
+        snprintf(filter, sizeof(filter), "y/level%02u-abcdefghijklmnopqrstu", i);
+        if (!topicSubscribe(filter))
+            break;
+    }
+    check(i < 20, "arena runs out");
+    check(topicFind(filter) == TOPIC_NONE, "filter that does not fit not found");
+    check(dispatch("env/temp") == 1, "filters kept when the arena runs out");
+}
+
+int main(void)
+{
+    testWildcards();
+    testRemove();
+    testFull();
+    testCompact();
+
+    if (failures == 0)
+        printf("topic: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+// uart0.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Sends console output through the UART0 transmit ring with stdout paced
+// at 115200 baud, and checks that a message that does not fit is dropped
+// and counted, that a blocking one waits for the transfer under way, and
+// that what reaches stdout is everything not dropped, in order.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "uart0.h"
+
+#define BAUD 115200
+
+char expected[4096];
+uint16_t expectedSize = 0;
+uint16_t failures = 0;
+
+void check(bool ok, const char what[])
+{
+    if (!ok)
+    {
+        fprintf(stderr, "FAIL %s\n", what);
+        failures++;
+    }
+}
+
+uint32_t elapsedUs(const struct timespec* start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+void send(const char str[], uint16_t size, uint8_t policy, bool sent)
+{
+    check(uart0Write(str, size, policy) == sent, sent ? "message sent" : "message dropped");
+    if (sent)
+    {
+        memcpy(expected + expectedSize, str, size);
+        expectedSize += size;
+    }
+}
+
+int main(void)
+{
+    char block[QUEUE_BUFFER_LENGTH], output[sizeof(expected) + 1];
+    struct timespec start;
+    uint32_t us;
+    uint16_t i;
+    FILE* file = tmpfile();
+
+    for (i = 0; i < sizeof(block); i++)
+        block[i] = 'a' + i % 26;
+
+    fflush(stdout);
+    dup2(fileno(file), STDOUT_FILENO);
+    setenv("IOT_UART_BAUD", "115200", 1);
+    initUart0(BAUD, 40e6);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Nearly fills the ring, all of it goes out as one transfer
+    send(block, 1000, UART0_BLOCK, true);
+    check(uart0Info.dmaSize == 1000, "transfer started");
+
+    // Log class messages only go in whole
+    send(block, 100, UART0_DROP, false);
+    check(uart0DroppedBytes == 100 && uart0DroppedMessages == 1, "drop counted");
+    send(block, QUEUE_BUFFER_LENGTH - 1000, UART0_DROP, true);
+    check(uart0TxSpace() == 0, "ring full");
+
+    // Waits for the first transfer to free its bytes
+    send(block + 500, 300, UART0_BLOCK, true);
+    us = elapsedUs(&start);
+    check(us >= (1000 * 10 * 1000000ULL) / BAUD, "block waited for the transfer");
+
+    printfUart0(UART0_BLOCK, "%u frames, %s\r\n", 42, "ok");
+    memcpy(expected + expectedSize, "42 frames, ok\r\n", 15);
+    expectedSize += 15;
+
+    while (uart0Info.readIndex != uart0Info.writeIndex)
+        pause();
+    us = elapsedUs(&start);
+    check(us >= ((uint64_t)expectedSize * 10 * 1000000) / BAUD, "paced at the baud rate");
+
+    fflush(file);
+    rewind(file);
+    check(fread(output, 1, sizeof(output), file) == expectedSize, "every byte sent");
+    check(memcmp(output, expected, expectedSize) == 0, "bytes in order");
+
+    if (failures == 0)
+        fprintf(stderr, "uart0: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+// tickbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Counts the Timer 4 interrupts an hour of a device on a DHCP lease and
+// connected to its broker takes with the timers matched at their deadlines,
+// against the 3600000 the old 1 kHz tick took whatever was running. The
+// timers are the ones the stack keeps: the lease's expiry, renewal and
+// rebind one-shots restarted when a renewal is acknowledged, the MQTT
+// keep-alive, the address announcement and the ARP refresh, plus for each
+// publish a retransmission timer stopped by the broker's ACK 5 ms later.
+// Their callbacks only restart timers as the stack's do. Timer 4 is on a
+// simulated clock that jumps from one match or publish to the next, so a
+// day passes at once. The host counter does not wrap, the wraps of the
+// target's 32-bit counter, one every 107 s, are added from the time.
+// Timers due on the same ms share an interrupt, so there can be fewer
+// matches than callbacks. A match left for a stopped timer would show as
+// more.
+// Usage: tickbench [HOURS], 24 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "host.h"
+#include "timers.h"
+#include "dhcp.h"
+#include "mqtt.h"
+#include "arp.h"
+
+#define LEASE_S     3600
+#define RTO_MS      1000
+#define ACK_MS      5
+#define MS_PER_HOUR 3600000ULL
+
+uint64_t clockCycles;
+uint32_t callbacks;
+timerHandle rtxTimer = TIMER_INVALID;
+timerHandle arpRefresh = TIMER_INVALID;
+
+uint64_t simCycles(void)
+{
+    return clockCycles;
+}
+
+void leaseExpired(void)
+{
+    callbacks++;
+}
+
+void rebind(void)
+{
+    callbacks++;
+}
+
+// Renewal acknowledged at once, the lease timers start over as dhcp.c
+// restarts them
+void renewal(void)
+{
+    callbacks++;
+    restartTimer(leaseExpired);
+    restartTimer(renewal);
+    restartTimer(rebind);
+}
+
+void keepAlive(void)
+{
+    callbacks++;
+}
+
+void announce(void)
+{
+    callbacks++;
+}
+
+// arpTimerExpired takes a new one-shot for the entry due next
+void arpExpired(void)
+{
+    callbacks++;
+    arpRefresh = timerStart(arpExpired, ARP_ENTRY_TIME, false);
+}
+
+void rtxExpired(void)
+{
+    callbacks++;
+}
+
+// Timer 4 interrupts in hours with a publish every publishMs, none if 0
+void run(uint32_t publishMs, uint32_t hours)
+{
+    uint64_t now = 0, end = hours * MS_PER_HOUR, next, publish, ack = UINT64_MAX;
+    uint32_t interrupts = 0, wraps;
+    int32_t wait;
+
+    clockCycles = 0;
+    initTimer();
+    callbacks = 0;
+
+    // Timers running once bound and connected
+    startOneShotTimer(leaseExpired, LEASE_S * MULT_FACTOR);
+    startOneShotTimer(renewal, (LEASE_S * MULT_FACTOR) / (2 * LEASE_TIME_DIVISOR));
+    startOneShotTimer(rebind, (LEASE_S * MULT_FACTOR * 7) / (8 * LEASE_TIME_DIVISOR));
+    startPeriodicTimer(keepAlive, MQTT_KEEP_ALIVE_TIME * MULT_FACTOR);
+    startPeriodicTimer(announce, 120 * MULT_FACTOR);
+    arpRefresh = timerStart(arpExpired, ARP_ENTRY_TIME, false);
+    publish = (publishMs != 0) ? publishMs : UINT64_MAX;
+
+    while (now < end)
+    {
+        // Sleep to the match or the next frame, whichever is first
+        wait = timer4Timeout();
+        next = (wait < 0) ? end : now + wait;
+        if (publish < next)
+            next = publish;
+        if (ack < next)
+            next = ack;
+        if (next > end)
+            next = end;
+        now = next;
+        clockCycles = now * TIMER_CYCLES_PER_MS;
+
+        if (timer4Pending())
+        {
+            tickIsr();
+            interrupts++;
+        }
+        timerPoll();
+
+        if (now == ack)
+        {
+            timerStop(rtxTimer);
+            ack = UINT64_MAX;
+        }
+        if (now == publish)
+        {
+            timerStop(rtxTimer);
+            rtxTimer = timerStart(rtxExpired, RTO_MS, false);
+            ack = now + ACK_MS;
+            publish += publishMs;
+        }
+    }
+
+    wraps = (end * TIMER_CYCLES_PER_MS) >> 32;
+    printf("%10u %12.0f %12.0f %12.0f %12.1f\n", publishMs / 1000, (double)callbacks / hours,
+           (double)interrupts / hours, (double)(interrupts + wraps) / hours,
+           (double)(interrupts + wraps) / hours / 60);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint32_t publishMs[] = {0, 60000, 10000, 1000};
+    uint32_t hours = 24;
+    uint8_t i;
+
+    if (argc > 1)
+        hours = strtoul(argv[1], NULL, 0);
+    if (hours == 0)
+        hours = 1;
+
+    timer4SetClock(simCycles);
+
+    printf("%u h lease, %u s keep-alive, 120 s announcements, %u s ARP refresh, over %u h\n",
+           LEASE_S / 3600, MQTT_KEEP_ALIVE_TIME, ARP_ENTRY_TIME / 1000, hours);
+    printf("Old 1 kHz tick: %llu interrupts an hour, %llu a minute\n\n", MS_PER_HOUR, MS_PER_HOUR / 60);
+    printf("%10s %12s %12s %12s %12s\n", "Publish s", "Callbacks/h", "Matches/h", "With wraps/h", "Per minute");
+    for (i = 0; i < sizeof(publishMs) / sizeof(publishMs[0]); i++)
+        run(publishMs[i], hours);
+
+    return 0;
+}
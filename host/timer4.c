@@ -0,0 +1,99 @@
+// timer4.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   IoT_Project/timer4.c
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "host.h"
+#include "timer4.h"
+#include "timers.h"
+
+// The monotonic clock scaled to the 40 MHz system clock, it does not wrap
+// so the match is the whole 64-bit deadline
+struct timespec timer4Start;
+uint64_t timer4Match = UINT64_MAX;
+bool timer4Enabled = false;
+hostClock timer4Clock = NULL;
+uint64_t timer4ClockStart = 0;
+
+// Counts cycles of clock from the next initTimer4 on, NULL for the
+// monotonic clock
+void timer4SetClock(hostClock clock)
+{
+    timer4Clock = clock;
+}
+
+void initTimer4(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &timer4Start);
+    if (timer4Clock != NULL)
+        timer4ClockStart = timer4Clock();
+    timer4Match = UINT64_MAX;
+    timer4Enabled = true;
+}
+
+void timer4DisableInterrupts(void)
+{
+    timer4Enabled = false;
+}
+
+void timer4EnableInterrupts(void)
+{
+    timer4Enabled = true;
+}
+
+uint64_t timer4GetCycles(void)
+{
+    struct timespec now;
+    int64_t ns;
+
+    if (timer4Clock != NULL)
+        return timer4Clock() - timer4ClockStart;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = (int64_t)(now.tv_sec - timer4Start.tv_sec) * 1000000000 + (now.tv_nsec - timer4Start.tv_nsec);
+
+    return ((uint64_t)ns * (TIMER_CYCLES_PER_MS / 1000)) / 1000;
+}
+
+void timer4SetMatch(uint64_t cycles)
+{
+    timer4Match = cycles;
+}
+
+void timer4ClearInterrupt(void)
+{
+    timer4Match = UINT64_MAX;
+}
+
+// True once the match has passed, tickIsr is then due
+bool timer4Pending(void)
+{
+    return timer4Enabled && timer4GetCycles() >= timer4Match;
+}
+
+// ms until the match rounded up for poll, -1 if none is set
+int32_t timer4Timeout(void)
+{
+    uint64_t now = timer4GetCycles();
+    uint64_t ms;
+
+    if (timer4Match == UINT64_MAX)
+        return -1;
+    if (timer4Match <= now)
+        return 0;
+
+    ms = (timer4Match - now + TIMER_CYCLES_PER_MS - 1) / TIMER_CYCLES_PER_MS;
+    if (ms > INT32_MAX)
+        return -1;
+
+    return (int32_t)ms;
+}
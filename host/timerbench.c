@@ -0,0 +1,243 @@
+// timerbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Runs sets of periodic timers with periods from 10 ms to 10 s on the timer
+// wheel, with Timer 4 on a simulated clock, against the linear array timers.c
+// kept before it, reimplemented here as it was: every slot decremented on
+// each 1 kHz tick and timers found by scanning for their callback, which is
+// a scan for an owner here since one callback cannot have two old timers.
+// It prints the time each simulated ms costs, Timer 4 interrupts taken and
+// the time to restart a running timer and to start and stop another, and
+// fails if the two do not run the callbacks the same number of times.
+// Host times only rank the two, count cycles on the target for its numbers.
+// timerbench_large is built with TIMER_MAX=4096 for the larger sets.
+// Usage: timerbench [SIM_MS], 60000 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "host.h"
+#include "timers.h"
+
+#define OPS 100000
+
+typedef struct _oldTimer
+{
+    bool      reload;
+    uint32_t  period;
+    uint32_t  ticks;
+    _callback fn;
+    uint16_t  owner;
+} oldTimer;
+
+oldTimer oldTimers[TIMER_MAX];
+uint16_t oldCount;
+uint32_t periods[TIMER_MAX];
+timerHandle handles[TIMER_MAX];
+uint64_t clockCycles;
+uint32_t oldFires, wheelFires;
+
+uint64_t simCycles(void)
+{
+    return clockCycles;
+}
+
+double elapsed(struct timespec* start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+void oldFired(void)
+{
+    oldFires++;
+}
+
+void wheelFired(void)
+{
+    wheelFires++;
+}
+
+// Same as the old startPeriodicTimer and startOneShotTimer
+bool oldStart(uint16_t owner, uint32_t period, bool reload)
+{
+    uint16_t i;
+
+    for (i = 0; i < oldCount; i++)
+    {
+        if (oldTimers[i].fn == NULL)
+        {
+            oldTimers[i].period = period;
+            oldTimers[i].ticks  = period;
+            oldTimers[i].fn     = oldFired;
+            oldTimers[i].reload = reload;
+            oldTimers[i].owner  = owner;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Same as the old stopTimer
+bool oldStop(uint16_t owner)
+{
+    uint16_t i;
+
+    for (i = 0; i < oldCount; i++)
+    {
+        if (oldTimers[i].fn != NULL && oldTimers[i].owner == owner)
+        {
+            oldTimers[i].period = 0;
+            oldTimers[i].ticks  = 0;
+            oldTimers[i].fn     = NULL;
+            oldTimers[i].reload = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Same as the old restartTimer
+bool oldRestart(uint16_t owner)
+{
+    uint16_t i;
+
+    for (i = 0; i < oldCount; i++)
+    {
+        if (oldTimers[i].fn != NULL && oldTimers[i].owner == owner)
+        {
+            oldTimers[i].ticks = oldTimers[i].period;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Same as the old tickIsr
+void oldTick(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < oldCount; i++)
+    {
+        if (oldTimers[i].ticks > 0)
+        {
+            oldTimers[i].ticks--;
+            if (oldTimers[i].ticks == 0)
+            {
+                if (oldTimers[i].reload)
+                    oldTimers[i].ticks = oldTimers[i].period;
+                (*oldTimers[i].fn)();
+            }
+        }
+    }
+}
+
+void run(uint16_t count, uint32_t simMs)
+{
+    struct timespec start;
+    double oldMsNs, wheelMsNs, oldRestartNs, wheelRestartNs, oldStartStopNs, wheelStartStopNs;
+    uint32_t i, isrs = 0;
+
+    // Old array, one spare slot for the start and stop
+    oldCount = count + 1;
+    for (i = 0; i < oldCount; i++)
+        oldTimers[i].fn = NULL;
+    for (i = 0; i < count; i++)
+        oldStart(i, periods[i], true);
+
+    oldFires = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < simMs; i++)
+        oldTick();
+    oldMsNs = elapsed(&start) / simMs;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < OPS; i++)
+        oldRestart((i * 7919) % count);
+    oldRestartNs = elapsed(&start) / OPS;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < OPS; i++)
+    {
+        oldStart(count, 100, false);
+        oldStop(count);
+    }
+    oldStartStopNs = elapsed(&start) / OPS;
+
+    // Wheel, Timer 4 interrupts taken when the match is reached
+    clockCycles = 0;
+    initTimer();
+    for (i = 0; i < count; i++)
+        handles[i] = timerStart(wheelFired, periods[i], true);
+
+    wheelFires = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < simMs; i++)
+    {
+        clockCycles += TIMER_CYCLES_PER_MS;
+        if (timer4Pending())
+        {
+            tickIsr();
+            isrs++;
+        }
+        timerPoll();
+    }
+    wheelMsNs = elapsed(&start) / simMs;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < OPS; i++)
+        timerRestart(handles[(i * 7919) % count]);
+    wheelRestartNs = elapsed(&start) / OPS;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < OPS; i++)
+        timerStop(timerStart(wheelFired, 100, false));
+    wheelStartStopNs = elapsed(&start) / OPS;
+
+    printf("%7u %9.1f %9.1f %8u %9u %9.1f %9.1f %9.1f %9.1f\n", count, oldMsNs, wheelMsNs, simMs, isrs,
+           oldRestartNs, wheelRestartNs, oldStartStopNs, wheelStartStopNs);
+
+    if (oldFires != wheelFires)
+    {
+        printf("FAIL %u timers fired %u times on the old array and %u on the wheel\n", count, oldFires, wheelFires);
+        exit(1);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint16_t counts[] = {10, 20, 100, 1000, 4000};
+    uint32_t simMs = 60000;
+    uint16_t i;
+
+    if (argc > 1)
+        simMs = strtoul(argv[1], NULL, 0);
+
+    // As many timers of 10 ms as of 10 s, spread over the powers of two
+    // between, so the long ones sit in the wheel's higher levels
+    for (i = 0; i < TIMER_MAX; i++)
+        periods[i] = (10 << (rand() % 11)) + rand() % 10;
+
+    timer4SetClock(simCycles);
+
+    printf("TIMER_MAX %u, %u simulated ms, times in ns\n\n", TIMER_MAX, simMs);
+    printf("%7s %9s %9s %8s %9s %9s %9s %9s %9s\n", "Timers", "Old ms", "Wheel ms", "Old irq", "Wheel irq",
+           "Old rst", "Wheel rst", "Old s+s", "Wheel s+s");
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        if (counts[i] < TIMER_MAX)
+            run(counts[i], simMs);
+    }
+
+    return 0;
+}
@@ -0,0 +1,32 @@
+// tm4c123gh6pm.h
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   TI device header
+
+// Only main.c's initHw and the unused adc.h, pwm0.h and rtc.h include the
+// device header in a host build, the driver modules it is meant for are
+// replaced by the files in this directory. initHw's clock setup writes to
+// a plain variable.
+
+#ifndef TM4C123GH6PM_H_
+#define TM4C123GH6PM_H_
+
+#include <stdint.h>
+
+extern volatile uint32_t hostSysctlRcc;
+
+#define SYSCTL_RCC_R            hostSysctlRcc
+#define SYSCTL_RCC_XTAL_16MHZ   0x00000540
+#define SYSCTL_RCC_OSCSRC_MAIN  0x00000000
+#define SYSCTL_RCC_USESYSDIV    0x00400000
+#define SYSCTL_RCC_SYSDIV_S     23
+
+#define _delay_cycles(cycles)
+
+#endif /* TM4C123GH6PM_H_ */
@@ -0,0 +1,179 @@
+// topicbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+
+// Times topicDispatch on 10000 topics against matching every filter in turn
+// as a flat subscription table would. Filters are added until the trie is
+// full. topicbench has the target's pool of 64 nodes, topicbench_large is
+// built with pools for the 500 and more filters a broker would take.
+// Both must find the same number of matches.
+// Host times only rank the two, count cycles on the target for its numbers.
+// Usage: topicbench [RUNS], 10 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "topic.h"
+#include "uart0.h"
+
+#define TOPICS      10000
+#define TOPIC_SIZE  32
+#define MAX_FILTERS TOPIC_MAX_NODES
+
+char filters[MAX_FILTERS][TOPIC_SIZE];
+char topics[TOPICS][TOPIC_SIZE];
+uint16_t filterCount = 0;
+uint32_t calls = 0;
+
+// Only topic.c is built in, topicPrint writes to the terminal
+void sendUart0String(char str[])
+{
+    fputs(str, stdout);
+}
+
+void count(char topic[], char payload[], topicIndex node)
+{
+    calls++;
+}
+
+// MQTT 3.1.1 Section 4.7 matching of one filter, a level at a time
+bool filterMatches(const char filter[], const char topic[])
+{
+    if (topic[0] == '$' && (filter[0] == '+' || filter[0] == '#'))
+        return false;
+
+    while (true)
+    {
+        if (*filter == '#')
+            return true;
+        if (*filter == '+')
+        {
+            filter++;
+            while (*topic != '/' && *topic != '\0')
+                topic++;
+        }
+        else
+        {
+            while (*filter != '/' && *filter != '\0' && *filter == *topic)
+            {
+                filter++;
+                topic++;
+            }
+            if ((*filter != '/' && *filter != '\0') || (*topic != '/' && *topic != '\0'))
+                return false;
+        }
+
+        if (*filter == '\0' && *topic == '\0')
+            return true;
+        if (*filter == '/' && *topic == '/')
+        {
+            filter++;
+            topic++;
+            continue;
+        }
+
+        // "a/#" also matches "a"
+        return *topic == '\0' && strcmp(filter, "/#") == 0;
+    }
+}
+
+// Mix of exact, '+' and '#' filters over a few devices, until one does not fit
+void addFilters(void)
+{
+    static const char* forms[] = {"dev%u/temp", "dev%u/+/state", "dev%u/#", "+/%u", "dev%u/led/+"};
+    char filter[TOPIC_SIZE];
+    uint16_t i = 0;
+
+    initTopics();
+    while (filterCount < MAX_FILTERS)
+    {
+        snprintf(filter, sizeof(filter), forms[i % 5], i / 5);
+        if (!topicRegister(filter, count))
+            break;
+        strcpy(filters[filterCount++], filter);
+        i++;
+    }
+}
+
+// Topics on twice as many devices as have filters, so some miss
+void makeTopics(void)
+{
+    static const char* forms[] = {"dev%u/temp", "dev%u/led/red", "dev%u/pump/state", "dev%u/a/b/c", "room/%u", "$SYS/%u"};
+    uint16_t i;
+
+    srand(1);
+    for (i = 0; i < TOPICS; i++)
+        snprintf(topics[i], TOPIC_SIZE, forms[rand() % 6], rand() % (2 * filterCount / 5 + 1));
+}
+
+double seconds(const struct timespec* start, const struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Returns ns per topic, matches counted in calls
+double nsPerTopic(bool trie, uint32_t runs)
+{
+    struct timespec start, end;
+    char payload[] = "x";
+    uint32_t i;
+    uint16_t j, k;
+
+    calls = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < runs; i++)
+    {
+        for (j = 0; j < TOPICS; j++)
+        {
+            if (trie)
+                topicDispatch(topics[j], payload);
+            else
+            {
+                for (k = 0; k < filterCount; k++)
+                {
+                    if (filterMatches(filters[k], topics[j]))
+                        count(topics[j], payload, k);
+                }
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return seconds(&start, &end) * 1e9 / ((double)runs * TOPICS);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t runs = 10, scanCalls;
+    double scan, trie;
+
+    if (argc > 1)
+        runs = strtoul(argv[1], NULL, 0);
+
+    addFilters();
+    makeTopics();
+
+    scan = nsPerTopic(false, runs);
+    scanCalls = calls;
+    trie = nsPerTopic(true, runs);
+    if (calls != scanCalls)
+    {
+        printf("trie matched %u, scan matched %u\n", calls, scanCalls);
+        return 1;
+    }
+
+    printf("%u filters, %u topics, %u matches\n", filterCount, TOPICS, calls / runs);
+    printf("%10s %10s %8s\n", "Scan ns", "Trie ns", "Speedup");
+    printf("%10.2f %10.2f %8.2f\n", scan, trie, scan / trie);
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+// txbench.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Sends a stream of QoS 0 PUBLISH frames through the ENC28J60 driver on the
+// model in host/enc28j60sim.c, with frames taking their time on a 10 Mb/s
+// wire and SPI transfers at the 4 MHz clock main.c asks for. Each pass of
+// the main loop does some other work, then sends one frame. It prints the
+// time a pass takes on average and at worst, which is how long the shell
+// and the timers wait, and the frames sent per second, for the old
+// etherPutPacket that spun on TXRTS after every frame and for the tx slots
+// that queue it and let TXIF retire it.
+// Usage: txbench [PUBLISHES], 1000 if not given
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "spi.h"
+#include "ethernet.h"
+#include "enc28j60.h"
+#include "enc28j60sim.h"
+
+#define FCYC       40000000
+#define SPI_CLOCK  4000000
+
+uint8_t frame[MAX_PACKET_SIZE];
+
+void discard(const uint8_t frame[], uint16_t size)
+{
+}
+
+void reset(void)
+{
+    initEnc28j60Sim(discard);
+    etherInit(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
+    enc28j60SimTiming(spi0BitRate);
+    enc28j60SimClearStats();
+}
+
+// etherIsr for as long as INT is asserted
+void service(void)
+{
+    while (enc28j60SimInterrupt())
+        etherIsr();
+}
+
+void run(bool spin, uint32_t workUs, uint16_t size, uint32_t count)
+{
+    uint64_t start, pass, worst = 0, total = 0, end;
+    uint32_t i;
+
+    reset();
+    start = enc28j60SimTime();
+    for (i = 0; i < count; i++)
+    {
+        pass = enc28j60SimTime();
+        enc28j60SimElapse(workUs * 1000);
+        service();
+        etherPutPacket(frame, size);
+        if (spin)
+        {
+            etherLock();
+            while ((etherReadReg(ECON1) & TXRTS) != 0);
+            etherUnlock();
+        }
+        service();
+        pass = enc28j60SimTime() - pass;
+        total += pass;
+        if (pass > worst)
+            worst = pass;
+    }
+
+    // Let the frames still queued go out
+    while (enc28j60Sim.transmitted < count)
+    {
+        enc28j60SimElapse(1000);
+        service();
+    }
+    end = enc28j60SimTime();
+
+    printf("%-8s %6u %8u %10.1f %10.1f %10.0f\n", spin ? "spin" : "slots", size, workUs,
+           total / 1000.0 / count, worst / 1000.0, count * 1e9 / (end - start));
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint16_t sizes[] = {80, 600, 1100};
+    static const uint32_t works[] = {0, 200, 1000};
+    uint32_t count = 1000;
+    uint8_t s, w;
+
+    if (argc > 1)
+        count = strtoul(argv[1], NULL, 0);
+
+    initSpi0(USE_SSI0_RX, SPI_CLOCK, FCYC);
+    memset(frame, 0x02, sizeof(frame));
+
+    printf("SPI clock %u Hz, %u tx slots\n\n", spi0BitRate, ETHER_TX_SLOTS);
+    printf("%-8s %6s %8s %10s %10s %10s\n", "Send", "Bytes", "Work us", "Pass us", "Worst us", "Frames/s");
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        for (w = 0; w < sizeof(works) / sizeof(works[0]); w++)
+        {
+            run(true, works[w], sizes[s], count);
+            run(false, works[w], sizes[s], count);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+// uart0.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   IoT_Project/uart0.c
+
+// The console is stdin and stdout. Transfers from the transmit ring in
+// console.c are written to stdout as soon as they are started, and typed
+// lines end in '\n' where a terminal sends '\r'.
+// With IOT_UART_BAUD set, each transfer holds its bytes in the ring for as
+// long as it would take on the wire at that rate, and SIGALRM stands in for
+// the uDMA done interrupt. The ring then fills as on the target, so the
+// drop and block policies of uart0Write can be watched and tested.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "host.h"
+#include "uart0.h"
+#include "events.h"
+
+#define UART0_RX_SIZE 256   // Power of 2
+
+char uart0Rx[UART0_RX_SIZE];
+uint16_t uart0RxWrite = 0;
+uint16_t uart0RxRead = 0;
+
+uint32_t uart0PaceBaud = 0;   // Transmit rate from IOT_UART_BAUD, 0 if not paced
+sigset_t uart0TxSignal;
+
+// Read stdin only while there is room for what it has
+bool uart0RxRoom(void)
+{
+    return (uint16_t)(uart0RxWrite - uart0RxRead) < UART0_RX_SIZE;
+}
+
+// Transfer done, its bytes are free and the next one can start
+void uart0TxDone(int signal)
+{
+    uart0Info.readIndex += uart0Info.dmaSize;
+    uart0Info.dmaSize = 0;
+    uart0TxStart();
+}
+
+void initUart0(uint32_t baudRate, uint32_t fcyc)
+{
+    struct sigaction action = {0};
+    const char* pace = getenv("IOT_UART_BAUD");
+
+    setUart0BaudRate(baudRate, fcyc);
+    hostAddSource(STDIN_FILENO, uart0RxRoom, uart0Isr);
+
+    sigemptyset(&uart0TxSignal);
+    sigaddset(&uart0TxSignal, SIGALRM);
+    if (pace != NULL)
+    {
+        uart0PaceBaud = strtoul(pace, NULL, 0);
+        action.sa_handler = uart0TxDone;
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGALRM, &action, NULL);
+    }
+}
+
+void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc)
+{
+}
+
+bool kbhitUart0(void)
+{
+    return uart0RxWrite != uart0RxRead;
+}
+
+char getcUart0(void)
+{
+    char c = uart0Rx[uart0RxRead & (UART0_RX_SIZE - 1)];
+
+    uart0RxRead++;
+    if (c == '\n')
+        c = '\r';
+
+    return c;
+}
+
+void clearUart0Interrupts(void)
+{
+}
+
+void uart0Lock(void)
+{
+    sigprocmask(SIG_BLOCK, &uart0TxSignal, NULL);
+}
+
+void uart0Unlock(void)
+{
+    sigprocmask(SIG_UNBLOCK, &uart0TxSignal, NULL);
+}
+
+// Write the bytes waiting up to the end of the ring, then the rest. When
+// paced, only the first transfer is started and uart0TxDone starts the next
+// once its time on the wire (10 bits a byte) is up.
+void uart0TxStart(void)
+{
+    struct itimerval timer = {{0, 0}, {0, 0}};
+    uint64_t us;
+    uint16_t start, size;
+
+    while (uart0Info.dmaSize == 0 && uart0Info.writeIndex != uart0Info.readIndex)
+    {
+        start = uart0Info.readIndex & (QUEUE_BUFFER_LENGTH - 1);
+        size = uart0Info.writeIndex - uart0Info.readIndex;
+        if (size > QUEUE_BUFFER_LENGTH - start)
+            size = QUEUE_BUFFER_LENGTH - start;
+
+        if (write(STDOUT_FILENO, &uart0Info.uart0String[start], size) < 0)
+            size = uart0Info.writeIndex - uart0Info.readIndex; // nowhere to write, drop the lot
+
+        if (uart0PaceBaud == 0)
+            uart0Info.readIndex += size;
+        else
+        {
+            us = ((uint64_t)size * 10 * 1000000) / uart0PaceBaud + 1;
+            timer.it_value.tv_sec = us / 1000000;
+            timer.it_value.tv_usec = us % 1000000;
+            uart0Info.dmaSize = size;
+            setitimer(ITIMER_REAL, &timer, NULL);
+        }
+    }
+}
+
+// stdin is readable, take what fits. At end of file the console goes quiet
+// and the stack keeps running.
+void uart0Isr(void)
+{
+    char buffer[UART0_RX_SIZE];
+    uint16_t room = UART0_RX_SIZE - (uint16_t)(uart0RxWrite - uart0RxRead);
+    ssize_t i, size;
+
+    size = read(STDIN_FILENO, buffer, room);
+    if (size <= 0)
+    {
+        hostRemoveSource(uart0Isr);
+        return;
+    }
+
+    for (i = 0; i < size; i++)
+        uart0Rx[(uart0RxWrite++) & (UART0_RX_SIZE - 1)] = buffer[i];
+
+    eventSet(EVENT_UART);
+}
@@ -0,0 +1,26 @@
+// wait.c
+// agent
+// Created on: October 18, 2026
+
+//-----------------------------------------------------------------------------
+// Host Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux
+// Stands in for:   IoT_Project/wait.c
+
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include "wait.h"
+
+// Sleeps instead of spinning, for the rest of the time if a signal (the
+// paced UART0 transmit) cuts the sleep short
+void waitMicrosecond(uint32_t us)
+{
+    struct timespec delay;
+
+    delay.tv_sec = us / 1000000;
+    delay.tv_nsec = (us % 1000000) * 1000;
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR);
+}